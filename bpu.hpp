@@ -0,0 +1,555 @@
+/*
+  bpu.hpp — header-only C++17 front-end for the BPU scheduling core
+
+  bpu::Engine<Config> runs the same pipeline as bpu_espidf.c (event queue
+  with coalescing -> job queue -> budgeted, backpressure-aware framing) but
+  every policy is a constexpr trait of Config:
+
+    - message types are bpu::Msg<...> entries of Config::types; push<M>()
+      resolves merge policy, tag and payload limit at compile time
+    - queue depths, budget, thresholds and wire version are constants, so
+      rings index with masks and dead branches are removed
+    - CRC tables and worst-case frame sizes come from constexpr functions,
+      and buffers are sized from the largest declared payload
+
+  Frames and counters are identical to bpu_espidf.c built with the same
+  wire version and run with enable_degrade = 0 (host/bpu_test_hpp.cpp).
+  State sync, batching, EDF, TTL, templates, bulk, spill, LOG and the
+  degradation ladder stay in the C core.
+*/
+
+#ifndef BPU_HPP_INCLUDED
+#define BPU_HPP_INCLUDED 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <array>
+#include <type_traits>
+#include <utility>
+
+namespace bpu {
+
+// -----------------------------------------------------------------------------
+// Traits
+// -----------------------------------------------------------------------------
+enum class Merge : uint8_t { None = 0, Last = 1 };
+enum class Degrade : uint8_t { Requeue = 0, Drop = 1 };
+
+// Priority classes (lower = more urgent), same values as BpuPrio
+enum : uint8_t { PRIO_NONE = 0, PRIO_CMD = 1, PRIO_SENSOR = 2, PRIO_HB = 3, PRIO_TELEM = 4 };
+
+// One message type: event code, job code, job payload tag, merge policy,
+// priority class, action on a budget miss, largest event payload
+template<uint8_t Evt, uint8_t Job, uint8_t Tag, Merge M, uint8_t Prio, Degrade D, uint16_t PayloadMax = 16>
+struct Msg {
+  static constexpr uint8_t evt = Evt;
+  static constexpr uint8_t job = Job;
+  static constexpr uint8_t tag = Tag;
+  static constexpr Merge merge = M;
+  static constexpr uint8_t prio = Prio;
+  static constexpr Degrade degrade = D;
+  static constexpr uint16_t payload_max = PayloadMax;
+};
+
+template<typename... Ms>
+struct Types {
+  static constexpr size_t count = sizeof...(Ms);
+};
+
+// The built-in demo types of bpu_espidf.c
+using Cmd    = Msg<1, 1, 0x04, Merge::None, PRIO_CMD,    Degrade::Requeue>;
+using Sensor = Msg<2, 2, 0x01, Merge::Last, PRIO_SENSOR, Degrade::Requeue>;
+using Hb     = Msg<3, 3, 0x02, Merge::Last, PRIO_HB,     Degrade::Requeue>;
+using Telem  = Msg<4, 4, 0x03, Merge::Last, PRIO_TELEM,  Degrade::Drop>;
+
+// Defaults matching the ESP-IDF example, except enable_degrade (see below);
+// derive and shadow what differs. Config::Io must provide:
+//   bool tx_free(size_t& free_out);
+//   bool tx_write_some(const uint8_t* p, size_t len, size_t& wrote_out);
+struct DefaultConfig {
+  using types = Types<Cmd, Sensor, Hb, Telem>;
+
+  static constexpr size_t evq_len = 8;      // power of two
+  static constexpr size_t jobq_len = 4;     // power of two
+
+  static constexpr uint16_t tx_budget_bytes = 200;
+  static constexpr uint16_t tx_min_free = 96;
+  static constexpr uint16_t tx_chunk_max = 64;
+  static constexpr uint16_t coalesce_window_ms = 20;
+  static constexpr uint16_t aged_ms = 200;
+
+  // true applies each type's Degrade action on a budget miss. The C core
+  // also runs its degradation ladder under that flag and the Engine does
+  // not, so the two only agree until the ladder leaves level 0.
+  static constexpr bool enable_degrade = false;
+
+  static constexpr uint8_t wire_version = 1;  // 1 or 2, as BPU_WIRE_VERSION
+  static constexpr uint16_t v2_crc8_max = 8;  // as BPU_V2_CRC8_MAX
+};
+
+// -----------------------------------------------------------------------------
+// constexpr wire helpers
+// -----------------------------------------------------------------------------
+constexpr std::array<uint16_t, 256> make_crc16_table(){
+  std::array<uint16_t, 256> t{};
+  for(unsigned i = 0; i < 256; i++){
+    uint16_t c = (uint16_t)(i << 8);
+    for(int b = 0; b < 8; b++) c = (c & 0x8000U) ? (uint16_t)((c << 1) ^ 0x1021U) : (uint16_t)(c << 1);
+    t[i] = c;
+  }
+  return t;
+}
+
+constexpr std::array<uint8_t, 256> make_crc8_table(){
+  std::array<uint8_t, 256> t{};
+  for(unsigned i = 0; i < 256; i++){
+    uint8_t c = (uint8_t)i;
+    for(int b = 0; b < 8; b++) c = (c & 0x80U) ? (uint8_t)((c << 1) ^ 0x07U) : (uint8_t)(c << 1);
+    t[i] = c;
+  }
+  return t;
+}
+
+inline constexpr std::array<uint16_t, 256> crc16_table = make_crc16_table();
+inline constexpr std::array<uint8_t, 256> crc8_table = make_crc8_table();
+
+// CRC16-CCITT (0x1021, init 0xFFFF), one table step per byte
+inline uint16_t crc16(const uint8_t* p, size_t n){
+  uint16_t crc = 0xFFFF;
+  for(size_t i = 0; i < n; i++) crc = (uint16_t)((crc << 8) ^ crc16_table[(uint8_t)((crc >> 8) ^ p[i])]);
+  return crc;
+}
+
+// CRC-8 (poly 0x07, init 0)
+inline uint8_t crc8(const uint8_t* p, size_t n){
+  uint8_t crc = 0;
+  for(size_t i = 0; i < n; i++) crc = crc8_table[(uint8_t)(crc ^ p[i])];
+  return crc;
+}
+
+static_assert(make_crc16_table()[1] == 0x1021 && make_crc8_table()[1] == 0x07, "CRC tables");
+
+constexpr size_t varint_len(uint32_t v){
+  size_t n = 1;
+  while(v >= 0x80U){ v >>= 7; n++; }
+  return n;
+}
+
+// Header bytes, check bytes and worst-case wire cost (COBS + delimiter) of a frame
+constexpr size_t frame_hdr(uint8_t wire, uint8_t type, uint16_t len){
+  return (wire == 2 && type < 32) ? 2 + varint_len(len) : 4;
+}
+
+constexpr size_t frame_check(uint8_t wire, uint8_t type, uint16_t len, uint16_t crc8_max){
+  return (wire == 2 && type < 32 && len <= crc8_max) ? 1 : 2;
+}
+
+constexpr size_t wire_cost(uint8_t wire, uint8_t type, uint16_t len, uint16_t crc8_max){
+  const size_t decoded = frame_hdr(wire, type, len) + len + frame_check(wire, type, len, crc8_max);
+  return decoded + decoded / 254 + 2 + 1;
+}
+
+static_assert(wire_cost(1, 2, 4, 8) == 13, "v1 cost matches bpu_frame_wire_cost");
+
+// COBS over [in, in+n) into out (caller sizes out for the worst case); returns length
+inline size_t cobs_encode(const uint8_t* in, size_t n, uint8_t* out){
+  size_t r = 0, w = 0;
+  for(;;){
+    size_t run_max = n - r;
+    if(run_max > 254) run_max = 254;
+    const void* z = memchr(in + r, 0, run_max);
+    const size_t run = z ? (size_t)((const uint8_t*)z - (in + r)) : run_max;
+    out[w] = (uint8_t)(run + 1);
+    memcpy(out + w + 1, in + r, run);
+    w += 1 + run;
+    r += run;
+    if(run < run_max) r++;            // zero implied by the code byte
+    else if(run != 254) break;        // end of input
+  }
+  return w;
+}
+
+// -----------------------------------------------------------------------------
+// Compile-time type-list queries
+// -----------------------------------------------------------------------------
+namespace detail {
+
+template<typename M, typename... Ms>
+constexpr uint8_t index_of(){
+  constexpr bool hit[] = { std::is_same<M, Ms>::value..., false };
+  for(uint8_t i = 0; i < sizeof...(Ms); i++) if(hit[i]) return i;
+  return 0xFF;
+}
+
+template<typename M> struct Tag { using type = M; };
+
+template<typename... Ms, typename F, size_t... I>
+inline void visit(uint8_t idx, F& f, std::index_sequence<I...>){
+  (void)(((idx == I) ? (f(Tag<Ms>{}), true) : false) || ...);
+}
+
+template<typename L> struct List;
+template<typename... Ms>
+struct List<Types<Ms...>> {
+  static constexpr size_t count = sizeof...(Ms);
+  static_assert(count > 0 && count < 255, "Config::types needs 1..254 messages");
+
+  template<typename M>
+  static constexpr uint8_t index = index_of<M, Ms...>();
+
+  static constexpr uint16_t payload_max = [](){
+    uint16_t m = 0;
+    for(uint16_t v : { Ms::payload_max... }) if(v > m) m = v;
+    return m;
+  }();
+
+  // Call f(Tag<M>{}) for the type at idx, once a record has left its
+  // push<M>() site: one branch per type, each compiled with M's constants
+  template<typename F>
+  static void visit(uint8_t idx, F&& f){
+    detail::visit<Ms...>(idx, f, std::index_sequence_for<Ms...>{});
+  }
+};
+
+} // namespace detail
+
+// Counters, named as in BpuStats
+struct Stats {
+  uint32_t tick = 0;
+  uint32_t ev_in = 0, ev_out = 0, ev_merge = 0, ev_drop = 0;
+  uint32_t job_in = 0, job_out = 0, job_merge = 0, job_drop = 0;
+  uint32_t tx_frame_sent = 0, tx_frame_partial = 0, tx_bytes = 0;
+  uint32_t tx_skip_budget = 0, tx_skip_backpressure = 0;
+  uint32_t flush_try = 0, flush_ok = 0;
+  uint32_t pick_sensor = 0, pick_hb = 0, pick_telem = 0, pick_aged = 0;
+  uint32_t aged_hit_sensor = 0, aged_hit_hb = 0, aged_hit_telem = 0;
+  uint32_t degrade_drop = 0, degrade_requeue = 0;
+};
+
+// Fixed ring, N a power of two
+template<typename T, size_t N>
+struct Ring {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "queue depth must be a power of two");
+  T buf[N];
+  uint16_t tail = 0, count = 0;
+
+  T& at(size_t i){ return buf[(tail + i) & (N - 1)]; }
+  bool full() const { return count == N; }
+  void push(const T& v){ buf[(tail + count) & (N - 1)] = v; count++; }
+  T& emplace(){ T& s = buf[(tail + count) & (N - 1)]; count++; return s; }
+  void pop(T& out){ out = buf[tail]; tail = (uint16_t)((tail + 1) & (N - 1)); count--; }
+};
+
+// -----------------------------------------------------------------------------
+// Engine
+// -----------------------------------------------------------------------------
+template<typename Config>
+class Engine {
+public:
+  using Io = typename Config::Io;
+  using L = detail::List<typename Config::types>;
+
+  static constexpr uint8_t wire = Config::wire_version;
+  static constexpr uint16_t evt_payload_max = L::payload_max;
+  static constexpr uint16_t job_payload_max = (uint16_t)(2 + L::payload_max);
+  static constexpr size_t decoded_max = 4 + job_payload_max + 2;  // v2 header <= 4 B for len <= 255
+  static constexpr size_t frame_wire_max = decoded_max + decoded_max / 254 + 2 + 1;
+
+  static_assert(wire == 1 || wire == 2, "wire_version is 1 or 2");
+  static_assert(L::payload_max > 0, "at least one message needs a payload");
+  static_assert(job_payload_max <= 255, "v1 frames carry an 8-bit length");
+  static_assert(frame_wire_max <= Config::tx_budget_bytes, "largest frame must fit one tick budget");
+
+  explicit Engine(Io& io) : io_(io) {}
+
+  // Queue one event of type M (payload clamped to M::payload_max)
+  template<typename M>
+  bool push(const uint8_t* payload, uint16_t len, uint32_t now_ms, uint16_t key = 0){
+    constexpr uint8_t idx = L::template index<M>;
+    static_assert(idx != 0xFF, "message type is not in Config::types");
+
+    count_prio(M::prio, st_.pick_sensor, st_.pick_hb, st_.pick_telem);
+    st_.ev_in++;
+
+    if(len > M::payload_max) len = M::payload_max;
+
+    if constexpr(M::merge != Merge::None && Config::coalesce_window_ms > 0){
+      // Newest queued event with the same (type, key)
+      for(size_t i = evq_.count; i-- > 0;){
+        Event& ex = evq_.at(i);
+        if(ex.idx == idx && ex.key == key){
+          if((uint32_t)(now_ms - ex.t_ms) > Config::coalesce_window_ms) break;
+          fill(ex, idx, key, payload, len, now_ms);
+          st_.ev_merge++;
+          return true;
+        }
+      }
+    }
+
+    if(evq_.full()){
+      st_.ev_drop++;
+      return false;
+    }
+    fill(evq_.emplace(), idx, key, payload, len, now_ms);
+    return true;
+  }
+
+  // Run one scheduling/flush cycle
+  void tick(uint32_t now_ms){
+    uint16_t budget = Config::tx_budget_bytes;
+    bool progress = false;
+
+    if(pending_len_) send_pending(budget, progress);
+    schedule_from_events(now_ms);
+    flush_jobs(budget);
+    st_.tick++;
+  }
+
+  const Stats& stats() const { return st_; }
+
+private:
+  struct Event {
+    uint8_t idx;
+    uint16_t len;
+    uint16_t key;
+    uint32_t t_ms;
+    uint8_t payload[evt_payload_max];
+  };
+
+  struct Job {
+    uint8_t idx;
+    uint16_t len;
+    uint16_t key;
+    uint32_t t_ms;
+    uint8_t payload[job_payload_max];
+  };
+
+  static void fill(Event& e, uint8_t idx, uint16_t key, const uint8_t* p, uint16_t len, uint32_t now_ms){
+    e.idx = idx;
+    e.len = len;
+    e.key = key;
+    e.t_ms = now_ms;
+    memcpy(e.payload, p, len);
+  }
+
+  static void count_prio(uint8_t prio, uint32_t& sensor, uint32_t& hb, uint32_t& telem){
+    if(prio == PRIO_SENSOR) sensor++;
+    else if(prio == PRIO_HB) hb++;
+    else if(prio == PRIO_TELEM) telem++;
+  }
+
+  template<typename M>
+  bool jobq_push_coalesce(const Job& j){
+    st_.job_in++;
+
+    if constexpr(M::merge != Merge::None){
+      for(size_t i = jobq_.count; i-- > 0;){
+        Job& ex = jobq_.at(i);
+        if(ex.idx == j.idx && ex.key == j.key){
+          ex = j;
+          st_.job_merge++;
+          return true;
+        }
+      }
+    }
+
+    if(jobq_.full()){
+      st_.job_drop++;
+      return false;
+    }
+    jobq_.push(j);
+    return true;
+  }
+
+  // Events -> jobs: [tag, len, payload...]
+  void schedule_from_events(uint32_t now_ms){
+    while(evq_.count){
+      Event e;
+      evq_.pop(e);
+      st_.ev_out++;
+
+      L::visit(e.idx, [&](auto t){
+        using M = typename decltype(t)::type;
+
+        if((uint32_t)(now_ms - e.t_ms) >= Config::aged_ms){
+          st_.pick_aged++;
+          count_prio(M::prio, st_.aged_hit_sensor, st_.aged_hit_hb, st_.aged_hit_telem);
+        }
+
+        Job j;
+        j.idx = e.idx;
+        j.key = e.key;
+        j.t_ms = e.t_ms;
+        j.payload[0] = M::tag;
+        j.payload[1] = (uint8_t)e.len;
+        memcpy(&j.payload[2], e.payload, e.len);
+        j.len = (uint16_t)(2 + e.len);
+        (void)jobq_push_coalesce<M>(j);
+      });
+    }
+  }
+
+  // Header, payload, check -> COBS -> 0x00 into the pending buffer
+  void build_frame(uint8_t type, const uint8_t* payload, uint16_t len){
+    uint8_t d[decoded_max];
+    size_t hdr;
+    size_t crc_n = 2;
+
+    if constexpr(wire == 2){
+      if(type < 32){
+        crc_n = frame_check(wire, type, len, Config::v2_crc8_max);
+        d[0] = (uint8_t)(0x40U | (crc_n == 1 ? 0x20U : 0x00U) | type);
+        d[1] = seq_;
+        hdr = 2;
+        uint32_t v = len;
+        while(v >= 0x80U){ d[hdr++] = (uint8_t)(v | 0x80U); v >>= 7; }
+        d[hdr++] = (uint8_t)v;
+      } else {
+        hdr = v1_header(d, type, len);
+      }
+    } else {
+      hdr = v1_header(d, type, len);
+    }
+    seq_++;
+
+    memcpy(&d[hdr], payload, len);
+
+    uint16_t crc;
+    if(d[0] == 0xB2U) crc = crc16(&d[1], hdr + len - 1);
+    else if(crc_n == 1) crc = crc8(d, hdr + len);
+    else crc = crc16(d, hdr + len);
+    d[hdr + len] = (uint8_t)(crc & 0xFF);
+    if(crc_n == 2) d[hdr + len + 1] = (uint8_t)(crc >> 8);
+
+    const size_t enc_len = cobs_encode(d, hdr + len + crc_n, pending_);
+    pending_[enc_len] = 0x00;
+    pending_len_ = (uint16_t)(enc_len + 1);
+    pending_pos_ = 0;
+  }
+
+  size_t v1_header(uint8_t* d, uint8_t type, uint16_t len){
+    d[0] = 0xB2;
+    d[1] = type;
+    d[2] = seq_;
+    d[3] = (uint8_t)len;
+    return 4;
+  }
+
+  // Drain the pending frame under budget and chunk limits
+  bool send_pending(uint16_t& budget, bool& progress){
+    progress = false;
+
+    while(pending_pos_ < pending_len_ && budget){
+      size_t want = (size_t)(pending_len_ - pending_pos_);
+      if(want > budget) want = budget;
+      if constexpr(Config::tx_chunk_max != 0){
+        if(want > Config::tx_chunk_max) want = Config::tx_chunk_max;
+      }
+
+      size_t wrote = 0;
+      if(!io_.tx_write_some(&pending_[pending_pos_], want, wrote)) return false;
+      if(wrote == 0){
+        st_.tx_skip_backpressure++;
+        break;
+      }
+      pending_pos_ = (uint16_t)(pending_pos_ + wrote);
+      budget = (uint16_t)(budget - wrote);
+      st_.tx_bytes += (uint32_t)wrote;
+      progress = true;
+    }
+
+    if(pending_pos_ >= pending_len_){
+      pending_len_ = pending_pos_ = 0;
+      st_.tx_frame_sent++;
+    } else if(progress){
+      st_.tx_frame_partial++;
+    }
+    return true;
+  }
+
+  template<typename M>
+  void requeue(const Job& j){
+    (void)jobq_push_coalesce<M>(j);
+  }
+
+  // One popped job of type M; false ends the flush for this tick
+  template<typename M>
+  bool flush_job(const Job& j, uint16_t& budget){
+    bool progress = false;
+
+    if(wire_cost(wire, M::job, j.len, Config::v2_crc8_max) > budget){
+      st_.tx_skip_budget++;
+      if constexpr(Config::enable_degrade && M::degrade == Degrade::Drop){
+        st_.degrade_drop++;
+      } else {
+        requeue<M>(j);
+        if constexpr(Config::enable_degrade) st_.degrade_requeue++;
+      }
+      return false;
+    }
+
+    size_t free_sz = 0;
+    if(!io_.tx_free(free_sz)){
+      requeue<M>(j);
+      st_.degrade_requeue++;
+      return false;
+    }
+    if(free_sz < Config::tx_min_free){
+      requeue<M>(j);
+      st_.degrade_requeue++;
+      st_.tx_skip_backpressure++;
+      return false;
+    }
+
+    build_frame(M::job, j.payload, j.len);
+
+    const uint16_t before = budget;
+    const bool ok = send_pending(budget, progress);
+    if(!ok || !progress){
+      requeue<M>(j);
+      pending_len_ = pending_pos_ = 0;
+      st_.degrade_requeue++;
+      if(ok) st_.tx_skip_backpressure++;
+      return false;
+    }
+    st_.flush_ok++;
+    return before != budget;
+  }
+
+  // Same decisions, in the same order, as bpu_flush_jobs()
+  void flush_jobs(uint16_t& budget){
+    bool more = true;
+
+    while(more && budget){
+      bool progress = false;
+
+      if(pending_len_){
+        if(!send_pending(budget, progress) || !progress) return;
+        continue;
+      }
+      if(jobq_.count == 0) return;
+
+      st_.flush_try++;
+      Job j;
+      jobq_.pop(j);
+      st_.job_out++;
+
+      L::visit(j.idx, [&](auto t){ more = flush_job<typename decltype(t)::type>(j, budget); });
+    }
+  }
+
+  Io& io_;
+  Ring<Event, Config::evq_len> evq_;
+  Ring<Job, Config::jobq_len> jobq_;
+  uint8_t pending_[frame_wire_max];
+  uint16_t pending_len_ = 0;
+  uint16_t pending_pos_ = 0;
+  uint8_t seq_ = 0;
+  Stats st_;
+};
+
+} // namespace bpu
+
+#endif
@@ -10,32 +10,240 @@
 typedef enum { BPU_RC_OK = 0, BPU_RC_ERR = 1 } BpuRc;
 
 // Event kinds produced by producers
-typedef enum { BPU_EVT_CMD = 1, BPU_EVT_SENSOR = 2, BPU_EVT_HB = 3, BPU_EVT_TELEM = 4 } BpuEvtType;
+typedef enum { BPU_EVT_CMD = 1, BPU_EVT_SENSOR = 2, BPU_EVT_HB = 3, BPU_EVT_TELEM = 4, BPU_EVT_SENSOR_BATCH = 5 } BpuEvtType;
 // Job kinds consumed by worker logic
-typedef enum { BPU_JOB_CMD = 1, BPU_JOB_SENSOR = 2, BPU_JOB_HB = 3, BPU_JOB_TELEM = 4 } BpuJobType;
+typedef enum { BPU_JOB_CMD = 1, BPU_JOB_SENSOR = 2, BPU_JOB_HB = 3, BPU_JOB_TELEM = 4, BPU_JOB_SENSOR_BATCH = 5, BPU_JOB_BULK = 6, BPU_JOB_LOG = 7 } BpuJobType;
+
+// Merge policy for queueing; SUM..AVG are per-field aggregating operators
+typedef enum {
+    BPU_MERGE_NONE = 0,
+    BPU_MERGE_LAST = 1,
+    BPU_MERGE_SUM = 2,
+    BPU_MERGE_MIN = 3,
+    BPU_MERGE_MAX = 4,
+    BPU_MERGE_COUNT = 5,
+    BPU_MERGE_AVG = 6
+} BpuMergePolicy;
+
+// Field encodings for aggregating merges (little-endian)
+typedef enum { BPU_FIELD_U8 = 0, BPU_FIELD_I8 = 1, BPU_FIELD_U16 = 2, BPU_FIELD_I16 = 3, BPU_FIELD_U32 = 4, BPU_FIELD_I32 = 5 } BpuFieldKind;
+
+// Typed field inside an event payload, merged with op during coalescing
+typedef struct {
+    uint8_t off;
+    uint8_t kind;
+    uint8_t op;
+} BpuField;
+
+// Type codes 0..63 share one descriptor table for events and jobs
+#define BPU_TYPE_MAX 64U
+
+// Priority class (lower value = more urgent), also selects per-class counters
+typedef enum { BPU_PRIO_NONE = 0, BPU_PRIO_CMD = 1, BPU_PRIO_SENSOR = 2, BPU_PRIO_HB = 3, BPU_PRIO_TELEM = 4 } BpuPrio;
+
+// Action when a job does not fit the tick budget (with enable_degrade)
+typedef enum { BPU_DEGRADE_REQUEUE = 0, BPU_DEGRADE_DROP = 1 } BpuDegrade;
+
+// Type descriptor flags
+#define BPU_TF_STATE 0x01U
+#define BPU_TF_BATCH 0x02U
+#define BPU_TF_ON_CHANGE 0x04U
+#define BPU_TF_TEMPLATE 0x08U
+#define BPU_TF_SPILL 0x10U
+
+// Degradation ladder: levels 0 (normal) .. BPU_LEVEL_MAX
+#ifndef BPU_LEVEL_MAX
+#define BPU_LEVEL_MAX 5U
+#endif
+#ifndef BPU_LADDER_UP_TICKS
+#define BPU_LADDER_UP_TICKS 4U
+#endif
+#ifndef BPU_LADDER_DOWN_TICKS
+#define BPU_LADDER_DOWN_TICKS 25U
+#endif
+
+// Producer feedback: default queue watermarks (percent) and the ticks
+// without a budget miss before the budget watermark clears
+#ifndef BPU_WM_HIGH_PCT
+#define BPU_WM_HIGH_PCT 75U
+#endif
+#ifndef BPU_WM_LOW_PCT
+#define BPU_WM_LOW_PCT 25U
+#endif
+#ifndef BPU_WM_COOL_TICKS
+#define BPU_WM_COOL_TICKS 10U
+#endif
+
+// Per-level admission action: keep all, keep 1 in 2^n, or stop the type
+typedef enum { BPU_SHED_KEEP = 0, BPU_SHED_HALF = 1, BPU_SHED_QUARTER = 2, BPU_SHED_EIGHTH = 3, BPU_SHED_DROP = 0xFF } BpuShed;
+
+// Type descriptor: event-side fields are read via the event type,
+// job-side fields (prio, degrade, ttl, deadline) via the job type.
+// Any merge other than NONE coalesces; fields (may be NULL) refine it.
+// BPU_TF_STATE types bypass the queues and live in the state table,
+// allocated from state_slot upward (lower slot = sent first); set the
+// flag on both the event and the job type code.
+// BPU_TF_BATCH types pack samples into delta-encoded batch jobs (merge
+// must be NONE); the job deadline_ms doubles as the batch hold time.
+// BPU_TF_ON_CHANGE job types skip frames equal to the last one sent (or
+// within deadband of its first field) until keepalive_ms has passed.
+// BPU_TF_TEMPLATE job types reuse a cached encoded frame for repeated
+// payloads, patching only seq and CRC.
+// BPU_TF_SPILL job types go to the spill store (if attached) instead of
+// being dropped when the job queue is full or the budget drops them.
+// shed[level] (job-side) is the admission action at each ladder level.
+typedef struct {
+    uint8_t merge;
+    uint8_t job;
+    uint8_t tag;
+    uint8_t prio;
+    uint8_t degrade;
+    uint16_t ttl_ms;
+    uint16_t deadline_ms;
+    uint8_t nfields;
+    const BpuField *fields;
+    uint8_t flags;
+    uint8_t state_slot;
+    uint8_t shed[BPU_LEVEL_MAX + 1U];
+    uint16_t keepalive_ms;
+    uint16_t deadband;
+} BpuTypeDesc;
+
+// Wire format: 1 = [0xB2, type, seq, len, payload, crc16]
+// 2 = [01 C TTTTT, seq, varint len, payload, crc8 (C=1) or crc16]; type < 32
+#ifndef BPU_WIRE_VERSION
+#define BPU_WIRE_VERSION 1U
+#endif
+#ifndef BPU_V2_CRC8_MAX
+#define BPU_V2_CRC8_MAX 8U
+#endif
+
+// Largest frame payload, job record payload, and derived buffer sizes
+#ifndef BPU_PAYLOAD_MAX
+#define BPU_PAYLOAD_MAX 64U
+#endif
+#ifndef BPU_JOB_PAYLOAD_LEN
+#define BPU_JOB_PAYLOAD_LEN 32U
+#endif
+#define BPU_FRAME_MAX (BPU_PAYLOAD_MAX + 7U)
+#define BPU_PENDING_MAX (BPU_FRAME_MAX + BPU_FRAME_MAX / 254U + 2U)
+
+// Queue depths and key index sizes (index: power of two, >= 2x depth)
+#ifndef BPU_EVQ_LEN
+#define BPU_EVQ_LEN 8U
+#endif
+#ifndef BPU_EVQ_IDX_LEN
+#define BPU_EVQ_IDX_LEN 16U
+#endif
+#ifndef BPU_JOBQ_LEN
+#define BPU_JOBQ_LEN 4U
+#endif
+#ifndef BPU_JOBQ_IDX_LEN
+#define BPU_JOBQ_IDX_LEN 8U
+#endif
+
+// State-sync table (one slot per type/key, at most 64 for the dirty mask)
+#ifndef BPU_STATE_SLOTS
+#define BPU_STATE_SLOTS 64U
+#endif
+#ifndef BPU_STATE_IDX_LEN
+#define BPU_STATE_IDX_LEN 128U
+#endif
+
+// Sample batching: open batches, samples per batch, default hold time
+#ifndef BPU_BATCH_SLOTS
+#define BPU_BATCH_SLOTS 2U
+#endif
+#ifndef BPU_BATCH_N
+#define BPU_BATCH_N 16U
+#endif
+#ifndef BPU_BATCH_HOLD_MS
+#define BPU_BATCH_HOLD_MS 500U
+#endif
+
+// Send-on-change filter: last-sent records kept per (type, key)
+#ifndef BPU_SOC_SLOTS
+#define BPU_SOC_SLOTS 16U
+#endif
+
+// Encoded-frame templates for constant-payload types
+#ifndef BPU_TPL_SLOTS
+#define BPU_TPL_SLOTS 4U
+#endif
 
-// Merge policy for queueing
-typedef enum { BPU_MERGE_NONE = 0, BPU_MERGE_LAST = 1 } BpuMergePolicy;
+// Bulk lane fragment: [id, flags, offset u32 LE, data...]
+#define BPU_BULK_HDR 6U
+#define BPU_BULK_F_LAST 0x01U
 
-// Event record (fixed payload)
+// Spill store: RAM write batch and most segments tracked
+// record: [0xA7, type, key u16, t_ms u32, n u16, len, payload, crc8]
+#ifndef BPU_SPILL_BUF
+#define BPU_SPILL_BUF 256U
+#endif
+#ifndef BPU_SPILL_SEG_MAX
+#define BPU_SPILL_SEG_MAX 32U
+#endif
+#define BPU_SPILL_MAGIC 0xA7U
+#define BPU_SPILL_REC_HDR 11U
+#define BPU_SPILL_REC_MAX (BPU_SPILL_REC_HDR + BPU_JOB_PAYLOAD_LEN + 1U)
+
+// Diagnostic LOG stream: byte ring drained with its own per-tick budget
+#ifndef BPU_LOG_RING
+#define BPU_LOG_RING 1024U
+#endif
+// Tokenised LOG record: varint id + up to BPU_LOG_ARGS_MAX varint arguments
+#define BPU_LOG_ARGS_MAX 12U
+
+// Timer wheel for periodic producers (64 slots of BPU_WHEEL_TICK_MS)
+#ifndef BPU_TIMER_MAX
+#define BPU_TIMER_MAX 16U
+#endif
+#ifndef BPU_WHEEL_TICK_MS
+#define BPU_WHEEL_TICK_MS 10U
+#endif
+#define BPU_WHEEL_SLOTS 64U
+#define BPU_TIMER_NONE 0xFFFFU
+// Slot of a timer in the list bpu_tick() is running (unlinked until relinked)
+#define BPU_WHEEL_DETACHED 0xFFU
+
+// Event record (fixed payload, key = caller-supplied source ID,
+// n = samples merged into it)
 typedef struct {
     uint8_t type;
     uint8_t flags;
     uint16_t len;
+    uint16_t key;
+    uint16_t n;
     uint32_t t_ms;
     uint8_t payload[16];
 } BpuEvent;
 
-// Job record (fixed payload)
+// Job record (fixed payload, t_ms = origin event time)
 typedef struct {
     uint8_t type;
     uint8_t flags;
     uint16_t len;
+    uint16_t key;
+    uint16_t n;
     uint32_t t_ms;
-    uint8_t payload[32];
+    uint8_t payload[BPU_JOB_PAYLOAD_LEN];
 } BpuJob;
 
-// Debug/telemetry counters
+// Open-addressing index entry: (type, key) -> ring slot
+typedef struct {
+    uint16_t key;
+    uint8_t type;
+    uint8_t used;
+    uint16_t slot;
+} BpuKeyEnt;
+
+// Reads of the published stats retry at most this often while a tick is
+// publishing (a reader that preempted the tick on its own core gives up)
+#ifndef BPU_STATS_RETRY
+#define BPU_STATS_RETRY 8U
+#endif
+
+// Debug/telemetry counters (uint32_t only: published word by word)
 typedef struct {
     uint32_t tick;
     uint32_t ev_in;
@@ -60,17 +268,99 @@ typedef struct {
     uint32_t aged_hit_sensor;
     uint32_t aged_hit_hb;
     uint32_t aged_hit_telem;
+    uint32_t edf_reorder;
+    uint32_t deadline_miss_cmd;
+    uint32_t deadline_miss_sensor;
+    uint32_t deadline_miss_hb;
+    uint32_t deadline_miss_telem;
+    uint32_t expired_ev;
+    uint32_t expired_job;
     uint32_t degrade_drop;
     uint32_t degrade_requeue;
     uint32_t pending_active;
     uint32_t pending_len;
     uint32_t pending_pos;
+    uint32_t preempt_abort;
+    uint32_t preempt_bytes;
     uint32_t dirty_mask_lo;
     uint32_t dirty_mask_hi;
+    uint32_t state_write;
+    uint32_t state_sent;
+    uint32_t state_full;
+    uint32_t state_dirty_lo;
+    uint32_t state_dirty_hi;
+    uint32_t batch_flush;
+    uint32_t batch_samples;
+    uint32_t suppressed;
+    uint32_t suppressed_bytes;
+    uint32_t tpl_hit;
+    uint32_t tpl_miss;
+    uint32_t tpl_fallback;
+    uint32_t bulk_frag;
+    uint32_t bulk_bytes;
+    uint32_t bulk_off;
+    uint32_t bulk_total;
+    uint32_t bulk_done;
+    uint32_t bulk_ms;
+    uint32_t spill_in;
+    uint32_t spill_out;
+    uint32_t spill_write;
+    uint32_t spill_bytes;
+    uint32_t spill_erase;
+    uint32_t spill_full;
+    uint32_t spill_bad;
+    uint32_t log_bytes;
+    uint32_t log_drop;
+    uint32_t log_drop_bytes;
+    uint32_t log_skip_backpressure;
+    uint32_t log_queued;
+    uint32_t log_queued_max;
+    uint32_t timer_fire;
+    uint32_t timer_late;
+    uint32_t level;
+    uint32_t level_up;
+    uint32_t level_down;
+    uint32_t shed;
+    uint32_t admit_reject;
+    uint32_t wm_queue_high;
+    uint32_t wm_budget_high;
+    uint32_t cap_records;
+    uint32_t cap_drop;
+    uint32_t level_ms[BPU_LEVEL_MAX + 1U];
     uint32_t work_us_last;
     uint32_t work_us_max;
 } BpuStats;
 
+// Per-phase tick profiling on the CPU cycle counter; 0 compiles the probes out
+#ifndef BPU_PROFILE
+#define BPU_PROFILE 0U
+#endif
+#ifndef BPU_PROFILE_BUCKETS
+#define BPU_PROFILE_BUCKETS 24U
+#endif
+
+// Profiled phases (exclusive time: a nested phase is not charged to its caller)
+typedef enum { BPU_PH_INGEST = 0, BPU_PH_SCHEDULE = 1, BPU_PH_SELECT = 2, BPU_PH_ENCODE = 3, BPU_PH_WRITE = 4 } BpuPhase;
+#define BPU_PH_COUNT 5U
+#define BPU_PH_NONE 0xFFU
+
+// Cycles spent in one phase per tick, over the ticks that entered it;
+// hist[i] counts ticks in [2^i, 2^(i+1)) cycles (0 lands in bucket 0, the last bucket is open)
+typedef struct {
+    uint32_t ticks;
+    uint32_t min;
+    uint32_t max;
+    uint32_t avg;
+    uint32_t sum_lo;
+    uint32_t sum_hi;
+    uint32_t hist[BPU_PROFILE_BUCKETS];
+} BpuPhaseProf;
+
+// Profile of all phases, indexed by BpuPhase
+typedef struct {
+    BpuPhaseProf ph[BPU_PH_COUNT];
+} BpuProfile;
+
 // IO callbacks provided by platform
 typedef struct {
     void *ctx;
@@ -87,45 +377,304 @@ typedef struct {
     uint16_t coalesce_window_ms;
     uint16_t aged_ms;
     uint8_t enable_degrade;
+    uint8_t enable_edf;
+    uint8_t enable_preempt;
+    uint8_t enable_admission;
 } BpuConfig;
 
-// Small ring buffer for events
+// Push outcome reported by bpu_push_event_ex()
+typedef enum { BPU_ADMIT_QUEUED = 0, BPU_ADMIT_MERGED = 1, BPU_ADMIT_SHED = 2, BPU_ADMIT_REJECTED = 3, BPU_ADMIT_DROPPED = 4 } BpuAdmit;
+
+// Producer feedback for one push: outcome (BpuAdmit), ladder level, fill of
+// the fuller queue in percent, what the next event of this type can expect
+// at the current level (BpuShed), and the predicted delay until its frame
+// is sent (0 = not known yet)
 typedef struct {
-    BpuEvent buf[8];
+    uint8_t admit;
+    uint8_t level;
+    uint8_t fill_pct;
+    uint8_t next_shed;
+    uint16_t delay_ms;
+} BpuPushResult;
+
+// Watermark edges: queue fill crossing high/low, tick budget missed/recovered
+typedef enum { BPU_WM_QUEUE_HIGH = 1, BPU_WM_QUEUE_LOW = 2, BPU_WM_BUDGET_HIGH = 3, BPU_WM_BUDGET_LOW = 4 } BpuWmEvent;
+
+// Watermark callback; runs inside push (queue edges) or tick (all edges)
+typedef void (*BpuWatermarkFn)(void *ctx, uint8_t event, uint8_t fill_pct);
+
+// Input capture for host replay (host/bpu_replay.c): one record per call,
+// a tag byte then u8 and unsigned varint fields; times are varint deltas
+// from the previous timed record (uint32 wrap), starting from 0
+#define BPU_CAP_INIT 0x01U  // budget, min_free, chunk_max, coalesce_window_ms, aged_ms; u8 enable bits (+0x10 io.time_us set); u8 wire version
+#define BPU_CAP_TYPE 0x02U  // u8 type merge job tag prio degrade; ttl, deadline; u8 flags slot shed[]; keepalive, deadband; u8 n, (off kind op)...
+#define BPU_CAP_PUSH 0x03U  // dt_ms; u8 type; key; u8 len; payload (pushed between ticks)
+#define BPU_CAP_TPUSH 0x04U // as PUSH, pushed by a timer producer inside the tick
+#define BPU_CAP_TICK 0x05U  // dt_ms; now_us
+#define BPU_CAP_FREE 0x06U  // u8 rc; free
+#define BPU_CAP_WRITE 0x07U // u8 rc; want; wrote
+#define BPU_CAP_TIME 0x08U  // u8 rc; us
+#define BPU_CAP_FIELDS_MAX 16U
+#define BPU_CAP_REC_MAX (32U + 3U * BPU_CAP_FIELDS_MAX)
+
+// Capture sink: store or forward one record; anything but BPU_RC_OK ends the capture
+typedef int (*BpuCaptureFn)(void *ctx, const uint8_t *rec, uint16_t len);
+
+// Ring buffer for events with last-value key index
+typedef struct {
+    BpuEvent buf[BPU_EVQ_LEN];
+    BpuKeyEnt idx[BPU_EVQ_IDX_LEN];
+    uint32_t wire;  // bpu_event_wire_cost() of all queued events
     uint16_t head;
     uint16_t tail;
     uint16_t count;
 } BpuEvRing;
 
-// Small ring buffer for jobs
+// Ring buffer for jobs with last-value key index and per-type occupancy
 typedef struct {
-    BpuJob buf[4];
+    BpuJob buf[BPU_JOBQ_LEN];
+    BpuKeyEnt idx[BPU_JOBQ_IDX_LEN];
+    uint16_t tcount[BPU_TYPE_MAX];
+    uint64_t tmask;
+    uint32_t wire;  // bpu_job_wire_cost() of all queued jobs
     uint16_t head;
     uint16_t tail;
     uint16_t count;
 } BpuJobRing;
 
+// Last-value state table flushed by dirty bit
+typedef struct {
+    BpuJob slot[BPU_STATE_SLOTS];
+    BpuKeyEnt idx[BPU_STATE_IDX_LEN];
+    uint64_t used;
+    uint64_t dirty;
+} BpuStateTable;
+
+// Open sample batch: varint t0, zigzag v0, then (varint dt, zigzag dv)...
+typedef struct {
+    uint8_t used;
+    uint8_t type;
+    uint16_t key;
+    uint16_t n;
+    uint16_t len;
+    uint32_t t0_ms;
+    uint32_t t_last_ms;
+    int32_t v_last;
+    uint8_t buf[BPU_JOB_PAYLOAD_LEN - 2U];
+} BpuBatch;
+
+// Last transmitted payload of an on-change (type, key)
+typedef struct {
+    uint32_t hash;
+    uint32_t t_ms;
+    int32_t v;
+    uint16_t key;
+    uint8_t type;
+    uint8_t used;
+} BpuSentEnt;
+
+// Pre-encoded frame plus the CRC terms needed to patch in a new seq
+typedef struct {
+    uint8_t enc[BPU_PENDING_MAX];
+    uint8_t payload[BPU_PAYLOAD_MAX];
+    uint32_t hash;
+    uint16_t enc_len;
+    uint16_t len;
+    uint16_t crc0;
+    uint16_t dseq[8];
+    uint16_t pos_crc;
+    uint8_t pos_seq;
+    uint8_t crc_n;
+    uint8_t type;
+    uint8_t used;
+} BpuTemplate;
+
+// Bulk source: copy up to max bytes starting at offset; got_out = 0 means no data
+typedef int (*BpuBulkPullFn)(void *ctx, uint32_t offset, uint8_t *buf, uint16_t max, uint16_t *got_out);
+
+// Active bulk transfer (one at a time)
+typedef struct {
+    BpuBulkPullFn fn;
+    void *ctx;
+    uint32_t total;
+    uint32_t off;
+    uint32_t t_last_ms;
+    uint8_t id;
+    uint8_t active;
+    uint8_t timed;
+} BpuBulk;
+
+// Spill backend: seg_count segments of seg_size bytes (flash partition,
+// file). write only appends inside a segment; erase resets a segment
+// before it is rewritten; read returns bytes written earlier.
+typedef struct {
+    void *ctx;
+    int (*read)(void *ctx, uint16_t seg, uint32_t off, uint8_t *p, size_t len);
+    int (*write)(void *ctx, uint16_t seg, uint32_t off, const uint8_t *p, size_t len);
+    int (*erase)(void *ctx, uint16_t seg);
+    uint32_t seg_size;
+    uint16_t seg_count;
+} BpuSpillIo;
+
+// Append-only segment log (read side rd_*, write side wr_*) plus the RAM
+// batch of records not yet written (buf_rd..buf_len, newest last)
+typedef struct {
+    BpuSpillIo io;
+    uint32_t seg_end[BPU_SPILL_SEG_MAX];
+    uint32_t rd_off;
+    uint32_t wr_off;
+    uint16_t rd_seg;
+    uint16_t wr_seg;
+    uint16_t buf_rd;
+    uint16_t buf_len;
+    uint8_t buf[BPU_SPILL_BUF];
+    uint8_t wr_open;
+    uint8_t attached;
+} BpuSpill;
+
+// LOG output: messages are queued whole or dropped whole, and drained
+// to io with at most budget bytes per tick
+typedef struct {
+    BpuIo io;
+    uint8_t buf[BPU_LOG_RING];
+    uint16_t head;
+    uint16_t tail;
+    uint16_t count;
+    uint16_t budget;
+    uint8_t seq;
+    uint8_t attached;
+} BpuLog;
+
+// Producer callback: fill payload (len_io: capacity in, length out);
+// return BPU_RC_OK to push the event, anything else to skip this period
+typedef int (*BpuTimerFn)(void *ctx, uint32_t now_ms, uint8_t *payload, uint16_t *len_io);
+
+// Periodic producer registered on the wheel
+typedef struct {
+    BpuTimerFn fn;
+    void *ctx;
+    uint32_t period_ms;
+    uint32_t due_ms;
+    uint16_t next;
+    uint16_t prev;
+    uint16_t key;
+    uint8_t evt_type;
+    uint8_t slot;
+} BpuTimer;
+
+// Hashed timer wheel: per-slot lists plus an occupancy mask. cur_tick counts
+// wheel ticks since init and cur_ms is the time that tick started; both are
+// advanced by elapsed time, so they wrap safely with now_ms
+typedef struct {
+    BpuTimer t[BPU_TIMER_MAX];
+    uint16_t head[BPU_WHEEL_SLOTS];
+    uint64_t occupied;
+    uint32_t cur_tick;
+    uint32_t cur_ms;
+} BpuWheel;
+
+// Degradation ladder state (pressure hysteresis and decimation phase)
+typedef struct {
+    uint8_t level;
+    uint8_t hot;
+    uint8_t cool;
+    uint8_t have_last;
+    uint32_t last_ms;
+    uint8_t decim[BPU_TYPE_MAX];
+} BpuLadder;
+
+// Producer feedback state: watermark edges and the measured tick period
+typedef struct {
+    BpuWatermarkFn fn;
+    void *ctx;
+    uint8_t high_pct;
+    uint8_t low_pct;
+    uint8_t queue_high;
+    uint8_t budget_high;
+    uint8_t cool;
+    uint8_t have_last;
+    uint16_t tick_ms;
+    uint32_t last_ms;
+} BpuPressure;
+
+// Capture state: while attached, Bpu.io holds recording wrappers around io
+typedef struct {
+    BpuCaptureFn fn;
+    void *ctx;
+    BpuIo io;
+    uint32_t last_ms;
+    uint8_t attached;
+    uint8_t in_tick;
+} BpuCapture;
+
 // Main BPU state (no heap)
 typedef struct {
     BpuIo io;
     BpuConfig cfg;
     BpuStats st;
+    BpuStats pub;
+    uint32_t pub_seq;
+    BpuTypeDesc types[BPU_TYPE_MAX];
     BpuEvRing evq;
     BpuJobRing jobq;
-    uint8_t pending_buf[4 + 64 + 2 + 16 + 1];
+    BpuStateTable state;
+    BpuWheel wheel;
+    BpuLadder ladder;
+    BpuPressure press;
+    BpuCapture cap;
+    BpuBatch batch[BPU_BATCH_SLOTS];
+    BpuSentEnt sent[BPU_SOC_SLOTS];
+    BpuTemplate tpl[BPU_TPL_SLOTS];
+    uint8_t tpl_next;
+    BpuBulk bulk;
+    BpuSpill spill;
+    BpuLog log;
+    uint8_t pending_buf[BPU_PENDING_MAX];
     uint16_t pending_len;
     uint16_t pending_pos;
     uint8_t pending_have;
+    uint8_t pending_preempt;
+    uint8_t pending_note;
+    BpuJob pending_job;
+#if BPU_PROFILE
+    BpuProfile prof;
+    BpuProfile prof_pub;
+    uint32_t prof_acc[BPU_PH_COUNT];
+    uint32_t prof_mark;
+    uint8_t prof_cur;
+    uint8_t prof_hit;
+#endif
     uint8_t seq;
     uint32_t init_magic;
 } Bpu;
 
 // Public API
 int bpu_init(Bpu *bpu, const BpuIo *io, const BpuConfig *cfg);
+int bpu_register_type(Bpu *bpu, uint8_t type, const BpuTypeDesc *desc);
 int bpu_push_event(Bpu *bpu, uint8_t evt_type, const uint8_t *payload, uint16_t len, uint32_t now_ms);
+int bpu_push_event_keyed(Bpu *bpu, uint8_t evt_type, uint16_t key, const uint8_t *payload, uint16_t len, uint32_t now_ms);
+int bpu_push_event_ex(Bpu *bpu, uint8_t evt_type, uint16_t key, const uint8_t *payload, uint16_t len, uint32_t now_ms,
+                      BpuPushResult *out);
+int bpu_watermark_set(Bpu *bpu, uint8_t high_pct, uint8_t low_pct, BpuWatermarkFn fn, void *ctx);
 int bpu_tick(Bpu *bpu, uint32_t now_ms);
 int bpu_tick_ex(Bpu *bpu, uint32_t now_ms, uint32_t now_us);
+// Snapshot published at the end of the last tick: events pushed since then
+// are not in ev_in (or any other counter) until the next tick completes
 int bpu_get_stats(const Bpu *bpu, BpuStats *out);
+int bpu_timer_add(Bpu *bpu, uint8_t evt_type, uint16_t key, uint32_t period_ms, uint32_t first_ms,
+                  BpuTimerFn fn, void *ctx, uint16_t *id_out);
+int bpu_timer_remove(Bpu *bpu, uint16_t id);
+int bpu_timer_next(const Bpu *bpu, uint32_t *next_ms_out);
+int bpu_bulk_start(Bpu *bpu, uint8_t id, uint32_t total_len, BpuBulkPullFn fn, void *ctx);
+int bpu_bulk_seek(Bpu *bpu, uint32_t offset);
+int bpu_bulk_cancel(Bpu *bpu);
+int bpu_spill_attach(Bpu *bpu, const BpuSpillIo *io);
+int bpu_log_attach(Bpu *bpu, const BpuIo *io, uint16_t budget_bytes);
+int bpu_log_write(Bpu *bpu, const uint8_t *p, uint16_t len);
+int bpu_log_tok(Bpu *bpu, uint16_t id, const uint32_t *args, uint8_t nargs);
+int bpu_get_profile(const Bpu *bpu, BpuProfile *out);
+int bpu_profile_reset(Bpu *bpu);
+int bpu_capture_attach(Bpu *bpu, BpuCaptureFn fn, void *ctx);
 
 // End of public header section
 #endif
@@ -133,44 +682,229 @@ int bpu_get_stats(const Bpu *bpu, BpuStats *out);
 // Implementation section (compiled unless DECLARE_ONLY)
 #if !defined(BPU_ESPIDF_DECLARE_ONLY)
 
+#include <string.h>
+
+// COBS zero scan: 1 = 32-bit SWAR words (plus SSE2/AVX2 blocks when the x86
+// build enables them), 0 = plain byte loop
+#ifndef BPU_COBS_FAST
+#define BPU_COBS_FAST 1U
+#endif
+#if BPU_COBS_FAST && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
+
+// Key index tables must be powers of two with spare room
+typedef char bpu_evq_idx_check[((BPU_EVQ_IDX_LEN & (BPU_EVQ_IDX_LEN - 1U)) == 0U && BPU_EVQ_IDX_LEN >= 2U * BPU_EVQ_LEN) ? 1 : -1];
+typedef char bpu_jobq_idx_check[((BPU_JOBQ_IDX_LEN & (BPU_JOBQ_IDX_LEN - 1U)) == 0U && BPU_JOBQ_IDX_LEN >= 2U * BPU_JOBQ_LEN) ? 1 : -1];
+// A tokenised LOG record must fit one frame payload
+typedef char bpu_log_tok_check[(BPU_PAYLOAD_MAX >= 3U + 5U * BPU_LOG_ARGS_MAX) ? 1 : -1];
+// Stats are copied as an array of 32-bit words
+typedef char bpu_stats_word_check[(sizeof(BpuStats) % sizeof(uint32_t) == 0U) ? 1 : -1];
+
+// Seqlock accessors for the published stats: GCC/Clang atomics (ESP-IDF,
+// host); other compilers get volatile accesses, safe on one core only
+#if defined(__GNUC__)
+#define BPU_LOAD_ACQ(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define BPU_LOAD_RLX(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define BPU_STORE_REL(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define BPU_STORE_RLX(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define BPU_FENCE_ACQ() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define BPU_FENCE_REL() __atomic_thread_fence(__ATOMIC_RELEASE)
+#else
+#define BPU_LOAD_ACQ(p) (*(const volatile uint32_t *)(p))
+#define BPU_LOAD_RLX(p) (*(const volatile uint32_t *)(p))
+#define BPU_STORE_REL(p, v) (*(volatile uint32_t *)(p) = (v))
+#define BPU_STORE_RLX(p, v) (*(volatile uint32_t *)(p) = (v))
+#define BPU_FENCE_ACQ() ((void)0)
+#define BPU_FENCE_REL() ((void)0)
+#endif
+
+// Profiling probes: ENTER saves the running phase in prev, LEAVE restores it
+#if BPU_PROFILE
+#define BPU_PROF_ENTER(b, ph, prev) ((prev) = bpu_prof_switch((b), (uint8_t)(ph)))
+#define BPU_PROF_LEAVE(b, prev) ((void)bpu_prof_switch((b), (prev)))
+#else
+#define BPU_PROF_ENTER(b, ph, prev) ((prev) = BPU_PH_NONE)
+#define BPU_PROF_LEAVE(b, prev) ((void)(prev))
+#endif
+
 // CRC16-CCITT for framing
 static uint16_t bpu_crc16_ccitt(const uint8_t *data, size_t len);
 static size_t bpu_cobs_encode(const uint8_t *input, size_t length, uint8_t *output, size_t out_max);
+static size_t bpu_zero_scan(const uint8_t *p, size_t n);
 
 // Internal helper declarations
-static BpuMergePolicy bpu_policy_for(uint8_t type);
-static uint8_t bpu_job_for_evt(uint8_t evt_type);
+static void bpu_count_prio(uint8_t prio, uint32_t *cmd, uint32_t *sensor, uint32_t *hb, uint32_t *telem);
+
+// Key index helpers (linear probing, backward-shift delete)
+static uint16_t bpu_kidx_hash(uint8_t type, uint16_t key, uint16_t mask);
+static bool bpu_kidx_find(const BpuKeyEnt *t, uint16_t mask, uint8_t type, uint16_t key, uint16_t *slot_out);
+static void bpu_kidx_put(BpuKeyEnt *t, uint16_t mask, uint8_t type, uint16_t key, uint16_t slot);
+static bool bpu_kidx_del(BpuKeyEnt *t, uint16_t mask, uint8_t type, uint16_t key, uint16_t slot);
+static void bpu_kidx_clear(BpuKeyEnt *t, uint16_t n);
 
 // Event ring helpers
 static int bpu_evr_push(BpuEvRing *r, const BpuEvent *v);
 static int bpu_evr_pop(BpuEvRing *r, BpuEvent *out);
-static BpuEvent *bpu_evr_at(BpuEvRing *r, uint16_t i);
+static BpuEvent *bpu_evr_find(BpuEvRing *r, uint8_t type, uint16_t key);
 
 // Job ring helpers
 static int bpu_jor_push(BpuJobRing *r, const BpuJob *v);
 static int bpu_jor_pop(BpuJobRing *r, BpuJob *out);
 static BpuJob *bpu_jor_at(BpuJobRing *r, uint16_t i);
+static BpuJob *bpu_jor_find(BpuJobRing *r, uint8_t type, uint16_t key);
+static int bpu_jor_remove_at(BpuJobRing *r, uint16_t i, BpuJob *out);
+
+// Aggregating merge helpers
+static int64_t bpu_field_get(const uint8_t *p, uint8_t kind);
+static void bpu_field_put(uint8_t *p, uint8_t kind, int64_t v);
+static uint8_t bpu_field_width(uint8_t kind);
+static void bpu_merge_payload(const BpuTypeDesc *d, uint8_t *dst, uint16_t dst_len, uint16_t dst_n,
+                              const uint8_t *src, uint16_t src_len, uint16_t src_n, uint16_t base);
 
 // Coalescing queue helpers
 static int bpu_evq_push_coalesce(Bpu *bpu, const BpuEvent *e);
 static int bpu_evq_pop(Bpu *bpu, BpuEvent *out);
 
+static bool bpu_jobq_slot_held(const Bpu *bpu, const BpuJob *j);
 static int bpu_jobq_push_coalesce(Bpu *bpu, const BpuJob *j);
 static int bpu_jobq_pop(Bpu *bpu, BpuJob *out);
+static int bpu_jobq_pop_edf(Bpu *bpu, uint16_t budget_left, BpuJob *out);
+
+// Deadline helpers
+static size_t bpu_job_wire_cost(const BpuJob *j);
+static size_t bpu_event_wire_cost(const Bpu *bpu, const BpuEvent *e);
+static void bpu_evq_rewire(Bpu *bpu);
+static bool bpu_job_deadline(const Bpu *bpu, const BpuJob *j, uint32_t *dl_out);
+static void bpu_note_deadline(Bpu *bpu, const BpuJob *j, uint32_t now_ms);
+
+// TTL expiry helpers
+static bool bpu_expired(const Bpu *bpu, uint8_t job_type, uint32_t t_ms, uint32_t now_ms);
+static void bpu_jobq_expire(Bpu *bpu, uint32_t now_ms);
 
 // Dirty-bit tracking
 static uint64_t bpu_bit64(uint8_t n);
+static uint8_t bpu_ctz64(uint64_t m);
 static uint64_t bpu_dirty_mask(const Bpu *bpu);
 
+// State-sync helpers
+static int bpu_state_write(Bpu *bpu, const BpuJob *j);
+static int bpu_state_take(Bpu *bpu, BpuJob *out);
+static void bpu_state_expire(Bpu *bpu, uint32_t now_ms);
+static void bpu_requeue_job(Bpu *bpu, const BpuJob *j);
+
+// Timer wheel helpers
+static uint32_t bpu_wheel_due_tick(const BpuWheel *w, uint32_t due_ms);
+static void bpu_wheel_link(BpuWheel *w, uint16_t id);
+static void bpu_wheel_unlink(BpuWheel *w, uint16_t id);
+static void bpu_timer_fire(Bpu *bpu, uint16_t id, uint32_t now_ms);
+static void bpu_timers_run(Bpu *bpu, uint32_t now_ms);
+
+// Degradation ladder helpers
+static bool bpu_shed_event(Bpu *bpu, uint8_t evt_type);
+static void bpu_ladder_purge(Bpu *bpu);
+static void bpu_ladder_update(Bpu *bpu, uint32_t now_ms, uint32_t skips);
+
+// CMD preemption helpers
+static bool bpu_cmd_waiting(const Bpu *bpu);
+static void bpu_preempt_put_back(Bpu *bpu, const BpuJob *j);
+static void bpu_preempt(Bpu *bpu, uint32_t now_ms);
+
+// Sample batching helpers
+static uint8_t bpu_varint_put(uint8_t *p, uint32_t v);
+static uint32_t bpu_zigzag(int32_t v);
+static int32_t bpu_batch_sample(const Bpu *bpu, const BpuEvent *e);
+static void bpu_batch_start(BpuBatch *b, const BpuEvent *e, int32_t v);
+static void bpu_batch_flush(Bpu *bpu, BpuBatch *b);
+static void bpu_batch_add(Bpu *bpu, const BpuEvent *e);
+static void bpu_batch_expire(Bpu *bpu, uint32_t now_ms);
+
+// Send-on-change helpers
+static uint32_t bpu_fnv1a(const uint8_t *p, uint16_t n);
+static int32_t bpu_job_field0(const Bpu *bpu, const BpuJob *j);
+static BpuSentEnt *bpu_soc_find(Bpu *bpu, uint8_t type, uint16_t key);
+static bool bpu_soc_suppress(Bpu *bpu, const BpuJob *j, uint32_t now_ms);
+static void bpu_soc_note(Bpu *bpu, const BpuJob *j, uint32_t now_ms);
+static void bpu_pending_done(Bpu *bpu, uint32_t now_ms);
+static int bpu_next_job(Bpu *bpu, uint16_t budget_left, uint32_t now_ms, BpuJob *out);
+
+// Frame template cache helpers
+static bool bpu_tpl_emit(Bpu *bpu, uint8_t type, const uint8_t *payload, uint16_t len);
+static void bpu_tpl_store(Bpu *bpu, uint8_t *decoded, uint8_t hdr, uint16_t len, uint8_t crc_n, uint16_t enc_len);
+
+// Wire header helpers
+static uint8_t bpu_crc8(const uint8_t *data, size_t len);
+static uint8_t bpu_frame_header(uint8_t *d, uint8_t type, uint8_t seq, uint16_t len, uint8_t *crc_n_out);
+static uint16_t bpu_frame_check(const uint8_t *d, size_t n, uint8_t crc_n);
+
+// Bulk lane helpers
+static size_t bpu_frame_wire_cost(uint8_t type, uint16_t len);
+static void bpu_bulk_run(Bpu *bpu, uint32_t now_ms, uint16_t *budget_left);
+
+// Spill store helpers
+static bool bpu_spill_open(Bpu *bpu, uint16_t seg);
+static bool bpu_spill_write_batch(Bpu *bpu);
+static bool bpu_spill_put(Bpu *bpu, const BpuJob *j);
+static bool bpu_spill_peek(Bpu *bpu, BpuJob *out, uint16_t *size_out, bool *from_buf_out);
+static void bpu_spill_run(Bpu *bpu, uint16_t *budget_left);
+
+// LOG stream helpers
+static void bpu_log_drain(Bpu *bpu);
+
+// Producer feedback helpers
+static uint8_t bpu_fill_pct(const Bpu *bpu);
+static uint16_t bpu_predict_delay(Bpu *bpu, uint8_t evt_type, uint16_t len);
+static void bpu_wm_queue(Bpu *bpu);
+static void bpu_wm_tick(Bpu *bpu, uint32_t now_ms, bool missed);
+
+// Stats publication (single writer: the task that runs bpu_tick)
+static void bpu_stats_publish(Bpu *bpu);
+static void bpu_words_store(uint32_t *dst, const uint32_t *src, size_t words);
+static int bpu_words_read(const Bpu *bpu, const uint32_t *src, uint32_t *dst, size_t words);
+
+// Input capture
+static void bpu_cap_emit(Bpu *bpu, const uint8_t *rec, uint16_t len);
+static uint8_t bpu_cap_dt(Bpu *bpu, uint8_t *p, uint32_t now_ms);
+static void bpu_cap_type(Bpu *bpu, uint8_t type);
+static void bpu_cap_push(Bpu *bpu, uint8_t evt_type, uint16_t key, const uint8_t *payload, uint16_t len, uint32_t now_ms);
+static void bpu_cap_tick(Bpu *bpu, uint32_t now_ms, uint32_t now_us);
+static int bpu_cap_tx_free(void *ctx, size_t *free_out);
+static int bpu_cap_tx_write_some(void *ctx, const uint8_t *p, size_t len, size_t *wrote_out);
+static int bpu_cap_time_us(void *ctx, uint32_t *us_out);
+
+#if BPU_PROFILE
+// Phase profiling
+static uint32_t bpu_prof_now(Bpu *bpu);
+static uint8_t bpu_prof_switch(Bpu *bpu, uint8_t ph);
+static void bpu_prof_fold(Bpu *bpu);
+static void bpu_prof_clear(Bpu *bpu);
+#endif
+
 // Framing and TX helpers
-static int bpu_build_frame(Bpu *bpu, uint8_t type, const uint8_t *payload, uint8_t len);
+static int bpu_build_frame(Bpu *bpu, uint8_t type, const uint8_t *payload, uint16_t len);
 static int bpu_send_pending(Bpu *bpu, uint16_t *budget_left, bool *progress_out);
+static void bpu_job_from_event(const Bpu *bpu, const BpuEvent *e, BpuJob *j);
+static int bpu_convert_event(Bpu *bpu, const BpuEvent *e, uint32_t now_ms);
 static int bpu_schedule_from_events(Bpu *bpu, uint32_t now_ms);
 static int bpu_flush_jobs(Bpu *bpu, uint32_t now_ms, uint16_t *budget_left);
 
 // Timing helpers
 static int bpu_try_time_us(Bpu *bpu, uint32_t *us_out);
 
+// Built-in descriptors for the demo types
+// (merge, job, tag, prio, degrade, ttl, deadline, fields, flags, state_slot, shed, keepalive, deadband)
+// Ladder: 1 SENSOR 1/2, 2 SENSOR 1/4, 3 stop TELEM, 4 HB only, 5 CMD only
+static const BpuTypeDesc bpu_type_default = { BPU_MERGE_NONE, 0U, 0x00U, BPU_PRIO_NONE, BPU_DEGRADE_REQUEUE, 0U, 0U, 0U, NULL, 0U, 0U, { 0U }, 0U, 0U };
+static const BpuTypeDesc bpu_type_cmd = { BPU_MERGE_NONE, BPU_JOB_CMD, 0x04U, BPU_PRIO_CMD, BPU_DEGRADE_REQUEUE, 0U, 0U, 0U, NULL, 0U, 0U, { 0U }, 0U, 0U };
+static const BpuTypeDesc bpu_type_sensor = { BPU_MERGE_LAST, BPU_JOB_SENSOR, 0x01U, BPU_PRIO_SENSOR, BPU_DEGRADE_REQUEUE, 0U, 0U, 0U, NULL, 0U, 0U,
+                                             { BPU_SHED_KEEP, BPU_SHED_HALF, BPU_SHED_QUARTER, BPU_SHED_QUARTER, BPU_SHED_DROP, BPU_SHED_DROP }, 0U, 0U };
+static const BpuTypeDesc bpu_type_hb = { BPU_MERGE_LAST, BPU_JOB_HB, 0x02U, BPU_PRIO_HB, BPU_DEGRADE_REQUEUE, 0U, 0U, 0U, NULL, 0U, 0U,
+                                         { BPU_SHED_KEEP, BPU_SHED_KEEP, BPU_SHED_KEEP, BPU_SHED_KEEP, BPU_SHED_KEEP, BPU_SHED_DROP }, 0U, 0U };
+static const BpuTypeDesc bpu_type_telem = { BPU_MERGE_LAST, BPU_JOB_TELEM, 0x03U, BPU_PRIO_TELEM, BPU_DEGRADE_DROP, 0U, 0U, 0U, NULL, 0U, 0U,
+                                            { BPU_SHED_KEEP, BPU_SHED_KEEP, BPU_SHED_KEEP, BPU_SHED_DROP, BPU_SHED_DROP, BPU_SHED_DROP }, 0U, 0U };
+static const BpuTypeDesc bpu_type_sensor_batch = { BPU_MERGE_NONE, BPU_JOB_SENSOR_BATCH, 0x05U, BPU_PRIO_SENSOR, BPU_DEGRADE_REQUEUE, 0U, 0U, 0U, NULL, BPU_TF_BATCH, 0U,
+                                                   { BPU_SHED_KEEP, BPU_SHED_HALF, BPU_SHED_QUARTER, BPU_SHED_QUARTER, BPU_SHED_DROP, BPU_SHED_DROP }, 0U, 0U };
+
 // Compute CRC16 over raw bytes
 static uint16_t bpu_crc16_ccitt(const uint8_t *data, size_t len)
 {
@@ -201,14 +935,74 @@ static uint16_t bpu_crc16_ccitt(const uint8_t *data, size_t len)
     return crc;
 }
 
-// Encode payload using COBS
+// Index of the first zero byte in p[0..n), or n if there is none
+static size_t bpu_zero_scan(const uint8_t *p, size_t n)
+{
+    size_t i;
+#if BPU_COBS_FAST
+    bool found;
+#endif
+
+    i = 0U;
+
+#if BPU_COBS_FAST
+    found = false;
+
+#if defined(__AVX2__)
+    while (!found && i + 32U <= n) {
+        uint32_t m;
+
+        m = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(const void *)&p[i]), _mm256_setzero_si256()));
+        if (m != 0U) {
+            i += (size_t)bpu_ctz64((uint64_t)m);
+            found = true;
+        } else {
+            i += 32U;
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    while (!found && i + 16U <= n) {
+        uint32_t m;
+
+        m = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(const void *)&p[i]), _mm_setzero_si128()));
+        if (m != 0U) {
+            i += (size_t)bpu_ctz64((uint64_t)m);
+            found = true;
+        } else {
+            i += 16U;
+        }
+    }
+#endif
+    // Classic has-zero-byte test; a hit only narrows the byte loop below
+    while (!found && i + 4U <= n) {
+        uint32_t w;
+
+        memcpy(&w, &p[i], 4U);
+        if (((w - 0x01010101U) & ~w & 0x80808080U) != 0U) {
+            found = true;
+        } else {
+            i += 4U;
+        }
+    }
+#endif
+
+    while (i < n && p[i] != 0U) {
+        i++;
+    }
+
+    return i;
+}
+
+// Encode payload using COBS (one zero scan and one run copy per block)
 static size_t bpu_cobs_encode(const uint8_t *input, size_t length, uint8_t *output, size_t out_max)
 {
     size_t out_len;
     size_t read_index;
     size_t write_index;
-    size_t code_index;
-    uint8_t code;
+    size_t run_max;
+    size_t run;
+    bool done;
     int rc;
 
     out_len = 0U;
@@ -228,101 +1022,215 @@ static size_t bpu_cobs_encode(const uint8_t *input, size_t length, uint8_t *outp
 
     if (rc == BPU_RC_OK) {
         read_index = 0U;
-        write_index = 1U;
-        code_index = 0U;
-        code = 1U;
+        write_index = 0U;
+        done = false;
+
+        while (!done) {
+            run_max = length - read_index;
+            if (run_max > 254U) {
+                run_max = 254U;
+            }
 
-        while (read_index < length && rc == BPU_RC_OK) {
-            if (write_index >= out_max) {
+            run = bpu_zero_scan(&input[read_index], run_max);
+
+            if (write_index + 1U + run > out_max) {
                 rc = BPU_RC_ERR;
+                done = true;
             } else {
-                if (input[read_index] == 0U) {
-                    output[code_index] = code;
-                    code = 1U;
-                    code_index = write_index;
-                    write_index++;
-                    read_index++;
+                output[write_index] = (uint8_t)(run + 1U);
+
+                // Short runs are cheaper inline than through a memcpy call
+                if (run >= 16U) {
+                    memcpy(&output[write_index + 1U], &input[read_index], run);
                 } else {
-                    output[write_index] = input[read_index];
-                    write_index++;
+                    size_t k;
+
+                    k = 0U;
+                    while (k < run) {
+                        output[write_index + 1U + k] = input[read_index + k];
+                        k++;
+                    }
+                }
+                write_index += 1U + run;
+                read_index += run;
+
+                if (run < run_max) {
+                    // Block ended on a zero: it is implied by the code byte
                     read_index++;
-                    code++;
-                    if (code == 0xFFU) {
-                        if (write_index >= out_max) {
-                            rc = BPU_RC_ERR;
-                        } else {
-                            output[code_index] = code;
-                            code = 1U;
-                            code_index = write_index;
-                            write_index++;
-                        }
+                } else {
+                    // A full 254-byte block always opens another one, even at the end
+                    if (run != 254U) {
+                        done = true;
                     }
                 }
             }
         }
 
         if (rc == BPU_RC_OK) {
-            if (code_index >= out_max) {
-                rc = BPU_RC_ERR;
-            } else {
-                output[code_index] = code;
-                out_len = write_index;
-            }
+            out_len = write_index;
         }
     }
 
     return out_len;
 }
 
-static BpuMergePolicy bpu_policy_for(uint8_t type)
+// Bump the counter matching a priority class (NULL = not tracked)
+static void bpu_count_prio(uint8_t prio, uint32_t *cmd, uint32_t *sensor, uint32_t *hb, uint32_t *telem)
 {
-    BpuMergePolicy p;
+    uint32_t *c;
 
-    p = BPU_MERGE_NONE;
+    c = NULL;
 
-    if (type == BPU_EVT_SENSOR) {
-        p = BPU_MERGE_LAST;
+    if (prio == BPU_PRIO_CMD) {
+        c = cmd;
     } else {
-        if (type == BPU_EVT_HB) {
-            p = BPU_MERGE_LAST;
+        if (prio == BPU_PRIO_SENSOR) {
+            c = sensor;
         } else {
-            if (type == BPU_EVT_TELEM) {
-                p = BPU_MERGE_LAST;
+            if (prio == BPU_PRIO_HB) {
+                c = hb;
             } else {
-                p = BPU_MERGE_NONE;
+                if (prio == BPU_PRIO_TELEM) {
+                    c = telem;
+                }
             }
         }
     }
 
-    return p;
+    if (c != NULL) {
+        (*c)++;
+    }
 }
 
-// Map event type to job type
-static uint8_t bpu_job_for_evt(uint8_t evt_type)
+// Hash (type, key) into an index table
+static uint16_t bpu_kidx_hash(uint8_t type, uint16_t key, uint16_t mask)
 {
-    uint8_t j;
+    uint32_t x;
 
-    j = 0U;
+    x = ((uint32_t)type << 16) | (uint32_t)key;
+    x *= 0x9E3779B1U;
 
-    if (evt_type == BPU_EVT_CMD) {
-        j = BPU_JOB_CMD;
-    } else {
-        if (evt_type == BPU_EVT_SENSOR) {
-            j = BPU_JOB_SENSOR;
+    return (uint16_t)((x >> 16) & (uint32_t)mask);
+}
+
+// Look up the ring slot holding the newest (type, key) entry
+static bool bpu_kidx_find(const BpuKeyEnt *t, uint16_t mask, uint8_t type, uint16_t key, uint16_t *slot_out)
+{
+    bool found;
+    bool done;
+    uint16_t h;
+
+    found = false;
+    done = false;
+    h = bpu_kidx_hash(type, key, mask);
+
+    while (!done) {
+        if (t[h].used == 0U) {
+            done = true;
         } else {
-            if (evt_type == BPU_EVT_HB) {
-                j = BPU_JOB_HB;
+            if (t[h].type == type && t[h].key == key) {
+                *slot_out = t[h].slot;
+                found = true;
+                done = true;
             } else {
-                if (evt_type == BPU_EVT_TELEM) {
-                    j = BPU_JOB_TELEM;
-                } else {
-                    j = 0U;
+                h = (uint16_t)((h + 1U) & mask);
+            }
+        }
+    }
+
+    return found;
+}
+
+// Map (type, key) to a ring slot, replacing any older mapping
+static void bpu_kidx_put(BpuKeyEnt *t, uint16_t mask, uint8_t type, uint16_t key, uint16_t slot)
+{
+    bool done;
+    uint16_t h;
+
+    done = false;
+    h = bpu_kidx_hash(type, key, mask);
+
+    while (!done) {
+        if (t[h].used == 0U) {
+            t[h].used = 1U;
+            t[h].type = type;
+            t[h].key = key;
+            t[h].slot = slot;
+            done = true;
+        } else {
+            if (t[h].type == type && t[h].key == key) {
+                t[h].slot = slot;
+                done = true;
+            } else {
+                h = (uint16_t)((h + 1U) & mask);
+            }
+        }
+    }
+}
+
+// Drop (type, key) if it still maps to this slot
+static bool bpu_kidx_del(BpuKeyEnt *t, uint16_t mask, uint8_t type, uint16_t key, uint16_t slot)
+{
+    bool done;
+    bool found;
+    uint16_t h;
+    uint16_t j;
+
+    done = false;
+    found = false;
+    h = bpu_kidx_hash(type, key, mask);
+
+    while (!done) {
+        if (t[h].used == 0U) {
+            done = true;
+        } else {
+            if (t[h].type == type && t[h].key == key) {
+                found = (t[h].slot == slot);
+                done = true;
+            } else {
+                h = (uint16_t)((h + 1U) & mask);
+            }
+        }
+    }
+
+    if (found) {
+        j = h;
+        done = false;
+
+        while (!done) {
+            uint16_t home;
+
+            j = (uint16_t)((j + 1U) & mask);
+
+            if (t[j].used == 0U) {
+                done = true;
+            } else {
+                home = bpu_kidx_hash(t[j].type, t[j].key, mask);
+
+                // Move back unless home lies cyclically in (h, j]
+                if ((uint16_t)((j - home) & mask) >= (uint16_t)((j - h) & mask)) {
+                    t[h] = t[j];
+                    h = j;
                 }
             }
         }
+
+        t[h].used = 0U;
     }
 
-    return j;
+    return found;
+}
+
+// Reset an index table
+static void bpu_kidx_clear(BpuKeyEnt *t, uint16_t n)
+{
+    uint16_t i;
+
+    i = 0U;
+    while (i < n) {
+        t[i].used = 0U;
+        i++;
+    }
 }
 
 // Push event into ring buffer
@@ -338,11 +1246,12 @@ static int bpu_evr_push(BpuEvRing *r, const BpuEvent *v)
         if (v == NULL) {
             rc = BPU_RC_ERR;
         } else {
-            if (r->count >= 8U) {
+            if (r->count >= BPU_EVQ_LEN) {
                 rc = BPU_RC_ERR;
             } else {
                 r->buf[r->head] = *v;
-                r->head = (uint16_t)((r->head + 1U) % 8U);
+                bpu_kidx_put(r->idx, (uint16_t)(BPU_EVQ_IDX_LEN - 1U), v->type, v->key, r->head);
+                r->head = (uint16_t)((r->head + 1U) % BPU_EVQ_LEN);
                 r->count++;
             }
         }
@@ -368,7 +1277,8 @@ static int bpu_evr_pop(BpuEvRing *r, BpuEvent *out)
                 rc = BPU_RC_ERR;
             } else {
                 *out = r->buf[r->tail];
-                r->tail = (uint16_t)((r->tail + 1U) % 8U);
+                (void)bpu_kidx_del(r->idx, (uint16_t)(BPU_EVQ_IDX_LEN - 1U), out->type, out->key, r->tail);
+                r->tail = (uint16_t)((r->tail + 1U) % BPU_EVQ_LEN);
                 r->count--;
             }
         }
@@ -377,16 +1287,19 @@ static int bpu_evr_pop(BpuEvRing *r, BpuEvent *out)
     return rc;
 }
 
-static BpuEvent *bpu_evr_at(BpuEvRing *r, uint16_t i)
+// Newest queued event for (type, key), NULL if none
+static BpuEvent *bpu_evr_find(BpuEvRing *r, uint8_t type, uint16_t key)
 {
     BpuEvent *p;
-    uint16_t idx;
+    uint16_t slot;
 
     p = NULL;
+    slot = 0U;
 
     if (r != NULL) {
-        idx = (uint16_t)((r->tail + i) % 8U);
-        p = &r->buf[idx];
+        if (bpu_kidx_find(r->idx, (uint16_t)(BPU_EVQ_IDX_LEN - 1U), type, key, &slot)) {
+            p = &r->buf[slot];
+        }
     }
 
     return p;
@@ -405,11 +1318,15 @@ static int bpu_jor_push(BpuJobRing *r, const BpuJob *v)
         if (v == NULL) {
             rc = BPU_RC_ERR;
         } else {
-            if (r->count >= 4U) {
+            if (r->count >= BPU_JOBQ_LEN) {
                 rc = BPU_RC_ERR;
             } else {
                 r->buf[r->head] = *v;
-                r->head = (uint16_t)((r->head + 1U) % 4U);
+                bpu_kidx_put(r->idx, (uint16_t)(BPU_JOBQ_IDX_LEN - 1U), v->type, v->key, r->head);
+                r->tcount[v->type]++;
+                r->tmask |= bpu_bit64(v->type);
+                r->wire += (uint32_t)bpu_job_wire_cost(v);
+                r->head = (uint16_t)((r->head + 1U) % BPU_JOBQ_LEN);
                 r->count++;
             }
         }
@@ -435,7 +1352,13 @@ static int bpu_jor_pop(BpuJobRing *r, BpuJob *out)
                 rc = BPU_RC_ERR;
             } else {
                 *out = r->buf[r->tail];
-                r->tail = (uint16_t)((r->tail + 1U) % 4U);
+                (void)bpu_kidx_del(r->idx, (uint16_t)(BPU_JOBQ_IDX_LEN - 1U), out->type, out->key, r->tail);
+                r->wire -= (uint32_t)bpu_job_wire_cost(out);
+                r->tcount[out->type]--;
+                if (r->tcount[out->type] == 0U) {
+                    r->tmask &= ~bpu_bit64(out->type);
+                }
+                r->tail = (uint16_t)((r->tail + 1U) % BPU_JOBQ_LEN);
                 r->count--;
             }
         }
@@ -452,64 +1375,97 @@ static BpuJob *bpu_jor_at(BpuJobRing *r, uint16_t i)
     p = NULL;
 
     if (r != NULL) {
-        idx = (uint16_t)((r->tail + i) % 4U);
+        idx = (uint16_t)((r->tail + i) % BPU_JOBQ_LEN);
         p = &r->buf[idx];
     }
 
     return p;
 }
 
-// Push event with optional coalescing
-static int bpu_evq_push_coalesce(Bpu *bpu, const BpuEvent *e)
+// Newest queued job for (type, key), NULL if none
+static BpuJob *bpu_jor_find(BpuJobRing *r, uint8_t type, uint16_t key)
+{
+    BpuJob *p;
+    uint16_t slot;
+
+    p = NULL;
+    slot = 0U;
+
+    if (r != NULL) {
+        if (bpu_kidx_find(r->idx, (uint16_t)(BPU_JOBQ_IDX_LEN - 1U), type, key, &slot)) {
+            p = &r->buf[slot];
+        }
+    }
+
+    return p;
+}
+
+// Remove job at ring position, keeping FIFO order of the rest
+static int bpu_jor_remove_at(BpuJobRing *r, uint16_t i, BpuJob *out)
 {
     int rc;
+    uint16_t k;
+    uint16_t mask;
+    bool was_newest;
 
     rc = BPU_RC_OK;
+    mask = (uint16_t)(BPU_JOBQ_IDX_LEN - 1U);
+    was_newest = false;
 
-    if (bpu == NULL) {
+    if (r == NULL) {
         rc = BPU_RC_ERR;
     } else {
-        if (e == NULL) {
+        if (out == NULL) {
             rc = BPU_RC_ERR;
         } else {
-            bpu->st.ev_in++;
-
-            if (bpu->cfg.coalesce_window_ms > 0U && bpu_policy_for(e->type) == BPU_MERGE_LAST && bpu->evq.count != 0U) {
-                uint16_t i;
-                bool merged;
-
-                i = 0U;
-                merged = false;
+            if (i >= r->count) {
+                rc = BPU_RC_ERR;
+            } else {
+                uint16_t dst;
+
+                dst = (uint16_t)((r->tail + i) % BPU_JOBQ_LEN);
+                *out = r->buf[dst];
+                was_newest = bpu_kidx_del(r->idx, mask, out->type, out->key, dst);
+                r->wire -= (uint32_t)bpu_job_wire_cost(out);
+                r->tcount[out->type]--;
+                if (r->tcount[out->type] == 0U) {
+                    r->tmask &= ~bpu_bit64(out->type);
+                }
 
-                while (i < bpu->evq.count) {
-                    BpuEvent *ex;
+                k = i;
+                while (k > 0U) {
+                    uint16_t src;
+                    uint16_t slot;
 
-                    ex = bpu_evr_at(&bpu->evq, i);
+                    src = (uint16_t)((r->tail + k - 1U) % BPU_JOBQ_LEN);
+                    r->buf[dst] = r->buf[src];
 
-                    if (ex != NULL) {
-                        if (ex->type == e->type) {
-                            if ((uint32_t)(e->t_ms - ex->t_ms) <= (uint32_t)bpu->cfg.coalesce_window_ms) {
-                                *ex = *e;
-                                bpu->st.ev_merge++;
-                                merged = true;
-                            }
+                    if (bpu_kidx_find(r->idx, mask, r->buf[dst].type, r->buf[dst].key, &slot)) {
+                        if (slot == src) {
+                            bpu_kidx_put(r->idx, mask, r->buf[dst].type, r->buf[dst].key, dst);
                         }
                     }
 
-                    i++;
+                    dst = src;
+                    k--;
                 }
 
-                if (!merged) {
-                    if (bpu_evr_push(&bpu->evq, e) != BPU_RC_OK) {
-                        bpu->st.ev_drop++;
-                        rc = BPU_RC_ERR;
+                r->tail = (uint16_t)((r->tail + 1U) % BPU_JOBQ_LEN);
+                r->count--;
+
+                // An older duplicate of the removed key becomes the newest
+                k = r->count;
+                while (was_newest && k > 0U) {
+                    uint16_t p;
+
+                    k--;
+                    p = (uint16_t)((r->tail + k) % BPU_JOBQ_LEN);
+
+                    if (r->buf[p].type == out->type && r->buf[p].key == out->key) {
+                        bpu_kidx_put(r->idx, mask, out->type, out->key, p);
+                        was_newest = false;
                     }
                 }
-            } else {
-                if (bpu_evr_push(&bpu->evq, e) != BPU_RC_OK) {
-                    bpu->st.ev_drop++;
-                    rc = BPU_RC_ERR;
-                }
             }
         }
     }
@@ -517,74 +1473,214 @@ static int bpu_evq_push_coalesce(Bpu *bpu, const BpuEvent *e)
     return rc;
 }
 
-// Pop next event respecting policy
-static int bpu_evq_pop(Bpu *bpu, BpuEvent *out)
+// Width in bytes of a field kind
+static uint8_t bpu_field_width(uint8_t kind)
 {
-    int rc;
+    uint8_t w;
 
-    rc = BPU_RC_OK;
+    w = 1U;
 
-    if (bpu == NULL) {
-        rc = BPU_RC_ERR;
+    if (kind == BPU_FIELD_U16 || kind == BPU_FIELD_I16) {
+        w = 2U;
     } else {
-        if (bpu_evr_pop(&bpu->evq, out) != BPU_RC_OK) {
-            rc = BPU_RC_ERR;
+        if (kind == BPU_FIELD_U32 || kind == BPU_FIELD_I32) {
+            w = 4U;
+        }
+    }
+
+    return w;
+}
+
+// Read a little-endian field as a wide signed value
+static int64_t bpu_field_get(const uint8_t *p, uint8_t kind)
+{
+    int64_t v;
+    uint32_t u;
+
+    u = 0U;
+
+    if (kind == BPU_FIELD_U8 || kind == BPU_FIELD_I8) {
+        u = (uint32_t)p[0];
+    } else {
+        if (kind == BPU_FIELD_U16 || kind == BPU_FIELD_I16) {
+            u = (uint32_t)p[0] | ((uint32_t)p[1] << 8);
         } else {
-            bpu->st.ev_out++;
+            u = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
         }
     }
 
-    return rc;
+    if (kind == BPU_FIELD_I8) {
+        v = (int64_t)(int8_t)(uint8_t)u;
+    } else {
+        if (kind == BPU_FIELD_I16) {
+            v = (int64_t)(int16_t)(uint16_t)u;
+        } else {
+            if (kind == BPU_FIELD_I32) {
+                v = (int64_t)(int32_t)u;
+            } else {
+                v = (int64_t)u;
+            }
+        }
+    }
+
+    return v;
 }
 
-// Push job with optional coalescing
-static int bpu_jobq_push_coalesce(Bpu *bpu, const BpuJob *j)
+// Write a field, saturating to the range of its kind
+static void bpu_field_put(uint8_t *p, uint8_t kind, int64_t v)
 {
-    int rc;
+    int64_t lo;
+    int64_t hi;
+    uint32_t u;
+    uint8_t w;
+    uint8_t i;
 
-    rc = BPU_RC_OK;
+    lo = 0;
+    hi = 0xFF;
 
-    if (bpu == NULL) {
-        rc = BPU_RC_ERR;
+    if (kind == BPU_FIELD_I8) {
+        lo = -128;
+        hi = 127;
     } else {
-        if (j == NULL) {
-            rc = BPU_RC_ERR;
+        if (kind == BPU_FIELD_U16) {
+            hi = 0xFFFF;
         } else {
-            bpu->st.job_in++;
+            if (kind == BPU_FIELD_I16) {
+                lo = -32768;
+                hi = 32767;
+            } else {
+                if (kind == BPU_FIELD_U32) {
+                    hi = (int64_t)0xFFFFFFFFU;
+                } else {
+                    if (kind == BPU_FIELD_I32) {
+                        lo = -(int64_t)0x80000000U;
+                        hi = (int64_t)0x7FFFFFFF;
+                    }
+                }
+            }
+        }
+    }
 
-            if (bpu->jobq.count != 0U) {
-                uint16_t i;
-                bool merged;
+    if (v < lo) {
+        v = lo;
+    }
+    if (v > hi) {
+        v = hi;
+    }
 
-                i = 0U;
-                merged = false;
+    u = (uint32_t)v;
+    w = bpu_field_width(kind);
+
+    i = 0U;
+    while (i < w) {
+        p[i] = (uint8_t)((u >> (8U * i)) & 0xFFU);
+        i++;
+    }
+}
 
-                while (i < bpu->jobq.count) {
-                    BpuJob *ex;
+// Apply field operators: dst holds the newer record (already LAST-copied),
+// src the record it replaces; base skips a job's tag/len prefix
+static void bpu_merge_payload(const BpuTypeDesc *d, uint8_t *dst, uint16_t dst_len, uint16_t dst_n,
+                              const uint8_t *src, uint16_t src_len, uint16_t src_n, uint16_t base)
+{
+    uint8_t f;
+
+    f = 0U;
+
+    while (d->fields != NULL && f < d->nfields) {
+        const BpuField *fd;
+        uint16_t end;
+
+        fd = &d->fields[f];
+        end = (uint16_t)(base + (uint16_t)fd->off + (uint16_t)bpu_field_width(fd->kind));
 
-                    ex = bpu_jor_at(&bpu->jobq, i);
+        if (end <= dst_len && end <= src_len) {
+            uint8_t *pd;
+            int64_t a;
+            int64_t b;
+            int64_t r;
+            int64_t wn;
 
-                    if (ex != NULL) {
-                        if (ex->type == j->type) {
-                            *ex = *j;
-                            bpu->st.job_merge++;
-                            merged = true;
+            pd = &dst[base + fd->off];
+            a = bpu_field_get(pd, fd->kind);
+            b = bpu_field_get(&src[base + fd->off], fd->kind);
+            r = a;
+
+            if (fd->op == BPU_MERGE_SUM) {
+                r = a + b;
+            } else {
+                if (fd->op == BPU_MERGE_MIN) {
+                    r = (b < a) ? b : a;
+                } else {
+                    if (fd->op == BPU_MERGE_MAX) {
+                        r = (b > a) ? b : a;
+                    } else {
+                        if (fd->op == BPU_MERGE_COUNT) {
+                            r = (int64_t)dst_n + (int64_t)src_n;
+                        } else {
+                            if (fd->op == BPU_MERGE_AVG) {
+                                wn = (int64_t)dst_n + (int64_t)src_n;
+                                if (wn > 0) {
+                                    r = (a * (int64_t)dst_n) + (b * (int64_t)src_n);
+                                    r = (r >= 0) ? ((r + (wn / 2)) / wn) : ((r - (wn / 2)) / wn);
+                                }
+                            }
                         }
                     }
-
-                    i++;
                 }
+            }
 
-                if (!merged) {
-                    if (bpu_jor_push(&bpu->jobq, j) != BPU_RC_OK) {
-                        bpu->st.job_drop++;
-                        rc = BPU_RC_ERR;
+            bpu_field_put(pd, fd->kind, r);
+        }
+
+        f++;
+    }
+}
+
+// Push event, coalescing mergeable types on (type, key)
+static int bpu_evq_push_coalesce(Bpu *bpu, const BpuEvent *e)
+{
+    int rc;
+    BpuEvent *ex;
+
+    rc = BPU_RC_OK;
+    ex = NULL;
+
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (e == NULL) {
+            rc = BPU_RC_ERR;
+        } else {
+            bpu->st.ev_in++;
+
+            if (bpu->cfg.coalesce_window_ms > 0U && bpu->types[e->type].merge != BPU_MERGE_NONE) {
+                ex = bpu_evr_find(&bpu->evq, e->type, e->key);
+
+                if (ex != NULL) {
+                    if ((uint32_t)(e->t_ms - ex->t_ms) > (uint32_t)bpu->cfg.coalesce_window_ms) {
+                        ex = NULL;
                     }
                 }
+            }
+
+            if (ex != NULL) {
+                BpuEvent m;
+                uint32_t n;
+
+                m = *e;
+                n = (uint32_t)ex->n + (uint32_t)e->n;
+                bpu_merge_payload(&bpu->types[e->type], m.payload, m.len, e->n, ex->payload, ex->len, ex->n, 0U);
+                m.n = (n > 0xFFFFU) ? 0xFFFFU : (uint16_t)n;
+                bpu->evq.wire = bpu->evq.wire - (uint32_t)bpu_event_wire_cost(bpu, ex) + (uint32_t)bpu_event_wire_cost(bpu, &m);
+                *ex = m;
+                bpu->st.ev_merge++;
             } else {
-                if (bpu_jor_push(&bpu->jobq, j) != BPU_RC_OK) {
-                    bpu->st.job_drop++;
+                if (bpu_evr_push(&bpu->evq, e) != BPU_RC_OK) {
+                    bpu->st.ev_drop++;
                     rc = BPU_RC_ERR;
+                } else {
+                    bpu->evq.wire += (uint32_t)bpu_event_wire_cost(bpu, e);
                 }
             }
         }
@@ -593,8 +1689,8 @@ static int bpu_jobq_push_coalesce(Bpu *bpu, const BpuJob *j)
     return rc;
 }
 
-// Pop next job respecting policy
-static int bpu_jobq_pop(Bpu *bpu, BpuJob *out)
+// Pop next event respecting policy
+static int bpu_evq_pop(Bpu *bpu, BpuEvent *out)
 {
     int rc;
 
@@ -603,494 +1699,3417 @@ static int bpu_jobq_pop(Bpu *bpu, BpuJob *out)
     if (bpu == NULL) {
         rc = BPU_RC_ERR;
     } else {
-        if (bpu_jor_pop(&bpu->jobq, out) != BPU_RC_OK) {
+        if (bpu_evr_pop(&bpu->evq, out) != BPU_RC_OK) {
             rc = BPU_RC_ERR;
         } else {
-            bpu->st.job_out++;
+            bpu->evq.wire -= (uint32_t)bpu_event_wire_cost(bpu, out);
+            bpu->st.ev_out++;
         }
     }
 
     return rc;
 }
 
-// Build 64-bit bit mask
-static uint64_t bpu_bit64(uint8_t n)
+// True while a preemptible queued-type frame is on the wire: the last job
+// slot is kept for it, so an abort can put the job back. Only CMD-class
+// jobs may take that slot
+static bool bpu_jobq_slot_held(const Bpu *bpu, const BpuJob *j)
 {
-    uint64_t r;
+    bool held;
 
-    r = 0ULL;
+    held = false;
 
-    if (n < 64U) {
-        r = 1ULL << n;
+    if (bpu->cfg.enable_preempt != 0U && bpu->pending_have != 0U && bpu->pending_preempt != 0U) {
+        if ((bpu->types[bpu->pending_job.type].flags & BPU_TF_STATE) == 0U && bpu->types[j->type].prio != BPU_PRIO_CMD) {
+            held = true;
+        }
     }
 
-    return r;
+    return held;
 }
 
-// Current dirty/coalesce bitmap
-static uint64_t bpu_dirty_mask(const Bpu *bpu)
+// Push job, coalescing mergeable types on (type, key)
+static int bpu_jobq_push_coalesce(Bpu *bpu, const BpuJob *j)
 {
-    uint64_t m;
-    uint16_t i;
-
-    m = 0ULL;
+    int rc;
+    BpuJob *ex;
 
-    if (bpu != NULL) {
-        i = 0U;
-        while (i < bpu->jobq.count) {
-            uint16_t idx;
-            const BpuJob *j;
+    rc = BPU_RC_OK;
+    ex = NULL;
 
-            idx = (uint16_t)((bpu->jobq.tail + i) % 4U);
-            j = &bpu->jobq.buf[idx];
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (j == NULL) {
+            rc = BPU_RC_ERR;
+        } else {
+            bpu->st.job_in++;
 
-            if (j->type >= 1U && j->type <= 63U) {
-                m |= bpu_bit64(j->type);
+            if (bpu->types[j->type].merge != BPU_MERGE_NONE) {
+                ex = bpu_jor_find(&bpu->jobq, j->type, j->key);
             }
 
-            i++;
-        }
-
-        if (bpu->pending_have != 0U) {
-            m |= bpu_bit64(63U);
+            if (ex != NULL) {
+                BpuJob m;
+                uint32_t n;
+
+                m = *j;
+                n = (uint32_t)ex->n + (uint32_t)j->n;
+                bpu_merge_payload(&bpu->types[j->type], m.payload, m.len, j->n, ex->payload, ex->len, ex->n, 2U);
+                m.n = (n > 0xFFFFU) ? 0xFFFFU : (uint16_t)n;
+                bpu->jobq.wire = bpu->jobq.wire - (uint32_t)bpu_job_wire_cost(ex) + (uint32_t)bpu_job_wire_cost(&m);
+                *ex = m;
+                bpu->st.job_merge++;
+            } else {
+                if ((bpu_jobq_slot_held(bpu, j) && bpu->jobq.count + 1U >= BPU_JOBQ_LEN) || bpu_jor_push(&bpu->jobq, j) != BPU_RC_OK) {
+                    if (!bpu_spill_put(bpu, j)) {
+                        bpu->st.job_drop++;
+                        rc = BPU_RC_ERR;
+                    }
+                }
+            }
         }
     }
 
-    return m;
+    return rc;
 }
 
-// Read microsecond clock if available
-static int bpu_try_time_us(Bpu *bpu, uint32_t *us_out)
+// Pop next job respecting policy
+static int bpu_jobq_pop(Bpu *bpu, BpuJob *out)
 {
     int rc;
 
-    rc = BPU_RC_ERR;
-
-    if (us_out != NULL) {
-        *us_out = 0U;
-    }
+    rc = BPU_RC_OK;
 
-    if (bpu != NULL && us_out != NULL) {
-        if (bpu->io.time_us != NULL) {
-            if (bpu->io.time_us(bpu->io.ctx, us_out) == BPU_RC_OK) {
-                rc = BPU_RC_OK;
-            }
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (bpu_jor_pop(&bpu->jobq, out) != BPU_RC_OK) {
+            rc = BPU_RC_ERR;
+        } else {
+            bpu->st.job_out++;
         }
     }
 
     return rc;
 }
 
-// Build framed packet into pending buffer
-static int bpu_build_frame(Bpu *bpu, uint8_t type, const uint8_t *payload, uint8_t len)
+// Pop the earliest-deadline job that fits the budget (head if none fits);
+// CMD-class jobs without a deadline are due at once and go first
+static int bpu_jobq_pop_edf(Bpu *bpu, uint16_t budget_left, BpuJob *out)
 {
     int rc;
-    uint8_t decoded[4 + 64 + 2];
-    size_t decoded_len;
-    size_t enc_len;
-    uint16_t crc;
-    uint8_t i;
+    uint16_t i;
+    uint16_t best;
+    uint32_t best_dl;
+    bool best_found;
+    uint8_t best_rank;
 
     rc = BPU_RC_OK;
 
     if (bpu == NULL) {
         rc = BPU_RC_ERR;
     } else {
-        if (payload == NULL) {
+        if (out == NULL) {
             rc = BPU_RC_ERR;
+        } else {
+            if (bpu->jobq.count == 0U) {
+                rc = BPU_RC_ERR;
+            }
         }
     }
 
     if (rc == BPU_RC_OK) {
-        if (len > 64U) {
-            len = 64U;
-        }
+        best = 0U;
+        best_dl = 0U;
+        best_found = false;
+        best_rank = 2U;
 
-        decoded[0] = 0xB2U;
-        decoded[1] = type;
-        decoded[2] = bpu->seq;
-        decoded[3] = len;
+        i = 0U;
+        while (i < bpu->jobq.count) {
+            const BpuJob *j;
+            uint32_t dl;
+            uint8_t rank;
 
-        bpu->seq++;
+            j = bpu_jor_at(&bpu->jobq, i);
+
+            if (bpu_job_wire_cost(j) <= (size_t)budget_left) {
+                // Rank 0: deadline-less CMD, 1: by deadline, 2: no deadline (FIFO within a rank)
+                dl = 0U;
+                rank = 2U;
+                if (bpu_job_deadline(bpu, j, &dl)) {
+                    rank = 1U;
+                } else {
+                    if (bpu->types[j->type].prio == BPU_PRIO_CMD) {
+                        rank = 0U;
+                    }
+                }
+
+                if (!best_found || rank < best_rank || (rank == 1U && best_rank == 1U && (int32_t)(dl - best_dl) < 0)) {
+                    best = i;
+                    best_dl = dl;
+                    best_rank = rank;
+                    best_found = true;
+                }
+            }
 
-        i = 0U;
-        while (i < len) {
-            decoded[4U + i] = payload[i];
             i++;
         }
 
-        crc = bpu_crc16_ccitt(&decoded[1], (size_t)(3U + (uint32_t)len));
-        decoded[4U + len + 0U] = (uint8_t)(crc & 0xFFU);
-        decoded[4U + len + 1U] = (uint8_t)((crc >> 8) & 0xFFU);
-
-        decoded_len = (size_t)(4U + (uint32_t)len + 2U);
+        if (best != 0U) {
+            bpu->st.edf_reorder++;
+        }
 
-        enc_len = bpu_cobs_encode(decoded, decoded_len, bpu->pending_buf, sizeof(bpu->pending_buf));
-        if (enc_len == 0U) {
+        if (bpu_jor_remove_at(&bpu->jobq, best, out) != BPU_RC_OK) {
             rc = BPU_RC_ERR;
         } else {
-            if (enc_len + 1U > sizeof(bpu->pending_buf)) {
-                rc = BPU_RC_ERR;
-            } else {
-                bpu->pending_buf[enc_len] = 0x00U;
-                bpu->pending_len = (uint16_t)(enc_len + 1U);
-                bpu->pending_pos = 0U;
-                bpu->pending_have = 1U;
-            }
+            bpu->st.job_out++;
         }
     }
 
     return rc;
 }
 
-// Drain pending buffer to IO under budget
-static int bpu_send_pending(Bpu *bpu, uint16_t *budget_left, bool *progress_out)
+// Worst-case on-wire bytes for a job (COBS overhead + delimiter)
+static size_t bpu_job_wire_cost(const BpuJob *j)
 {
-    int rc;
-    bool progress;
-    bool done;
+    return bpu_frame_wire_cost(j->type, j->len);
+}
 
-    rc = BPU_RC_OK;
-    progress = false;
-    done = false;
+// Worst-case on-wire bytes of the job frame a queued event becomes
+static size_t bpu_event_wire_cost(const Bpu *bpu, const BpuEvent *e)
+{
+    return bpu_frame_wire_cost(bpu->types[e->type].job, (uint16_t)(e->len + 2U));
+}
 
-    if (progress_out != NULL) {
-        *progress_out = false;
+// Recount evq.wire after a descriptor changed an event type's job code
+static void bpu_evq_rewire(Bpu *bpu)
+{
+    uint16_t i;
+
+    bpu->evq.wire = 0U;
+
+    i = 0U;
+    while (i < bpu->evq.count) {
+        bpu->evq.wire += (uint32_t)bpu_event_wire_cost(bpu, &bpu->evq.buf[(uint16_t)((bpu->evq.tail + i) % BPU_EVQ_LEN)]);
+        i++;
     }
+}
 
-    if (bpu == NULL) {
-        rc = BPU_RC_ERR;
-    } else {
-        if (budget_left == NULL) {
-            rc = BPU_RC_ERR;
-        } else {
-            if (bpu->pending_have == 0U) {
-                bpu->pending_len = 0U;
-                bpu->pending_pos = 0U;
-            } else {
-                if (bpu->io.tx_write_some == NULL) {
-                    rc = BPU_RC_ERR;
-                } else {
-                    while (!done && bpu->pending_pos < bpu->pending_len && rc == BPU_RC_OK) {
-                        size_t want;
-                        size_t wrote;
-                        uint16_t budget;
-                        uint16_t chunk_cap;
+// Absolute deadline of a job, false if its type has none
+static bool bpu_job_deadline(const Bpu *bpu, const BpuJob *j, uint32_t *dl_out)
+{
+    bool has;
+    uint16_t rel;
 
-                        want = 0U;
-                        if (*budget_left != 0U) {
-                            want = (size_t)(bpu->pending_len - bpu->pending_pos);
-                        }
+    has = false;
+    *dl_out = 0U;
 
-                        budget = *budget_left;
+    rel = bpu->types[j->type].deadline_ms;
+    if (rel != 0U) {
+        *dl_out = j->t_ms + (uint32_t)rel;
+        has = true;
+    }
 
-                        if (want > (size_t)budget) {
-                            want = (size_t)budget;
-                        }
+    return has;
+}
 
-                        chunk_cap = bpu->cfg.tx_chunk_max;
-                        if (chunk_cap != 0U) {
-                            if (want > (size_t)chunk_cap) {
-                                want = (size_t)chunk_cap;
-                            }
-                        }
+// Count a deadline miss for a dispatched job
+static void bpu_note_deadline(Bpu *bpu, const BpuJob *j, uint32_t now_ms)
+{
+    uint32_t dl;
 
-                        wrote = 0U;
+    dl = 0U;
+
+    if (bpu_job_deadline(bpu, j, &dl)) {
+        if ((int32_t)(now_ms - dl) > 0) {
+            bpu_count_prio(bpu->types[j->type].prio,
+                           &bpu->st.deadline_miss_cmd, &bpu->st.deadline_miss_sensor,
+                           &bpu->st.deadline_miss_hb, &bpu->st.deadline_miss_telem);
+        }
+    }
+}
+
+// True if data of this job type is older than its TTL
+static bool bpu_expired(const Bpu *bpu, uint8_t job_type, uint32_t t_ms, uint32_t now_ms)
+{
+    bool exp;
+    uint16_t ttl;
+
+    exp = false;
+
+    ttl = bpu->types[job_type].ttl_ms;
+    if (ttl != 0U) {
+        if ((uint32_t)(now_ms - t_ms) >= (uint32_t)ttl) {
+            exp = true;
+        }
+    }
+
+    return exp;
+}
+
+// Evict expired jobs from the queue (pending frame is untouched)
+static void bpu_jobq_expire(Bpu *bpu, uint32_t now_ms)
+{
+    uint16_t i;
+
+    i = 0U;
+    while (i < bpu->jobq.count) {
+        const BpuJob *j;
+        BpuJob dead;
+
+        j = bpu_jor_at(&bpu->jobq, i);
+
+        if (bpu_expired(bpu, j->type, j->t_ms, now_ms)) {
+            (void)bpu_jor_remove_at(&bpu->jobq, i, &dead);
+            bpu->st.expired_job++;
+        } else {
+            i++;
+        }
+    }
+}
+
+// Build 64-bit bit mask
+static uint64_t bpu_bit64(uint8_t n)
+{
+    uint64_t r;
+
+    r = 0ULL;
+
+    if (n < 64U) {
+        r = 1ULL << n;
+    }
+
+    return r;
+}
+
+// Index of the lowest set bit (m must be non-zero); GCC/Clang (ESP-IDF,
+// host) use the builtin, other compilers a 6-step binary search
+static uint8_t bpu_ctz64(uint64_t m)
+{
+#if defined(__GNUC__)
+    return (uint8_t)__builtin_ctzll(m);
+#else
+    uint8_t n;
+
+    n = 0U;
+
+    if ((m & 0xFFFFFFFFULL) == 0ULL) {
+        m >>= 32;
+        n = (uint8_t)(n + 32U);
+    }
+    if ((m & 0xFFFFULL) == 0ULL) {
+        m >>= 16;
+        n = (uint8_t)(n + 16U);
+    }
+    if ((m & 0xFFULL) == 0ULL) {
+        m >>= 8;
+        n = (uint8_t)(n + 8U);
+    }
+    if ((m & 0xFULL) == 0ULL) {
+        m >>= 4;
+        n = (uint8_t)(n + 4U);
+    }
+    if ((m & 0x3ULL) == 0ULL) {
+        m >>= 2;
+        n = (uint8_t)(n + 2U);
+    }
+    if ((m & 0x1ULL) == 0ULL) {
+        n = (uint8_t)(n + 1U);
+    }
+
+    return n;
+#endif
+}
+
+// Current dirty/coalesce bitmap (queued job types, bit 63 = frame pending)
+static uint64_t bpu_dirty_mask(const Bpu *bpu)
+{
+    uint64_t m;
+
+    m = 0ULL;
+
+    if (bpu != NULL) {
+        m = bpu->jobq.tmask & ~bpu_bit64(0U);
+
+        if (bpu->pending_have != 0U) {
+            m |= bpu_bit64(63U);
+        }
+    }
+
+    return m;
+}
+
+// Overwrite the state slot for (type, key), allocating one on first use
+static int bpu_state_write(Bpu *bpu, const BpuJob *j)
+{
+    int rc;
+    uint16_t slot;
+    uint16_t mask;
+    const BpuTypeDesc *d;
+
+    rc = BPU_RC_OK;
+    slot = 0U;
+    mask = (uint16_t)(BPU_STATE_IDX_LEN - 1U);
+    d = &bpu->types[j->type];
+
+    if (!bpu_kidx_find(bpu->state.idx, mask, j->type, j->key, &slot)) {
+        uint64_t all;
+        uint64_t free_m;
+        uint64_t pref;
+
+        all = (BPU_STATE_SLOTS >= 64U) ? ~0ULL : (bpu_bit64((uint8_t)BPU_STATE_SLOTS) - 1ULL);
+        free_m = ~bpu->state.used & all;
+
+        // Prefer slots at or above the type's priority base
+        pref = free_m;
+        if (d->state_slot < 64U) {
+            pref &= ~(bpu_bit64(d->state_slot) - 1ULL);
+        }
+        if (pref != 0ULL) {
+            free_m = pref;
+        }
+
+        if (free_m == 0ULL) {
+            bpu->st.state_full++;
+            bpu->st.ev_drop++;
+            rc = BPU_RC_ERR;
+        } else {
+            slot = bpu_ctz64(free_m);
+            bpu->state.used |= bpu_bit64((uint8_t)slot);
+            bpu_kidx_put(bpu->state.idx, mask, j->type, j->key, slot);
+            bpu->state.slot[slot] = *j;
+        }
+    } else {
+        BpuJob m;
+        BpuJob *ex;
+        uint32_t n;
+
+        ex = &bpu->state.slot[slot];
+        m = *j;
+
+        if ((bpu->state.dirty & bpu_bit64((uint8_t)slot)) != 0ULL) {
+            n = (uint32_t)ex->n + (uint32_t)j->n;
+            bpu_merge_payload(d, m.payload, m.len, j->n, ex->payload, ex->len, ex->n, 2U);
+            m.n = (n > 0xFFFFU) ? 0xFFFFU : (uint16_t)n;
+            bpu->st.ev_merge++;
+        }
+
+        *ex = m;
+    }
+
+    if (rc == BPU_RC_OK) {
+        bpu->state.dirty |= bpu_bit64((uint8_t)slot);
+        bpu->st.state_write++;
+    }
+
+    return rc;
+}
+
+// Take the highest-priority dirty slot, clearing its bit
+static int bpu_state_take(Bpu *bpu, BpuJob *out)
+{
+    int rc;
+    uint8_t slot;
+
+    rc = BPU_RC_OK;
+
+    if (bpu->state.dirty == 0ULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        slot = bpu_ctz64(bpu->state.dirty);
+        bpu->state.dirty &= ~bpu_bit64(slot);
+        *out = bpu->state.slot[slot];
+    }
+
+    return rc;
+}
+
+// Clear dirty bits of state slots older than their TTL
+static void bpu_state_expire(Bpu *bpu, uint32_t now_ms)
+{
+    uint64_t m;
+
+    m = bpu->state.dirty;
+
+    while (m != 0ULL) {
+        uint8_t slot;
+        const BpuJob *j;
+
+        slot = bpu_ctz64(m);
+        m &= m - 1ULL;
+        j = &bpu->state.slot[slot];
+
+        if (bpu_expired(bpu, j->type, j->t_ms, now_ms)) {
+            bpu->state.dirty &= ~bpu_bit64(slot);
+            bpu->st.expired_job++;
+        }
+    }
+}
+
+// Put an unsent job back: re-mark its state slot or requeue it
+static void bpu_requeue_job(Bpu *bpu, const BpuJob *j)
+{
+    uint16_t slot;
+
+    slot = 0U;
+
+    if ((bpu->types[j->type].flags & BPU_TF_STATE) != 0U) {
+        if (bpu_kidx_find(bpu->state.idx, (uint16_t)(BPU_STATE_IDX_LEN - 1U), j->type, j->key, &slot)) {
+            bpu->state.dirty |= bpu_bit64((uint8_t)slot);
+        }
+    } else {
+        (void)bpu_jobq_push_coalesce(bpu, j);
+    }
+}
+
+// Wheel tick of a due time, rounding up (timers never fire early); a time
+// at or before the start of the current tick maps to cur_tick
+static uint32_t bpu_wheel_due_tick(const BpuWheel *w, uint32_t due_ms)
+{
+    uint32_t tick;
+
+    tick = w->cur_tick;
+
+    if ((int32_t)(due_ms - w->cur_ms) > 0) {
+        tick += (uint32_t)((due_ms - w->cur_ms + (BPU_WHEEL_TICK_MS - 1U)) / BPU_WHEEL_TICK_MS);
+    }
+
+    return tick;
+}
+
+// Link a timer into the slot of its due tick (never before the next tick)
+static void bpu_wheel_link(BpuWheel *w, uint16_t id)
+{
+    BpuTimer *t;
+    uint32_t due_tick;
+    uint8_t slot;
+
+    t = &w->t[id];
+    due_tick = bpu_wheel_due_tick(w, t->due_ms);
+
+    if ((int32_t)(due_tick - w->cur_tick) <= 0) {
+        due_tick = w->cur_tick + 1U;
+    }
+
+    slot = (uint8_t)(due_tick & (BPU_WHEEL_SLOTS - 1U));
+
+    t->prev = BPU_TIMER_NONE;
+    t->next = w->head[slot];
+    if (w->head[slot] != BPU_TIMER_NONE) {
+        w->t[w->head[slot]].prev = id;
+    }
+    w->head[slot] = id;
+    t->slot = slot;
+    w->occupied |= bpu_bit64(slot);
+}
+
+// Unlink a timer from its slot list
+static void bpu_wheel_unlink(BpuWheel *w, uint16_t id)
+{
+    BpuTimer *t;
+
+    t = &w->t[id];
+
+    if (t->prev != BPU_TIMER_NONE) {
+        w->t[t->prev].next = t->next;
+    } else {
+        w->head[t->slot] = t->next;
+    }
+
+    if (t->next != BPU_TIMER_NONE) {
+        w->t[t->next].prev = t->prev;
+    }
+
+    if (w->head[t->slot] == BPU_TIMER_NONE) {
+        w->occupied &= ~bpu_bit64(t->slot);
+    }
+}
+
+// Fire one due timer: fill and push its event, then schedule the next period
+static void bpu_timer_fire(Bpu *bpu, uint16_t id, uint32_t now_ms)
+{
+    BpuTimer *t;
+    uint8_t payload[16];
+    uint16_t len;
+
+    t = &bpu->wheel.t[id];
+    len = (uint16_t)sizeof(payload);
+
+    if (t->fn(t->ctx, now_ms, payload, &len) == BPU_RC_OK) {
+        (void)bpu_push_event_keyed(bpu, t->evt_type, t->key, payload, len, now_ms);
+    }
+
+    bpu->st.timer_fire++;
+
+    t->due_ms += t->period_ms;
+    if ((int32_t)(now_ms - t->due_ms) >= 0) {
+        // Missed whole periods (stalled caller): skip them, keep the phase
+        t->due_ms = now_ms + t->period_ms - ((now_ms - t->due_ms) % t->period_ms);
+        bpu->st.timer_late++;
+    }
+}
+
+// Expire due timers; cost is O(occupied slots in window + timers walked)
+static void bpu_timers_run(Bpu *bpu, uint32_t now_ms)
+{
+    BpuWheel *w;
+    uint32_t steps;
+    uint64_t m;
+    uint16_t mark;
+    uint8_t base;
+
+    w = &bpu->wheel;
+    // Whole wheel ticks since cur_ms; unsigned, so the now_ms wrap is harmless
+    steps = (uint32_t)(now_ms - w->cur_ms) / BPU_WHEEL_TICK_MS;
+
+    if (steps != 0U) {
+        // Slots for ticks cur+1 .. cur+steps (every slot once after a long gap)
+        base = (uint8_t)((w->cur_tick + 1U) & (BPU_WHEEL_SLOTS - 1U));
+        m = (w->occupied >> base) | ((base != 0U) ? (w->occupied << (64U - base)) : 0ULL);
+        if (steps < 64U) {
+            m &= bpu_bit64((uint8_t)steps) - 1ULL;
+        }
+
+        w->cur_tick += steps;
+        w->cur_ms += steps * BPU_WHEEL_TICK_MS;
+
+        while (m != 0ULL) {
+            uint8_t slot;
+            uint16_t id;
+
+            slot = (uint8_t)((base + bpu_ctz64(m)) & (BPU_WHEEL_SLOTS - 1U));
+            m &= m - 1ULL;
+
+            // Detach the slot list and mark its entries, so a callback that
+            // removes one of them only kills it (fn = NULL) instead of unlinking
+            id = w->head[slot];
+            w->head[slot] = BPU_TIMER_NONE;
+            w->occupied &= ~bpu_bit64(slot);
+
+            mark = id;
+            while (mark != BPU_TIMER_NONE) {
+                w->t[mark].slot = BPU_WHEEL_DETACHED;
+                mark = w->t[mark].next;
+            }
+
+            // Fire or relink every live entry; dead ones are left unlinked
+            while (id != BPU_TIMER_NONE) {
+                uint16_t nx;
+
+                nx = w->t[id].next;
+
+                if (w->t[id].fn != NULL && (int32_t)(w->t[id].due_ms - w->cur_ms) <= 0) {
+                    bpu_timer_fire(bpu, id, now_ms);
+                }
+
+                if (w->t[id].fn != NULL) {
+                    bpu_wheel_link(w, id);
+                } else {
+                    w->t[id].slot = 0U;
+                }
+                id = nx;
+            }
+        }
+    }
+}
+
+// Admission-side shedding for the current ladder level (true = discard)
+static bool bpu_shed_event(Bpu *bpu, uint8_t evt_type)
+{
+    bool shed;
+    uint8_t act;
+
+    shed = false;
+    act = bpu->types[bpu->types[evt_type].job].shed[bpu->ladder.level];
+
+    if (act == BPU_SHED_DROP) {
+        shed = true;
+    } else {
+        if (act != BPU_SHED_KEEP) {
+            // Keep one event in 2^act per event type
+            if ((bpu->ladder.decim[evt_type] & (uint8_t)((1U << act) - 1U)) != 0U) {
+                shed = true;
+            }
+            bpu->ladder.decim[evt_type]++;
+        }
+    }
+
+    return shed;
+}
+
+// Discard queued jobs and dirty state whose type the current level stops
+static void bpu_ladder_purge(Bpu *bpu)
+{
+    uint16_t i;
+    uint64_t m;
+
+    i = 0U;
+    while (i < bpu->jobq.count) {
+        const BpuJob *j;
+        BpuJob dead;
+
+        j = bpu_jor_at(&bpu->jobq, i);
+
+        if (bpu->types[j->type].shed[bpu->ladder.level] == BPU_SHED_DROP) {
+            (void)bpu_jor_remove_at(&bpu->jobq, i, &dead);
+            bpu->st.shed++;
+        } else {
+            i++;
+        }
+    }
+
+    m = bpu->state.dirty;
+    while (m != 0ULL) {
+        uint8_t slot;
+
+        slot = bpu_ctz64(m);
+        m &= m - 1ULL;
+
+        if (bpu->types[bpu->state.slot[slot].type].shed[bpu->ladder.level] == BPU_SHED_DROP) {
+            bpu->state.dirty &= ~bpu_bit64(slot);
+            bpu->st.shed++;
+        }
+    }
+}
+
+// Classify this tick's pressure and step the level with hysteresis
+static void bpu_ladder_update(Bpu *bpu, uint32_t now_ms, uint32_t skips)
+{
+    BpuLadder *l;
+    bool hot;
+    bool cool;
+
+    l = &bpu->ladder;
+
+    if (l->have_last != 0U) {
+        bpu->st.level_ms[l->level] += now_ms - l->last_ms;
+    }
+    l->last_ms = now_ms;
+    l->have_last = 1U;
+
+    hot = false;
+    cool = false;
+
+    if (skips != 0U) {
+        hot = true;
+    } else {
+        if ((uint32_t)bpu->jobq.count * 4U >= BPU_JOBQ_LEN * 3U || (uint32_t)bpu->evq.count * 4U >= BPU_EVQ_LEN * 3U) {
+            hot = true;
+        } else {
+            if ((uint32_t)bpu->jobq.count * 4U <= BPU_JOBQ_LEN && (uint32_t)bpu->evq.count * 4U <= BPU_EVQ_LEN) {
+                cool = true;
+            }
+        }
+    }
+
+    if (hot) {
+        l->cool = 0U;
+        l->hot++;
+
+        if (l->hot >= BPU_LADDER_UP_TICKS && l->level < BPU_LEVEL_MAX) {
+            l->level++;
+            l->hot = 0U;
+            bpu->st.level_up++;
+            bpu_ladder_purge(bpu);
+        }
+    } else {
+        l->hot = 0U;
+
+        if (cool) {
+            l->cool++;
+
+            if (l->cool >= BPU_LADDER_DOWN_TICKS && l->level > 0U) {
+                l->level--;
+                l->cool = 0U;
+                bpu->st.level_down++;
+            }
+        } else {
+            l->cool = 0U;
+        }
+    }
+
+    bpu->st.level = l->level;
+}
+
+// True when a CMD-class event or job is waiting
+static bool bpu_cmd_waiting(const Bpu *bpu)
+{
+    bool found;
+    uint64_t m;
+    uint16_t i;
+
+    found = false;
+
+    m = bpu->jobq.tmask;
+    while (m != 0ULL && !found) {
+        if (bpu->types[bpu_ctz64(m)].prio == BPU_PRIO_CMD) {
+            found = true;
+        }
+        m &= m - 1ULL;
+    }
+
+    i = 0U;
+    while (i < bpu->evq.count && !found) {
+        const BpuEvent *e;
+
+        e = &bpu->evq.buf[(uint16_t)((bpu->evq.tail + i) % BPU_EVQ_LEN)];
+        if (bpu->types[bpu->types[e->type].job].prio == BPU_PRIO_CMD) {
+            found = true;
+        }
+        i++;
+    }
+
+    return found;
+}
+
+// Put an aborted job back without coalescing. A newer job for the same
+// (type, key) keeps its values; the aborted one only folds its aggregate
+// fields and sample count into it. Otherwise the job goes to the end of the
+// queue, into the slot bpu_jobq_slot_held() kept for it
+static void bpu_preempt_put_back(Bpu *bpu, const BpuJob *j)
+{
+    const BpuTypeDesc *d;
+    BpuJob *ex;
+    uint32_t n;
+
+    d = &bpu->types[j->type];
+    ex = NULL;
+
+    if ((d->flags & BPU_TF_STATE) != 0U) {
+        bpu_requeue_job(bpu, j);
+    } else {
+        if (d->merge != BPU_MERGE_NONE) {
+            ex = bpu_jor_find(&bpu->jobq, j->type, j->key);
+        }
+
+        if (ex != NULL) {
+            n = (uint32_t)ex->n + (uint32_t)j->n;
+            bpu_merge_payload(d, ex->payload, ex->len, ex->n, j->payload, j->len, j->n, 2U);
+            ex->n = (n > 0xFFFFU) ? 0xFFFFU : (uint16_t)n;
+            bpu->st.job_merge++;
+        } else {
+            if (bpu_jor_push(&bpu->jobq, j) != BPU_RC_OK) {
+                if (!bpu_spill_put(bpu, j)) {
+                    bpu->st.job_drop++;
+                }
+            }
+        }
+    }
+}
+
+// Abort a partially sent low-priority frame so a waiting CMD goes next.
+// Waiting events are converted first, so under FIFO the aborted job is
+// put back behind the CMD instead of ahead of it
+static void bpu_preempt(Bpu *bpu, uint32_t now_ms)
+{
+    BpuJob j;
+
+    if (bpu->pending_have != 0U && bpu->pending_preempt != 0U) {
+        if (bpu_cmd_waiting(bpu)) {
+            j = bpu->pending_job;
+            (void)bpu_schedule_from_events(bpu, now_ms);
+            bpu->pending_preempt = 0U;
+            bpu_preempt_put_back(bpu, &j);
+            bpu->st.preempt_abort++;
+            bpu->st.preempt_bytes += (uint32_t)bpu->pending_pos;
+
+            if (bpu->pending_pos != 0U) {
+                // Terminate the cut frame; the receiver drops it on CRC/COBS
+                bpu->pending_buf[0] = 0x00U;
+                bpu->pending_len = 1U;
+                bpu->pending_pos = 0U;
+            } else {
+                bpu->pending_len = 0U;
+                bpu->pending_have = 0U;
+            }
+
+            bpu->pending_note = 0U;
+        }
+    }
+}
+
+// Append v as an unsigned LEB128 varint; returns bytes written (1..5)
+static uint8_t bpu_varint_put(uint8_t *p, uint32_t v)
+{
+    uint8_t n;
+
+    n = 0U;
+
+    while (v >= 0x80U) {
+        p[n] = (uint8_t)((v & 0x7FU) | 0x80U);
+        v >>= 7;
+        n++;
+    }
+
+    p[n] = (uint8_t)v;
+    n++;
+
+    return n;
+}
+
+// Map signed to unsigned so small magnitudes get short varints
+static uint32_t bpu_zigzag(int32_t v)
+{
+    uint32_t z;
+
+    if (v < 0) {
+        z = ((uint32_t)(-(v + 1)) << 1) | 1U;
+    } else {
+        z = (uint32_t)v << 1;
+    }
+
+    return z;
+}
+
+// Read the sample value of a batched event (first field, default U16 at 0)
+static int32_t bpu_batch_sample(const Bpu *bpu, const BpuEvent *e)
+{
+    const BpuTypeDesc *d;
+    uint8_t off;
+    uint8_t kind;
+    int32_t v;
+
+    d = &bpu->types[e->type];
+    off = 0U;
+    kind = BPU_FIELD_U16;
+    v = 0;
+
+    if (d->nfields != 0U && d->fields != NULL) {
+        off = d->fields[0].off;
+        kind = d->fields[0].kind;
+    }
+
+    if ((uint16_t)off + (uint16_t)bpu_field_width(kind) <= e->len) {
+        v = (int32_t)bpu_field_get(&e->payload[off], kind);
+    }
+
+    return v;
+}
+
+// Start a batch with its absolute time and base value
+static void bpu_batch_start(BpuBatch *b, const BpuEvent *e, int32_t v)
+{
+    b->used = 1U;
+    b->type = e->type;
+    b->key = e->key;
+    b->n = 1U;
+    b->t0_ms = e->t_ms;
+    b->t_last_ms = e->t_ms;
+    b->v_last = v;
+
+    b->len = bpu_varint_put(&b->buf[0], e->t_ms);
+    b->len = (uint16_t)(b->len + bpu_varint_put(&b->buf[b->len], bpu_zigzag(v)));
+}
+
+// Turn a batch into one job and release its slot
+static void bpu_batch_flush(Bpu *bpu, BpuBatch *b)
+{
+    const BpuTypeDesc *d;
+    BpuJob j;
+    uint16_t i;
+
+    d = &bpu->types[b->type];
+
+    j.type = d->job;
+    j.flags = 0U;
+    j.key = b->key;
+    j.n = b->n;
+    j.t_ms = b->t_last_ms;
+    j.payload[0] = d->tag;
+    j.payload[1] = (uint8_t)b->len;
+
+    i = 0U;
+    while (i < b->len) {
+        j.payload[2U + i] = b->buf[i];
+        i++;
+    }
+
+    j.len = (uint16_t)(2U + b->len);
+
+    bpu->st.batch_flush++;
+    bpu->st.batch_samples += (uint32_t)b->n;
+
+    (void)bpu_jobq_push_coalesce(bpu, &j);
+
+    b->used = 0U;
+    b->n = 0U;
+    b->len = 0U;
+}
+
+// Add one sample to the batch of (type, key); flush when it is full
+static void bpu_batch_add(Bpu *bpu, const BpuEvent *e)
+{
+    BpuBatch *b;
+    uint8_t i;
+    int32_t v;
+
+    b = NULL;
+
+    i = 0U;
+    while (i < BPU_BATCH_SLOTS && b == NULL) {
+        if (bpu->batch[i].used != 0U && bpu->batch[i].type == e->type && bpu->batch[i].key == e->key) {
+            b = &bpu->batch[i];
+        }
+        i++;
+    }
+
+    if (b == NULL) {
+        // No open batch: take a free slot, else flush the oldest one
+        b = &bpu->batch[0];
+
+        i = 0U;
+        while (i < BPU_BATCH_SLOTS) {
+            if (bpu->batch[i].used == 0U) {
+                if (b->used != 0U) {
+                    b = &bpu->batch[i];
+                }
+            } else {
+                if (b->used != 0U && (int32_t)(bpu->batch[i].t0_ms - b->t0_ms) < 0) {
+                    b = &bpu->batch[i];
+                }
+            }
+            i++;
+        }
+
+        if (b->used != 0U) {
+            bpu_batch_flush(bpu, b);
+        }
+    }
+
+    v = bpu_batch_sample(bpu, e);
+
+    if (b->used == 0U) {
+        bpu_batch_start(b, e, v);
+    } else {
+        uint8_t tmp[10];
+        uint8_t k;
+
+        k = bpu_varint_put(&tmp[0], e->t_ms - b->t_last_ms);
+        k = (uint8_t)(k + bpu_varint_put(&tmp[k], bpu_zigzag((int32_t)((uint32_t)v - (uint32_t)b->v_last))));
+
+        if (b->len + (uint16_t)k > (uint16_t)sizeof(b->buf)) {
+            bpu_batch_flush(bpu, b);
+            bpu_batch_start(b, e, v);
+        } else {
+            i = 0U;
+            while (i < k) {
+                b->buf[b->len + i] = tmp[i];
+                i++;
+            }
+
+            b->len = (uint16_t)(b->len + k);
+            b->n++;
+            b->t_last_ms = e->t_ms;
+            b->v_last = v;
+        }
+    }
+
+    if (b->n >= BPU_BATCH_N) {
+        bpu_batch_flush(bpu, b);
+    }
+}
+
+// Flush batches held longer than their hold time (deadline_ms or default)
+static void bpu_batch_expire(Bpu *bpu, uint32_t now_ms)
+{
+    uint8_t i;
+
+    i = 0U;
+    while (i < BPU_BATCH_SLOTS) {
+        BpuBatch *b;
+        uint32_t hold;
+
+        b = &bpu->batch[i];
+
+        if (b->used != 0U) {
+            hold = (uint32_t)bpu->types[bpu->types[b->type].job].deadline_ms;
+            if (hold == 0U) {
+                hold = BPU_BATCH_HOLD_MS;
+            }
+
+            if ((uint32_t)(now_ms - b->t0_ms) >= hold) {
+                bpu_batch_flush(bpu, b);
+            }
+        }
+
+        i++;
+    }
+}
+
+// FNV-1a over a job payload
+static uint32_t bpu_fnv1a(const uint8_t *p, uint16_t n)
+{
+    uint32_t h;
+    uint16_t i;
+
+    h = 2166136261U;
+
+    i = 0U;
+    while (i < n) {
+        h ^= (uint32_t)p[i];
+        h *= 16777619U;
+        i++;
+    }
+
+    return h;
+}
+
+// Value of the job type's first field (0 when the type has none)
+static int32_t bpu_job_field0(const Bpu *bpu, const BpuJob *j)
+{
+    const BpuTypeDesc *d;
+    int32_t v;
+    uint16_t off;
+
+    d = &bpu->types[j->type];
+    v = 0;
+
+    if (d->nfields != 0U && d->fields != NULL) {
+        off = (uint16_t)(2U + d->fields[0].off);
+
+        if (off + (uint16_t)bpu_field_width(d->fields[0].kind) <= j->len) {
+            v = (int32_t)bpu_field_get(&j->payload[off], d->fields[0].kind);
+        }
+    }
+
+    return v;
+}
+
+// Find the last-sent record of (type, key)
+static BpuSentEnt *bpu_soc_find(Bpu *bpu, uint8_t type, uint16_t key)
+{
+    BpuSentEnt *e;
+    uint8_t i;
+
+    e = NULL;
+
+    i = 0U;
+    while (i < BPU_SOC_SLOTS && e == NULL) {
+        if (bpu->sent[i].used != 0U && bpu->sent[i].type == type && bpu->sent[i].key == key) {
+            e = &bpu->sent[i];
+        }
+        i++;
+    }
+
+    return e;
+}
+
+// True when an on-change job matches what was last sent and no keepalive is due
+static bool bpu_soc_suppress(Bpu *bpu, const BpuJob *j, uint32_t now_ms)
+{
+    const BpuTypeDesc *d;
+    const BpuSentEnt *e;
+    bool same;
+
+    d = &bpu->types[j->type];
+    same = false;
+
+    if ((d->flags & BPU_TF_ON_CHANGE) != 0U) {
+        e = bpu_soc_find(bpu, j->type, j->key);
+
+        if (e != NULL) {
+            if (d->keepalive_ms == 0U || (uint32_t)(now_ms - e->t_ms) < (uint32_t)d->keepalive_ms) {
+                if (d->deadband != 0U && d->nfields != 0U) {
+                    int32_t dv;
+
+                    dv = bpu_job_field0(bpu, j) - e->v;
+                    if (dv < 0) {
+                        dv = -dv;
+                    }
+
+                    same = (dv <= (int32_t)d->deadband);
+                } else {
+                    same = (bpu_fnv1a(j->payload, j->len) == e->hash);
+                }
+            }
+        }
+    }
+
+    return same;
+}
+
+// Remember what was sent for an on-change type (evicts the oldest record)
+static void bpu_soc_note(Bpu *bpu, const BpuJob *j, uint32_t now_ms)
+{
+    BpuSentEnt *e;
+    uint8_t i;
+
+    if ((bpu->types[j->type].flags & BPU_TF_ON_CHANGE) != 0U) {
+        e = bpu_soc_find(bpu, j->type, j->key);
+
+        if (e == NULL) {
+            e = &bpu->sent[0];
+
+            i = 0U;
+            while (i < BPU_SOC_SLOTS) {
+                if (bpu->sent[i].used == 0U) {
+                    if (e->used != 0U) {
+                        e = &bpu->sent[i];
+                    }
+                } else {
+                    if (e->used != 0U && (int32_t)(bpu->sent[i].t_ms - e->t_ms) < 0) {
+                        e = &bpu->sent[i];
+                    }
+                }
+                i++;
+            }
+        }
+
+        e->used = 1U;
+        e->type = j->type;
+        e->key = j->key;
+        e->t_ms = now_ms;
+        e->hash = bpu_fnv1a(j->payload, j->len);
+        e->v = bpu_job_field0(bpu, j);
+    }
+}
+
+// Record a queued job once the last byte of its frame is out: the on-change
+// record and the deadline check must not see a frame that is later aborted
+static void bpu_pending_done(Bpu *bpu, uint32_t now_ms)
+{
+    if (bpu->pending_note != 0U && bpu->pending_have == 0U) {
+        bpu_soc_note(bpu, &bpu->pending_job, now_ms);
+        bpu_note_deadline(bpu, &bpu->pending_job, now_ms);
+        bpu->pending_note = 0U;
+    }
+}
+
+// Take the next job to send (queue first, then dirty state), skipping unchanged ones
+static int bpu_next_job(Bpu *bpu, uint16_t budget_left, uint32_t now_ms, BpuJob *out)
+{
+    int rc;
+    bool found;
+
+    rc = BPU_RC_OK;
+    found = false;
+
+    while (!found && rc == BPU_RC_OK) {
+        if (bpu->jobq.count == 0U) {
+            rc = bpu_state_take(bpu, out);
+        } else {
+            if (bpu->cfg.enable_edf != 0U) {
+                rc = bpu_jobq_pop_edf(bpu, budget_left, out);
+            } else {
+                rc = bpu_jobq_pop(bpu, out);
+            }
+        }
+
+        if (rc == BPU_RC_OK) {
+            if (bpu_soc_suppress(bpu, out, now_ms)) {
+                bpu->st.suppressed++;
+                bpu->st.suppressed_bytes += (uint32_t)bpu_job_wire_cost(out);
+            } else {
+                found = true;
+            }
+        }
+    }
+
+    return rc;
+}
+
+// Send a cached frame for (type, payload) with seq and CRC patched in; false on miss
+static bool bpu_tpl_emit(Bpu *bpu, uint8_t type, const uint8_t *payload, uint16_t len)
+{
+    BpuTemplate *t;
+    bool sent;
+    uint32_t h;
+    uint16_t crc;
+    uint16_t i;
+    uint8_t seq;
+
+    t = NULL;
+    sent = false;
+    h = bpu_fnv1a(payload, len);
+
+    i = 0U;
+    while (i < BPU_TPL_SLOTS && t == NULL) {
+        if (bpu->tpl[i].used != 0U && bpu->tpl[i].type == type && bpu->tpl[i].len == len && bpu->tpl[i].hash == h) {
+            t = &bpu->tpl[i];
+        }
+        i++;
+    }
+
+    if (t != NULL) {
+        i = 0U;
+        while (i < len && t->payload[i] == payload[i]) {
+            i++;
+        }
+
+        if (i != len) {
+            t = NULL;
+        }
+    }
+
+    if (t == NULL) {
+        bpu->st.tpl_miss++;
+    } else {
+        // CRC is affine in the seq byte: crc(seq) = crc(0) ^ XOR of per-bit deltas
+        seq = bpu->seq;
+        crc = t->crc0;
+
+        i = 0U;
+        while (i < 8U) {
+            if ((seq & (uint8_t)(1U << i)) != 0U) {
+                crc ^= t->dseq[i];
+            }
+            i++;
+        }
+
+        // Patched bytes must stay non-zero or the COBS code bytes would move
+        if (seq == 0U || (crc & 0xFFU) == 0U || (t->crc_n == 2U && (crc >> 8) == 0U)) {
+            bpu->st.tpl_fallback++;
+        } else {
+            i = 0U;
+            while (i < t->enc_len) {
+                bpu->pending_buf[i] = t->enc[i];
+                i++;
+            }
+
+            // Frames are < 254 bytes, so decoded[k] is encoded at k + 1
+            bpu->pending_buf[t->pos_seq + 1U] = seq;
+            bpu->pending_buf[t->pos_crc + 1U] = (uint8_t)(crc & 0xFFU);
+            if (t->crc_n == 2U) {
+                bpu->pending_buf[t->pos_crc + 2U] = (uint8_t)((crc >> 8) & 0xFFU);
+            }
+
+            bpu->pending_len = t->enc_len;
+            bpu->pending_pos = 0U;
+            bpu->pending_have = 1U;
+
+            bpu->seq++;
+            bpu->st.tpl_hit++;
+            sent = true;
+        }
+    }
+
+    return sent;
+}
+
+// Cache a freshly encoded frame as a template (only when seq/CRC bytes are non-zero)
+static void bpu_tpl_store(Bpu *bpu, uint8_t *decoded, uint8_t hdr, uint16_t len, uint8_t crc_n, uint16_t enc_len)
+{
+    BpuTemplate *t;
+    size_t dl;
+    uint16_t crc;
+    uint16_t i;
+    uint8_t pos_seq;
+    uint8_t seq;
+
+    dl = (size_t)hdr + (size_t)len;
+    pos_seq = (uint8_t)((decoded[0] == 0xB2U) ? 2U : 1U);
+    seq = decoded[pos_seq];
+    crc = decoded[dl];
+    if (crc_n == 2U) {
+        crc = (uint16_t)(crc | ((uint16_t)decoded[dl + 1U] << 8));
+    }
+
+    if (dl + crc_n < 254U && seq != 0U && (crc & 0xFFU) != 0U && (crc_n == 1U || (crc >> 8) != 0U)) {
+        // Round-robin replacement
+        t = &bpu->tpl[bpu->tpl_next];
+        bpu->tpl_next = (uint8_t)((bpu->tpl_next + 1U) % BPU_TPL_SLOTS);
+
+        t->used = 1U;
+        t->type = (uint8_t)((decoded[0] == 0xB2U) ? decoded[1] : (decoded[0] & 0x1FU));
+        t->len = len;
+        t->hash = bpu_fnv1a(&decoded[hdr], len);
+        t->enc_len = enc_len;
+        t->pos_seq = pos_seq;
+        t->pos_crc = (uint16_t)dl;
+        t->crc_n = crc_n;
+
+        i = 0U;
+        while (i < len) {
+            t->payload[i] = decoded[hdr + i];
+            i++;
+        }
+
+        i = 0U;
+        while (i < enc_len) {
+            t->enc[i] = bpu->pending_buf[i];
+            i++;
+        }
+
+        decoded[pos_seq] = 0U;
+        t->crc0 = bpu_frame_check(decoded, dl, crc_n);
+
+        i = 0U;
+        while (i < 8U) {
+            decoded[pos_seq] = (uint8_t)(1U << i);
+            t->dseq[i] = (uint16_t)(bpu_frame_check(decoded, dl, crc_n) ^ t->crc0);
+            i++;
+        }
+
+        decoded[pos_seq] = seq;
+    }
+}
+
+// CRC-8 (poly 0x07) for short v2 frames
+static uint8_t bpu_crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc;
+    size_t i;
+
+    crc = 0x00U;
+    i = 0U;
+
+    while (i < len) {
+        int b;
+
+        crc ^= data[i];
+
+        b = 0;
+        while (b < 8) {
+            if ((crc & 0x80U) != 0U) {
+                crc = (uint8_t)((crc << 1) ^ 0x07U);
+            } else {
+                crc = (uint8_t)(crc << 1);
+            }
+            b++;
+        }
+
+        i++;
+    }
+
+    return crc;
+}
+
+// Write the frame header; returns its length and the check size (1 or 2)
+static uint8_t bpu_frame_header(uint8_t *d, uint8_t type, uint8_t seq, uint16_t len, uint8_t *crc_n_out)
+{
+    uint8_t hdr;
+    uint8_t crc_n;
+
+    crc_n = 2U;
+
+    if (BPU_WIRE_VERSION == 2U && type < 32U) {
+        // v2: 01 C TTTTT, seq, varint len (C = CRC-8 instead of CRC-16)
+        if (len <= BPU_V2_CRC8_MAX) {
+            crc_n = 1U;
+        }
+
+        d[0] = (uint8_t)(0x40U | ((crc_n == 1U) ? 0x20U : 0x00U) | type);
+        d[1] = seq;
+        hdr = (uint8_t)(2U + bpu_varint_put(&d[2], len));
+    } else {
+        d[0] = 0xB2U;
+        d[1] = type;
+        d[2] = seq;
+        d[3] = (uint8_t)len;
+        hdr = 4U;
+    }
+
+    *crc_n_out = crc_n;
+
+    return hdr;
+}
+
+// Frame check over header and payload (v1 skips the 0xB2 magic)
+static uint16_t bpu_frame_check(const uint8_t *d, size_t n, uint8_t crc_n)
+{
+    uint16_t crc;
+
+    if (d[0] == 0xB2U) {
+        crc = bpu_crc16_ccitt(&d[1], n - 1U);
+    } else {
+        if (crc_n == 1U) {
+            crc = (uint16_t)bpu_crc8(d, n);
+        } else {
+            crc = bpu_crc16_ccitt(d, n);
+        }
+    }
+
+    return crc;
+}
+
+// Wire bytes of a frame (header, payload, check, COBS worst case, delimiter)
+static size_t bpu_frame_wire_cost(uint8_t type, uint16_t len)
+{
+    size_t decoded_len;
+    uint8_t hdr_buf[8];
+    uint8_t hdr;
+    uint8_t crc_n;
+
+    hdr = bpu_frame_header(hdr_buf, type, 0U, len, &crc_n);
+    decoded_len = (size_t)hdr + (size_t)len + (size_t)crc_n;
+
+    return decoded_len + (decoded_len / 254U) + 2U + 1U;
+}
+
+// Send bulk fragments with the budget left once real-time work is drained
+static void bpu_bulk_run(Bpu *bpu, uint32_t now_ms, uint16_t *budget_left)
+{
+    BpuBulk *b;
+    bool done;
+
+    b = &bpu->bulk;
+    done = false;
+
+    if (b->active != 0U) {
+        if (b->timed != 0U) {
+            bpu->st.bulk_ms += now_ms - b->t_last_ms;
+        }
+        b->t_last_ms = now_ms;
+        b->timed = 1U;
+    }
+
+    while (!done) {
+        uint8_t frag[BPU_PAYLOAD_MAX];
+        uint16_t n;
+        uint16_t got;
+        size_t free_sz;
+
+        n = 0U;
+
+        if (b->active == 0U || bpu->pending_have != 0U || bpu->jobq.count != 0U || bpu->state.dirty != 0ULL) {
+            done = true;
+        } else {
+            // Largest data size whose whole frame fits the leftover budget
+            if (b->total - b->off < (uint32_t)(BPU_PAYLOAD_MAX - BPU_BULK_HDR)) {
+                n = (uint16_t)(b->total - b->off);
+            } else {
+                n = (uint16_t)(BPU_PAYLOAD_MAX - BPU_BULK_HDR);
+            }
+
+            while (n != 0U && bpu_frame_wire_cost(BPU_JOB_BULK, (uint16_t)(BPU_BULK_HDR + n)) > (size_t)(*budget_left)) {
+                n--;
+            }
+
+            free_sz = 0U;
+            if (n == 0U || bpu->io.tx_free(bpu->io.ctx, &free_sz) != BPU_RC_OK || free_sz < (size_t)bpu->cfg.tx_min_free) {
+                done = true;
+            }
+        }
+
+        if (!done) {
+            got = 0U;
+
+            if (b->fn(b->ctx, b->off, &frag[BPU_BULK_HDR], n, &got) != BPU_RC_OK || got == 0U || got > n) {
+                // Source failed or ended early: stop, the receiver may resume later
+                b->active = 0U;
+                done = true;
+            } else {
+                bool progress;
+
+                frag[0] = b->id;
+                frag[1] = (uint8_t)((b->off + got >= b->total) ? BPU_BULK_F_LAST : 0U);
+                frag[2] = (uint8_t)(b->off & 0xFFU);
+                frag[3] = (uint8_t)((b->off >> 8) & 0xFFU);
+                frag[4] = (uint8_t)((b->off >> 16) & 0xFFU);
+                frag[5] = (uint8_t)((b->off >> 24) & 0xFFU);
+
+                if (bpu_build_frame(bpu, BPU_JOB_BULK, frag, (uint16_t)(BPU_BULK_HDR + got)) != BPU_RC_OK) {
+                    done = true;
+                } else {
+                    // A committed fragment is never preempted or requeued
+                    bpu->pending_preempt = 0U;
+
+                    b->off += got;
+                    bpu->st.bulk_frag++;
+                    bpu->st.bulk_bytes += (uint32_t)got;
+                    bpu->st.bulk_off = b->off;
+
+                    if (b->off >= b->total) {
+                        b->active = 0U;
+                        bpu->st.bulk_done++;
+                    }
+
+                    progress = false;
+                    if (bpu_send_pending(bpu, budget_left, &progress) != BPU_RC_OK || !progress || bpu->pending_have != 0U) {
+                        done = true;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Erase seg and make it the write segment; on failure the writer stays where it was
+static bool bpu_spill_open(Bpu *bpu, uint16_t seg)
+{
+    BpuSpill *sp;
+    bool ok;
+
+    sp = &bpu->spill;
+    ok = false;
+
+    if (sp->io.erase(sp->io.ctx, seg) == BPU_RC_OK) {
+        bpu->st.spill_erase++;
+        sp->wr_seg = seg;
+        sp->wr_off = 0U;
+        sp->seg_end[seg] = 0U;
+        sp->wr_open = 1U;
+        ok = true;
+    }
+
+    return ok;
+}
+
+// Append the RAM batch to the log as whole-record runs (records never
+// straddle segments); true when the batch is empty afterwards
+static bool bpu_spill_write_batch(Bpu *bpu)
+{
+    BpuSpill *sp;
+    bool done;
+
+    sp = &bpu->spill;
+    done = false;
+
+    while (!done) {
+        uint16_t run;
+        bool fits;
+
+        run = 0U;
+
+        if (sp->buf_rd >= sp->buf_len) {
+            done = true;
+        } else {
+            if (sp->wr_open == 0U) {
+                if (!bpu_spill_open(bpu, sp->wr_seg)) {
+                    done = true;
+                }
+            }
+        }
+
+        if (!done) {
+            fits = true;
+
+            while (fits && (uint16_t)(sp->buf_rd + run) < sp->buf_len) {
+                uint16_t r;
+
+                r = (uint16_t)(BPU_SPILL_REC_HDR + (uint16_t)sp->buf[sp->buf_rd + run + 10U] + 1U);
+
+                if (sp->wr_off + (uint32_t)run + (uint32_t)r > sp->io.seg_size) {
+                    fits = false;
+                } else {
+                    run = (uint16_t)(run + r);
+                }
+            }
+
+            if (run != 0U) {
+                if (sp->io.write(sp->io.ctx, sp->wr_seg, sp->wr_off, &sp->buf[sp->buf_rd], (size_t)run) != BPU_RC_OK) {
+                    done = true;
+                } else {
+                    bpu->st.spill_write++;
+                    bpu->st.spill_bytes += (uint32_t)run;
+                    sp->wr_off += (uint32_t)run;
+                    sp->seg_end[sp->wr_seg] = sp->wr_off;
+                    sp->buf_rd = (uint16_t)(sp->buf_rd + run);
+                }
+            } else {
+                uint16_t next;
+
+                // Segment is full: open the next one unless it still holds unread
+                // data. The writer moves only after the erase succeeded, so the
+                // reader never follows it onto a segment with stale records
+                next = (uint16_t)((sp->wr_seg + 1U) % sp->io.seg_count);
+
+                if (next == sp->rd_seg || !bpu_spill_open(bpu, next)) {
+                    done = true;
+                }
+            }
+        }
+    }
+
+    return sp->buf_rd >= sp->buf_len;
+}
+
+// Keep a job that would be dropped; false if the type does not spill or the store is full
+static bool bpu_spill_put(Bpu *bpu, const BpuJob *j)
+{
+    BpuSpill *sp;
+    bool stored;
+    uint16_t size;
+    uint16_t i;
+    uint8_t *p;
+
+    sp = &bpu->spill;
+    stored = false;
+
+    if (sp->attached != 0U && (bpu->types[j->type].flags & BPU_TF_SPILL) != 0U && j->len <= BPU_JOB_PAYLOAD_LEN) {
+        size = (uint16_t)(BPU_SPILL_REC_HDR + j->len + 1U);
+
+        if (sp->buf_rd >= sp->buf_len) {
+            sp->buf_rd = 0U;
+            sp->buf_len = 0U;
+        }
+
+        if ((uint32_t)sp->buf_len + (uint32_t)size > BPU_SPILL_BUF) {
+            (void)bpu_spill_write_batch(bpu);
+
+            // Compact whatever the log could not take
+            i = 0U;
+            while ((uint16_t)(sp->buf_rd + i) < sp->buf_len) {
+                sp->buf[i] = sp->buf[sp->buf_rd + i];
+                i++;
+            }
+            sp->buf_len = i;
+            sp->buf_rd = 0U;
+        }
+
+        if ((uint32_t)sp->buf_len + (uint32_t)size > BPU_SPILL_BUF) {
+            bpu->st.spill_full++;
+        } else {
+            p = &sp->buf[sp->buf_len];
+
+            p[0] = BPU_SPILL_MAGIC;
+            p[1] = j->type;
+            p[2] = (uint8_t)(j->key & 0xFFU);
+            p[3] = (uint8_t)((j->key >> 8) & 0xFFU);
+            p[4] = (uint8_t)(j->t_ms & 0xFFU);
+            p[5] = (uint8_t)((j->t_ms >> 8) & 0xFFU);
+            p[6] = (uint8_t)((j->t_ms >> 16) & 0xFFU);
+            p[7] = (uint8_t)((j->t_ms >> 24) & 0xFFU);
+            p[8] = (uint8_t)(j->n & 0xFFU);
+            p[9] = (uint8_t)((j->n >> 8) & 0xFFU);
+            p[10] = (uint8_t)j->len;
+
+            i = 0U;
+            while (i < j->len) {
+                p[BPU_SPILL_REC_HDR + i] = j->payload[i];
+                i++;
+            }
+
+            p[size - 1U] = bpu_crc8(p, (size_t)(size - 1U));
+
+            sp->buf_len = (uint16_t)(sp->buf_len + size);
+            bpu->st.spill_in++;
+            stored = true;
+        }
+    }
+
+    return stored;
+}
+
+// Read the oldest spilled record: from the log first, then the RAM batch
+static bool bpu_spill_peek(Bpu *bpu, BpuJob *out, uint16_t *size_out, bool *from_buf_out)
+{
+    BpuSpill *sp;
+    uint8_t rec[BPU_SPILL_REC_MAX];
+    const uint8_t *p;
+    uint16_t size;
+    uint16_t i;
+    bool done;
+
+    sp = &bpu->spill;
+    p = NULL;
+    size = 0U;
+    done = false;
+    *from_buf_out = false;
+
+    // Step over segments that have been read completely
+    while (!done) {
+        if (sp->rd_seg != sp->wr_seg && sp->rd_off >= sp->seg_end[sp->rd_seg]) {
+            sp->rd_seg = (uint16_t)((sp->rd_seg + 1U) % sp->io.seg_count);
+            sp->rd_off = 0U;
+        } else {
+            done = true;
+        }
+    }
+
+    if (sp->rd_seg != sp->wr_seg || sp->rd_off < sp->wr_off) {
+        if (sp->io.read(sp->io.ctx, sp->rd_seg, sp->rd_off, rec, BPU_SPILL_REC_HDR) == BPU_RC_OK && rec[0] == BPU_SPILL_MAGIC &&
+            rec[10] <= BPU_JOB_PAYLOAD_LEN) {
+            size = (uint16_t)(BPU_SPILL_REC_HDR + (uint16_t)rec[10] + 1U);
+
+            if (sp->rd_off + (uint32_t)size <= sp->seg_end[sp->rd_seg] &&
+                sp->io.read(sp->io.ctx, sp->rd_seg, sp->rd_off + BPU_SPILL_REC_HDR, &rec[BPU_SPILL_REC_HDR], (size_t)(size - BPU_SPILL_REC_HDR)) == BPU_RC_OK &&
+                bpu_crc8(rec, (size_t)(size - 1U)) == rec[size - 1U] && rec[1] < BPU_TYPE_MAX) {
+                p = rec;
+            }
+        }
+
+        if (p == NULL) {
+            // Unreadable record (or a type that would index past types[]):
+            // the rest of the segment cannot be trusted
+            bpu->st.spill_bad++;
+            sp->rd_off = sp->seg_end[sp->rd_seg];
+        }
+    } else {
+        if (sp->buf_rd < sp->buf_len) {
+            p = &sp->buf[sp->buf_rd];
+            size = (uint16_t)(BPU_SPILL_REC_HDR + (uint16_t)p[10] + 1U);
+            *from_buf_out = true;
+        }
+    }
+
+    if (p != NULL) {
+        out->type = p[1];
+        out->flags = 0U;
+        out->key = (uint16_t)((uint16_t)p[2] | ((uint16_t)p[3] << 8));
+        out->t_ms = (uint32_t)p[4] | ((uint32_t)p[5] << 8) | ((uint32_t)p[6] << 16) | ((uint32_t)p[7] << 24);
+        out->n = (uint16_t)((uint16_t)p[8] | ((uint16_t)p[9] << 8));
+        out->len = (uint16_t)p[10];
+
+        i = 0U;
+        while (i < out->len) {
+            out->payload[i] = p[BPU_SPILL_REC_HDR + i];
+            i++;
+        }
+
+        *size_out = size;
+    }
+
+    return p != NULL;
+}
+
+// Replay spilled jobs in order with the budget left once live work is drained
+static void bpu_spill_run(Bpu *bpu, uint16_t *budget_left)
+{
+    BpuSpill *sp;
+    bool done;
+
+    sp = &bpu->spill;
+    done = false;
+
+    while (!done) {
+        BpuJob j;
+        uint16_t size;
+        bool from_buf;
+        bool progress;
+        size_t free_sz;
+
+        size = 0U;
+        from_buf = false;
+        free_sz = 0U;
+
+        if (sp->attached == 0U || bpu->pending_have != 0U || bpu->jobq.count != 0U || bpu->state.dirty != 0ULL) {
+            done = true;
+        } else {
+            if (!bpu_spill_peek(bpu, &j, &size, &from_buf)) {
+                done = true;
+            } else {
+                if (bpu_frame_wire_cost(j.type, j.len) > (size_t)(*budget_left) || bpu->io.tx_free == NULL ||
+                    bpu->io.tx_free(bpu->io.ctx, &free_sz) != BPU_RC_OK || free_sz < (size_t)bpu->cfg.tx_min_free) {
+                    done = true;
+                } else {
+                    if (bpu_build_frame(bpu, j.type, j.payload, j.len) != BPU_RC_OK) {
+                        done = true;
+                    }
+                }
+            }
+        }
+
+        if (!done) {
+            // A replayed frame is never preempted: there is no queue slot to put it back in
+            bpu->pending_preempt = 0U;
+
+            if (from_buf) {
+                sp->buf_rd = (uint16_t)(sp->buf_rd + size);
+            } else {
+                sp->rd_off += (uint32_t)size;
+            }
+            bpu->st.spill_out++;
+
+            progress = false;
+            if (bpu_send_pending(bpu, budget_left, &progress) != BPU_RC_OK || !progress || bpu->pending_have != 0U) {
+                done = true;
+            }
+        }
+    }
+}
+
+// Drain the LOG ring: never more than the LOG budget or the free TX space
+static void bpu_log_drain(Bpu *bpu)
+{
+    BpuLog *lg;
+    uint16_t budget;
+    bool done;
+
+    lg = &bpu->log;
+    budget = lg->budget;
+    done = false;
+
+    while (!done) {
+        size_t free_sz;
+        size_t wrote;
+        size_t n;
+
+        free_sz = 0U;
+        wrote = 0U;
+
+        if (lg->attached == 0U || lg->count == 0U || budget == 0U) {
+            done = true;
+        } else {
+            if (lg->io.tx_free(lg->io.ctx, &free_sz) != BPU_RC_OK || free_sz == 0U) {
+                bpu->st.log_skip_backpressure++;
+                done = true;
+            } else {
+                n = (size_t)lg->count;
+                if (n > (size_t)(BPU_LOG_RING - lg->tail)) {
+                    n = (size_t)(BPU_LOG_RING - lg->tail);
+                }
+                if (n > (size_t)budget) {
+                    n = (size_t)budget;
+                }
+                if (n > free_sz) {
+                    n = free_sz;
+                }
+
+                if (lg->io.tx_write_some(lg->io.ctx, &lg->buf[lg->tail], n, &wrote) != BPU_RC_OK || wrote == 0U || wrote > n) {
+                    done = true;
+                } else {
+                    lg->tail = (uint16_t)((lg->tail + wrote) % BPU_LOG_RING);
+                    lg->count = (uint16_t)(lg->count - wrote);
+                    budget = (uint16_t)(budget - wrote);
+                    bpu->st.log_bytes += (uint32_t)wrote;
+                }
+            }
+        }
+    }
+
+    bpu->st.log_queued = lg->count;
+}
+
+// Fill of the fuller queue, in percent
+static uint8_t bpu_fill_pct(const Bpu *bpu)
+{
+    uint32_t ev;
+    uint32_t jo;
+
+    ev = ((uint32_t)bpu->evq.count * 100U) / BPU_EVQ_LEN;
+    jo = ((uint32_t)bpu->jobq.count * 100U) / BPU_JOBQ_LEN;
+
+    return (uint8_t)((ev > jo) ? ev : jo);
+}
+
+// Predict when a new event's frame would be sent: wire bytes ahead of it
+// (pending frame, queued jobs and events, its own frame) over the tick
+// budget, times the measured tick period; FIFO order, so EDF can only beat it.
+// The queue totals are kept by the ring operations, so this does not scan.
+static uint16_t bpu_predict_delay(Bpu *bpu, uint8_t evt_type, uint16_t len)
+{
+    uint32_t bytes;
+    uint32_t d;
+
+    d = 0U;
+
+    if (bpu->press.tick_ms != 0U && bpu->cfg.tx_budget_bytes != 0U) {
+        bytes = bpu->jobq.wire + bpu->evq.wire;
+        if (bpu->pending_have != 0U) {
+            bytes += (uint32_t)(bpu->pending_len - bpu->pending_pos);
+        }
+
+        bytes += (uint32_t)bpu_frame_wire_cost(bpu->types[evt_type].job, (uint16_t)(len + 2U));
+
+        d = ((bytes + bpu->cfg.tx_budget_bytes - 1U) / bpu->cfg.tx_budget_bytes) * (uint32_t)bpu->press.tick_ms;
+        if (d > 0xFFFFU) {
+            d = 0xFFFFU;
+        }
+    }
+
+    return (uint16_t)d;
+}
+
+// Report queue fill crossing the high or low watermark
+static void bpu_wm_queue(Bpu *bpu)
+{
+    BpuPressure *p;
+    uint8_t fill;
+
+    p = &bpu->press;
+    fill = bpu_fill_pct(bpu);
+
+    if (p->queue_high == 0U) {
+        if (fill >= p->high_pct) {
+            p->queue_high = 1U;
+            bpu->st.wm_queue_high++;
+            if (p->fn != NULL) {
+                p->fn(p->ctx, BPU_WM_QUEUE_HIGH, fill);
+            }
+        }
+    } else {
+        if (fill <= p->low_pct) {
+            p->queue_high = 0U;
+            if (p->fn != NULL) {
+                p->fn(p->ctx, BPU_WM_QUEUE_LOW, fill);
+            }
+        }
+    }
+}
+
+// Measure the tick period and report budget and queue watermark edges
+// (high on a tick with a budget miss, low after BPU_WM_COOL_TICKS without)
+static void bpu_wm_tick(Bpu *bpu, uint32_t now_ms, bool missed)
+{
+    BpuPressure *p;
+    uint32_t dt;
+
+    p = &bpu->press;
+
+    if (p->have_last != 0U) {
+        dt = now_ms - p->last_ms;
+        if (dt > 0xFFFFU) {
+            dt = 0xFFFFU;
+        }
+
+        if (p->tick_ms == 0U) {
+            p->tick_ms = (uint16_t)dt;
+        } else {
+            p->tick_ms = (uint16_t)((3U * (uint32_t)p->tick_ms + dt) / 4U);
+        }
+    }
+    p->last_ms = now_ms;
+    p->have_last = 1U;
+
+    if (missed) {
+        p->cool = 0U;
+
+        if (p->budget_high == 0U) {
+            p->budget_high = 1U;
+            bpu->st.wm_budget_high++;
+            if (p->fn != NULL) {
+                p->fn(p->ctx, BPU_WM_BUDGET_HIGH, bpu_fill_pct(bpu));
+            }
+        }
+    } else {
+        if (p->budget_high != 0U) {
+            p->cool++;
+
+            if (p->cool >= BPU_WM_COOL_TICKS) {
+                p->budget_high = 0U;
+                p->cool = 0U;
+                if (p->fn != NULL) {
+                    p->fn(p->ctx, BPU_WM_BUDGET_LOW, bpu_fill_pct(bpu));
+                }
+            }
+        }
+    }
+
+    bpu_wm_queue(bpu);
+}
+
+// Publish the live counters (and profile) under the seqlock: odd sequence while copying
+static void bpu_stats_publish(Bpu *bpu)
+{
+    uint32_t seq;
+
+    seq = bpu->pub_seq;
+
+    BPU_STORE_RLX(&bpu->pub_seq, seq + 1U);
+    BPU_FENCE_REL();
+
+    bpu_words_store((uint32_t *)(void *)&bpu->pub, (const uint32_t *)(const void *)&bpu->st, sizeof(BpuStats) / sizeof(uint32_t));
+#if BPU_PROFILE
+    bpu_words_store((uint32_t *)(void *)&bpu->prof_pub, (const uint32_t *)(const void *)&bpu->prof, sizeof(BpuProfile) / sizeof(uint32_t));
+#endif
+
+    BPU_STORE_REL(&bpu->pub_seq, seq + 2U);
+}
+
+// Copy words into a published block (inside an odd sequence)
+static void bpu_words_store(uint32_t *dst, const uint32_t *src, size_t words)
+{
+    size_t i;
+
+    i = 0U;
+    while (i < words) {
+        BPU_STORE_RLX(&dst[i], src[i]);
+        i++;
+    }
+}
+
+// Copy a published block, retrying while a publish overlaps the copy
+static int bpu_words_read(const Bpu *bpu, const uint32_t *src, uint32_t *dst, size_t words)
+{
+    int rc;
+    uint32_t seq0;
+    uint32_t seq1;
+    uint32_t tries;
+    size_t i;
+
+    rc = BPU_RC_OK;
+    tries = 0U;
+    seq0 = 1U;
+    seq1 = 0U;
+
+    while (tries < BPU_STATS_RETRY && (seq0 != seq1 || (seq0 & 1U) != 0U)) {
+        seq0 = BPU_LOAD_ACQ(&bpu->pub_seq);
+
+        i = 0U;
+        while (i < words) {
+            dst[i] = BPU_LOAD_RLX(&src[i]);
+            i++;
+        }
+
+        BPU_FENCE_ACQ();
+        seq1 = BPU_LOAD_RLX(&bpu->pub_seq);
+        tries++;
+    }
+
+    if (seq0 != seq1 || (seq0 & 1U) != 0U) {
+        rc = BPU_RC_ERR;
+    }
+
+    return rc;
+}
+
+// Hand one record to the capture sink; a failed sink ends the capture
+static void bpu_cap_emit(Bpu *bpu, const uint8_t *rec, uint16_t len)
+{
+    if (bpu->cap.fn(bpu->cap.ctx, rec, len) == BPU_RC_OK) {
+        bpu->st.cap_records++;
+    } else {
+        bpu->st.cap_drop++;
+        bpu->io = bpu->cap.io;
+        bpu->cap.attached = 0U;
+    }
+}
+
+// Write the time delta since the previous timed record
+static uint8_t bpu_cap_dt(Bpu *bpu, uint8_t *p, uint32_t now_ms)
+{
+    uint8_t n;
+
+    n = bpu_varint_put(p, now_ms - bpu->cap.last_ms);
+    bpu->cap.last_ms = now_ms;
+
+    return n;
+}
+
+// Record one type descriptor (fields beyond BPU_CAP_FIELDS_MAX are cut)
+static void bpu_cap_type(Bpu *bpu, uint8_t type)
+{
+    const BpuTypeDesc *d;
+    uint8_t rec[BPU_CAP_REC_MAX];
+    uint16_t n;
+    uint8_t nf;
+    uint8_t i;
+
+    d = &bpu->types[type];
+    nf = (d->fields == NULL) ? 0U : d->nfields;
+    if (nf > BPU_CAP_FIELDS_MAX) {
+        nf = BPU_CAP_FIELDS_MAX;
+    }
+
+    rec[0] = BPU_CAP_TYPE;
+    rec[1] = type;
+    rec[2] = d->merge;
+    rec[3] = d->job;
+    rec[4] = d->tag;
+    rec[5] = d->prio;
+    rec[6] = d->degrade;
+    n = 7U;
+    n = (uint16_t)(n + bpu_varint_put(&rec[n], d->ttl_ms));
+    n = (uint16_t)(n + bpu_varint_put(&rec[n], d->deadline_ms));
+    rec[n] = d->flags;
+    n++;
+    rec[n] = d->state_slot;
+    n++;
+
+    i = 0U;
+    while (i <= BPU_LEVEL_MAX) {
+        rec[n] = d->shed[i];
+        n++;
+        i++;
+    }
+
+    n = (uint16_t)(n + bpu_varint_put(&rec[n], d->keepalive_ms));
+    n = (uint16_t)(n + bpu_varint_put(&rec[n], d->deadband));
+    rec[n] = nf;
+    n++;
+
+    i = 0U;
+    while (i < nf) {
+        rec[n] = d->fields[i].off;
+        n++;
+        rec[n] = d->fields[i].kind;
+        n++;
+        rec[n] = d->fields[i].op;
+        n++;
+        i++;
+    }
+
+    bpu_cap_emit(bpu, rec, n);
+}
+
+// Record one push (len already clamped to the event payload)
+static void bpu_cap_push(Bpu *bpu, uint8_t evt_type, uint16_t key, const uint8_t *payload, uint16_t len, uint32_t now_ms)
+{
+    uint8_t rec[BPU_CAP_REC_MAX];
+    uint16_t n;
+    uint16_t i;
+
+    rec[0] = (bpu->cap.in_tick != 0U) ? BPU_CAP_TPUSH : BPU_CAP_PUSH;
+    n = 1U;
+    n = (uint16_t)(n + bpu_cap_dt(bpu, &rec[n], now_ms));
+    rec[n] = evt_type;
+    n++;
+    n = (uint16_t)(n + bpu_varint_put(&rec[n], key));
+    rec[n] = (uint8_t)len;
+    n++;
+
+    i = 0U;
+    while (i < len) {
+        rec[n] = payload[i];
+        n++;
+        i++;
+    }
+
+    bpu_cap_emit(bpu, rec, n);
+}
+
+// Record the start of a tick
+static void bpu_cap_tick(Bpu *bpu, uint32_t now_ms, uint32_t now_us)
+{
+    uint8_t rec[16];
+    uint16_t n;
+
+    rec[0] = BPU_CAP_TICK;
+    n = 1U;
+    n = (uint16_t)(n + bpu_cap_dt(bpu, &rec[n], now_ms));
+    n = (uint16_t)(n + bpu_varint_put(&rec[n], now_us));
+
+    bpu_cap_emit(bpu, rec, n);
+}
+
+// BpuIo.tx_free wrapper: call the platform and record the answer
+static int bpu_cap_tx_free(void *ctx, size_t *free_out)
+{
+    Bpu *bpu;
+    uint8_t rec[8];
+    uint16_t n;
+    int rc;
+
+    bpu = (Bpu *)ctx;
+    rc = bpu->cap.io.tx_free(bpu->cap.io.ctx, free_out);
+
+    if (bpu->cap.attached != 0U) {
+        rec[0] = BPU_CAP_FREE;
+        rec[1] = (uint8_t)rc;
+        n = 2U;
+        n = (uint16_t)(n + bpu_varint_put(&rec[n], (rc == BPU_RC_OK) ? (uint32_t)*free_out : 0U));
+        bpu_cap_emit(bpu, rec, n);
+    }
+
+    return rc;
+}
+
+// BpuIo.tx_write_some wrapper: call the platform and record the answer
+static int bpu_cap_tx_write_some(void *ctx, const uint8_t *p, size_t len, size_t *wrote_out)
+{
+    Bpu *bpu;
+    uint8_t rec[16];
+    uint16_t n;
+    int rc;
+
+    bpu = (Bpu *)ctx;
+    rc = bpu->cap.io.tx_write_some(bpu->cap.io.ctx, p, len, wrote_out);
+
+    if (bpu->cap.attached != 0U) {
+        rec[0] = BPU_CAP_WRITE;
+        rec[1] = (uint8_t)rc;
+        n = 2U;
+        n = (uint16_t)(n + bpu_varint_put(&rec[n], (uint32_t)len));
+        n = (uint16_t)(n + bpu_varint_put(&rec[n], (rc == BPU_RC_OK) ? (uint32_t)*wrote_out : 0U));
+        bpu_cap_emit(bpu, rec, n);
+    }
+
+    return rc;
+}
+
+// BpuIo.time_us wrapper: call the platform and record the answer
+static int bpu_cap_time_us(void *ctx, uint32_t *us_out)
+{
+    Bpu *bpu;
+    uint8_t rec[8];
+    uint16_t n;
+    int rc;
+
+    bpu = (Bpu *)ctx;
+    rc = bpu->cap.io.time_us(bpu->cap.io.ctx, us_out);
+
+    if (bpu->cap.attached != 0U) {
+        rec[0] = BPU_CAP_TIME;
+        rec[1] = (uint8_t)rc;
+        n = 2U;
+        n = (uint16_t)(n + bpu_varint_put(&rec[n], (rc == BPU_RC_OK) ? *us_out : 0U));
+        bpu_cap_emit(bpu, rec, n);
+    }
+
+    return rc;
+}
+
+#if BPU_PROFILE
+// Read the profiling clock: CCOUNT on Xtensa, TSC on x86, else BPU_PROFILE_CYCLES()
+// or, failing that, the time_us callback (microseconds instead of cycles)
+static uint32_t bpu_prof_now(Bpu *bpu)
+{
+    uint32_t lo;
+    uint32_t hi;
+
+    lo = 0U;
+    hi = 0U;
+
+#if defined(BPU_PROFILE_CYCLES)
+    lo = (uint32_t)BPU_PROFILE_CYCLES();
+#else
+#if defined(__XTENSA__)
+    __asm__ __volatile__("rsr %0, ccount" : "=a"(lo));
+#else
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+#else
+    (void)bpu_try_time_us(bpu, &lo);
+#endif
+#endif
+#endif
+
+    (void)bpu;
+    (void)hi;
+
+    return lo;
+}
+
+// Charge the time since the last switch to the running phase and start ph
+static uint8_t bpu_prof_switch(Bpu *bpu, uint8_t ph)
+{
+    uint32_t now;
+    uint8_t prev;
+
+    now = bpu_prof_now(bpu);
+    prev = bpu->prof_cur;
+
+    if (prev < BPU_PH_COUNT) {
+        bpu->prof_acc[prev] += now - bpu->prof_mark;
+    }
+    if (ph < BPU_PH_COUNT) {
+        bpu->prof_hit = (uint8_t)(bpu->prof_hit | (1U << ph));
+    }
+
+    bpu->prof_mark = now;
+    bpu->prof_cur = ph;
+
+    return prev;
+}
+
+// Fold this tick's per-phase cycles into min/avg/max and the log2 histogram
+static void bpu_prof_fold(Bpu *bpu)
+{
+    BpuPhaseProf *pp;
+    uint64_t sum;
+    uint32_t v;
+    uint32_t b;
+    uint8_t ph;
+
+    ph = 0U;
+    while (ph < BPU_PH_COUNT) {
+        if ((bpu->prof_hit & (1U << ph)) != 0U) {
+            pp = &bpu->prof.ph[ph];
+            v = bpu->prof_acc[ph];
+
+            if (pp->ticks == 0U || v < pp->min) {
+                pp->min = v;
+            }
+            if (v > pp->max) {
+                pp->max = v;
+            }
+
+            pp->ticks++;
+            sum = (((uint64_t)pp->sum_hi << 32) | (uint64_t)pp->sum_lo) + (uint64_t)v;
+            pp->sum_lo = (uint32_t)(sum & 0xFFFFFFFFULL);
+            pp->sum_hi = (uint32_t)(sum >> 32);
+            pp->avg = (uint32_t)(sum / (uint64_t)pp->ticks);
+
+            b = 0U;
+            while ((v >> 1) != 0U && b < BPU_PROFILE_BUCKETS - 1U) {
+                v >>= 1;
+                b++;
+            }
+            pp->hist[b]++;
+        }
+
+        bpu->prof_acc[ph] = 0U;
+        ph++;
+    }
+
+    bpu->prof_hit = 0U;
+}
+
+// Zero the live profile and this tick's accumulators
+static void bpu_prof_clear(Bpu *bpu)
+{
+    uint32_t *w;
+    size_t i;
+
+    w = (uint32_t *)(void *)&bpu->prof;
+    i = 0U;
+    while (i < sizeof(BpuProfile) / sizeof(uint32_t)) {
+        w[i] = 0U;
+        i++;
+    }
+
+    i = 0U;
+    while (i < BPU_PH_COUNT) {
+        bpu->prof_acc[i] = 0U;
+        i++;
+    }
+
+    bpu->prof_mark = 0U;
+    bpu->prof_cur = BPU_PH_NONE;
+    bpu->prof_hit = 0U;
+}
+#endif
+
+// Read microsecond clock if available
+static int bpu_try_time_us(Bpu *bpu, uint32_t *us_out)
+{
+    int rc;
+
+    rc = BPU_RC_ERR;
+
+    if (us_out != NULL) {
+        *us_out = 0U;
+    }
+
+    if (bpu != NULL && us_out != NULL) {
+        if (bpu->io.time_us != NULL) {
+            if (bpu->io.time_us(bpu->io.ctx, us_out) == BPU_RC_OK) {
+                rc = BPU_RC_OK;
+            }
+        }
+    }
+
+    return rc;
+}
+
+// Build framed packet into pending buffer
+static int bpu_build_frame(Bpu *bpu, uint8_t type, const uint8_t *payload, uint16_t len)
+{
+    int rc;
+    uint8_t decoded[BPU_FRAME_MAX];
+    size_t decoded_len;
+    size_t enc_len;
+    uint16_t crc;
+    uint16_t i;
+    uint8_t hdr;
+    uint8_t crc_n;
+    bool tpl;
+    uint8_t ph;
+
+    rc = BPU_RC_OK;
+
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (payload == NULL) {
+            rc = BPU_RC_ERR;
+        }
+    }
+
+    if (rc == BPU_RC_OK) {
+        BPU_PROF_ENTER(bpu, BPU_PH_ENCODE, ph);
+
+        if (len > BPU_PAYLOAD_MAX) {
+            len = BPU_PAYLOAD_MAX;
+        }
+
+        // v1 (and types >= 32 under v2) carry an 8-bit length
+        if ((BPU_WIRE_VERSION != 2U || type >= 32U) && len > 255U) {
+            len = 255U;
+        }
+
+        tpl = ((bpu->types[type].flags & BPU_TF_TEMPLATE) != 0U);
+
+        if (!(tpl && bpu_tpl_emit(bpu, type, payload, len))) {
+            hdr = bpu_frame_header(decoded, type, bpu->seq, len, &crc_n);
+
+            bpu->seq++;
+
+            i = 0U;
+            while (i < len) {
+                decoded[hdr + i] = payload[i];
+                i++;
+            }
+
+            crc = bpu_frame_check(decoded, (size_t)hdr + (size_t)len, crc_n);
+            decoded[hdr + len] = (uint8_t)(crc & 0xFFU);
+            if (crc_n == 2U) {
+                decoded[hdr + len + 1U] = (uint8_t)((crc >> 8) & 0xFFU);
+            }
+
+            decoded_len = (size_t)hdr + (size_t)len + (size_t)crc_n;
+
+            enc_len = bpu_cobs_encode(decoded, decoded_len, bpu->pending_buf, sizeof(bpu->pending_buf));
+            if (enc_len == 0U) {
+                rc = BPU_RC_ERR;
+            } else {
+                if (enc_len + 1U > sizeof(bpu->pending_buf)) {
+                    rc = BPU_RC_ERR;
+                } else {
+                    bpu->pending_buf[enc_len] = 0x00U;
+                    bpu->pending_len = (uint16_t)(enc_len + 1U);
+                    bpu->pending_pos = 0U;
+                    bpu->pending_have = 1U;
+
+                    if (tpl) {
+                        bpu_tpl_store(bpu, decoded, hdr, len, crc_n, bpu->pending_len);
+                    }
+                }
+            }
+        }
+
+        BPU_PROF_LEAVE(bpu, ph);
+    }
+
+    return rc;
+}
+
+// Drain pending buffer to IO under budget
+static int bpu_send_pending(Bpu *bpu, uint16_t *budget_left, bool *progress_out)
+{
+    int rc;
+    bool progress;
+    bool done;
+
+    rc = BPU_RC_OK;
+    progress = false;
+    done = false;
+
+    if (progress_out != NULL) {
+        *progress_out = false;
+    }
+
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (budget_left == NULL) {
+            rc = BPU_RC_ERR;
+        } else {
+            if (bpu->pending_have == 0U) {
+                bpu->pending_len = 0U;
+                bpu->pending_pos = 0U;
+            } else {
+                if (bpu->io.tx_write_some == NULL) {
+                    rc = BPU_RC_ERR;
+                } else {
+                    while (!done && bpu->pending_pos < bpu->pending_len && rc == BPU_RC_OK) {
+                        size_t want;
+                        size_t wrote;
+                        uint16_t budget;
+                        uint16_t chunk_cap;
+                        int wrc;
+                        uint8_t ph;
+
+                        want = 0U;
+                        if (*budget_left != 0U) {
+                            want = (size_t)(bpu->pending_len - bpu->pending_pos);
+                        }
+
+                        budget = *budget_left;
+
+                        if (want > (size_t)budget) {
+                            want = (size_t)budget;
+                        }
+
+                        chunk_cap = bpu->cfg.tx_chunk_max;
+                        if (chunk_cap != 0U) {
+                            if (want > (size_t)chunk_cap) {
+                                want = (size_t)chunk_cap;
+                            }
+                        }
+
+                        wrote = 0U;
+
+                        if (want == 0U) {
+                            done = true;
+                        } else {
+                            BPU_PROF_ENTER(bpu, BPU_PH_WRITE, ph);
+                            wrc = bpu->io.tx_write_some(bpu->io.ctx, &bpu->pending_buf[bpu->pending_pos], want, &wrote);
+                            BPU_PROF_LEAVE(bpu, ph);
+
+                            if (wrc != BPU_RC_OK) {
+                                rc = BPU_RC_ERR;
+                            } else {
+                                if (wrote == 0U) {
+                                    bpu->st.tx_skip_backpressure++;
+                                    done = true;
+                                } else {
+                                    bpu->pending_pos = (uint16_t)(bpu->pending_pos + (uint16_t)wrote);
+                                    *budget_left = (uint16_t)(*budget_left - (uint16_t)wrote);
+                                    bpu->st.tx_bytes += (uint32_t)wrote;
+                                    progress = true;
+                                }
+                            }
+                        }
+                    }
+
+                    if (rc == BPU_RC_OK) {
+                        if (bpu->pending_pos >= bpu->pending_len) {
+                            bpu->pending_len = 0U;
+                            bpu->pending_pos = 0U;
+                            bpu->pending_have = 0U;
+
+                            bpu->st.tx_frame_sent++;
+                            bpu->st.pending_active = 0U;
+                            bpu->st.pending_len = 0U;
+                            bpu->st.pending_pos = 0U;
+                        } else {
+                            if (progress) {
+                                bpu->st.tx_frame_partial++;
+                            }
+
+                            bpu->st.pending_active = 1U;
+                            bpu->st.pending_len = (uint32_t)bpu->pending_len;
+                            bpu->st.pending_pos = (uint32_t)bpu->pending_pos;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (progress_out != NULL) {
+        *progress_out = progress;
+    }
+
+    return rc;
+}
+
+// Build the job record for an event (tag, len, payload)
+static void bpu_job_from_event(const Bpu *bpu, const BpuEvent *e, BpuJob *j)
+{
+    const BpuTypeDesc *d;
+    uint16_t copy_n;
+    uint16_t i;
+
+    d = &bpu->types[e->type];
+
+    j->type = d->job;
+    j->flags = e->flags;
+    j->key = e->key;
+    j->n = e->n;
+    j->t_ms = e->t_ms;
+
+    j->payload[0] = d->tag;
+    j->payload[1] = (uint8_t)e->len;
+
+    copy_n = e->len;
+    if (copy_n > (uint16_t)(sizeof(j->payload) - 2U)) {
+        copy_n = (uint16_t)(sizeof(j->payload) - 2U);
+    }
+
+    i = 0U;
+    while (i < copy_n) {
+        j->payload[2U + i] = e->payload[i];
+        i++;
+    }
+
+    j->len = (uint16_t)(2U + copy_n);
+}
+
+// Convert one event into a job and queue it
+static int bpu_convert_event(Bpu *bpu, const BpuEvent *e, uint32_t now_ms)
+{
+    int rc;
+    bool aged;
+    BpuJob j;
+
+    rc = BPU_RC_OK;
+    aged = false;
+
+    if ((uint32_t)(now_ms - e->t_ms) >= (uint32_t)bpu->cfg.aged_ms) {
+        aged = true;
+    }
+
+    if (aged) {
+        bpu->st.pick_aged++;
+        bpu_count_prio(bpu->types[e->type].prio, NULL, &bpu->st.aged_hit_sensor, &bpu->st.aged_hit_hb, &bpu->st.aged_hit_telem);
+    }
+
+    bpu_job_from_event(bpu, e, &j);
+
+    if (bpu_jobq_push_coalesce(bpu, &j) != BPU_RC_OK) {
+        rc = BPU_RC_ERR;
+    }
+
+    return rc;
+}
+
+// Convert queued events into jobs, evicting expired ones
+static int bpu_schedule_from_events(Bpu *bpu, uint32_t now_ms)
+{
+    int rc;
+    bool done;
+
+    rc = BPU_RC_OK;
+    done = false;
+
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        bpu_batch_expire(bpu, now_ms);
+
+        while (!done) {
+            BpuEvent e;
+
+            if (bpu_evq_pop(bpu, &e) != BPU_RC_OK) {
+                done = true;
+            } else {
+                if (bpu_expired(bpu, bpu->types[e.type].job, e.t_ms, now_ms)) {
+                    bpu->st.expired_ev++;
+                } else {
+                    if (bpu_convert_event(bpu, &e, now_ms) != BPU_RC_OK) {
+                        rc = BPU_RC_ERR;
+                    }
+                }
+            }
+        }
+    }
+
+    return rc;
+}
+
+// Serialize and send queued jobs
+static int bpu_flush_jobs(Bpu *bpu, uint32_t now_ms, uint16_t *budget_left)
+{
+    int rc;
+    bool done;
+
+    rc = BPU_RC_OK;
+    done = false;
+
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (budget_left == NULL) {
+            rc = BPU_RC_ERR;
+        } else {
+            bpu_jobq_expire(bpu, now_ms);
+            bpu_state_expire(bpu, now_ms);
+
+            while (!done) {
+                if (*budget_left == 0U) {
+                    done = true;
+                } else {
+                    if (bpu->pending_have != 0U) {
+                        bool progress;
+
+                        progress = false;
+
+                        if (bpu_send_pending(bpu, budget_left, &progress) != BPU_RC_OK) {
+                            rc = BPU_RC_ERR;
+                            done = true;
+                        } else {
+                            bpu_pending_done(bpu, now_ms);
+                            if (!progress) {
+                                done = true;
+                            }
+                        }
+                    } else {
+                        if (bpu->jobq.count == 0U && bpu->state.dirty == 0ULL) {
+                            done = true;
+                        } else {
+                            BpuJob j;
+                            int pop_rc;
+                            size_t free_sz;
+                            int have_free;
+
+                            bpu->st.flush_try++;
+
+                            pop_rc = bpu_next_job(bpu, *budget_left, now_ms, &j);
+
+                            if (pop_rc != BPU_RC_OK) {
+                                done = true;
+                            } else {
+                                if (bpu_job_wire_cost(&j) > (size_t)(*budget_left)) {
+                                    bpu->st.tx_skip_budget++;
+
+                                    if (bpu->cfg.enable_degrade != 0U) {
+                                        if (bpu->types[j.type].degrade == BPU_DEGRADE_DROP) {
+                                            if (!bpu_spill_put(bpu, &j)) {
+                                                bpu->st.degrade_drop++;
+                                            }
+                                        } else {
+                                            bpu_requeue_job(bpu, &j);
+                                            bpu->st.degrade_requeue++;
+                                        }
+                                    } else {
+                                        bpu_requeue_job(bpu, &j);
+                                    }
 
-                        if (want == 0U) {
-                            done = true;
-                        } else {
-                            if (bpu->io.tx_write_some(bpu->io.ctx, &bpu->pending_buf[bpu->pending_pos], want, &wrote) != BPU_RC_OK) {
-                                rc = BPU_RC_ERR;
-                            } else {
-                                if (wrote == 0U) {
-                                    bpu->st.tx_skip_backpressure++;
                                     done = true;
                                 } else {
-                                    bpu->pending_pos = (uint16_t)(bpu->pending_pos + (uint16_t)wrote);
-                                    *budget_left = (uint16_t)(*budget_left - (uint16_t)wrote);
-                                    bpu->st.tx_bytes += (uint32_t)wrote;
-                                    progress = true;
+                                    free_sz = 0U;
+                                    have_free = BPU_RC_ERR;
+
+                                    if (bpu->io.tx_free != NULL) {
+                                        have_free = bpu->io.tx_free(bpu->io.ctx, &free_sz);
+                                    }
+
+                                    if (have_free != BPU_RC_OK) {
+                                        bpu_requeue_job(bpu, &j);
+                                        bpu->st.degrade_requeue++;
+                                        done = true;
+                                    } else {
+                                        if (free_sz < (size_t)bpu->cfg.tx_min_free) {
+                                            bpu_requeue_job(bpu, &j);
+                                            bpu->st.degrade_requeue++;
+                                            bpu->st.tx_skip_backpressure++;
+                                            done = true;
+                                        } else {
+                                            if (bpu_build_frame(bpu, j.type, j.payload, j.len) != BPU_RC_OK) {
+                                                bpu_requeue_job(bpu, &j);
+                                                bpu->st.degrade_requeue++;
+                                                done = true;
+                                            } else {
+                                                bool progress;
+                                                uint16_t before;
+
+                                                bpu->pending_job = j;
+                                                bpu->pending_preempt = (uint8_t)((bpu->types[j.type].prio != BPU_PRIO_CMD) ? 1U : 0U);
+                                                bpu->pending_note = 1U;
+
+                                                before = *budget_left;
+                                                progress = false;
+
+                                                if (bpu_send_pending(bpu, budget_left, &progress) != BPU_RC_OK) {
+                                                    bpu_requeue_job(bpu, &j);
+                                                    bpu->pending_len = 0U;
+                                                    bpu->pending_pos = 0U;
+                                                    bpu->pending_have = 0U;
+                                                    bpu->pending_note = 0U;
+                                                    bpu->st.degrade_requeue++;
+                                                    done = true;
+                                                } else {
+                                                    if (!progress) {
+                                                        bpu_requeue_job(bpu, &j);
+                                                        bpu->pending_len = 0U;
+                                                        bpu->pending_pos = 0U;
+                                                        bpu->pending_have = 0U;
+                                                        bpu->pending_note = 0U;
+                                                        bpu->st.degrade_requeue++;
+                                                        bpu->st.tx_skip_backpressure++;
+                                                        done = true;
+                                                    } else {
+                                                        bpu->st.flush_ok++;
+                                                        if ((bpu->types[j.type].flags & BPU_TF_STATE) != 0U) {
+                                                            bpu->st.state_sent++;
+                                                        }
+                                                        bpu_pending_done(bpu, now_ms);
+
+                                                        if (before == *budget_left) {
+                                                            done = true;
+                                                        }
+                                                    }
+                                                }
+                                            }
+                                        }
+                                    }
                                 }
                             }
                         }
                     }
+                }
+            }
+        }
+    }
+
+    return rc;
+}
+
+// Initialize BPU state and defaults
+int bpu_init(Bpu *bpu, const BpuIo *io, const BpuConfig *cfg)
+{
+    int rc;
+
+    rc = BPU_RC_OK;
+
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (io == NULL) {
+            rc = BPU_RC_ERR;
+        } else {
+            if (cfg == NULL) {
+                rc = BPU_RC_ERR;
+            } else {
+                if (io->tx_free == NULL) {
+                    rc = BPU_RC_ERR;
+                } else {
+                    if (io->tx_write_some == NULL) {
+                        rc = BPU_RC_ERR;
+                    }
+                }
+            }
+        }
+    }
+
+    if (rc == BPU_RC_OK) {
+        uint16_t t;
+
+        bpu->io = *io;
+        bpu->cfg = *cfg;
+
+        t = 0U;
+        while (t < BPU_TYPE_MAX) {
+            bpu->types[t] = bpu_type_default;
+            bpu->jobq.tcount[t] = 0U;
+            t++;
+        }
+
+        bpu->types[BPU_EVT_CMD] = bpu_type_cmd;
+        bpu->types[BPU_EVT_SENSOR] = bpu_type_sensor;
+        bpu->types[BPU_EVT_HB] = bpu_type_hb;
+        bpu->types[BPU_EVT_TELEM] = bpu_type_telem;
+        bpu->types[BPU_EVT_SENSOR_BATCH] = bpu_type_sensor_batch;
+
+        bpu->evq.head = 0U;
+        bpu->evq.tail = 0U;
+        bpu->evq.count = 0U;
+        bpu->evq.wire = 0U;
+        bpu_kidx_clear(bpu->evq.idx, BPU_EVQ_IDX_LEN);
+
+        bpu->jobq.head = 0U;
+        bpu->jobq.tail = 0U;
+        bpu->jobq.count = 0U;
+        bpu->jobq.tmask = 0ULL;
+        bpu->jobq.wire = 0U;
+        bpu_kidx_clear(bpu->jobq.idx, BPU_JOBQ_IDX_LEN);
+
+        bpu->state.used = 0ULL;
+        bpu->state.dirty = 0ULL;
+        bpu_kidx_clear(bpu->state.idx, BPU_STATE_IDX_LEN);
+
+        t = 0U;
+        while (t < BPU_TIMER_MAX) {
+            bpu->wheel.t[t].fn = NULL;
+            bpu->wheel.t[t].slot = 0U;
+            t++;
+        }
+
+        t = 0U;
+        while (t < BPU_WHEEL_SLOTS) {
+            bpu->wheel.head[t] = BPU_TIMER_NONE;
+            t++;
+        }
+
+        bpu->wheel.occupied = 0ULL;
+        bpu->wheel.cur_tick = 0U;
+        bpu->wheel.cur_ms = 0U;
+
+        t = 0U;
+        while (t < BPU_BATCH_SLOTS) {
+            bpu->batch[t].used = 0U;
+            bpu->batch[t].n = 0U;
+            bpu->batch[t].len = 0U;
+            t++;
+        }
+
+        t = 0U;
+        while (t < BPU_SOC_SLOTS) {
+            bpu->sent[t].used = 0U;
+            t++;
+        }
+
+        t = 0U;
+        while (t < BPU_TPL_SLOTS) {
+            bpu->tpl[t].used = 0U;
+            t++;
+        }
+        bpu->tpl_next = 0U;
+
+        bpu->bulk.fn = NULL;
+        bpu->bulk.ctx = NULL;
+        bpu->bulk.total = 0U;
+        bpu->bulk.off = 0U;
+        bpu->bulk.t_last_ms = 0U;
+        bpu->bulk.id = 0U;
+        bpu->bulk.active = 0U;
+        bpu->bulk.timed = 0U;
+
+        bpu->spill.io.ctx = NULL;
+        bpu->spill.io.read = NULL;
+        bpu->spill.io.write = NULL;
+        bpu->spill.io.erase = NULL;
+        bpu->spill.io.seg_size = 0U;
+        bpu->spill.io.seg_count = 0U;
+        bpu->spill.rd_off = 0U;
+        bpu->spill.wr_off = 0U;
+        bpu->spill.rd_seg = 0U;
+        bpu->spill.wr_seg = 0U;
+        bpu->spill.buf_rd = 0U;
+        bpu->spill.buf_len = 0U;
+        bpu->spill.wr_open = 0U;
+        bpu->spill.attached = 0U;
+
+        t = 0U;
+        while (t < BPU_SPILL_SEG_MAX) {
+            bpu->spill.seg_end[t] = 0U;
+            t++;
+        }
+
+        bpu->log.io.ctx = NULL;
+        bpu->log.io.tx_free = NULL;
+        bpu->log.io.tx_write_some = NULL;
+        bpu->log.io.time_us = NULL;
+        bpu->log.head = 0U;
+        bpu->log.tail = 0U;
+        bpu->log.count = 0U;
+        bpu->log.budget = 0U;
+        bpu->log.seq = 0U;
+        bpu->log.attached = 0U;
+
+        bpu->press.fn = NULL;
+        bpu->press.ctx = NULL;
+        bpu->press.high_pct = BPU_WM_HIGH_PCT;
+        bpu->press.low_pct = BPU_WM_LOW_PCT;
+        bpu->press.queue_high = 0U;
+        bpu->press.budget_high = 0U;
+        bpu->press.cool = 0U;
+        bpu->press.have_last = 0U;
+        bpu->press.tick_ms = 0U;
+        bpu->press.last_ms = 0U;
+
+        bpu->ladder.level = 0U;
+        bpu->ladder.hot = 0U;
+        bpu->ladder.cool = 0U;
+        bpu->ladder.have_last = 0U;
+        bpu->ladder.last_ms = 0U;
+
+        t = 0U;
+        while (t < BPU_TYPE_MAX) {
+            bpu->ladder.decim[t] = 0U;
+            t++;
+        }
+
+        bpu->pending_len = 0U;
+        bpu->pending_pos = 0U;
+        bpu->pending_have = 0U;
+        bpu->pending_preempt = 0U;
+        bpu->pending_note = 0U;
+
+        bpu->st.tick = 0U;
+        bpu->st.ev_in = 0U;
+        bpu->st.ev_out = 0U;
+        bpu->st.ev_merge = 0U;
+        bpu->st.ev_drop = 0U;
+        bpu->st.job_in = 0U;
+        bpu->st.job_out = 0U;
+        bpu->st.job_merge = 0U;
+        bpu->st.job_drop = 0U;
+        bpu->st.tx_frame_sent = 0U;
+        bpu->st.tx_frame_partial = 0U;
+        bpu->st.tx_bytes = 0U;
+        bpu->st.tx_skip_budget = 0U;
+        bpu->st.tx_skip_backpressure = 0U;
+        bpu->st.flush_try = 0U;
+        bpu->st.flush_ok = 0U;
+        bpu->st.pick_sensor = 0U;
+        bpu->st.pick_hb = 0U;
+        bpu->st.pick_telem = 0U;
+        bpu->st.pick_aged = 0U;
+        bpu->st.aged_hit_sensor = 0U;
+        bpu->st.aged_hit_hb = 0U;
+        bpu->st.aged_hit_telem = 0U;
+        bpu->st.edf_reorder = 0U;
+        bpu->st.deadline_miss_cmd = 0U;
+        bpu->st.deadline_miss_sensor = 0U;
+        bpu->st.deadline_miss_hb = 0U;
+        bpu->st.deadline_miss_telem = 0U;
+        bpu->st.expired_ev = 0U;
+        bpu->st.expired_job = 0U;
+        bpu->st.degrade_drop = 0U;
+        bpu->st.degrade_requeue = 0U;
+        bpu->st.pending_active = 0U;
+        bpu->st.pending_len = 0U;
+        bpu->st.pending_pos = 0U;
+        bpu->st.preempt_abort = 0U;
+        bpu->st.preempt_bytes = 0U;
+        bpu->st.dirty_mask_lo = 0U;
+        bpu->st.dirty_mask_hi = 0U;
+        bpu->st.state_write = 0U;
+        bpu->st.state_sent = 0U;
+        bpu->st.state_full = 0U;
+        bpu->st.state_dirty_lo = 0U;
+        bpu->st.state_dirty_hi = 0U;
+        bpu->st.batch_flush = 0U;
+        bpu->st.batch_samples = 0U;
+        bpu->st.suppressed = 0U;
+        bpu->st.suppressed_bytes = 0U;
+        bpu->st.tpl_hit = 0U;
+        bpu->st.tpl_miss = 0U;
+        bpu->st.tpl_fallback = 0U;
+        bpu->st.bulk_frag = 0U;
+        bpu->st.bulk_bytes = 0U;
+        bpu->st.bulk_off = 0U;
+        bpu->st.bulk_total = 0U;
+        bpu->st.bulk_done = 0U;
+        bpu->st.bulk_ms = 0U;
+        bpu->st.spill_in = 0U;
+        bpu->st.spill_out = 0U;
+        bpu->st.spill_write = 0U;
+        bpu->st.spill_bytes = 0U;
+        bpu->st.spill_erase = 0U;
+        bpu->st.spill_full = 0U;
+        bpu->st.spill_bad = 0U;
+        bpu->st.log_bytes = 0U;
+        bpu->st.log_drop = 0U;
+        bpu->st.log_drop_bytes = 0U;
+        bpu->st.log_skip_backpressure = 0U;
+        bpu->st.log_queued = 0U;
+        bpu->st.log_queued_max = 0U;
+        bpu->st.timer_fire = 0U;
+        bpu->st.timer_late = 0U;
+        bpu->st.level = 0U;
+        bpu->st.level_up = 0U;
+        bpu->st.level_down = 0U;
+        bpu->st.shed = 0U;
+        bpu->st.admit_reject = 0U;
+        bpu->st.wm_queue_high = 0U;
+        bpu->st.wm_budget_high = 0U;
+        bpu->st.cap_records = 0U;
+        bpu->st.cap_drop = 0U;
+
+        t = 0U;
+        while (t <= BPU_LEVEL_MAX) {
+            bpu->st.level_ms[t] = 0U;
+            t++;
+        }
+        bpu->st.work_us_last = 0U;
+        bpu->st.work_us_max = 0U;
 
-                    if (rc == BPU_RC_OK) {
-                        if (bpu->pending_pos >= bpu->pending_len) {
-                            bpu->pending_len = 0U;
-                            bpu->pending_pos = 0U;
-                            bpu->pending_have = 0U;
+#if BPU_PROFILE
+        bpu_prof_clear(bpu);
+#endif
+        bpu->cap.fn = NULL;
+        bpu->cap.ctx = NULL;
+        bpu->cap.last_ms = 0U;
+        bpu->cap.attached = 0U;
+        bpu->cap.in_tick = 0U;
 
-                            bpu->st.tx_frame_sent++;
-                            bpu->st.pending_active = 0U;
-                            bpu->st.pending_len = 0U;
-                            bpu->st.pending_pos = 0U;
-                        } else {
-                            if (progress) {
-                                bpu->st.tx_frame_partial++;
-                            }
+        bpu->pub_seq = 0U;
+        bpu_stats_publish(bpu);
 
-                            bpu->st.pending_active = 1U;
-                            bpu->st.pending_len = (uint32_t)bpu->pending_len;
-                            bpu->st.pending_pos = (uint32_t)bpu->pending_pos;
-                        }
-                    }
+        bpu->seq = 0U;
+        bpu->init_magic = 0x42505531U;
+    }
+
+    return rc;
+}
+
+// Register or replace a type descriptor
+int bpu_register_type(Bpu *bpu, uint8_t type, const BpuTypeDesc *desc)
+{
+    int rc;
+    bool job_changed;
+
+    rc = BPU_RC_OK;
+
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (desc == NULL) {
+            rc = BPU_RC_ERR;
+        } else {
+            if (bpu->init_magic != 0x42505531U) {
+                rc = BPU_RC_ERR;
+            } else {
+                if (type >= BPU_TYPE_MAX || desc->job >= BPU_TYPE_MAX) {
+                    rc = BPU_RC_ERR;
                 }
             }
         }
     }
 
-    if (progress_out != NULL) {
-        *progress_out = progress;
+    if (rc == BPU_RC_OK) {
+        job_changed = (bpu->types[type].job != desc->job);
+        bpu->types[type] = *desc;
+
+        if (job_changed) {
+            bpu_evq_rewire(bpu);
+        }
+
+        if (bpu->cap.attached != 0U) {
+            bpu_cap_type(bpu, type);
+        }
     }
 
     return rc;
 }
 
-// Convert queued events into jobs
-static int bpu_schedule_from_events(Bpu *bpu, uint32_t now_ms)
+// Add new event into queue (key 0)
+int bpu_push_event(Bpu *bpu, uint8_t evt_type, const uint8_t *payload, uint16_t len, uint32_t now_ms)
+{
+    return bpu_push_event_keyed(bpu, evt_type, 0U, payload, len, now_ms);
+}
+
+// Add new event for a given source key
+int bpu_push_event_keyed(Bpu *bpu, uint8_t evt_type, uint16_t key, const uint8_t *payload, uint16_t len, uint32_t now_ms)
+{
+    return bpu_push_event_ex(bpu, evt_type, key, payload, len, now_ms, NULL);
+}
+
+// Add new event and report the outcome and current pressure (out may be NULL).
+// With enable_admission, non-CMD events are rejected at ingress when the
+// predicted delay exceeds their job deadline (or TTL). Returns ERR only
+// when the event was dropped; shed and rejected events are policy, not errors.
+int bpu_push_event_ex(Bpu *bpu, uint8_t evt_type, uint16_t key, const uint8_t *payload, uint16_t len, uint32_t now_ms,
+                      BpuPushResult *out)
 {
     int rc;
-    bool done;
+    BpuEvent e;
+    const BpuTypeDesc *jd;
+    uint16_t i;
+    uint16_t delay;
+    uint16_t limit;
+    uint32_t merged;
+    uint8_t admit;
+    uint8_t ph;
 
     rc = BPU_RC_OK;
-    done = false;
+    delay = 0U;
+    admit = BPU_ADMIT_QUEUED;
 
     if (bpu == NULL) {
         rc = BPU_RC_ERR;
     } else {
-        while (!done) {
-            BpuEvent e;
+        if (payload == NULL) {
+            rc = BPU_RC_ERR;
+        } else {
+            if (bpu->init_magic != 0x42505531U) {
+                rc = BPU_RC_ERR;
+            }
+        }
+    }
 
-            if (bpu_evq_pop(bpu, &e) != BPU_RC_OK) {
-                done = true;
-            } else {
-                bool aged;
-                BpuJob j;
-                uint8_t tag;
-                uint16_t copy_n;
-                uint16_t i;
+    if (rc == BPU_RC_OK) {
+        if (evt_type >= BPU_TYPE_MAX) {
+            rc = BPU_RC_ERR;
+        }
+    }
 
-                aged = false;
+    if (rc == BPU_RC_OK) {
+        BPU_PROF_ENTER(bpu, BPU_PH_INGEST, ph);
+        bpu_count_prio(bpu->types[evt_type].prio, NULL, &bpu->st.pick_sensor, &bpu->st.pick_hb, &bpu->st.pick_telem);
 
-                if ((uint32_t)(now_ms - e.t_ms) >= (uint32_t)bpu->cfg.aged_ms) {
-                    aged = true;
-                }
+        jd = &bpu->types[bpu->types[evt_type].job];
 
-                if (aged) {
-                    bpu->st.pick_aged++;
+        if (len > (uint16_t)sizeof(e.payload)) {
+            len = (uint16_t)sizeof(e.payload);
+        }
 
-                    if (e.type == BPU_EVT_SENSOR) {
-                        bpu->st.aged_hit_sensor++;
-                    } else {
-                        if (e.type == BPU_EVT_HB) {
-                            bpu->st.aged_hit_hb++;
-                        } else {
-                            if (e.type == BPU_EVT_TELEM) {
-                                bpu->st.aged_hit_telem++;
-                            }
-                        }
-                    }
+        if (bpu->cap.attached != 0U) {
+            bpu_cap_push(bpu, evt_type, key, payload, len, now_ms);
+        }
+
+        if (out != NULL || bpu->cfg.enable_admission != 0U) {
+            delay = bpu_predict_delay(bpu, evt_type, len);
+        }
+
+        limit = (jd->deadline_ms != 0U) ? jd->deadline_ms : jd->ttl_ms;
+
+        if (bpu_shed_event(bpu, evt_type)) {
+            bpu->st.shed++;
+            admit = BPU_ADMIT_SHED;
+        } else {
+            // State and batch types are not queued per event, so only queued types are predicted
+            if (bpu->cfg.enable_admission != 0U && jd->prio >= BPU_PRIO_SENSOR && limit != 0U && delay > limit &&
+                (bpu->types[evt_type].flags & (BPU_TF_STATE | BPU_TF_BATCH)) == 0U) {
+                bpu->st.admit_reject++;
+                admit = BPU_ADMIT_REJECTED;
+            } else {
+                e.type = evt_type;
+                e.flags = 0U;
+                e.len = len;
+                e.key = key;
+                e.n = 1U;
+                e.t_ms = now_ms;
+
+                i = 0U;
+                while (i < len) {
+                    e.payload[i] = payload[i];
+                    i++;
                 }
 
-                j.type = bpu_job_for_evt(e.type);
-                j.flags = e.flags;
-                j.t_ms = now_ms;
+                if ((bpu->types[evt_type].flags & BPU_TF_STATE) != 0U) {
+                    BpuJob j;
 
-                tag = 0U;
-                if (e.type == BPU_EVT_SENSOR) {
-                    tag = 0x01U;
+                    bpu->st.ev_in++;
+                    bpu_job_from_event(bpu, &e, &j);
+
+                    if (bpu_state_write(bpu, &j) != BPU_RC_OK) {
+                        rc = BPU_RC_ERR;
+                        admit = BPU_ADMIT_DROPPED;
+                    }
                 } else {
-                    if (e.type == BPU_EVT_HB) {
-                        tag = 0x02U;
+                    if ((bpu->types[evt_type].flags & BPU_TF_BATCH) != 0U) {
+                        bpu->st.ev_in++;
+                        bpu_batch_add(bpu, &e);
                     } else {
-                        if (e.type == BPU_EVT_TELEM) {
-                            tag = 0x03U;
+                        merged = bpu->st.ev_merge;
+
+                        if (bpu_evq_push_coalesce(bpu, &e) != BPU_RC_OK) {
+                            rc = BPU_RC_ERR;
+                            admit = BPU_ADMIT_DROPPED;
                         } else {
-                            if (e.type == BPU_EVT_CMD) {
-                                tag = 0x04U;
-                            } else {
-                                tag = 0x00U;
+                            if (bpu->st.ev_merge != merged) {
+                                admit = BPU_ADMIT_MERGED;
                             }
                         }
                     }
                 }
+            }
+        }
 
-                j.payload[0] = tag;
-                j.payload[1] = (uint8_t)e.len;
+        bpu_wm_queue(bpu);
 
-                copy_n = e.len;
-                if (copy_n > (uint16_t)(sizeof(j.payload) - 2U)) {
-                    copy_n = (uint16_t)(sizeof(j.payload) - 2U);
-                }
+        if (out != NULL) {
+            out->admit = admit;
+            out->level = bpu->ladder.level;
+            out->fill_pct = bpu_fill_pct(bpu);
+            out->next_shed = jd->shed[bpu->ladder.level];
+            out->delay_ms = delay;
+        }
+        BPU_PROF_LEAVE(bpu, ph);
+    }
 
-                i = 0U;
-                while (i < copy_n) {
-                    j.payload[2U + i] = e.payload[i];
-                    i++;
-                }
+    return rc;
+}
+
+// Set queue watermarks (percent, low < high <= 100) and the edge callback (fn may be NULL)
+int bpu_watermark_set(Bpu *bpu, uint8_t high_pct, uint8_t low_pct, BpuWatermarkFn fn, void *ctx)
+{
+    int rc;
 
-                j.len = (uint16_t)(2U + copy_n);
+    rc = BPU_RC_OK;
 
-                if (bpu_jobq_push_coalesce(bpu, &j) != BPU_RC_OK) {
-                    rc = BPU_RC_ERR;
-                }
-            }
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (bpu->init_magic != 0x42505531U || high_pct > 100U || low_pct >= high_pct) {
+            rc = BPU_RC_ERR;
         }
     }
 
+    if (rc == BPU_RC_OK) {
+        bpu->press.high_pct = high_pct;
+        bpu->press.low_pct = low_pct;
+        bpu->press.fn = fn;
+        bpu->press.ctx = ctx;
+    }
+
     return rc;
 }
 
-// Serialize and send queued jobs
-static int bpu_flush_jobs(Bpu *bpu, uint32_t now_ms, uint16_t *budget_left)
+// Register a periodic producer; the first expiry is at first_ms
+int bpu_timer_add(Bpu *bpu, uint8_t evt_type, uint16_t key, uint32_t period_ms, uint32_t first_ms,
+                  BpuTimerFn fn, void *ctx, uint16_t *id_out)
 {
     int rc;
-    bool done;
+    uint16_t id;
 
     rc = BPU_RC_OK;
-    done = false;
+    id = 0U;
 
     if (bpu == NULL) {
         rc = BPU_RC_ERR;
     } else {
-        if (budget_left == NULL) {
+        if (fn == NULL || period_ms == 0U || evt_type >= BPU_TYPE_MAX) {
             rc = BPU_RC_ERR;
         } else {
-            while (!done) {
-                if (*budget_left == 0U) {
-                    done = true;
-                } else {
-                    if (bpu->pending_have != 0U) {
-                        bool progress;
-
-                        progress = false;
+            if (bpu->init_magic != 0x42505531U) {
+                rc = BPU_RC_ERR;
+            }
+        }
+    }
 
-                        if (bpu_send_pending(bpu, budget_left, &progress) != BPU_RC_OK) {
-                            rc = BPU_RC_ERR;
-                            done = true;
-                        } else {
-                            if (!progress) {
-                                done = true;
-                            }
-                        }
-                    } else {
-                        if (bpu->jobq.count == 0U) {
-                            done = true;
-                        } else {
-                            BpuJob j;
-                            size_t decoded_len;
-                            size_t worst_overhead;
-                            size_t worst_on_wire;
-                            uint8_t wire_len;
-                            size_t free_sz;
-                            int have_free;
+    if (rc == BPU_RC_OK) {
+        // A dead entry still on the list being run is not free yet
+        while (id < BPU_TIMER_MAX && (bpu->wheel.t[id].fn != NULL || bpu->wheel.t[id].slot == BPU_WHEEL_DETACHED)) {
+            id++;
+        }
 
-                            bpu->st.flush_try++;
+        if (id >= BPU_TIMER_MAX) {
+            rc = BPU_RC_ERR;
+        } else {
+            BpuTimer *t;
 
-                            if (bpu_jobq_pop(bpu, &j) != BPU_RC_OK) {
-                                done = true;
-                            } else {
-                                decoded_len = 4U + (size_t)j.len + 2U;
-                                worst_overhead = (decoded_len / 254U) + 2U;
-                                worst_on_wire = decoded_len + worst_overhead + 1U;
+            t = &bpu->wheel.t[id];
+            t->fn = fn;
+            t->ctx = ctx;
+            t->period_ms = period_ms;
+            t->due_ms = first_ms;
+            t->key = key;
+            t->evt_type = evt_type;
 
-                                if (worst_on_wire > (size_t)(*budget_left)) {
-                                    bpu->st.tx_skip_budget++;
+            bpu_wheel_link(&bpu->wheel, id);
 
-                                    if (bpu->cfg.enable_degrade != 0U) {
-                                        if (j.type == BPU_JOB_TELEM) {
-                                            bpu->st.degrade_drop++;
-                                        } else {
-                                            (void)bpu_jobq_push_coalesce(bpu, &j);
-                                            bpu->st.degrade_requeue++;
-                                        }
-                                    } else {
-                                        (void)bpu_jobq_push_coalesce(bpu, &j);
-                                    }
+            if (id_out != NULL) {
+                *id_out = id;
+            }
+        }
+    }
 
-                                    done = true;
-                                } else {
-                                    free_sz = 0U;
-                                    have_free = BPU_RC_ERR;
+    return rc;
+}
 
-                                    if (bpu->io.tx_free != NULL) {
-                                        have_free = bpu->io.tx_free(bpu->io.ctx, &free_sz);
-                                    }
+// Unregister a periodic producer (also from inside a timer callback)
+int bpu_timer_remove(Bpu *bpu, uint16_t id)
+{
+    int rc;
 
-                                    if (have_free != BPU_RC_OK) {
-                                        (void)bpu_jobq_push_coalesce(bpu, &j);
-                                        bpu->st.degrade_requeue++;
-                                        done = true;
-                                    } else {
-                                        if (free_sz < (size_t)bpu->cfg.tx_min_free) {
-                                            (void)bpu_jobq_push_coalesce(bpu, &j);
-                                            bpu->st.degrade_requeue++;
-                                            bpu->st.tx_skip_backpressure++;
-                                            done = true;
-                                        } else {
-                                            wire_len = 0U;
-                                            if (j.len > 255U) {
-                                                wire_len = 255U;
-                                            } else {
-                                                wire_len = (uint8_t)j.len;
-                                            }
+    rc = BPU_RC_OK;
 
-                                            if (bpu_build_frame(bpu, j.type, j.payload, wire_len) != BPU_RC_OK) {
-                                                (void)bpu_jobq_push_coalesce(bpu, &j);
-                                                bpu->st.degrade_requeue++;
-                                                done = true;
-                                            } else {
-                                                bool progress;
-                                                uint16_t before;
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (id >= BPU_TIMER_MAX) {
+            rc = BPU_RC_ERR;
+        } else {
+            if (bpu->wheel.t[id].fn == NULL) {
+                rc = BPU_RC_ERR;
+            }
+        }
+    }
 
-                                                before = *budget_left;
-                                                progress = false;
+    if (rc == BPU_RC_OK) {
+        // A timer on the list being run is dropped by bpu_timers_run()
+        if (bpu->wheel.t[id].slot != BPU_WHEEL_DETACHED) {
+            bpu_wheel_unlink(&bpu->wheel, id);
+        }
+        bpu->wheel.t[id].fn = NULL;
+    }
 
-                                                if (bpu_send_pending(bpu, budget_left, &progress) != BPU_RC_OK) {
-                                                    (void)bpu_jobq_push_coalesce(bpu, &j);
-                                                    bpu->pending_len = 0U;
-                                                    bpu->pending_pos = 0U;
-                                                    bpu->pending_have = 0U;
-                                                    bpu->st.degrade_requeue++;
-                                                    done = true;
-                                                } else {
-                                                    if (!progress) {
-                                                        (void)bpu_jobq_push_coalesce(bpu, &j);
-                                                        bpu->pending_len = 0U;
-                                                        bpu->pending_pos = 0U;
-                                                        bpu->pending_have = 0U;
-                                                        bpu->st.degrade_requeue++;
-                                                        bpu->st.tx_skip_backpressure++;
-                                                        done = true;
-                                                    } else {
-                                                        bpu->st.flush_ok++;
+    return rc;
+}
 
-                                                        if (before == *budget_left) {
-                                                            done = true;
-                                                        }
-                                                    }
-                                                }
-                                            }
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
+// Earliest time a timer may expire (lower bound, wheel-tick resolution)
+int bpu_timer_next(const Bpu *bpu, uint32_t *next_ms_out)
+{
+    int rc;
+    uint64_t occ;
+    uint8_t base;
+    uint64_t m;
+
+    rc = BPU_RC_OK;
+
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (next_ms_out == NULL) {
+            rc = BPU_RC_ERR;
+        } else {
+            if (bpu->wheel.occupied == 0ULL) {
+                rc = BPU_RC_ERR;
             }
         }
     }
 
-    (void)now_ms;
+    if (rc == BPU_RC_OK) {
+        occ = bpu->wheel.occupied;
+        base = (uint8_t)((bpu->wheel.cur_tick + 1U) & (BPU_WHEEL_SLOTS - 1U));
+        m = (occ >> base) | ((base != 0U) ? (occ << (64U - base)) : 0ULL);
+
+        *next_ms_out = bpu->wheel.cur_ms + (1U + (uint32_t)bpu_ctz64(m)) * BPU_WHEEL_TICK_MS;
+    }
 
     return rc;
 }
 
-// Initialize BPU state and defaults
-int bpu_init(Bpu *bpu, const BpuIo *io, const BpuConfig *cfg)
+// Start streaming a blob of total_len bytes through the bulk lane
+int bpu_bulk_start(Bpu *bpu, uint8_t id, uint32_t total_len, BpuBulkPullFn fn, void *ctx)
 {
     int rc;
 
@@ -1099,84 +5118,81 @@ int bpu_init(Bpu *bpu, const BpuIo *io, const BpuConfig *cfg)
     if (bpu == NULL) {
         rc = BPU_RC_ERR;
     } else {
-        if (io == NULL) {
+        if (fn == NULL || total_len == 0U) {
             rc = BPU_RC_ERR;
         } else {
-            if (cfg == NULL) {
+            if (bpu->init_magic != 0x42505531U) {
                 rc = BPU_RC_ERR;
             } else {
-                if (io->tx_free == NULL) {
+                if (bpu->bulk.active != 0U) {
                     rc = BPU_RC_ERR;
-                } else {
-                    if (io->tx_write_some == NULL) {
-                        rc = BPU_RC_ERR;
-                    }
                 }
             }
         }
     }
 
     if (rc == BPU_RC_OK) {
-        bpu->io = *io;
-        bpu->cfg = *cfg;
+        bpu->bulk.fn = fn;
+        bpu->bulk.ctx = ctx;
+        bpu->bulk.total = total_len;
+        bpu->bulk.off = 0U;
+        bpu->bulk.id = id;
+        bpu->bulk.active = 1U;
+        bpu->bulk.timed = 0U;
+
+        bpu->st.bulk_total = total_len;
+        bpu->st.bulk_off = 0U;
+    }
 
-        bpu->evq.head = 0U;
-        bpu->evq.tail = 0U;
-        bpu->evq.count = 0U;
+    return rc;
+}
 
-        bpu->jobq.head = 0U;
-        bpu->jobq.tail = 0U;
-        bpu->jobq.count = 0U;
+// Continue the current (or last) blob from offset, e.g. the receiver's resume point
+int bpu_bulk_seek(Bpu *bpu, uint32_t offset)
+{
+    int rc;
 
-        bpu->pending_len = 0U;
-        bpu->pending_pos = 0U;
-        bpu->pending_have = 0U;
+    rc = BPU_RC_OK;
 
-        bpu->st.tick = 0U;
-        bpu->st.ev_in = 0U;
-        bpu->st.ev_out = 0U;
-        bpu->st.ev_merge = 0U;
-        bpu->st.ev_drop = 0U;
-        bpu->st.job_in = 0U;
-        bpu->st.job_out = 0U;
-        bpu->st.job_merge = 0U;
-        bpu->st.job_drop = 0U;
-        bpu->st.tx_frame_sent = 0U;
-        bpu->st.tx_frame_partial = 0U;
-        bpu->st.tx_bytes = 0U;
-        bpu->st.tx_skip_budget = 0U;
-        bpu->st.tx_skip_backpressure = 0U;
-        bpu->st.flush_try = 0U;
-        bpu->st.flush_ok = 0U;
-        bpu->st.pick_sensor = 0U;
-        bpu->st.pick_hb = 0U;
-        bpu->st.pick_telem = 0U;
-        bpu->st.pick_aged = 0U;
-        bpu->st.aged_hit_sensor = 0U;
-        bpu->st.aged_hit_hb = 0U;
-        bpu->st.aged_hit_telem = 0U;
-        bpu->st.degrade_drop = 0U;
-        bpu->st.degrade_requeue = 0U;
-        bpu->st.pending_active = 0U;
-        bpu->st.pending_len = 0U;
-        bpu->st.pending_pos = 0U;
-        bpu->st.dirty_mask_lo = 0U;
-        bpu->st.dirty_mask_hi = 0U;
-        bpu->st.work_us_last = 0U;
-        bpu->st.work_us_max = 0U;
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (bpu->bulk.fn == NULL || offset >= bpu->bulk.total) {
+            rc = BPU_RC_ERR;
+        }
+    }
 
-        bpu->seq = 0U;
-        bpu->init_magic = 0x42505531U;
+    if (rc == BPU_RC_OK) {
+        bpu->bulk.off = offset;
+        bpu->bulk.active = 1U;
+        bpu->bulk.timed = 0U;
+        bpu->st.bulk_off = offset;
     }
 
     return rc;
 }
 
-// Add new event into queue
-int bpu_push_event(Bpu *bpu, uint8_t evt_type, const uint8_t *payload, uint16_t len, uint32_t now_ms)
+// Stop the bulk lane (a fragment already in flight still completes)
+int bpu_bulk_cancel(Bpu *bpu)
+{
+    int rc;
+
+    rc = BPU_RC_OK;
+
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        bpu->bulk.active = 0U;
+        bpu->bulk.timed = 0U;
+    }
+
+    return rc;
+}
+
+// Attach a spill store (NULL detaches); the log starts empty
+int bpu_spill_attach(Bpu *bpu, const BpuSpillIo *io)
 {
     int rc;
-    BpuEvent e;
     uint16_t i;
 
     rc = BPU_RC_OK;
@@ -1184,48 +5200,214 @@ int bpu_push_event(Bpu *bpu, uint8_t evt_type, const uint8_t *payload, uint16_t
     if (bpu == NULL) {
         rc = BPU_RC_ERR;
     } else {
-        if (payload == NULL) {
-            rc = BPU_RC_ERR;
+        if (io == NULL) {
+            bpu->spill.attached = 0U;
         } else {
-            if (bpu->init_magic != 0x42505531U) {
+            if (io->read == NULL || io->write == NULL || io->erase == NULL || io->seg_count < 2U || io->seg_count > BPU_SPILL_SEG_MAX ||
+                io->seg_size < BPU_SPILL_REC_MAX) {
                 rc = BPU_RC_ERR;
+            } else {
+                bpu->spill.io = *io;
+                bpu->spill.rd_off = 0U;
+                bpu->spill.wr_off = 0U;
+                bpu->spill.rd_seg = 0U;
+                bpu->spill.wr_seg = 0U;
+                bpu->spill.buf_rd = 0U;
+                bpu->spill.buf_len = 0U;
+                bpu->spill.wr_open = 0U;
+
+                i = 0U;
+                while (i < BPU_SPILL_SEG_MAX) {
+                    bpu->spill.seg_end[i] = 0U;
+                    i++;
+                }
+
+                bpu->spill.attached = 1U;
             }
         }
     }
 
-    if (rc == BPU_RC_OK) {
-        if (evt_type == BPU_EVT_SENSOR) {
-            bpu->st.pick_sensor++;
+    return rc;
+}
+
+// Attach the LOG output (NULL detaches); budget_bytes caps bytes per tick
+int bpu_log_attach(Bpu *bpu, const BpuIo *io, uint16_t budget_bytes)
+{
+    int rc;
+
+    rc = BPU_RC_OK;
+
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (io == NULL) {
+            bpu->log.attached = 0U;
         } else {
-            if (evt_type == BPU_EVT_HB) {
-                bpu->st.pick_hb++;
+            if (io->tx_free == NULL || io->tx_write_some == NULL) {
+                rc = BPU_RC_ERR;
             } else {
-                if (evt_type == BPU_EVT_TELEM) {
-                    bpu->st.pick_telem++;
-                }
+                bpu->log.io = *io;
+                bpu->log.budget = budget_bytes;
+                bpu->log.attached = 1U;
             }
         }
+    }
 
-        if (len > (uint16_t)sizeof(e.payload)) {
-            len = (uint16_t)sizeof(e.payload);
+    return rc;
+}
+
+// Queue one LOG message without blocking; it is dropped whole if the ring is full
+int bpu_log_write(Bpu *bpu, const uint8_t *p, uint16_t len)
+{
+    int rc;
+    uint16_t first;
+
+    rc = BPU_RC_OK;
+
+    if (bpu == NULL || p == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if ((uint32_t)bpu->log.count + (uint32_t)len > BPU_LOG_RING) {
+            bpu->st.log_drop++;
+            bpu->st.log_drop_bytes += (uint32_t)len;
+            rc = BPU_RC_ERR;
+        } else {
+            // Copy in at most two pieces around the ring end
+            first = (uint16_t)(BPU_LOG_RING - bpu->log.head);
+            if (first > len) {
+                first = len;
+            }
+            memcpy(&bpu->log.buf[bpu->log.head], p, (size_t)first);
+            memcpy(&bpu->log.buf[0], &p[first], (size_t)(len - first));
+            bpu->log.head = (uint16_t)((bpu->log.head + len) % BPU_LOG_RING);
+
+            bpu->log.count = (uint16_t)(bpu->log.count + len);
+            bpu->st.log_queued = bpu->log.count;
+            if (bpu->log.count > bpu->st.log_queued_max) {
+                bpu->st.log_queued_max = bpu->log.count;
+            }
         }
+    }
+
+    return rc;
+}
+
+// Queue a tokenised LOG record: a BPU_JOB_LOG frame whose payload is the
+// varint id followed by one varint per argument (formatting happens on the host)
+int bpu_log_tok(Bpu *bpu, uint16_t id, const uint32_t *args, uint8_t nargs)
+{
+    int rc;
+    uint8_t payload[BPU_PAYLOAD_MAX];
+    uint8_t decoded[BPU_FRAME_MAX];
+    uint8_t enc[BPU_PENDING_MAX];
+    size_t enc_len;
+    uint16_t len;
+    uint16_t crc;
+    uint16_t i;
+    uint8_t hdr;
+    uint8_t crc_n;
+
+    rc = BPU_RC_OK;
 
-        e.type = evt_type;
-        e.flags = 0U;
-        e.len = len;
-        e.t_ms = now_ms;
+    if (bpu == NULL || (args == NULL && nargs != 0U) || nargs > BPU_LOG_ARGS_MAX) {
+        rc = BPU_RC_ERR;
+    } else {
+        len = (uint16_t)bpu_varint_put(payload, (uint32_t)id);
 
         i = 0U;
-        while (i < len) {
-            e.payload[i] = payload[i];
+        while (i < (uint16_t)nargs) {
+            len = (uint16_t)(len + bpu_varint_put(&payload[len], args[i]));
             i++;
         }
 
-        if (bpu_evq_push_coalesce(bpu, &e) != BPU_RC_OK) {
+        hdr = bpu_frame_header(decoded, BPU_JOB_LOG, bpu->log.seq, len, &crc_n);
+        bpu->log.seq++;
+
+        memcpy(&decoded[hdr], payload, (size_t)len);
+
+        crc = bpu_frame_check(decoded, (size_t)hdr + (size_t)len, crc_n);
+        decoded[hdr + len] = (uint8_t)(crc & 0xFFU);
+        if (crc_n == 2U) {
+            decoded[hdr + len + 1U] = (uint8_t)((crc >> 8) & 0xFFU);
+        }
+
+        enc_len = bpu_cobs_encode(decoded, (size_t)hdr + (size_t)len + (size_t)crc_n, enc, sizeof(enc) - 1U);
+        if (enc_len == 0U) {
+            rc = BPU_RC_ERR;
+        } else {
+            enc[enc_len] = 0x00U;
+            rc = bpu_log_write(bpu, enc, (uint16_t)(enc_len + 1U));
+        }
+    }
+
+    return rc;
+}
+
+// Start recording engine inputs into fn (NULL stops): writes the config and
+// registered types, then every push, tick and main-IO answer until stopped
+// or fn fails. Attach after bpu_init and before the first push to replay
+int bpu_capture_attach(Bpu *bpu, BpuCaptureFn fn, void *ctx)
+{
+    int rc;
+    uint8_t rec[16];
+    uint16_t n;
+    uint16_t t;
+
+    rc = BPU_RC_OK;
+
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (bpu->init_magic != 0x42505531U) {
             rc = BPU_RC_ERR;
         }
     }
 
+    if (rc == BPU_RC_OK) {
+        if (bpu->cap.attached != 0U) {
+            bpu->io = bpu->cap.io;
+            bpu->cap.attached = 0U;
+        }
+
+        if (fn != NULL) {
+            bpu->cap.fn = fn;
+            bpu->cap.ctx = ctx;
+            bpu->cap.io = bpu->io;
+            bpu->cap.last_ms = 0U;
+            bpu->cap.in_tick = 0U;
+            bpu->cap.attached = 1U;
+
+            bpu->io.ctx = bpu;
+            bpu->io.tx_free = bpu_cap_tx_free;
+            bpu->io.tx_write_some = bpu_cap_tx_write_some;
+            if (bpu->cap.io.time_us != NULL) {
+                bpu->io.time_us = bpu_cap_time_us;
+            }
+
+            rec[0] = BPU_CAP_INIT;
+            n = 1U;
+            n = (uint16_t)(n + bpu_varint_put(&rec[n], bpu->cfg.tx_budget_bytes));
+            n = (uint16_t)(n + bpu_varint_put(&rec[n], bpu->cfg.tx_min_free));
+            n = (uint16_t)(n + bpu_varint_put(&rec[n], bpu->cfg.tx_chunk_max));
+            n = (uint16_t)(n + bpu_varint_put(&rec[n], bpu->cfg.coalesce_window_ms));
+            n = (uint16_t)(n + bpu_varint_put(&rec[n], bpu->cfg.aged_ms));
+            rec[n++] = (uint8_t)(((bpu->cfg.enable_degrade != 0U) ? 0x01U : 0U) | ((bpu->cfg.enable_edf != 0U) ? 0x02U : 0U) |
+                                 ((bpu->cfg.enable_preempt != 0U) ? 0x04U : 0U) | ((bpu->cfg.enable_admission != 0U) ? 0x08U : 0U) |
+                                 ((bpu->cap.io.time_us != NULL) ? 0x10U : 0U));
+            rec[n] = (uint8_t)BPU_WIRE_VERSION;
+            n++;
+            bpu_cap_emit(bpu, rec, n);
+
+            t = 0U;
+            while (t < BPU_TYPE_MAX && bpu->cap.attached != 0U) {
+                if (bpu->types[t].job != 0U) {
+                    bpu_cap_type(bpu, (uint8_t)t);
+                }
+                t++;
+            }
+        }
+    }
+
     return rc;
 }
 
@@ -1243,8 +5425,11 @@ int bpu_tick_ex(Bpu *bpu, uint32_t now_ms, uint32_t now_us)
     uint32_t t0;
     uint32_t t1;
     uint64_t dirty;
+    uint32_t skips;
+    uint32_t skip_budget;
     bool have_t0;
     bool have_t1;
+    uint8_t ph;
 
     rc = BPU_RC_OK;
 
@@ -1262,6 +5447,11 @@ int bpu_tick_ex(Bpu *bpu, uint32_t now_ms, uint32_t now_us)
     }
 
     if (rc == BPU_RC_OK) {
+        if (bpu->cap.attached != 0U) {
+            bpu_cap_tick(bpu, now_ms, now_us);
+            bpu->cap.in_tick = 1U;
+        }
+
         if (now_us != 0U) {
             t0 = now_us;
             have_t0 = true;
@@ -1271,7 +5461,18 @@ int bpu_tick_ex(Bpu *bpu, uint32_t now_ms, uint32_t now_us)
             }
         }
 
+        BPU_PROF_ENTER(bpu, BPU_PH_INGEST, ph);
+        bpu_timers_run(bpu, now_ms);
+        BPU_PROF_LEAVE(bpu, ph);
+        bpu->cap.in_tick = 0U;
+
         budget = bpu->cfg.tx_budget_bytes;
+        skips = bpu->st.tx_skip_budget + bpu->st.tx_skip_backpressure;
+        skip_budget = bpu->st.tx_skip_budget;
+
+        if (bpu->cfg.enable_preempt != 0U) {
+            bpu_preempt(bpu, now_ms);
+        }
 
         if (bpu->pending_have != 0U) {
             bool progress;
@@ -1280,18 +5481,36 @@ int bpu_tick_ex(Bpu *bpu, uint32_t now_ms, uint32_t now_us)
             if (bpu_send_pending(bpu, &budget, &progress) != BPU_RC_OK) {
                 rc = BPU_RC_ERR;
             }
+            bpu_pending_done(bpu, now_ms);
         }
 
         if (rc == BPU_RC_OK) {
+            BPU_PROF_ENTER(bpu, BPU_PH_SCHEDULE, ph);
             (void)bpu_schedule_from_events(bpu, now_ms);
+            BPU_PROF_LEAVE(bpu, ph);
+
+            BPU_PROF_ENTER(bpu, BPU_PH_SELECT, ph);
             (void)bpu_flush_jobs(bpu, now_ms, &budget);
+            bpu_spill_run(bpu, &budget);
+            bpu_bulk_run(bpu, now_ms, &budget);
+            BPU_PROF_LEAVE(bpu, ph);
         }
 
+        bpu_log_drain(bpu);
+
+        if (bpu->cfg.enable_degrade != 0U) {
+            bpu_ladder_update(bpu, now_ms, bpu->st.tx_skip_budget + bpu->st.tx_skip_backpressure - skips);
+        }
+
+        bpu_wm_tick(bpu, now_ms, bpu->st.tx_skip_budget != skip_budget);
+
         bpu->st.tick++;
 
         dirty = bpu_dirty_mask(bpu);
         bpu->st.dirty_mask_lo = (uint32_t)(dirty & 0xFFFFFFFFULL);
         bpu->st.dirty_mask_hi = (uint32_t)((dirty >> 32) & 0xFFFFFFFFULL);
+        bpu->st.state_dirty_lo = (uint32_t)(bpu->state.dirty & 0xFFFFFFFFULL);
+        bpu->st.state_dirty_hi = (uint32_t)((bpu->state.dirty >> 32) & 0xFFFFFFFFULL);
 
         if (now_us != 0U) {
             t1 = now_us;
@@ -1313,12 +5532,19 @@ int bpu_tick_ex(Bpu *bpu, uint32_t now_ms, uint32_t now_us)
                 bpu->st.work_us_max = bpu->st.work_us_last;
             }
         }
+
+#if BPU_PROFILE
+        bpu_prof_fold(bpu);
+#endif
+        bpu_stats_publish(bpu);
     }
 
     return rc;
 }
 
-// Copy stats snapshot
+// Copy the stats published by the last tick; safe from another task or
+// core (seqlock read, no lock on the tick side). Returns ERR if a publish
+// overlapped every one of BPU_STATS_RETRY attempts
 int bpu_get_stats(const Bpu *bpu, BpuStats *out)
 {
     int rc;
@@ -1338,8 +5564,61 @@ int bpu_get_stats(const Bpu *bpu, BpuStats *out)
     }
 
     if (rc == BPU_RC_OK) {
-        *out = bpu->st;
+        rc = bpu_words_read(bpu, (const uint32_t *)(const void *)&bpu->pub, (uint32_t *)(void *)out, sizeof(BpuStats) / sizeof(uint32_t));
+    }
+
+    return rc;
+}
+
+// Copy the phase profile published by the last tick (same rules as
+// bpu_get_stats); ERR when built without BPU_PROFILE
+int bpu_get_profile(const Bpu *bpu, BpuProfile *out)
+{
+    int rc;
+
+    rc = BPU_RC_OK;
+
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (out == NULL) {
+            rc = BPU_RC_ERR;
+        } else {
+            if (bpu->init_magic != 0x42505531U || BPU_PROFILE == 0U) {
+                rc = BPU_RC_ERR;
+            }
+        }
+    }
+
+#if BPU_PROFILE
+    if (rc == BPU_RC_OK) {
+        rc = bpu_words_read(bpu, (const uint32_t *)(const void *)&bpu->prof_pub, (uint32_t *)(void *)out, sizeof(BpuProfile) / sizeof(uint32_t));
+    }
+#endif
+
+    return rc;
+}
+
+// Clear the phase profile (call from the tick task; visible after the next tick)
+int bpu_profile_reset(Bpu *bpu)
+{
+    int rc;
+
+    rc = BPU_RC_OK;
+
+    if (bpu == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        if (bpu->init_magic != 0x42505531U || BPU_PROFILE == 0U) {
+            rc = BPU_RC_ERR;
+        }
+    }
+
+#if BPU_PROFILE
+    if (rc == BPU_RC_OK) {
+        bpu_prof_clear(bpu);
     }
+#endif
 
     return rc;
 }
@@ -11,6 +11,9 @@
 #include "esp_err.h"
 #include "esp_timer.h"
 
+// Flash partition used as the spill store
+#include "esp_partition.h"
+
 // Pull BPU declarations without compiling implementation
 #define BPU_ESPIDF_DECLARE_ONLY 1
 #include "bpu_espidf.c"
@@ -21,9 +24,24 @@
 #define BPU_EXAMPLE_DEBUG 0
 #endif
 
+// Input capture for host/bpu_replay: RAM bytes, 0 = off. Read it out over
+// JTAG, e.g. gdb: dump binary memory cap.bin g_cap g_cap+g_cap_len
+#ifndef BPU_EXAMPLE_CAPTURE
+#define BPU_EXAMPLE_CAPTURE 0
+#endif
+
 // Example-local return codes
 typedef enum { EX_RC_OK = 0, EX_RC_ERR = 1 } ExRc;
 
+// Tokenised LOG ids; the format strings stay in the host-side table
+// (host/bpu_decode renders them from the same bpu_log_fmt.def)
+typedef enum {
+#define BPU_LOG_FMT(name, fmt) name,
+#include "bpu_log_fmt.def"
+#undef BPU_LOG_FMT
+    LOGT_COUNT
+} LogTok;
+
 // UART TX context for BPU IO callbacks
 typedef struct {
     uart_port_t uart;
@@ -49,16 +67,48 @@ static const uint32_t TICK_MS = 20;
 static const uint32_t SENSOR_MS = 80;
 static const uint32_t HB_MS = 200;
 static const uint32_t TELEM_MS = 1000;
+static const uint32_t FAST_MS = 10;
+
+// Bulk lane demo: one synthetic blob streamed with leftover budget
+static const uint32_t BULK_DEMO_LEN = 16384;
+static const uint8_t BULK_DEMO_ID = 1;
+
+// Spill store: data partition "bpu_spill" cut into flash-sector segments
+static const char SPILL_LABEL[] = "bpu_spill";
+static const uint32_t SPILL_SEG_SIZE = 4096;
 
 // TX pacing and backpressure thresholds
 static const uint16_t TX_BUDGET_BYTES = 200;
 static const uint16_t OUT_MIN_FREE = 96;
 static const uint16_t TX_CHUNK_MAX = 128;
 
+// LOG stream: bytes per tick (~3.2 KB/s, under the 11.5 KB/s of 115200 baud)
+// and the period of the stats line
+static const uint16_t LOG_BUDGET_BYTES = 64;
+static const uint32_t STATS_MS = 1000;
+
 // Coalescing/aging thresholds
 static const uint16_t COALESCE_WINDOW_MS = 20;
 static const uint16_t AGED_MS = 200;
 
+// SENSOR samples merged while queued are averaged, not overwritten
+static const BpuField SENSOR_FIELDS[] = { { 0U, BPU_FIELD_U16, BPU_MERGE_AVG } };
+
+// Type table registered after bpu_init (HB/TELEM are last-value state slots)
+// (merge, job, tag, prio, degrade, ttl_ms, deadline_ms, fields, flags, state_slot, shed, keepalive_ms, deadband; 0 = none)
+// HB is constant: sent on change with a 1 s keepalive, from a cached frame
+static const BpuTypeDesc TYPE_CMD = { BPU_MERGE_NONE, BPU_JOB_CMD, 0x04U, BPU_PRIO_CMD, BPU_DEGRADE_REQUEUE, 0U, 40U, 0U, NULL, 0U, 0U, { 0U }, 0U, 0U };
+static const BpuTypeDesc TYPE_SENSOR = { BPU_MERGE_LAST, BPU_JOB_SENSOR, 0x01U, BPU_PRIO_SENSOR, BPU_DEGRADE_REQUEUE, 400U, 80U, 1U, SENSOR_FIELDS, 0U, 0U,
+                                         { BPU_SHED_KEEP, BPU_SHED_HALF, BPU_SHED_QUARTER, BPU_SHED_QUARTER, BPU_SHED_DROP, BPU_SHED_DROP }, 0U, 0U };
+static const BpuTypeDesc TYPE_HB = { BPU_MERGE_LAST, BPU_JOB_HB, 0x02U, BPU_PRIO_HB, BPU_DEGRADE_REQUEUE, 1000U, 200U, 0U, NULL, BPU_TF_STATE | BPU_TF_ON_CHANGE | BPU_TF_TEMPLATE, 16U,
+                                     { BPU_SHED_KEEP, BPU_SHED_KEEP, BPU_SHED_KEEP, BPU_SHED_KEEP, BPU_SHED_KEEP, BPU_SHED_DROP }, 1000U, 0U };
+static const BpuTypeDesc TYPE_TELEM = { BPU_MERGE_LAST, BPU_JOB_TELEM, 0x03U, BPU_PRIO_TELEM, BPU_DEGRADE_DROP, 3000U, 0U, 0U, NULL, BPU_TF_STATE, 32U,
+                                        { BPU_SHED_KEEP, BPU_SHED_KEEP, BPU_SHED_KEEP, BPU_SHED_DROP, BPU_SHED_DROP, BPU_SHED_DROP }, 0U, 0U };
+// High-rate channel: delta-packed batches held for at most 200 ms; during
+// a link outage they spill to flash (no TTL) and are replayed afterwards
+static const BpuTypeDesc TYPE_SENSOR_BATCH = { BPU_MERGE_NONE, BPU_JOB_SENSOR_BATCH, 0x05U, BPU_PRIO_SENSOR, BPU_DEGRADE_REQUEUE, 0U, 200U, 0U, NULL, BPU_TF_BATCH | BPU_TF_SPILL, 0U,
+                                               { BPU_SHED_KEEP, BPU_SHED_HALF, BPU_SHED_QUARTER, BPU_SHED_QUARTER, BPU_SHED_DROP, BPU_SHED_DROP }, 0U, 0U };
+
 // UART driver buffer sizes
 static const int LOG_RX_BUF = 256;
 static const int LOG_TX_BUF = 512;
@@ -70,160 +120,48 @@ static const int OUT_TX_BUF = 2048;
 static StaticTask_t g_task_tcb;
 static StackType_t g_task_stack[4096 / sizeof(StackType_t)];
 
-// Logging helpers
-static int log_write(const uint8_t *p, size_t n);
-static int log_str(const char *s);
-static int log_nl(void);
-static int log_u32_dec(uint32_t v);
-static int log_u32_hex(uint32_t v);
+// Engine state (kept off the task stack: type and state tables are large)
+static Bpu g_bpu;
+
+// Pressure edges reported by the engine (queue and budget, one bit each)
+static uint8_t g_pressure;
+
+#if BPU_EXAMPLE_CAPTURE
+// Capture buffer; the capture stops (cap_drop) when it is full
+static uint8_t g_cap[BPU_EXAMPLE_CAPTURE];
+static uint32_t g_cap_len;
+
+static int cap_sink(void *ctx, const uint8_t *rec, uint16_t len);
+#endif
+
+// Tokenised logging
+static void log_stats(Bpu *bpu);
 
 // BPU IO callbacks for output UART
 static int out_tx_free(void *ctx, size_t *free_out);
 static int out_tx_write_some(void *ctx, const uint8_t *p, size_t len, size_t *wrote_out);
 static int out_time_us(void *ctx, uint32_t *us_out);
 
+// BPU spill store callbacks over a flash partition
+static int spill_read(void *ctx, uint16_t seg, uint32_t off, uint8_t *p, size_t len);
+static int spill_write(void *ctx, uint16_t seg, uint32_t off, const uint8_t *p, size_t len);
+static int spill_erase(void *ctx, uint16_t seg);
+
+// Periodic producers driven by the BPU timer wheel
+static int src_sensor(void *ctx, uint32_t now_ms, uint8_t *payload, uint16_t *len_io);
+static int src_hb(void *ctx, uint32_t now_ms, uint8_t *payload, uint16_t *len_io);
+static int src_telem(void *ctx, uint32_t now_ms, uint8_t *payload, uint16_t *len_io);
+static int src_fast(void *ctx, uint32_t now_ms, uint8_t *payload, uint16_t *len_io);
+// Watermark edges: producers back off while either bit is set
+static void on_watermark(void *ctx, uint8_t event, uint8_t fill_pct);
+// Bulk source for the demo blob
+static int bulk_pull(void *ctx, uint32_t offset, uint8_t *buf, uint16_t max, uint16_t *got_out);
+
 // UART initialization
 static int uart_init_ports(void);
 // Demo task running BPU tick loop
 static void bpu_demo_task(void *arg);
 
-// Write raw bytes to log UART
-static int log_write(const uint8_t *p, size_t n)
-{
-    int rc;
-    int w;
-
-    rc = EX_RC_OK;
-
-    if (p == NULL) {
-        rc = EX_RC_ERR;
-    } else {
-        if (n != 0U) {
-            w = uart_write_bytes(LOG_UART, (const char *)p, n);
-            if (w < 0) {
-                rc = EX_RC_ERR;
-            }
-        }
-    }
-
-    return rc;
-}
-
-// Write zero-terminated string
-static int log_str(const char *s)
-{
-    int rc;
-    size_t i;
-
-    rc = EX_RC_OK;
-
-    if (s == NULL) {
-        rc = EX_RC_ERR;
-    } else {
-        i = 0U;
-        while (s[i] != 0) {
-            (void)log_write((const uint8_t *)&s[i], 1U);
-            i++;
-        }
-    }
-
-    return rc;
-}
-
-// Write newline
-static int log_nl(void)
-{
-    int rc;
-    uint8_t nl;
-
-    rc = EX_RC_OK;
-    nl = (uint8_t)'\n';
-
-    if (log_write(&nl, 1U) != EX_RC_OK) {
-        rc = EX_RC_ERR;
-    }
-
-    return rc;
-}
-
-// Write u32 as decimal
-static int log_u32_dec(uint32_t v)
-{
-    int rc;
-    char buf[11];
-    uint32_t x;
-    size_t i;
-    size_t j;
-
-    rc = EX_RC_OK;
-    x = v;
-    i = 0U;
-
-    if (x == 0U) {
-        buf[i] = '0';
-        i++;
-    } else {
-        while (x != 0U && i < sizeof(buf)) {
-            buf[i] = (char)('0' + (char)(x % 10U));
-            i++;
-            x /= 10U;
-        }
-    }
-
-    j = 0U;
-    while (j < i / 2U) {
-        char t;
-
-        t = buf[j];
-        buf[j] = buf[i - 1U - j];
-        buf[i - 1U - j] = t;
-
-        j++;
-    }
-
-    j = 0U;
-    while (j < i) {
-        (void)log_write((const uint8_t *)&buf[j], 1U);
-        j++;
-    }
-
-    return rc;
-}
-
-// Write u32 as hex
-static int log_u32_hex(uint32_t v)
-{
-    int rc;
-    uint32_t x;
-    uint32_t i;
-
-    rc = EX_RC_OK;
-    x = v;
-    i = 0U;
-
-    (void)log_str("0x");
-
-    while (i < 8U) {
-        uint32_t shift;
-        uint32_t nib;
-        uint8_t c;
-
-        shift = 28U - (i * 4U);
-        nib = (x >> shift) & 0x0FU;
-
-        if (nib < 10U) {
-            c = (uint8_t)('0' + (uint8_t)nib);
-        } else {
-            c = (uint8_t)('A' + (uint8_t)(nib - 10U));
-        }
-
-        (void)log_write(&c, 1U);
-        i++;
-    }
-
-    return rc;
-}
-
 // Query free space for TX backpressure
 static int out_tx_free(void *ctx, size_t *free_out)
 {
@@ -346,6 +284,48 @@ static int out_time_us(void *ctx, uint32_t *us_out)
     return rc;
 }
 
+// Read back spilled bytes
+static int spill_read(void *ctx, uint16_t seg, uint32_t off, uint8_t *p, size_t len)
+{
+    int rc;
+
+    rc = BPU_RC_OK;
+
+    if (esp_partition_read((const esp_partition_t *)ctx, (size_t)seg * SPILL_SEG_SIZE + off, p, len) != ESP_OK) {
+        rc = BPU_RC_ERR;
+    }
+
+    return rc;
+}
+
+// Append a batch of spilled records
+static int spill_write(void *ctx, uint16_t seg, uint32_t off, const uint8_t *p, size_t len)
+{
+    int rc;
+
+    rc = BPU_RC_OK;
+
+    if (esp_partition_write((const esp_partition_t *)ctx, (size_t)seg * SPILL_SEG_SIZE + off, p, len) != ESP_OK) {
+        rc = BPU_RC_ERR;
+    }
+
+    return rc;
+}
+
+// Erase one segment (one flash sector) before it is rewritten
+static int spill_erase(void *ctx, uint16_t seg)
+{
+    int rc;
+
+    rc = BPU_RC_OK;
+
+    if (esp_partition_erase_range((const esp_partition_t *)ctx, (size_t)seg * SPILL_SEG_SIZE, SPILL_SEG_SIZE) != ESP_OK) {
+        rc = BPU_RC_ERR;
+    }
+
+    return rc;
+}
+
 // Configure and install UART drivers
 static int uart_init_ports(void)
 {
@@ -394,23 +374,198 @@ static int uart_init_ports(void)
     return rc;
 }
 
-// Periodically push events and call bpu_tick
+// Sample the (synthetic) sensor value
+static int src_sensor(void *ctx, uint32_t now_ms, uint8_t *payload, uint16_t *len_io)
+{
+    uint16_t v;
+
+    (void)ctx;
+
+    v = (uint16_t)((now_ms / 10U) & 0xFFFFU);
+
+    payload[0] = (uint8_t)(v & 0xFFU);
+    payload[1] = (uint8_t)((v >> 8) & 0xFFU);
+    *len_io = 2U;
+
+    return BPU_RC_OK;
+}
+
+// Emit a heartbeat marker
+static int src_hb(void *ctx, uint32_t now_ms, uint8_t *payload, uint16_t *len_io)
+{
+    (void)ctx;
+    (void)now_ms;
+
+    payload[0] = 0x01U;
+    *len_io = 1U;
+
+    return BPU_RC_OK;
+}
+
+// Emit uptime telemetry
+static int src_telem(void *ctx, uint32_t now_ms, uint8_t *payload, uint16_t *len_io)
+{
+    (void)ctx;
+
+    payload[0] = (uint8_t)(now_ms & 0xFFU);
+    payload[1] = (uint8_t)((now_ms >> 8) & 0xFFU);
+    payload[2] = (uint8_t)((now_ms >> 16) & 0xFFU);
+    payload[3] = (uint8_t)((now_ms >> 24) & 0xFFU);
+    *len_io = 4U;
+
+    return BPU_RC_OK;
+}
+
+// Sample the (synthetic) high-rate channel: a slow ramp; under pressure
+// every other period is skipped at the source instead of shed downstream
+static int src_fast(void *ctx, uint32_t now_ms, uint8_t *payload, uint16_t *len_io)
+{
+    static uint8_t phase;
+    int rc;
+    uint16_t v;
+
+    (void)ctx;
+
+    rc = BPU_RC_OK;
+    phase ^= 1U;
+
+    if (g_pressure != 0U && phase != 0U) {
+        rc = BPU_RC_ERR;
+    } else {
+        v = (uint16_t)(1000U + ((now_ms / 50U) & 0xFFU));
+
+        payload[0] = (uint8_t)(v & 0xFFU);
+        payload[1] = (uint8_t)((v >> 8) & 0xFFU);
+        *len_io = 2U;
+    }
+
+    return rc;
+}
+
+#if BPU_EXAMPLE_CAPTURE
+// Append one capture record to RAM
+static int cap_sink(void *ctx, const uint8_t *rec, uint16_t len)
+{
+    int rc;
+    uint16_t i;
+
+    (void)ctx;
+
+    rc = BPU_RC_OK;
+
+    if (g_cap_len + (uint32_t)len > (uint32_t)sizeof(g_cap)) {
+        rc = BPU_RC_ERR;
+    } else {
+        i = 0U;
+        while (i < len) {
+            g_cap[g_cap_len + i] = rec[i];
+            i++;
+        }
+        g_cap_len += (uint32_t)len;
+    }
+
+    return rc;
+}
+#endif
+
+// Track queue/budget pressure edges (runs inside bpu_tick or a push)
+static void on_watermark(void *ctx, uint8_t event, uint8_t fill_pct)
+{
+    (void)ctx;
+    (void)fill_pct;
+
+    if (event == BPU_WM_QUEUE_HIGH) {
+        g_pressure |= 0x01U;
+    } else {
+        if (event == BPU_WM_QUEUE_LOW) {
+            g_pressure &= (uint8_t)~0x01U;
+        } else {
+            if (event == BPU_WM_BUDGET_HIGH) {
+                g_pressure |= 0x02U;
+            } else {
+                if (event == BPU_WM_BUDGET_LOW) {
+                    g_pressure &= (uint8_t)~0x02U;
+                }
+            }
+        }
+    }
+}
+
+// Generate the demo blob on the fly (a real source would read flash or a file)
+static int bulk_pull(void *ctx, uint32_t offset, uint8_t *buf, uint16_t max, uint16_t *got_out)
+{
+    uint16_t i;
+
+    (void)ctx;
+
+    i = 0U;
+    while (i < max) {
+        buf[i] = (uint8_t)((offset + i) & 0xFFU);
+        i++;
+    }
+    *got_out = max;
+
+    return BPU_RC_OK;
+}
+
+// Queue the counter summary as one tokenised LOG record (~20 B instead of ~80 B of text)
+static void log_stats(Bpu *bpu)
+{
+    BpuStats st;
+    uint32_t a[2U * BPU_PH_COUNT];
+#if BPU_PROFILE
+    BpuProfile prof;
+    uint8_t ph;
+#endif
+
+    if (bpu_get_stats(bpu, &st) == BPU_RC_OK) {
+        a[0] = st.tick;
+        a[1] = st.tx_frame_sent;
+        a[2] = st.tx_skip_budget;
+        a[3] = st.tx_skip_backpressure;
+        a[4] = st.job_drop + st.degrade_drop;
+        a[5] = st.log_drop;
+        a[6] = st.work_us_max;
+
+        (void)bpu_log_tok(bpu, LOGT_EX_STATS, a, 7U);
+    }
+
+#if BPU_PROFILE
+    if (bpu_get_profile(bpu, &prof) == BPU_RC_OK) {
+        ph = 0U;
+        while (ph < BPU_PH_COUNT) {
+            a[2U * ph] = prof.ph[ph].avg;
+            a[2U * ph + 1U] = prof.ph[ph].max;
+            ph++;
+        }
+
+        (void)bpu_log_tok(bpu, LOGT_EX_PROFILE, a, (uint8_t)(2U * BPU_PH_COUNT));
+    }
+#endif
+}
+
+// Register producers and call bpu_tick periodically
 static void bpu_demo_task(void *arg)
 {
-    Bpu bpu;
+    Bpu *bpu;
     BpuIo io;
     BpuConfig cfg;
+    BpuSpillIo spill;
+    const esp_partition_t *part;
     UartOutCtx out_ctx;
-
-    uint32_t next_sensor;
-    uint32_t next_hb;
-    uint32_t next_telem;
+    BpuIo log_io;
+    UartOutCtx log_ctx;
+    uint32_t boot_args[2];
+    uint32_t start_ms;
+    uint32_t stats_ms;
 
     TickType_t last_wake;
     TickType_t period_ticks;
 
     (void)arg;
 
+    bpu = &g_bpu;
+
     out_ctx.uart = OUT_UART;
     out_ctx.min_free = OUT_MIN_FREE;
     out_ctx.chunk_max = TX_CHUNK_MAX;
@@ -426,57 +581,76 @@ static void bpu_demo_task(void *arg)
     cfg.coalesce_window_ms = COALESCE_WINDOW_MS;
     cfg.aged_ms = AGED_MS;
     cfg.enable_degrade = 1U;
+    cfg.enable_edf = 1U;
+    cfg.enable_preempt = 1U;
+    cfg.enable_admission = 1U;
+
+    (void)bpu_init(bpu, &io, &cfg);
+    (void)bpu_watermark_set(bpu, BPU_WM_HIGH_PCT, BPU_WM_LOW_PCT, on_watermark, NULL);
+
+    // LOG is a second, budgeted output: a full log UART never stalls the tick
+    log_ctx.uart = LOG_UART;
+    log_ctx.min_free = 0U;
+    log_ctx.chunk_max = LOG_BUDGET_BYTES;
+
+    log_io.ctx = &log_ctx;
+    log_io.tx_free = out_tx_free;
+    log_io.tx_write_some = out_tx_write_some;
+    log_io.time_us = NULL;
+
+    (void)bpu_log_attach(bpu, &log_io, LOG_BUDGET_BYTES);
+
+    boot_args[0] = TX_BUDGET_BYTES;
+    boot_args[1] = LOG_BUDGET_BYTES;
+    (void)bpu_log_tok(bpu, LOGT_EX_BOOT, boot_args, 2U);
+
+    (void)bpu_register_type(bpu, BPU_EVT_CMD, &TYPE_CMD);
+    (void)bpu_register_type(bpu, BPU_EVT_SENSOR, &TYPE_SENSOR);
+    (void)bpu_register_type(bpu, BPU_EVT_HB, &TYPE_HB);
+    (void)bpu_register_type(bpu, BPU_EVT_TELEM, &TYPE_TELEM);
+    (void)bpu_register_type(bpu, BPU_EVT_SENSOR_BATCH, &TYPE_SENSOR_BATCH);
+
+#if BPU_EXAMPLE_CAPTURE
+    // Records config and types now, then all traffic (the bulk blob is not replayed)
+    (void)bpu_capture_attach(bpu, cap_sink, NULL);
+#endif
 
-    (void)bpu_init(&bpu, &io, &cfg);
+    // Spill is optional: without the partition, overflowing batches are dropped
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, SPILL_LABEL);
+    if (part != NULL) {
+        spill.ctx = (void *)part;
+        spill.read = spill_read;
+        spill.write = spill_write;
+        spill.erase = spill_erase;
+        spill.seg_size = SPILL_SEG_SIZE;
+        spill.seg_count = (uint16_t)((part->size / SPILL_SEG_SIZE < BPU_SPILL_SEG_MAX) ? (part->size / SPILL_SEG_SIZE) : BPU_SPILL_SEG_MAX);
+        (void)bpu_spill_attach(bpu, &spill);
+    }
 
-    next_sensor = 10U;
-    next_hb = 50U;
-    next_telem = 200U;
+    start_ms = (uint32_t)(esp_timer_get_time() / 1000ULL);
+
+    (void)bpu_timer_add(bpu, BPU_EVT_SENSOR, 0U, SENSOR_MS, start_ms + 10U, src_sensor, NULL, NULL);
+    (void)bpu_timer_add(bpu, BPU_EVT_HB, 0U, HB_MS, start_ms + 50U, src_hb, NULL, NULL);
+    (void)bpu_timer_add(bpu, BPU_EVT_TELEM, 0U, TELEM_MS, start_ms + 200U, src_telem, NULL, NULL);
+    (void)bpu_timer_add(bpu, BPU_EVT_SENSOR_BATCH, 0U, FAST_MS, start_ms + 5U, src_fast, NULL, NULL);
+
+    (void)bpu_bulk_start(bpu, BULK_DEMO_ID, BULK_DEMO_LEN, bulk_pull, NULL);
 
     last_wake = xTaskGetTickCount();
     period_ticks = pdMS_TO_TICKS(TICK_MS);
+    stats_ms = start_ms;
 
     while (1) {
         uint32_t now_ms;
 
         now_ms = (uint32_t)(esp_timer_get_time() / 1000ULL);
 
-        if ((int32_t)(now_ms - next_sensor) >= 0) {
-            uint8_t payload[2];
-            uint16_t v;
-
-            next_sensor = now_ms + SENSOR_MS;
-            v = (uint16_t)((now_ms / 10U) & 0xFFFFU);
-
-            payload[0] = (uint8_t)(v & 0xFFU);
-            payload[1] = (uint8_t)((v >> 8) & 0xFFU);
-
-            (void)bpu_push_event(&bpu, BPU_EVT_SENSOR, payload, 2U, now_ms);
-        }
-
-        if ((int32_t)(now_ms - next_hb) >= 0) {
-            uint8_t payload[1];
-
-            next_hb = now_ms + HB_MS;
-            payload[0] = 0x01U;
-
-            (void)bpu_push_event(&bpu, BPU_EVT_HB, payload, 1U, now_ms);
-        }
-
-        if ((int32_t)(now_ms - next_telem) >= 0) {
-            uint8_t payload[4];
-
-            next_telem = now_ms + TELEM_MS;
-
-            payload[0] = (uint8_t)(now_ms & 0xFFU);
-            payload[1] = (uint8_t)((now_ms >> 8) & 0xFFU);
-            payload[2] = (uint8_t)((now_ms >> 16) & 0xFFU);
-            payload[3] = (uint8_t)((now_ms >> 24) & 0xFFU);
-
-            (void)bpu_push_event(&bpu, BPU_EVT_TELEM, payload, 4U, now_ms);
+        if ((uint32_t)(now_ms - stats_ms) >= STATS_MS) {
+            stats_ms = now_ms;
+            log_stats(bpu);
         }
 
-        (void)bpu_tick(&bpu, now_ms);
+        (void)bpu_tick(bpu, now_ms);
 
         vTaskDelayUntil(&last_wake, period_ticks);
     }
@@ -2,7 +2,7 @@
   BPU v2.9b-r1 (Dual UART demo) — FINAL (cleanup + safety)
 
   Streams:
-    - LOG: Serial  @115200 (human-readable)
+    - LOG: Serial  @115200 (human-readable; binary records with LOG_TOKENIZED)
     - OUT: Serial1 @921600 (binary frames)
 
   ESP32-WROOM pins:
@@ -13,6 +13,7 @@
 #include <Arduino.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <string.h>
 
 // -----------------------------------------------------------------------------
 // Streams
@@ -45,6 +46,15 @@ static const bool DEBUG_DUMP_TX_HEX = false;
 // Minimum free bytes required to attempt sending a frame.
 static const int OUT_MIN_FREE = 96;
 
+// LOG stream: messages are queued in a ring and drained with a per-tick
+// budget, so a full LOG serial never stalls the tick.
+static const size_t   LOG_RING_LEN = 2048;
+static const uint16_t LOG_BUDGET_BYTES = 64;
+
+// true: LOG carries binary records (format id + varint args, framed like OUT)
+// rendered on the host by host/bpu_decode; false: plain text for a Serial Monitor.
+static const bool LOG_TOKENIZED = false;
+
 // -----------------------------------------------------------------------------
 // Types
 // -----------------------------------------------------------------------------
@@ -62,6 +72,14 @@ enum : uint8_t {
   JOB_TELEM  = 4,
 };
 
+// Tokenised LOG record ids (position in bpu_log_fmt.def)
+enum : uint16_t {
+#define BPU_LOG_FMT(name, fmt) name,
+#include "bpu_log_fmt.def"
+#undef BPU_LOG_FMT
+};
+static const uint8_t LOG_FRAME_TYPE = 7;
+
 enum MergePolicy : uint8_t {
   MERGE_NONE = 0,
   MERGE_LAST = 1,
@@ -121,6 +139,7 @@ struct BpuStats {
 
   uint32_t out_bytes_total=0;
   uint32_t log_bytes_total=0;
+  uint32_t log_drop=0, log_drop_bytes=0, log_skip_txbuf=0;
 };
 
 template<typename T, size_t N>
@@ -149,6 +168,8 @@ struct Ring {
 // Forward declarations
 // -----------------------------------------------------------------------------
 static void     logf(const char* fmt, ...);
+static void     logt(uint16_t id, const uint32_t* args, uint8_t nargs);
+static void     log_drain();
 static uint16_t crc16_ccitt(const uint8_t* data, size_t len);
 static size_t   cobs_encode(const uint8_t* input, size_t length, uint8_t* output, size_t out_max);
 
@@ -182,10 +203,29 @@ static uint8_t  g_seq = 0;
 static uint32_t t_next_sensor=0, t_next_hb=0, t_next_telem=0;
 
 // -----------------------------------------------------------------------------
-// Logging (counts bytes written to LOG)
+// Logging: non-blocking ring drained by log_drain() (counts bytes written)
 // -----------------------------------------------------------------------------
+static uint8_t log_ring[LOG_RING_LEN];
+static size_t  log_head = 0, log_tail = 0, log_count = 0;
+static uint8_t log_seq = 0;
+
+// Whole message or nothing: a cut line is worse than a missing one
+static void log_push(const uint8_t* p, size_t n){
+  if(log_count + n > LOG_RING_LEN){
+    st.log_drop++;
+    st.log_drop_bytes += (uint32_t)n;
+    return;
+  }
+  size_t first = LOG_RING_LEN - log_head;
+  if(first > n) first = n;
+  memcpy(log_ring + log_head, p, first);
+  memcpy(log_ring, p + first, n - first);
+  log_head = (log_head + n) % LOG_RING_LEN;
+  log_count += n;
+}
+
 static void logf(const char* fmt, ...){
-  char buf[512];
+  static char buf[768];   // static: the stats line is long, keep it off the stack
   va_list ap;
   va_start(ap, fmt);
   int n = vsnprintf(buf, sizeof(buf), fmt, ap);
@@ -193,9 +233,61 @@ static void logf(const char* fmt, ...){
 
   if(n <= 0) return;
   if(n >= (int)sizeof(buf)) n = (int)sizeof(buf) - 1;
+  log_push((const uint8_t*)buf, (size_t)n);
+}
 
-  LOG.print(buf);
-  st.log_bytes_total += (uint32_t)n;
+// Tokenised record: [0xB2, 7, seq, len, varint id, varint args..., crc16] -> COBS -> 0x00.
+// No formatting on the device; the host looks the text up in bpu_log_fmt.def.
+static void logt(uint16_t id, const uint32_t* args, uint8_t nargs){
+  uint8_t decoded[4 + 64 + 2];
+  uint8_t len = 0;
+
+  for(int i = -1; i < (int)nargs; i++){
+    uint32_t v = (i < 0) ? id : args[i];
+    do {
+      if(len >= 64) return;
+      uint8_t b = (uint8_t)(v & 0x7F);
+      v >>= 7;
+      decoded[4 + len++] = (uint8_t)(b | (v ? 0x80 : 0));
+    } while(v);
+  }
+
+  decoded[0] = 0xB2;
+  decoded[1] = LOG_FRAME_TYPE;
+  decoded[2] = log_seq++;
+  decoded[3] = len;
+  uint16_t crc = crc16_ccitt(&decoded[1], (size_t)(3 + len));
+  decoded[4+len+0] = (uint8_t)(crc & 0xFF);
+  decoded[4+len+1] = (uint8_t)((crc >> 8) & 0xFF);
+
+  uint8_t encoded[4 + 64 + 2 + 16];
+  size_t enc_len = cobs_encode(decoded, (size_t)(4 + len + 2), encoded, sizeof(encoded) - 1);
+  if(enc_len == 0) return;
+  encoded[enc_len++] = 0x00;
+  log_push(encoded, enc_len);
+}
+
+// Write at most LOG_BUDGET_BYTES, and never more than LOG can take without blocking
+static void log_drain(){
+  uint16_t budget = LOG_BUDGET_BYTES;
+  while(budget > 0 && log_count > 0){
+    int room = LOG.availableForWrite();
+    if(room <= 0){
+      st.log_skip_txbuf++;
+      return;
+    }
+    size_t n = log_count;
+    if(n > LOG_RING_LEN - log_tail) n = LOG_RING_LEN - log_tail;
+    if(n > budget) n = budget;
+    if(n > (size_t)room) n = (size_t)room;
+
+    size_t w = LOG.write(log_ring + log_tail, n);
+    if(w == 0) return;
+    log_tail = (log_tail + w) % LOG_RING_LEN;
+    log_count -= w;
+    budget = (uint16_t)(budget - w);
+    st.log_bytes_total += (uint32_t)w;
+  }
 }
 
 // -----------------------------------------------------------------------------
@@ -214,34 +306,39 @@ static uint16_t crc16_ccitt(const uint8_t* data, size_t len){
 }
 
 // -----------------------------------------------------------------------------
-// COBS encode
+// COBS encode (32-bit SWAR zero scan, one memcpy per block)
 // -----------------------------------------------------------------------------
+static size_t zero_scan(const uint8_t* p, size_t n){
+  size_t i = 0;
+  while(i + 4 <= n){
+    uint32_t w;
+    memcpy(&w, p + i, 4);
+    if((w - 0x01010101u) & ~w & 0x80808080u) break;   // a zero is in this word
+    i += 4;
+  }
+  while(i < n && p[i] != 0) i++;
+  return i;
+}
+
 static size_t cobs_encode(const uint8_t* input, size_t length, uint8_t* output, size_t out_max){
   if(out_max == 0) return 0;
   size_t read_index = 0;
-  size_t write_index = 1;
-  size_t code_index = 0;
-  uint8_t code = 1;
-
-  while(read_index < length){
-    if(write_index >= out_max) return 0;
-    if(input[read_index] == 0){
-      output[code_index] = code;
-      code = 1;
-      code_index = write_index++;
-      read_index++;
-    } else {
-      output[write_index++] = input[read_index++];
-      code++;
-      if(code == 0xFF){
-        output[code_index] = code;
-        code = 1;
-        code_index = write_index++;
-      }
-    }
+  size_t write_index = 0;
+
+  for(;;){
+    size_t run_max = length - read_index;
+    if(run_max > 254) run_max = 254;
+    size_t run = zero_scan(input + read_index, run_max);
+    if(write_index + 1 + run > out_max) return 0;
+    output[write_index] = (uint8_t)(run + 1);
+    if(run >= 16) memcpy(output + write_index + 1, input + read_index, run);
+    else for(size_t k = 0; k < run; k++) output[write_index + 1 + k] = input[read_index + k];
+    write_index += 1 + run;
+    read_index += run;
+    if(run < run_max) read_index++;        // zero implied by the code byte
+    else if(run != 254) break;             // end of input
+    // a full 254-byte block always opens another one
   }
-  if(code_index >= out_max) return 0;
-  output[code_index] = code;
   return write_index;
 }
 
@@ -542,6 +639,8 @@ static void bpu_tick(uint32_t now_ms){
     else               st.flush_partial++;
   }
 
+  log_drain();
+
   st.tick++;
 
   const uint32_t t1 = (uint32_t)micros();
@@ -555,6 +654,24 @@ static void bpu_tick(uint32_t now_ms){
 
     const uint64_t dirty = dirty_derived();
 
+    if(LOG_TOKENIZED){
+      // Same line as below, as four records of ~10-25 B instead of ~400 B of text
+      const uint32_t q[11] = { st.tick, st.ev_in, st.ev_out, st.ev_merge, st.ev_drop, (uint32_t)evq.count,
+                               st.job_in, st.job_out, st.job_merge, st.job_drop, (uint32_t)jobq.count };
+      const uint32_t tx[10] = { (uint32_t)(dirty >> 32), (uint32_t)dirty,
+                                st.uart_sent, st.uart_skip_budget, st.uart_skip_txbuf, st.uart_bytes,
+                                st.flush_try, st.flush_ok, st.flush_partial, st.flush_full };
+      const uint32_t pk[11] = { st.pick_sensor, st.pick_hb, st.pick_telem, st.pick_aged,
+                                st.aged_hit_sensor, st.aged_hit_hb, st.aged_hit_telem,
+                                st.degrade_drop, st.degrade_requeue, st.work_us_last, st.work_us_max };
+      const uint32_t io[5] = { st.out_bytes_total, st.log_bytes_total, st.log_drop, st.log_drop_bytes, st.log_skip_txbuf };
+      logt(LOGT_INO_STATS_Q, q, 11);
+      logt(LOGT_INO_STATS_TX, tx, 10);
+      logt(LOGT_INO_STATS_PICK, pk, 11);
+      logt(LOGT_INO_STATS_IO, io, 5);
+      return;
+    }
+
     logf(
       "[BPU2.9b-r1] tick=%lu ev(in/out/merge/drop)=%lu/%lu/%lu/%lu evQ=%u "
       "job(in/out/merge/drop)=%lu/%lu/%lu/%lu jobQ=%u dirty=0x%016llX "
@@ -562,7 +679,7 @@ static void bpu_tick(uint32_t now_ms){
       "flush(try/ok/partial/full)=%lu/%lu/%lu/%lu "
       "pick(sensor/hb/telem/aged)=%lu/%lu/%lu/%lu aged_hit(s/h/t)=%lu/%lu/%lu "
       "degrade(drop/requeue)=%lu/%lu work_us(last/max)=%lu/%lu "
-      "streams(OUT/LOG)=%lu/%luB\n",
+      "streams(OUT/LOG)=%lu/%luB log(drop/dropB/skipTX)=%lu/%lu/%lu\n",
       (unsigned long)st.tick,
       (unsigned long)st.ev_in, (unsigned long)st.ev_out, (unsigned long)st.ev_merge, (unsigned long)st.ev_drop,
       (unsigned)evq.count,
@@ -575,7 +692,8 @@ static void bpu_tick(uint32_t now_ms){
       (unsigned long)st.aged_hit_sensor, (unsigned long)st.aged_hit_hb, (unsigned long)st.aged_hit_telem,
       (unsigned long)st.degrade_drop, (unsigned long)st.degrade_requeue,
       (unsigned long)st.work_us_last, (unsigned long)st.work_us_max,
-      (unsigned long)st.out_bytes_total, (unsigned long)st.log_bytes_total
+      (unsigned long)st.out_bytes_total, (unsigned long)st.log_bytes_total,
+      (unsigned long)st.log_drop, (unsigned long)st.log_drop_bytes, (unsigned long)st.log_skip_txbuf
     );
   }
 }
@@ -591,10 +709,15 @@ void setup(){
   OUT.begin(OUT_BAUD, SERIAL_8N1, OUT_RX_PIN, OUT_TX_PIN);
   delay(50);
 
-  logf("\n");
-  logf("BPU v2.9b-r1 boot\n");
-  logf("LOG: Serial @%lu\n", (unsigned long)LOG_BAUD);
-  logf("OUT: Serial1 TX=GPIO%d @%lu\n", OUT_TX_PIN, (unsigned long)OUT_BAUD);
+  if(LOG_TOKENIZED){
+    const uint32_t boot[3] = { LOG_BAUD, (uint32_t)OUT_TX_PIN, OUT_BAUD };
+    logt(LOGT_INO_BOOT, boot, 3);
+  } else {
+    logf("\n");
+    logf("BPU v2.9b-r1 boot\n");
+    logf("LOG: Serial @%lu\n", (unsigned long)LOG_BAUD);
+    logf("OUT: Serial1 TX=GPIO%d @%lu\n", OUT_TX_PIN, (unsigned long)OUT_BAUD);
+  }
 
   const uint32_t now = millis();
   t_next_sensor = now + 10;
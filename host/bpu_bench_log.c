@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bpu_simlink.h"
+#include "bpu_logfmt.h"
+
+// Stats line on the LOG port: text vs tokenised records. The engine runs
+// 60 s of SENSOR/TELEM traffic at 10 ms ticks and reports the sketch's
+// 200 ms stats line on LOG, once as formatted text (bpu_log_write) and
+// once as the four LOGT_INO_STATS_* records (bpu_log_tok). Reported: bytes
+// on LOG, CPU per report (argument gathering plus formatting or encoding,
+// up to the ring), and for the records a decode of the capture through
+// bpu_wire and bpu_logfmt, split into record payload and framing bytes.
+
+#define RUN_MS 60000U
+#define REPORT_MS 200U
+#define ROUNDS 10U
+#define LOG_CAP (256UL * 1024UL)
+
+// Ids from the shared format table
+enum {
+#define BPU_LOG_FMT(name, fmt) name,
+#include "../bpu_log_fmt.def"
+#undef BPU_LOG_FMT
+    LOGT_COUNT
+};
+
+static const char *const FMT[] = {
+#define BPU_LOG_FMT(name, fmt) fmt,
+#include "../bpu_log_fmt.def"
+#undef BPU_LOG_FMT
+};
+
+static uint8_t g_log[LOG_CAP];
+static size_t g_log_len;
+
+static int log_tx_free(void *ctx, size_t *free_out)
+{
+    (void)ctx;
+    *free_out = 4096U;
+
+    return BPU_RC_OK;
+}
+
+static int log_tx_write_some(void *ctx, const uint8_t *p, size_t len, size_t *wrote_out)
+{
+    (void)ctx;
+
+    if (g_log_len + len <= LOG_CAP) {
+        memcpy(&g_log[g_log_len], p, len);
+        g_log_len += len;
+    }
+    *wrote_out = len;
+
+    return BPU_RC_OK;
+}
+
+// Render one format with up to 11 arguments (extra arguments are ignored)
+static int fmt_text(char *out, size_t cap, uint16_t id, const uint32_t *a)
+{
+    return snprintf(out, cap, FMT[id], (unsigned)a[0], (unsigned)a[1], (unsigned)a[2], (unsigned)a[3], (unsigned)a[4], (unsigned)a[5],
+                    (unsigned)a[6], (unsigned)a[7], (unsigned)a[8], (unsigned)a[9], (unsigned)a[10]);
+}
+
+// One stats report: the sketch's four groups, as text or as records
+static void report(Bpu *bpu, uint8_t tokenised)
+{
+    static char line[768];
+    BpuStats st;
+    uint32_t q[11];
+    uint32_t tx[11];
+    uint32_t pk[11];
+    uint32_t io[11];
+    size_t n;
+
+    (void)bpu_get_stats(bpu, &st);
+    memset(tx, 0, sizeof(tx));
+    memset(io, 0, sizeof(io));
+
+    q[0] = st.tick;
+    q[1] = st.ev_in;
+    q[2] = st.ev_out;
+    q[3] = st.ev_merge;
+    q[4] = st.ev_drop;
+    q[5] = (uint32_t)bpu->evq.count;
+    q[6] = st.job_in;
+    q[7] = st.job_out;
+    q[8] = st.job_merge;
+    q[9] = st.job_drop;
+    q[10] = (uint32_t)bpu->jobq.count;
+
+    tx[0] = st.dirty_mask_hi;
+    tx[1] = st.dirty_mask_lo;
+    tx[2] = st.tx_frame_sent;
+    tx[3] = st.tx_skip_budget;
+    tx[4] = st.tx_skip_backpressure;
+    tx[5] = st.tx_bytes;
+    tx[6] = st.flush_try;
+    tx[7] = st.flush_ok;
+    tx[8] = st.tx_frame_partial;
+
+    pk[0] = st.pick_sensor;
+    pk[1] = st.pick_hb;
+    pk[2] = st.pick_telem;
+    pk[3] = st.pick_aged;
+    pk[4] = st.aged_hit_sensor;
+    pk[5] = st.aged_hit_hb;
+    pk[6] = st.aged_hit_telem;
+    pk[7] = st.degrade_drop;
+    pk[8] = st.degrade_requeue;
+    pk[9] = st.work_us_last;
+    pk[10] = st.work_us_max;
+
+    io[0] = st.tx_bytes;
+    io[1] = st.log_bytes;
+    io[2] = st.log_drop;
+    io[3] = st.log_drop_bytes;
+    io[4] = st.log_skip_backpressure;
+
+    if (tokenised != 0U) {
+        (void)bpu_log_tok(bpu, LOGT_INO_STATS_Q, q, 11U);
+        (void)bpu_log_tok(bpu, LOGT_INO_STATS_TX, tx, 10U);
+        (void)bpu_log_tok(bpu, LOGT_INO_STATS_PICK, pk, 11U);
+        (void)bpu_log_tok(bpu, LOGT_INO_STATS_IO, io, 5U);
+    } else {
+        n = (size_t)fmt_text(line, sizeof(line), LOGT_INO_STATS_Q, q);
+        n += (size_t)fmt_text(&line[n], sizeof(line) - n, LOGT_INO_STATS_TX, tx);
+        n += (size_t)fmt_text(&line[n], sizeof(line) - n, LOGT_INO_STATS_PICK, pk);
+        n += (size_t)fmt_text(&line[n], sizeof(line) - n, LOGT_INO_STATS_IO, io);
+        if (n < sizeof(line) - 1U) {
+            line[n] = '\n';
+            n++;
+        }
+        (void)bpu_log_write(bpu, (const uint8_t *)line, (uint16_t)n);
+    }
+}
+
+// 60 s run; returns ns spent in report() and fills the LOG capture
+static uint64_t run(uint8_t tokenised, BpuStats *st)
+{
+    static Bpu bpu;
+    static BpuSimLink link;
+    BpuConfig cfg;
+    BpuIo io;
+    BpuIo log_io;
+    uint64_t t0;
+    uint64_t spent;
+    uint8_t p[8];
+    uint32_t t;
+
+    g_log_len = 0U;
+    spent = 0U;
+    memset(p, 0x11, sizeof(p));
+
+    bpu_simlink_init(&link, 256U, 11520U, NULL, NULL);
+    bpu_simlink_io(&link, &io);
+
+    log_io.ctx = NULL;
+    log_io.tx_free = log_tx_free;
+    log_io.tx_write_some = log_tx_write_some;
+    log_io.time_us = NULL;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tx_budget_bytes = 64U;
+    cfg.tx_min_free = 16U;
+    cfg.tx_chunk_max = 64U;
+    cfg.aged_ms = 200U;
+
+    (void)bpu_init(&bpu, &io, &cfg);
+    (void)bpu_log_attach(&bpu, &log_io, 1024U);
+
+    t = 0U;
+    while (t < RUN_MS) {
+        p[0] = (uint8_t)t;
+        (void)bpu_push_event(&bpu, BPU_EVT_SENSOR, p, 8U, t);
+        if (t % 100U == 0U) {
+            (void)bpu_push_event(&bpu, BPU_EVT_TELEM, p, 8U, t);
+        }
+
+        (void)bpu_tick(&bpu, t);
+
+        if (t % REPORT_MS == 0U) {
+            t0 = bpu_sim_now_ns();
+            report(&bpu, tokenised);
+            spent += bpu_sim_now_ns() - t0;
+        }
+
+        t += 10U;
+        bpu_simlink_advance(&link, t);
+    }
+
+    // Drain what the last report queued
+    (void)bpu_tick(&bpu, t);
+    (void)bpu_get_stats(&bpu, st);
+
+    return spent;
+}
+
+// Decode the record capture: every frame must be a type 7 record that renders.
+// Also sums the record payloads (varint id + arguments)
+static int decode_records(unsigned long *ok_out, size_t *payload_out)
+{
+    static uint8_t dec[1024];
+    static char text[1024];
+    BpuWireFrame f;
+    unsigned long bad;
+    size_t start;
+    size_t i;
+    size_t n;
+
+    *ok_out = 0UL;
+    *payload_out = 0U;
+    bad = 0UL;
+    start = 0U;
+
+    i = 0U;
+    while (i < g_log_len) {
+        if (g_log[i] == 0U) {
+            n = bpu_wire_cobs_decode(&g_log[start], i - start, dec, sizeof(dec));
+            if (n == 0U || bpu_wire_parse(dec, n, &f) != BPU_WIRE_OK || f.type != BPU_JOB_LOG ||
+                bpu_logfmt_render(f.payload, (size_t)f.len, text, sizeof(text)) != BPU_WIRE_OK) {
+                bad++;
+            } else {
+                (*ok_out)++;
+                *payload_out += (size_t)f.len;
+            }
+            start = i + 1U;
+        }
+        i++;
+    }
+
+    return (bad == 0UL && start == g_log_len) ? 0 : 1;
+}
+
+// Usage: bpu_bench_log
+int main(void)
+{
+    BpuStats st;
+    uint64_t text_ns;
+    uint64_t tok_ns;
+    size_t text_bytes;
+    size_t tok_bytes;
+    size_t payload;
+    unsigned long reports;
+    unsigned long records;
+    unsigned long text_drop;
+    unsigned long tok_drop;
+    unsigned r;
+    int rc;
+
+    rc = 0;
+    text_ns = 0U;
+    tok_ns = 0U;
+    text_bytes = 0U;
+    tok_bytes = 0U;
+    payload = 0U;
+    text_drop = 0UL;
+    tok_drop = 0UL;
+    records = 0UL;
+
+    r = 0U;
+    while (rc == 0 && r < ROUNDS) {
+        text_ns += run(0U, &st);
+        text_bytes = g_log_len;
+        text_drop = (unsigned long)st.log_drop;
+
+        tok_ns += run(1U, &st);
+        tok_bytes = g_log_len;
+        tok_drop = (unsigned long)st.log_drop;
+
+        rc = decode_records(&records, &payload);
+        r++;
+    }
+
+    reports = RUN_MS / REPORT_MS;
+
+    printf("# wire v%u, %lu stats reports in %u s, CPU averaged over %u runs\n", (unsigned)BPU_WIRE_VERSION, reports, RUN_MS / 1000U, ROUNDS);
+    printf("%-10s %10s %10s %10s %8s\n", "mode", "log_bytes", "B/report", "ns/report", "dropped");
+    printf("%-10s %10lu %10.1f %10.0f %8lu\n", "text", (unsigned long)text_bytes, (double)text_bytes / (double)reports,
+           (double)text_ns / (double)(reports * ROUNDS), text_drop);
+    printf("%-10s %10lu %10.1f %10.0f %8lu\n", "tokenised", (unsigned long)tok_bytes, (double)tok_bytes / (double)reports,
+           (double)tok_ns / (double)(reports * ROUNDS), tok_drop);
+    printf("record payload %.1f B/report, framing %.1f B/report\n", (double)payload / (double)reports,
+           (double)(tok_bytes - payload) / (double)reports);
+    printf("records decoded: %lu of %lu %s\n", records, reports * 4UL, (rc == 0 && records == reports * 4UL) ? "ok" : "FAIL");
+
+    if (records != reports * 4UL || text_drop != 0UL || tok_drop != 0UL) {
+        rc = 1;
+    }
+
+    return rc;
+}
@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bpu_simlink.h"
+
+// Push cost against queue depth. For n = 8, 16, .. BPU_EVQ_LEN queued
+// events with distinct keys, every timed push coalesces into one of them
+// (MERGE_LAST on (type, key)), so the queue depth stays at n. A linear
+// scan over the same ring is timed alongside as the reference the hashed
+// index replaces. The depth comes from the build: both translation units
+// must see the same BPU_EVQ_LEN / BPU_EVQ_IDX_LEN.
+
+#define PUSHES 1000000UL
+
+static volatile uint32_t g_sink;
+
+// Linear (type, key) lookup over the live events, as a scan-based queue would do it
+static const BpuEvent *scan_find(const BpuEvRing *r, uint8_t type, uint16_t key)
+{
+    const BpuEvent *found;
+    uint16_t i;
+
+    found = NULL;
+
+    i = 0U;
+    while (i < r->count && found == NULL) {
+        const BpuEvent *e;
+
+        e = &r->buf[(r->tail + i) % BPU_EVQ_LEN];
+        if (e->type == type && e->key == key) {
+            found = e;
+        }
+        i++;
+    }
+
+    return found;
+}
+
+// Time PUSHES coalescing pushes and PUSHES reference scans at depth n
+static int bench_depth(uint16_t n, double *push_ns, double *scan_ns)
+{
+    static Bpu bpu;
+    static BpuSimLink link;
+    BpuConfig cfg;
+    BpuIo io;
+    uint8_t p[8];
+    uint64_t t0;
+    unsigned long i;
+    uint32_t seed;
+    uint32_t sink;
+    uint16_t k;
+    int rc;
+
+    rc = BPU_RC_OK;
+    memset(p, 0x5A, sizeof(p));
+
+    bpu_simlink_init(&link, 256U, 11520U, NULL, NULL);
+    bpu_simlink_io(&link, &io);
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tx_budget_bytes = 64U;
+    cfg.tx_min_free = 16U;
+    cfg.tx_chunk_max = 64U;
+    cfg.coalesce_window_ms = 60000U;
+    cfg.aged_ms = 200U;
+
+    rc |= bpu_init(&bpu, &io, &cfg);
+
+    k = 0U;
+    while (k < n) {
+        rc |= bpu_push_event_keyed(&bpu, BPU_EVT_SENSOR, k, p, (uint16_t)sizeof(p), 0U);
+        k++;
+    }
+
+    seed = 0x9E3779B9U;
+    t0 = bpu_sim_now_ns();
+    i = 0UL;
+    while (i < PUSHES) {
+        p[0] = (uint8_t)i;
+        rc |= bpu_push_event_keyed(&bpu, BPU_EVT_SENSOR, (uint16_t)(bpu_sim_rand(&seed) % n), p, (uint16_t)sizeof(p), 1U);
+        i++;
+    }
+    *push_ns = (double)(bpu_sim_now_ns() - t0) / (double)PUSHES;
+
+    seed = 0x9E3779B9U;
+    sink = 0U;
+    t0 = bpu_sim_now_ns();
+    i = 0UL;
+    while (i < PUSHES) {
+        const BpuEvent *e;
+
+        e = scan_find(&bpu.evq, BPU_EVT_SENSOR, (uint16_t)(bpu_sim_rand(&seed) % n));
+        sink += (e != NULL) ? e->n : 0U;
+        i++;
+    }
+    *scan_ns = (double)(bpu_sim_now_ns() - t0) / (double)PUSHES;
+    g_sink = sink;
+
+    // Every timed push must have merged: nothing dropped, depth unchanged
+    if (bpu.evq.count != n || bpu.st.ev_drop != 0U || bpu.st.ev_merge != (uint32_t)PUSHES) {
+        rc = BPU_RC_ERR;
+    }
+
+    return rc;
+}
+
+// Usage: bpu_bench_push
+int main(void)
+{
+    double push_ns;
+    double scan_ns;
+    uint32_t n;
+    int rc;
+
+    rc = 0;
+
+    printf("# BPU_EVQ_LEN=%u BPU_EVQ_IDX_LEN=%u, %lu coalescing pushes per depth\n", (unsigned)BPU_EVQ_LEN, (unsigned)BPU_EVQ_IDX_LEN, PUSHES);
+    printf("%6s %10s %10s\n", "depth", "push_ns", "scan_ns");
+
+    n = 8U;
+    while (rc == 0 && n <= BPU_EVQ_LEN) {
+        if (bench_depth((uint16_t)n, &push_ns, &scan_ns) != BPU_RC_OK) {
+            fprintf(stderr, "depth %u: pushes did not all coalesce\n", (unsigned)n);
+            rc = 1;
+        } else {
+            printf("%6u %10.1f %10.1f\n", (unsigned)n, push_ns, scan_ns);
+        }
+        n *= 2U;
+    }
+
+    return rc;
+}
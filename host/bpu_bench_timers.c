@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bpu_simlink.h"
+
+// Timer wheel with 1000 producers. Build with -DBPU_TIMER_MAX=1024U (the
+// default is 16) in both translation units.
+//
+// 1. Churn check: callbacks remove themselves, remove the timer after them
+//    on the same slot, and register new timers while the wheel runs; the
+//    slot lists must stay consistent and hold only live timers, and
+//    bpu_timer_next() must stay within one wheel lap ahead. It runs once
+//    from 0 ms and once across the 2^32 ms wrap; both runs must fire the
+//    same number of times.
+// 2. Benchmark: 1000 timers with periods of 10..2000 ms over 60 s of
+//    virtual time, against the hand-coded "test every deadline on every
+//    tick" loop the wheel replaces.
+
+#define NTIMERS 1000U
+#define RUN_MS 60000U
+#define CHURN_MS 2000U
+#define WRAP_START 0xFFFFFBFEUL  // 1026 ms before the wrap, on the 10 ms grid
+
+#if BPU_TIMER_MAX < 1000U
+#error "build with -DBPU_TIMER_MAX=1024U (see host/README.md)"
+#endif
+
+typedef struct {
+    Bpu *bpu;
+    uint16_t id;
+    uint16_t victim;
+    uint8_t mode;
+    unsigned long fired;
+} TimerCtx;
+
+static TimerCtx g_ctx[BPU_TIMER_MAX];
+static unsigned long g_fired;
+
+// Bench producer: count the expiry, skip the push (times the wheel only)
+static int tm_count(void *ctx, uint32_t now_ms, uint8_t *payload, uint16_t *len_io)
+{
+    (void)ctx;
+    (void)now_ms;
+    (void)payload;
+    (void)len_io;
+
+    g_fired++;
+
+    return BPU_RC_ERR;
+}
+
+// Churn producer: 0 = keep, 1 = remove self, 2 = remove victim, 3 = remove self and add one
+static int tm_churn(void *ctx, uint32_t now_ms, uint8_t *payload, uint16_t *len_io)
+{
+    TimerCtx *c;
+
+    c = (TimerCtx *)ctx;
+    (void)payload;
+    c->fired++;
+    *len_io = 0U;
+
+    if (c->mode == 1U) {
+        (void)bpu_timer_remove(c->bpu, c->id);
+    } else {
+        if (c->mode == 2U) {
+            (void)bpu_timer_remove(c->bpu, c->victim);
+            c->mode = 0U;
+        } else {
+            if (c->mode == 3U) {
+                (void)bpu_timer_remove(c->bpu, c->id);
+                (void)bpu_timer_add(c->bpu, BPU_EVT_HB, 0U, 10U, now_ms + 10U, tm_churn, &g_ctx[0], NULL);
+            }
+        }
+    }
+
+    return BPU_RC_ERR;
+}
+
+// Walk every slot list: links, slots and occupancy must agree, and every
+// linked timer must be live; returns the number of linked timers or -1
+static int wheel_check(const BpuWheel *w)
+{
+    unsigned slot;
+    unsigned linked;
+    uint16_t id;
+    uint16_t prev;
+    int ok;
+
+    linked = 0U;
+    ok = 1;
+
+    slot = 0U;
+    while (slot < BPU_WHEEL_SLOTS) {
+        if (((w->occupied >> slot) & 1ULL) != ((w->head[slot] != BPU_TIMER_NONE) ? 1ULL : 0ULL)) {
+            ok = 0;
+        }
+
+        prev = BPU_TIMER_NONE;
+        id = w->head[slot];
+        while (ok != 0 && id != BPU_TIMER_NONE) {
+            if (id >= BPU_TIMER_MAX || w->t[id].fn == NULL || w->t[id].slot != slot || w->t[id].prev != prev || linked > BPU_TIMER_MAX) {
+                ok = 0;
+            } else {
+                linked++;
+                prev = id;
+                id = w->t[id].next;
+            }
+        }
+        slot++;
+    }
+
+    return (ok != 0) ? (int)linked : -1;
+}
+
+// Count registered timers
+static unsigned wheel_live(const BpuWheel *w)
+{
+    unsigned i;
+    unsigned n;
+
+    n = 0U;
+    i = 0U;
+    while (i < BPU_TIMER_MAX) {
+        if (w->t[i].fn != NULL) {
+            n++;
+        }
+        i++;
+    }
+
+    return n;
+}
+
+static int churn_check(uint32_t start, unsigned long *fired_out)
+{
+    static Bpu bpu;
+    static BpuSimLink link;
+    BpuConfig cfg;
+    BpuIo io;
+    uint16_t i;
+    uint16_t id;
+    uint32_t t;
+    uint32_t next;
+    int linked;
+    int rc;
+
+    rc = 0;
+    memset(g_ctx, 0, sizeof(g_ctx));
+
+    bpu_simlink_init(&link, 256U, 11520U, NULL, NULL);
+    bpu_simlink_io(&link, &io);
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tx_budget_bytes = 64U;
+    cfg.tx_min_free = 16U;
+    cfg.tx_chunk_max = 64U;
+    cfg.aged_ms = 200U;
+
+    if (bpu_init(&bpu, &io, &cfg) != BPU_RC_OK) {
+        rc = 1;
+    }
+
+    // 64 timers on one 10 ms period (same slot); every 4th removes itself,
+    // removes the next one in its slot list, or replaces itself
+    i = 0U;
+    while (rc == 0 && i < 64U) {
+        g_ctx[i].bpu = &bpu;
+        g_ctx[i].mode = (uint8_t)((i % 4U == 1U) ? 1U : ((i % 4U == 2U) ? 2U : ((i % 4U == 3U) ? 3U : 0U)));
+        if (bpu_timer_add(&bpu, BPU_EVT_HB, i, 10U, start + 10U, tm_churn, &g_ctx[i], &id) != BPU_RC_OK) {
+            rc = 1;
+        }
+        g_ctx[i].id = id;
+        i++;
+    }
+
+    // Victims: the entry after each mode-2 timer on the slot list
+    i = 0U;
+    while (rc == 0 && i < 64U) {
+        g_ctx[i].victim = bpu.wheel.t[g_ctx[i].id].next;
+        if (g_ctx[i].mode == 2U && g_ctx[i].victim == BPU_TIMER_NONE) {
+            g_ctx[i].mode = 0U;
+        }
+        i++;
+    }
+
+    t = 0U;
+    while (rc == 0 && t <= CHURN_MS) {
+        (void)bpu_tick(&bpu, start + t);
+
+        linked = wheel_check(&bpu.wheel);
+        if (linked < 0 || (unsigned)linked != wheel_live(&bpu.wheel)) {
+            fprintf(stderr, "churn: wheel inconsistent at %lu ms (linked %d, live %u)\n", (unsigned long)t, linked, wheel_live(&bpu.wheel));
+            rc = 1;
+        }
+        if (bpu_timer_next(&bpu, &next) == BPU_RC_OK && (next - (start + t) == 0U || next - (start + t) > BPU_WHEEL_SLOTS * BPU_WHEEL_TICK_MS)) {
+            fprintf(stderr, "churn: next expiry %lu ms away at %lu ms\n", (unsigned long)(next - (start + t)), (unsigned long)t);
+            rc = 1;
+        }
+        t += 10U;
+    }
+
+    *fired_out = g_ctx[0].fired;
+    printf("churn from 0x%08lx: live=%u linked=%d fired=%lu %s\n", (unsigned long)start, wheel_live(&bpu.wheel), wheel_check(&bpu.wheel),
+           g_ctx[0].fired, (rc == 0) ? "ok" : "FAIL");
+
+    return rc;
+}
+
+static int bench(void)
+{
+    static Bpu bpu;
+    static BpuSimLink link;
+    static uint32_t due[NTIMERS];
+    static uint32_t period[NTIMERS];
+    BpuConfig cfg;
+    BpuIo io;
+    uint64_t t0;
+    uint64_t wheel_ns;
+    uint64_t naive_ns;
+    unsigned long wheel_fired;
+    unsigned long naive_fired;
+    uint32_t seed;
+    uint32_t t;
+    uint32_t next;
+    uint16_t i;
+    int rc;
+
+    rc = 0;
+    seed = 0x1234567U;
+
+    bpu_simlink_init(&link, 256U, 11520U, NULL, NULL);
+    bpu_simlink_io(&link, &io);
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tx_budget_bytes = 64U;
+    cfg.tx_min_free = 16U;
+    cfg.tx_chunk_max = 64U;
+    cfg.aged_ms = 200U;
+
+    if (bpu_init(&bpu, &io, &cfg) != BPU_RC_OK) {
+        rc = 1;
+    }
+
+    i = 0U;
+    while (rc == 0 && i < NTIMERS) {
+        period[i] = 10U * (1U + bpu_sim_rand(&seed) % 200U);
+        due[i] = period[i];
+        if (bpu_timer_add(&bpu, BPU_EVT_HB, i, period[i], period[i], tm_count, NULL, NULL) != BPU_RC_OK) {
+            rc = 1;
+        }
+        i++;
+    }
+
+    // Engine tick with the wheel (1 ms ticks, nothing else to send)
+    g_fired = 0UL;
+    t0 = bpu_sim_now_ns();
+    t = 1U;
+    while (rc == 0 && t <= RUN_MS) {
+        (void)bpu_tick(&bpu, t);
+        t++;
+    }
+    wheel_ns = bpu_sim_now_ns() - t0;
+    wheel_fired = g_fired;
+
+    // Reference: test every deadline on every tick
+    g_fired = 0UL;
+    t0 = bpu_sim_now_ns();
+    t = 1U;
+    while (rc == 0 && t <= RUN_MS) {
+        i = 0U;
+        while (i < NTIMERS) {
+            if ((int32_t)(t - due[i]) >= 0) {
+                (void)tm_count(NULL, t, NULL, NULL);
+                due[i] += period[i];
+            }
+            i++;
+        }
+        t++;
+    }
+    naive_ns = bpu_sim_now_ns() - t0;
+    naive_fired = g_fired;
+
+    if (rc == 0 && bpu_timer_next(&bpu, &next) != BPU_RC_OK) {
+        rc = 1;
+    }
+
+    printf("timers=%u ticks=%u fired wheel=%lu naive=%lu\n", NTIMERS, RUN_MS, wheel_fired, naive_fired);
+    printf("wheel: %.0f ns/tick (whole bpu_tick) %.0f ns/expiry\n", (double)wheel_ns / RUN_MS, (double)wheel_ns / (double)wheel_fired);
+    printf("naive: %.0f ns/tick (deadline loop only)\n", (double)naive_ns / RUN_MS);
+
+    if (wheel_fired != naive_fired) {
+        fprintf(stderr, "expiry counts differ\n");
+        rc = 1;
+    }
+
+    return rc;
+}
+
+// Usage: bpu_bench_timers
+int main(void)
+{
+    unsigned long fired;
+    unsigned long fired_wrap;
+    int rc;
+
+    fired = 0UL;
+    fired_wrap = 0UL;
+
+    rc = churn_check(0U, &fired);
+    if (rc == 0) {
+        rc = churn_check((uint32_t)WRAP_START, &fired_wrap);
+    }
+    if (rc == 0 && fired_wrap != fired) {
+        fprintf(stderr, "churn: %lu expiries across the wrap, %lu from 0\n", fired_wrap, fired);
+        rc = 1;
+    }
+    if (rc == 0) {
+        rc = bench();
+    }
+
+    return rc;
+}
@@ -0,0 +1,209 @@
+// clock_gettime under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+// Whole engine in this translation unit: the benchmark calls the static
+// bpu_build_frame() directly
+#include "../bpu_espidf.c"
+
+// HB frame templates (BPU_TF_TEMPLATE) against the full CRC + COBS path.
+//
+// 1. Equivalence: two engines get the same HB traffic, one with the
+//    template cache; their wire output must be byte-identical. The run
+//    covers every seq value many times (including the seq/CRC bytes that
+//    force a fallback) and switches the payload so templates are replaced.
+// 2. Benchmark: bpu_build_frame() on a constant HB payload with the cache
+//    off and on; best of ROUNDS alternating runs.
+
+#define EQ_FRAMES 70000UL
+#define BENCH_FRAMES 5000000UL
+#define ROUNDS 5U
+#define OUT_MAX (EQ_FRAMES * 16UL)
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+} TplOut;
+
+static uint8_t g_out[2][OUT_MAX];
+
+// Never back-pressured
+static int tpl_tx_free(void *ctx, size_t *free_out)
+{
+    (void)ctx;
+    *free_out = 4096U;
+
+    return BPU_RC_OK;
+}
+
+// Append to the capture buffer, or discard when it has none
+static int tpl_tx_write_some(void *ctx, const uint8_t *p, size_t len, size_t *wrote_out)
+{
+    TplOut *o;
+
+    o = (TplOut *)ctx;
+    if (o->buf != NULL && o->len + len <= o->cap) {
+        memcpy(&o->buf[o->len], p, len);
+        o->len += len;
+    }
+    *wrote_out = len;
+
+    return BPU_RC_OK;
+}
+
+// Engine with the built-in HB descriptor, optionally template-cached
+static int tpl_setup(Bpu *bpu, TplOut *o, uint8_t cached)
+{
+    BpuTypeDesc d;
+    BpuConfig cfg;
+    BpuIo io;
+    int rc;
+
+    io.ctx = o;
+    io.tx_free = tpl_tx_free;
+    io.tx_write_some = tpl_tx_write_some;
+    io.time_us = NULL;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tx_budget_bytes = 512U;
+    cfg.tx_min_free = 1U;
+    cfg.tx_chunk_max = 128U;
+    cfg.aged_ms = 200U;
+
+    d = bpu_type_hb;
+    if (cached != 0U) {
+        d.flags = BPU_TF_TEMPLATE;
+    }
+
+    rc = bpu_init(bpu, &io, &cfg);
+    rc |= bpu_register_type(bpu, BPU_EVT_HB, &d);
+
+    return rc;
+}
+
+static int equivalence(void)
+{
+    static Bpu bpu[2];
+    TplOut out[2];
+    BpuStats st;
+    unsigned long i;
+    uint8_t p[3];
+    uint8_t k;
+    int rc;
+
+    rc = 0;
+
+    k = 0U;
+    while (k < 2U) {
+        out[k].buf = g_out[k];
+        out[k].len = 0U;
+        out[k].cap = OUT_MAX;
+        rc |= tpl_setup(&bpu[k], &out[k], k);
+        k++;
+    }
+
+    // 1-byte HB most of the time, a 3-byte variant in between, and a value
+    // that changes every 1000 frames (more distinct payloads than slots)
+    i = 0UL;
+    while (rc == 0 && i < EQ_FRAMES) {
+        p[0] = 0x01U;
+        p[1] = (uint8_t)(i / 1000UL);
+        p[2] = 0x07U;
+
+        k = 0U;
+        while (k < 2U) {
+            (void)bpu_push_event(&bpu[k], BPU_EVT_HB, p, ((i / 5000UL) % 2UL != 0UL) ? 3U : 1U, (uint32_t)(i * 10UL));
+            (void)bpu_tick(&bpu[k], (uint32_t)(i * 10UL));
+            k++;
+        }
+        i++;
+    }
+
+    (void)bpu_get_stats(&bpu[1], &st);
+
+    printf("equivalence: %lu frames, %lu bytes, tpl_hit=%lu tpl_miss=%lu tpl_fallback=%lu ", EQ_FRAMES, (unsigned long)out[0].len,
+           (unsigned long)st.tpl_hit, (unsigned long)st.tpl_miss, (unsigned long)st.tpl_fallback);
+
+    if (rc != 0 || out[0].len != out[1].len || memcmp(out[0].buf, out[1].buf, out[0].len) != 0 || st.tpl_hit == 0U || st.tpl_fallback == 0U) {
+        printf("FAIL\n");
+        rc = 1;
+    } else {
+        printf("ok\n");
+    }
+
+    return rc;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// ns per bpu_build_frame() of the HB job payload with the cache off or on
+static double bench_run(uint8_t cached)
+{
+    static Bpu bpu;
+    static const uint8_t p[3] = { 0x02U, 0x01U, 0x01U };
+    TplOut out;
+    uint64_t t0;
+    unsigned long i;
+
+    out.buf = NULL;
+    out.len = 0U;
+    out.cap = 0U;
+    (void)tpl_setup(&bpu, &out, cached);
+
+    t0 = now_ns();
+    i = 0UL;
+    while (i < BENCH_FRAMES) {
+        (void)bpu_build_frame(&bpu, BPU_JOB_HB, p, (uint16_t)sizeof(p));
+        i++;
+    }
+
+    return (double)(now_ns() - t0) / (double)BENCH_FRAMES;
+}
+
+// Usage: bpu_bench_tpl
+int main(void)
+{
+    double full_ns;
+    double tpl_ns;
+    double ns;
+    unsigned r;
+    int rc;
+
+    rc = equivalence();
+
+    if (rc == 0) {
+        full_ns = 0.0;
+        tpl_ns = 0.0;
+
+        r = 0U;
+        while (r < ROUNDS) {
+            ns = bench_run(0U);
+            if (r == 0U || ns < full_ns) {
+                full_ns = ns;
+            }
+            ns = bench_run(1U);
+            if (r == 0U || ns < tpl_ns) {
+                tpl_ns = ns;
+            }
+            r++;
+        }
+
+        printf("# wire v%u, %lu HB frames, bpu_build_frame() only, best of %u\n", (unsigned)BPU_WIRE_VERSION, BENCH_FRAMES, ROUNDS);
+        printf("full path: %.1f ns/frame\n", full_ns);
+        printf("template:  %.1f ns/frame (%.1f ns saved)\n", tpl_ns, full_ns - tpl_ns);
+    }
+
+    return rc;
+}
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bpu_wire.h"
+#include "bpu_logfmt.h"
+
+// Bulk reassembly state (one blob written to an output file)
+typedef struct {
+    FILE *out;
+    uint32_t resume;
+    uint32_t end;
+    unsigned long bytes;
+    int have_last;
+} BulkRx;
+
+// Place one fragment at its offset and advance the contiguous resume point
+static void bulk_rx(BulkRx *rx, const BpuWireBulk *b)
+{
+    uint32_t end;
+
+    end = b->off + (uint32_t)b->n;
+
+    if (rx->out != NULL) {
+        if (fseek(rx->out, (long)b->off, SEEK_SET) == 0) {
+            (void)fwrite(b->data, 1U, (size_t)b->n, rx->out);
+        }
+    }
+
+    if (b->off <= rx->resume && end > rx->resume) {
+        rx->resume = end;
+    }
+
+    if ((b->flags & BPU_WIRE_BULK_F_LAST) != 0U) {
+        rx->have_last = 1;
+        rx->end = end;
+    }
+
+    rx->bytes += (unsigned long)b->n;
+}
+
+// Print one decoded frame; batch payloads are expanded into samples
+static void print_frame(const BpuWireFrame *f, unsigned long *samples, BulkRx *rx)
+{
+    uint16_t i;
+    BpuWireBulk b;
+
+    printf("v%u type=%u seq=%u len=%u", (unsigned)f->version, (unsigned)f->type, (unsigned)f->seq, (unsigned)f->len);
+
+    if (f->type == BPU_WIRE_TYPE_BULK && bpu_wire_bulk_parse(f, &b) == BPU_WIRE_OK) {
+        printf(" bulk id=%u off=%lu n=%u%s", (unsigned)b.id, (unsigned long)b.off, (unsigned)b.n,
+               ((b.flags & BPU_WIRE_BULK_F_LAST) != 0U) ? " last" : "");
+        bulk_rx(rx, &b);
+    } else {
+        if (f->type == BPU_WIRE_TYPE_LOG) {
+            char text[256];
+
+            // Log records are rendered here, the device never formats them
+            if (bpu_logfmt_render(f->payload, (size_t)f->len, text, sizeof(text)) != BPU_WIRE_OK) {
+                printf(" log=bad");
+            } else {
+                printf(" log: %s", text);
+            }
+        } else {
+            if (f->len >= 2U && f->payload[0] == BPU_WIRE_TAG_SENSOR_BATCH) {
+                BpuWireSample s[64];
+                size_t n;
+
+                n = 0U;
+
+                if (bpu_wire_batch_decode(&f->payload[2], (size_t)f->payload[1], s, 64U, &n) != BPU_WIRE_OK) {
+                    printf(" batch=bad");
+                } else {
+                    printf(" batch=%lu", (unsigned long)n);
+
+                    i = 0U;
+                    while (i < n) {
+                        printf(" %lu:%ld", (unsigned long)s[i].t_ms, (long)s[i].v);
+                        i++;
+                    }
+
+                    *samples += (unsigned long)n;
+                }
+            } else {
+                printf(" :");
+
+                i = 0U;
+                while (i < f->len) {
+                    printf(" %02X", (unsigned)f->payload[i]);
+                    i++;
+                }
+
+                *samples += 1UL;
+            }
+        }
+    }
+
+    printf("\n");
+}
+
+// Decode a raw capture (stdin or file) into frames and report bytes per sample.
+// Usage: bpu_decode [-o bulk_out] [capture]
+int main(int argc, char **argv)
+{
+    FILE *in;
+    uint8_t enc[1024];
+    uint8_t dec[1024];
+    size_t enc_len;
+    unsigned long bytes;
+    unsigned long frames;
+    unsigned long bad;
+    unsigned long samples;
+    BulkRx rx;
+    int argi;
+    int c;
+    int rc;
+
+    in = stdin;
+    enc_len = 0U;
+    bytes = 0UL;
+    frames = 0UL;
+    bad = 0UL;
+    samples = 0UL;
+    rc = 0;
+    argi = 1;
+
+    memset(&rx, 0, sizeof(rx));
+
+    if (argi + 1 < argc && strcmp(argv[argi], "-o") == 0) {
+        // r+b keeps earlier fragments so an interrupted transfer can resume
+        rx.out = fopen(argv[argi + 1], "r+b");
+        if (rx.out == NULL) {
+            rx.out = fopen(argv[argi + 1], "w+b");
+        }
+        if (rx.out == NULL) {
+            fprintf(stderr, "cannot open %s\n", argv[argi + 1]);
+            rc = 1;
+        }
+        argi += 2;
+    }
+
+    if (rc == 0 && argi < argc) {
+        in = fopen(argv[argi], "rb");
+        if (in == NULL) {
+            fprintf(stderr, "cannot open %s\n", argv[argi]);
+            rc = 1;
+        }
+    }
+
+    if (rc == 0) {
+        while ((c = fgetc(in)) != EOF) {
+            bytes++;
+
+            if (c != 0) {
+                if (enc_len < sizeof(enc)) {
+                    enc[enc_len] = (uint8_t)c;
+                }
+                enc_len++;
+            } else {
+                if (enc_len != 0U) {
+                    BpuWireFrame f;
+                    size_t n;
+
+                    n = 0U;
+                    if (enc_len <= sizeof(enc)) {
+                        n = bpu_wire_cobs_decode(enc, enc_len, dec, sizeof(dec));
+                    }
+
+                    if (n == 0U || bpu_wire_parse(dec, n, &f) != BPU_WIRE_OK) {
+                        bad++;
+                    } else {
+                        frames++;
+                        print_frame(&f, &samples, &rx);
+                    }
+                }
+
+                enc_len = 0U;
+            }
+        }
+
+        if (in != stdin) {
+            fclose(in);
+        }
+
+        printf("# bytes=%lu frames=%lu bad=%lu samples=%lu", bytes, frames, bad, samples);
+        if (samples != 0UL) {
+            printf(" bytes/sample=%.2f", (double)bytes / (double)samples);
+        }
+        printf("\n");
+
+        if (rx.bytes != 0UL) {
+            printf("# bulk bytes=%lu resume=%lu complete=%s\n", rx.bytes, (unsigned long)rx.resume,
+                   (rx.have_last != 0 && rx.resume >= rx.end) ? "yes" : "no");
+        }
+    }
+
+    if (rx.out != NULL) {
+        fclose(rx.out);
+    }
+
+    return rc;
+}
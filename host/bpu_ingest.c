@@ -0,0 +1,473 @@
+// Linux-only: epoll, eventfd and per-thread CPU clocks
+#define _DEFAULT_SOURCE 1
+#define _GNU_SOURCE 1
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "bpu_ingest.h"
+
+// Cross-thread accesses (the ring indices and the link counters)
+#define ING_LOAD_ACQ(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ING_LOAD_RLX(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define ING_STORE_REL(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define ING_STORE_RLX(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+
+// Owner-only counter bump: a plain add published with a relaxed store
+#define ING_ADD(p, v) ING_STORE_RLX((p), (uint32_t)(ING_LOAD_RLX(p) + (uint32_t)(v)))
+
+// epoll tag of the stop eventfd (links use their id)
+#define ING_TAG_STOP 0xFFFFFFFFU
+
+// Ring records start on 8-byte boundaries
+#define ING_REC_ALIGN 8U
+
+// epoll events taken per wait
+#define ING_EVENTS_MAX 64
+
+typedef char ing_ring_pow2[((BPU_INGEST_RING_BYTES & (BPU_INGEST_RING_BYTES - 1UL)) == 0UL) ? 1 : -1];
+
+// Milliseconds on CLOCK_MONOTONIC
+static uint32_t ing_now_ms(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL);
+}
+
+// Copy n bytes into the ring at free-running offset pos (wraps at most once)
+static void ing_ring_put(BpuIngestRing *r, uint32_t pos, const void *src, size_t n)
+{
+    uint32_t at;
+    size_t first;
+
+    at = pos & r->mask;
+    first = (size_t)(r->mask + 1U - at);
+
+    if (first >= n) {
+        memcpy(&r->buf[at], src, n);
+    } else {
+        memcpy(&r->buf[at], src, first);
+        memcpy(r->buf, (const uint8_t *)src + first, n - first);
+    }
+}
+
+// Copy n bytes out of the ring at free-running offset pos (wraps at most once)
+static void ing_ring_get(const BpuIngestRing *r, uint32_t pos, void *dst, size_t n)
+{
+    uint32_t at;
+    size_t first;
+
+    at = pos & r->mask;
+    first = (size_t)(r->mask + 1U - at);
+
+    if (first >= n) {
+        memcpy(dst, &r->buf[at], n);
+    } else {
+        memcpy(dst, &r->buf[at], first);
+        memcpy((uint8_t *)dst + first, r->buf, n - first);
+    }
+}
+
+// Space one record takes in the ring
+static uint32_t ing_rec_size(uint16_t len)
+{
+    return ((uint32_t)sizeof(BpuIngestFrame) + (uint32_t)len + (ING_REC_ALIGN - 1U)) & ~(ING_REC_ALIGN - 1U);
+}
+
+// Producer side: append one record, BPU_WIRE_ERR when it does not fit
+static int ing_ring_push(BpuIngestRing *r, const BpuIngestFrame *f, const uint8_t *payload)
+{
+    uint32_t head;
+    uint32_t tail;
+    uint32_t need;
+    int rc;
+
+    rc = BPU_WIRE_OK;
+
+    head = r->head;
+    tail = ING_LOAD_ACQ(&r->tail);
+    need = ing_rec_size(f->len);
+
+    if ((uint32_t)(r->mask + 1U) - (uint32_t)(head - tail) < need) {
+        rc = BPU_WIRE_ERR;
+    } else {
+        ing_ring_put(r, head, f, sizeof(*f));
+        ing_ring_put(r, head + (uint32_t)sizeof(*f), payload, (size_t)f->len);
+        ING_STORE_REL(&r->head, head + need);
+    }
+
+    return rc;
+}
+
+// Decode one complete COBS block and deliver it
+static void ing_frame(BpuIngestWorker *w, BpuIngestLink *lk, unsigned link, const uint8_t *enc, size_t n, uint32_t now_ms)
+{
+    uint8_t dec[BPU_INGEST_FRAME_MAX];
+    BpuWireFrame wf;
+    BpuIngestFrame f;
+    size_t dn;
+    uint8_t gap;
+
+    dn = bpu_wire_cobs_decode(enc, n, dec, sizeof(dec));
+
+    if (dn == 0U) {
+        ING_ADD(&lk->st.cobs_err, 1U);
+    } else {
+        if (bpu_wire_parse(dec, dn, &wf) != BPU_WIRE_OK) {
+            ING_ADD(&lk->st.crc_err, 1U);
+        } else {
+            ING_ADD(&lk->st.frames, 1U);
+
+            // A corrupted frame still used a sequence number, so it shows up as lost
+            if (lk->have_seq != 0U) {
+                gap = (uint8_t)(wf.seq - (uint8_t)(lk->last_seq + 1U));
+                if (gap != 0U) {
+                    ING_ADD(&lk->st.seq_gaps, 1U);
+                    ING_ADD(&lk->st.seq_lost, gap);
+                }
+            }
+            lk->have_seq = 1U;
+            lk->last_seq = wf.seq;
+
+            f.link = (uint16_t)link;
+            f.version = wf.version;
+            f.type = wf.type;
+            f.seq = wf.seq;
+            f.len = wf.len;
+            f.rx_ms = now_ms;
+
+            if (ing_ring_push(&w->ring, &f, wf.payload) != BPU_WIRE_OK) {
+                ING_ADD(&lk->st.ring_drop, 1U);
+            }
+        }
+    }
+}
+
+// Split a chunk read from one link at the 0x00 delimiters
+static void ing_chunk(BpuIngestWorker *w, BpuIngestLink *lk, unsigned link, const uint8_t *p, size_t n, uint32_t now_ms)
+{
+    size_t z;
+    size_t room;
+
+    while (n != 0U) {
+        z = bpu_wire_zero_scan(p, n);
+
+        if (z < n && lk->enc_len == 0U) {
+            // Whole block in this chunk: decode in place, no copy
+            if (z != 0U) {
+                if (z > (size_t)BPU_INGEST_FRAME_MAX) {
+                    ING_ADD(&lk->st.overrun, 1U);
+                } else {
+                    ing_frame(w, lk, link, p, z, now_ms);
+                }
+            }
+        } else {
+            room = (lk->enc_len < (size_t)BPU_INGEST_FRAME_MAX) ? ((size_t)BPU_INGEST_FRAME_MAX - lk->enc_len) : 0U;
+            memcpy(&lk->enc[lk->enc_len], p, (z < room) ? z : room);
+            lk->enc_len += z;
+
+            if (z < n) {
+                if (lk->enc_len > (size_t)BPU_INGEST_FRAME_MAX) {
+                    ING_ADD(&lk->st.overrun, 1U);
+                } else {
+                    ing_frame(w, lk, link, lk->enc, lk->enc_len, now_ms);
+                }
+                lk->enc_len = 0U;
+            } else {
+                // Keep counting an oversized block, but only up to the limit + 1
+                if (lk->enc_len > (size_t)BPU_INGEST_FRAME_MAX) {
+                    lk->enc_len = (size_t)BPU_INGEST_FRAME_MAX + 1U;
+                }
+            }
+        }
+
+        if (z < n) {
+            z++;
+        }
+        p += z;
+        n -= z;
+    }
+}
+
+// Read one chunk from a readable link; EOF or an error closes it
+static void ing_read(BpuIngestWorker *w, unsigned link, uint8_t *buf)
+{
+    BpuIngest *ing;
+    BpuIngestLink *lk;
+    ssize_t n;
+
+    ing = w->ing;
+    lk = &ing->links[link];
+
+    do {
+        n = read(lk->fd, buf, (size_t)BPU_INGEST_READ_CHUNK);
+    } while (n < 0 && errno == EINTR);
+
+    w->reads++;
+
+    if (n > 0) {
+        ING_ADD(&lk->st.bytes, (uint32_t)n);
+        ing_chunk(w, lk, link, buf, (size_t)n, ing_now_ms());
+    } else {
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            (void)epoll_ctl(w->ep, EPOLL_CTL_DEL, lk->fd, NULL);
+            ING_STORE_RLX(&lk->st.closed, 1U);
+            (void)__atomic_sub_fetch(&ing->open_links, 1U, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+// Worker thread: wait on this shard's links and decode whatever is readable
+static void *ing_worker(void *arg)
+{
+    BpuIngestWorker *w;
+    struct epoll_event evs[ING_EVENTS_MAX];
+    uint8_t *buf;
+    int n;
+    int k;
+
+    w = (BpuIngestWorker *)arg;
+    buf = (uint8_t *)malloc((size_t)BPU_INGEST_READ_CHUNK);
+
+    while (buf != NULL && ING_LOAD_ACQ(&w->ing->stop) == 0U) {
+        n = epoll_wait(w->ep, evs, ING_EVENTS_MAX, -1);
+
+        if (n > 0) {
+            w->wakeups++;
+        }
+
+        k = 0;
+        while (k < n) {
+            if (evs[k].data.u32 != ING_TAG_STOP) {
+                ing_read(w, (unsigned)evs[k].data.u32, buf);
+            }
+            k++;
+        }
+    }
+
+    free(buf);
+
+    return NULL;
+}
+
+// Set up nworkers epoll sets and rings
+int bpu_ingest_init(BpuIngest *ing, unsigned nworkers)
+{
+    struct epoll_event ev;
+    BpuIngestWorker *w;
+    unsigned i;
+    int rc;
+
+    rc = BPU_WIRE_OK;
+
+    if (ing == NULL || nworkers == 0U || nworkers > BPU_INGEST_WORKERS_MAX) {
+        rc = BPU_WIRE_ERR;
+    } else {
+        memset(ing, 0, sizeof(*ing));
+        ing->nworkers = nworkers;
+        ing->stop_fd = eventfd(0U, EFD_CLOEXEC | EFD_NONBLOCK);
+
+        i = 0U;
+        while (i < nworkers) {
+            w = &ing->workers[i];
+            w->ing = ing;
+            w->idx = i;
+            w->ep = epoll_create1(EPOLL_CLOEXEC);
+            w->ring.buf = (uint8_t *)malloc((size_t)BPU_INGEST_RING_BYTES);
+            w->ring.mask = (uint32_t)(BPU_INGEST_RING_BYTES - 1UL);
+
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.u32 = ING_TAG_STOP;
+
+            if (w->ep < 0 || w->ring.buf == NULL || ing->stop_fd < 0 || epoll_ctl(w->ep, EPOLL_CTL_ADD, ing->stop_fd, &ev) != 0) {
+                rc = BPU_WIRE_ERR;
+            }
+            i++;
+        }
+
+        if (rc != BPU_WIRE_OK) {
+            bpu_ingest_close(ing);
+        }
+    }
+
+    return rc;
+}
+
+// Add one input fd to worker link % nworkers
+int bpu_ingest_add(BpuIngest *ing, int fd, unsigned *link_out)
+{
+    struct epoll_event ev;
+    BpuIngestLink *lk;
+    unsigned link;
+    int flags;
+    int rc;
+
+    rc = BPU_WIRE_ERR;
+
+    if (ing != NULL && fd >= 0 && ing->nlinks < BPU_INGEST_LINKS_MAX && ing->workers[0].started == 0) {
+        link = ing->nlinks;
+        lk = &ing->links[link];
+        lk->fd = fd;
+        lk->worker = link % ing->nworkers;
+
+        flags = fcntl(fd, F_GETFL);
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = (uint32_t)link;
+
+        if (flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0 && epoll_ctl(ing->workers[lk->worker].ep, EPOLL_CTL_ADD, fd, &ev) == 0) {
+            ing->nlinks++;
+            ing->open_links++;
+            if (link_out != NULL) {
+                *link_out = link;
+            }
+            rc = BPU_WIRE_OK;
+        }
+    }
+
+    return rc;
+}
+
+// Start the worker threads
+int bpu_ingest_start(BpuIngest *ing)
+{
+    unsigned i;
+    int rc;
+
+    rc = (ing != NULL) ? BPU_WIRE_OK : BPU_WIRE_ERR;
+
+    i = 0U;
+    while (rc == BPU_WIRE_OK && i < ing->nworkers) {
+        if (pthread_create(&ing->workers[i].th, NULL, ing_worker, &ing->workers[i]) != 0) {
+            rc = BPU_WIRE_ERR;
+        } else {
+            ing->workers[i].started = 1;
+        }
+        i++;
+    }
+
+    return rc;
+}
+
+// Pop the next frame from one worker's ring
+int bpu_ingest_pop(BpuIngest *ing, unsigned worker, BpuIngestFrame *f, uint8_t *payload, size_t max)
+{
+    BpuIngestRing *r;
+    uint32_t head;
+    uint32_t tail;
+    int rc;
+
+    rc = BPU_WIRE_ERR;
+
+    if (ing != NULL && worker < ing->nworkers) {
+        r = &ing->workers[worker].ring;
+        tail = r->tail;
+        head = ING_LOAD_ACQ(&r->head);
+
+        if (head != tail) {
+            ing_ring_get(r, tail, f, sizeof(*f));
+            ing_ring_get(r, tail + (uint32_t)sizeof(*f), payload, ((size_t)f->len < max) ? (size_t)f->len : max);
+            ING_STORE_REL(&r->tail, tail + ing_rec_size(f->len));
+            rc = BPU_WIRE_OK;
+        }
+    }
+
+    return rc;
+}
+
+// Snapshot one link's counters
+void bpu_ingest_link_stats(BpuIngest *ing, unsigned link, BpuIngestLinkStats *out)
+{
+    BpuIngestLinkStats *st;
+
+    if (ing != NULL && out != NULL && link < ing->nlinks) {
+        st = &ing->links[link].st;
+        out->bytes = ING_LOAD_RLX(&st->bytes);
+        out->frames = ING_LOAD_RLX(&st->frames);
+        out->crc_err = ING_LOAD_RLX(&st->crc_err);
+        out->cobs_err = ING_LOAD_RLX(&st->cobs_err);
+        out->overrun = ING_LOAD_RLX(&st->overrun);
+        out->seq_gaps = ING_LOAD_RLX(&st->seq_gaps);
+        out->seq_lost = ING_LOAD_RLX(&st->seq_lost);
+        out->ring_drop = ING_LOAD_RLX(&st->ring_drop);
+        out->closed = ING_LOAD_RLX(&st->closed);
+    }
+}
+
+// Links that have not reached EOF yet
+unsigned bpu_ingest_open_links(BpuIngest *ing)
+{
+    return (ing != NULL) ? (unsigned)ING_LOAD_ACQ(&ing->open_links) : 0U;
+}
+
+// CPU time used by one running worker thread, in microseconds
+uint64_t bpu_ingest_worker_cpu_us(BpuIngest *ing, unsigned worker)
+{
+    struct timespec ts;
+    clockid_t cid;
+    uint64_t us;
+
+    us = 0U;
+
+    if (ing != NULL && worker < ing->nworkers && ing->workers[worker].started != 0) {
+        if (pthread_getcpuclockid(ing->workers[worker].th, &cid) == 0 && clock_gettime(cid, &ts) == 0) {
+            us = (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+        }
+    }
+
+    return us;
+}
+
+// Stop and join the workers, close the links, free the rings
+void bpu_ingest_close(BpuIngest *ing)
+{
+    uint64_t one;
+    unsigned i;
+
+    if (ing != NULL) {
+        ING_STORE_REL(&ing->stop, 1U);
+
+        one = 1U;
+        if (ing->stop_fd >= 0) {
+            (void)write(ing->stop_fd, &one, sizeof(one));
+        }
+
+        i = 0U;
+        while (i < ing->nworkers) {
+            if (ing->workers[i].started != 0) {
+                (void)pthread_join(ing->workers[i].th, NULL);
+                ing->workers[i].started = 0;
+            }
+            if (ing->workers[i].ep >= 0) {
+                close(ing->workers[i].ep);
+            }
+            free(ing->workers[i].ring.buf);
+            ing->workers[i].ep = -1;
+            ing->workers[i].ring.buf = NULL;
+            i++;
+        }
+
+        i = 0U;
+        while (i < ing->nlinks) {
+            close(ing->links[i].fd);
+            i++;
+        }
+        ing->nlinks = 0U;
+
+        if (ing->stop_fd >= 0) {
+            close(ing->stop_fd);
+        }
+        ing->stop_fd = -1;
+    }
+}
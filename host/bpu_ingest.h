@@ -0,0 +1,126 @@
+#ifndef BPU_INGEST_H
+#define BPU_INGEST_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "bpu_wire.h"
+
+// Multi-link ingest: N input fds (tty, pty, socket, pipe) carrying the BPU
+// frame stream are sharded over a worker pool. Link i belongs to worker
+// i % nworkers for its whole life, so per-link order is preserved without
+// locks. Each worker has its own epoll set, reads and decodes its links, and
+// hands decoded frames to one consumer through a lock-free SPSC ring.
+
+#ifndef BPU_INGEST_LINKS_MAX
+#define BPU_INGEST_LINKS_MAX 256U
+#endif
+
+#ifndef BPU_INGEST_WORKERS_MAX
+#define BPU_INGEST_WORKERS_MAX 32U
+#endif
+
+// Bytes per worker ring (power of two)
+#ifndef BPU_INGEST_RING_BYTES
+#define BPU_INGEST_RING_BYTES (1UL << 20)
+#endif
+
+// Largest COBS block kept per link (same limit as bpu_decode)
+#define BPU_INGEST_FRAME_MAX 1024U
+
+// Bytes taken from one readable link per wakeup (fairness between links)
+#ifndef BPU_INGEST_READ_CHUNK
+#define BPU_INGEST_READ_CHUNK 16384U
+#endif
+
+// Per-link counters. Only the owning worker writes them; other threads read
+// them with relaxed loads. They wrap like the engine stats, so rates are
+// computed from unsigned deltas.
+typedef struct {
+    uint32_t bytes;
+    uint32_t frames;
+    uint32_t crc_err;   // COBS ok, but header or CRC check failed
+    uint32_t cobs_err;  // bad COBS block
+    uint32_t overrun;   // block longer than BPU_INGEST_FRAME_MAX
+    uint32_t seq_gaps;  // sequence discontinuities
+    uint32_t seq_lost;  // frames missing across those gaps
+    uint32_t ring_drop; // decoded, but the consumer ring was full
+    uint32_t closed;    // 1 after EOF or a read error
+} BpuIngestLinkStats;
+
+// Decoded frame as delivered to the consumer (payload copied out separately)
+typedef struct {
+    uint16_t link;
+    uint8_t version;
+    uint8_t type;
+    uint8_t seq;
+    uint16_t len;
+    uint32_t rx_ms;
+} BpuIngestFrame;
+
+// Single-producer single-consumer byte ring of [BpuIngestFrame][payload]
+// records; head and tail run freely and are masked on access
+typedef struct {
+    uint32_t head;
+    uint8_t pad_head[60];
+    uint32_t tail;
+    uint8_t pad_tail[60];
+    uint8_t *buf;
+    uint32_t mask;
+} BpuIngestRing;
+
+// Per-link receive state (owned by one worker)
+typedef struct {
+    int fd;
+    unsigned worker;
+    uint8_t have_seq;
+    uint8_t last_seq;
+    size_t enc_len;
+    uint8_t enc[BPU_INGEST_FRAME_MAX];
+    BpuIngestLinkStats st;
+} BpuIngestLink;
+
+struct BpuIngest;
+
+typedef struct {
+    struct BpuIngest *ing;
+    unsigned idx;
+    int ep;
+    pthread_t th;
+    int started;
+    BpuIngestRing ring;
+    uint32_t wakeups;
+    uint32_t reads;
+} BpuIngestWorker;
+
+typedef struct BpuIngest {
+    BpuIngestLink links[BPU_INGEST_LINKS_MAX];
+    unsigned nlinks;
+    BpuIngestWorker workers[BPU_INGEST_WORKERS_MAX];
+    unsigned nworkers;
+    int stop_fd;
+    uint32_t stop;
+    uint32_t open_links;
+} BpuIngest;
+
+// Set up nworkers epoll sets and rings (links are added before start)
+int bpu_ingest_init(BpuIngest *ing, unsigned nworkers);
+// Add one input fd (made non-blocking); *link_out is its link id
+int bpu_ingest_add(BpuIngest *ing, int fd, unsigned *link_out);
+// Start the worker threads
+int bpu_ingest_start(BpuIngest *ing);
+// Pop the next frame from one worker's ring; BPU_WIRE_ERR when it is empty.
+// Only one consumer thread may pop a given ring. Payloads longer than max
+// are truncated (f->len keeps the real length).
+int bpu_ingest_pop(BpuIngest *ing, unsigned worker, BpuIngestFrame *f, uint8_t *payload, size_t max);
+// Snapshot one link's counters (any thread)
+void bpu_ingest_link_stats(BpuIngest *ing, unsigned link, BpuIngestLinkStats *out);
+// Links that have not reached EOF yet
+unsigned bpu_ingest_open_links(BpuIngest *ing);
+// CPU time used by one worker thread, in microseconds (0 if unknown)
+uint64_t bpu_ingest_worker_cpu_us(BpuIngest *ing, unsigned worker);
+// Stop and join the workers, close the links, free the rings
+void bpu_ingest_close(BpuIngest *ing);
+
+#endif
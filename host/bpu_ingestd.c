@@ -0,0 +1,263 @@
+// Linux-only: termios baud constants above 38400 and sockets
+#define _DEFAULT_SOURCE 1
+#define _GNU_SOURCE 1
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "bpu_ingest.h"
+
+// Baud rates accepted by -B
+static const unsigned long BAUD_RATE[] = { 9600UL, 19200UL, 38400UL, 57600UL, 115200UL, 230400UL, 460800UL, 921600UL };
+static const speed_t BAUD_CODE[] = { B9600, B19200, B38400, B57600, B115200, B230400, B460800, B921600 };
+#define BAUD_COUNT (sizeof(BAUD_RATE) / sizeof(BAUD_RATE[0]))
+
+static volatile sig_atomic_t g_quit;
+
+// SIGINT/SIGTERM: drain what was decoded and exit
+static void on_signal(int sig)
+{
+    (void)sig;
+    g_quit = 1;
+}
+
+// Microseconds of CPU used by the whole process
+static uint64_t cpu_us(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+// Microseconds on CLOCK_MONOTONIC
+static uint64_t wall_us(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+// Open one input: "unix:/path" connects a stream socket, anything else is
+// opened as a device, pty or fifo; ttys are put in raw mode at baud
+static int open_input(const char *spec, unsigned long baud)
+{
+    struct sockaddr_un sa;
+    struct termios t;
+    unsigned i;
+    int fd;
+
+    fd = -1;
+
+    if (strncmp(spec, "unix:", 5U) == 0) {
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+        strncpy(sa.sun_path, &spec[5], sizeof(sa.sun_path) - 1U);
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (const struct sockaddr *)&sa, (socklen_t)sizeof(sa)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    } else {
+        fd = open(spec, O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+
+        if (fd >= 0 && isatty(fd) != 0 && tcgetattr(fd, &t) == 0) {
+            cfmakeraw(&t);
+
+            i = 0U;
+            while (i < BAUD_COUNT && BAUD_RATE[i] != baud) {
+                i++;
+            }
+            if (i < BAUD_COUNT) {
+                (void)cfsetispeed(&t, BAUD_CODE[i]);
+                (void)cfsetospeed(&t, BAUD_CODE[i]);
+            }
+
+            (void)tcsetattr(fd, TCSANOW, &t);
+        }
+    }
+
+    return fd;
+}
+
+// Print every link's rates and errors since the previous report
+static void report(BpuIngest *ing, BpuIngestLinkStats *prev, double dt_s, uint64_t cpu_used_us)
+{
+    BpuIngestLinkStats st;
+    unsigned long bytes;
+    unsigned i;
+
+    bytes = 0UL;
+
+    i = 0U;
+    while (i < ing->nlinks) {
+        bpu_ingest_link_stats(ing, i, &st);
+
+        printf("# link=%u fps=%.0f kBps=%.1f frames=%lu crc=%lu cobs=%lu over=%lu gaps=%lu lost=%lu drop=%lu%s\n", i,
+               (double)(uint32_t)(st.frames - prev[i].frames) / dt_s, (double)(uint32_t)(st.bytes - prev[i].bytes) / dt_s / 1000.0,
+               (unsigned long)st.frames, (unsigned long)st.crc_err, (unsigned long)st.cobs_err, (unsigned long)st.overrun,
+               (unsigned long)st.seq_gaps, (unsigned long)st.seq_lost, (unsigned long)st.ring_drop, (st.closed != 0U) ? " closed" : "");
+
+        bytes += (unsigned long)(uint32_t)(st.bytes - prev[i].bytes);
+        prev[i] = st;
+        i++;
+    }
+
+    printf("# total MBps=%.2f cpu=%.1f%% cpu_ms/MB=%.2f\n", (double)bytes / dt_s / 1e6, (double)cpu_used_us / (dt_s * 1e4),
+           (bytes != 0UL) ? ((double)cpu_used_us / 1000.0) / ((double)bytes / 1e6) : 0.0);
+    fflush(stdout);
+}
+
+// Decode BPU frame streams from many links in parallel.
+// Usage: bpu_ingestd [-w workers] [-B baud] [-s report_s] [-v] input...
+int main(int argc, char **argv)
+{
+    static BpuIngest ing;
+    static BpuIngestLinkStats prev[BPU_INGEST_LINKS_MAX];
+    static uint8_t payload[BPU_INGEST_FRAME_MAX];
+    BpuIngestFrame f;
+    unsigned long baud;
+    unsigned long nframes;
+    unsigned workers;
+    unsigned report_s;
+    unsigned w;
+    unsigned open_links;
+    uint64_t t_last;
+    uint64_t cpu_last;
+    uint64_t now;
+    int inited;
+    int verbose;
+    int got;
+    int argi;
+    int fd;
+    int rc;
+
+    workers = 4U;
+    baud = 921600UL;
+    report_s = 10U;
+    verbose = 0;
+    inited = 0;
+    nframes = 0UL;
+    rc = 0;
+    argi = 1;
+
+    while (argi < argc && argv[argi][0] == '-') {
+        if (strcmp(argv[argi], "-v") == 0) {
+            verbose = 1;
+            argi++;
+        } else {
+            if (argi + 1 < argc && strcmp(argv[argi], "-w") == 0) {
+                workers = (unsigned)strtoul(argv[argi + 1], NULL, 0);
+            } else {
+                if (argi + 1 < argc && strcmp(argv[argi], "-B") == 0) {
+                    baud = strtoul(argv[argi + 1], NULL, 0);
+                } else {
+                    if (argi + 1 < argc && strcmp(argv[argi], "-s") == 0) {
+                        report_s = (unsigned)strtoul(argv[argi + 1], NULL, 0);
+                    } else {
+                        rc = 1;
+                        argi = argc;
+                    }
+                }
+            }
+            argi += 2;
+        }
+    }
+
+    if (rc != 0 || argi >= argc) {
+        fprintf(stderr, "usage: bpu_ingestd [-w workers] [-B baud] [-s report_s] [-v] input...\n");
+        rc = 1;
+    }
+
+    if (rc == 0) {
+        if (bpu_ingest_init(&ing, workers) != BPU_WIRE_OK) {
+            fprintf(stderr, "cannot start %u workers (max %u)\n", workers, (unsigned)BPU_INGEST_WORKERS_MAX);
+            rc = 1;
+        } else {
+            inited = 1;
+        }
+    }
+
+    while (rc == 0 && argi < argc) {
+        fd = open_input(argv[argi], baud);
+        if (fd < 0 || bpu_ingest_add(&ing, fd, NULL) != BPU_WIRE_OK) {
+            fprintf(stderr, "cannot add %s\n", argv[argi]);
+            rc = 1;
+        }
+        argi++;
+    }
+
+    if (rc == 0) {
+        (void)signal(SIGINT, on_signal);
+        (void)signal(SIGTERM, on_signal);
+
+        if (bpu_ingest_start(&ing) != BPU_WIRE_OK) {
+            fprintf(stderr, "cannot start workers\n");
+            rc = 1;
+        }
+    }
+
+    if (rc == 0) {
+        t_last = wall_us();
+        cpu_last = cpu_us();
+
+        // One consumer for all rings; it sleeps 1 ms whenever every ring is
+        // empty. open_links is read before the pass, so the last pass after
+        // every link closed sees all their frames.
+        got = 1;
+        open_links = 1U;
+        while (g_quit == 0 && (got != 0 || open_links != 0U)) {
+            got = 0;
+            open_links = bpu_ingest_open_links(&ing);
+
+            w = 0U;
+            while (w < ing.nworkers) {
+                while (bpu_ingest_pop(&ing, w, &f, payload, sizeof(payload)) == BPU_WIRE_OK) {
+                    got = 1;
+                    nframes++;
+                    if (verbose != 0) {
+                        printf("link=%u v%u type=%u seq=%u len=%u\n", (unsigned)f.link, (unsigned)f.version, (unsigned)f.type, (unsigned)f.seq, (unsigned)f.len);
+                    }
+                }
+                w++;
+            }
+
+            now = wall_us();
+            if (report_s != 0U && now - t_last >= (uint64_t)report_s * 1000000ULL) {
+                report(&ing, prev, (double)(now - t_last) / 1e6, cpu_us() - cpu_last);
+                t_last = now;
+                cpu_last = cpu_us();
+            }
+
+            if (got == 0) {
+                struct timespec nap;
+
+                nap.tv_sec = 0;
+                nap.tv_nsec = 1000000L;
+                (void)nanosleep(&nap, NULL);
+            }
+        }
+
+        now = wall_us();
+        report(&ing, prev, (double)(now - t_last) / 1e6, cpu_us() - cpu_last);
+        printf("# frames delivered=%lu\n", nframes);
+    }
+
+    if (inited != 0) {
+        bpu_ingest_close(&ing);
+    }
+
+    return rc;
+}
@@ -0,0 +1,399 @@
+// Linux-only: epoll, timerfd and the queue ioctls need the default feature set
+#define _DEFAULT_SOURCE 1
+#define _GNU_SOURCE 1
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <linux/sockios.h>
+
+#include "bpu_linux_io.h"
+
+// Default kernel output room assumed for a tty (the n_tty buffer is 4 KiB)
+#define LINUX_TTY_BUF 4096U
+
+// epoll data tags for the two non-watch fds
+#define LINUX_TAG_TIMER 0xFFFFFFFFU
+#define LINUX_TAG_OUT 0xFFFFFFFEU
+
+// Bytes still queued in the kernel for this fd
+static int linux_queued(BpuLinuxIo *lx, size_t *queued_out)
+{
+    int q;
+    int rc;
+
+    rc = BPU_RC_OK;
+    q = 0;
+
+    if (lx->kind == BPU_LINUX_KIND_TTY) {
+        rc = (ioctl(lx->fd, TIOCOUTQ, &q) == 0) ? BPU_RC_OK : BPU_RC_ERR;
+    } else {
+        if (lx->kind == BPU_LINUX_KIND_SOCKET) {
+            rc = (ioctl(lx->fd, SIOCOUTQ, &q) == 0) ? BPU_RC_OK : BPU_RC_ERR;
+        } else {
+            rc = (ioctl(lx->fd, FIONREAD, &q) == 0) ? BPU_RC_OK : BPU_RC_ERR;
+        }
+    }
+
+    *queued_out = (rc == BPU_RC_OK && q > 0) ? (size_t)q : 0U;
+    lx->n_query++;
+
+    return rc;
+}
+
+// BpuIo.tx_free: one queue query per tick, then the local estimate
+static int linux_tx_free(void *ctx, size_t *free_out)
+{
+    BpuLinuxIo *lx;
+    size_t queued;
+    int rc;
+
+    lx = (BpuLinuxIo *)ctx;
+    rc = BPU_RC_OK;
+
+    if (lx->blocked != 0) {
+        lx->free_est = 0U;
+    } else {
+        if (lx->have_free == 0) {
+            rc = linux_queued(lx, &queued);
+            if (rc == BPU_RC_OK) {
+                lx->free_est = (queued < lx->buf_size) ? (lx->buf_size - queued) : 0U;
+                lx->have_free = 1;
+            }
+        }
+    }
+
+    *free_out = lx->free_est;
+
+    return rc;
+}
+
+// BpuIo.tx_write_some: one non-blocking write(); EAGAIN and short writes
+// mark the fd blocked until epoll reports it writable again
+static int linux_tx_write_some(void *ctx, const uint8_t *p, size_t len, size_t *wrote_out)
+{
+    BpuLinuxIo *lx;
+    ssize_t n;
+    int rc;
+
+    lx = (BpuLinuxIo *)ctx;
+    rc = BPU_RC_OK;
+    *wrote_out = 0U;
+
+    do {
+        n = write(lx->fd, p, len);
+    } while (n < 0 && errno == EINTR);
+
+    lx->n_write++;
+
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            lx->n_eagain++;
+            lx->blocked = 1;
+            lx->free_est = 0U;
+        } else {
+            rc = BPU_RC_ERR;
+        }
+    } else {
+        *wrote_out = (size_t)n;
+        lx->bytes += (unsigned long)n;
+
+        if ((size_t)n < len) {
+            lx->blocked = 1;
+            lx->free_est = 0U;
+        } else {
+            lx->free_est = (lx->free_est > (size_t)n) ? (lx->free_est - (size_t)n) : 0U;
+        }
+    }
+
+    return rc;
+}
+
+// BpuIo.time_us: CLOCK_MONOTONIC (wraps every ~71 minutes like the engine's)
+static int linux_time_us(void *ctx, uint32_t *us_out)
+{
+    struct timespec ts;
+    int rc;
+
+    (void)ctx;
+
+    rc = (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) ? BPU_RC_OK : BPU_RC_ERR;
+    *us_out = (rc == BPU_RC_OK) ? (uint32_t)((uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL) : 0U;
+
+    return rc;
+}
+
+// Milliseconds on CLOCK_MONOTONIC (the loop's now_ms)
+uint32_t bpu_linux_now_ms(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL);
+}
+
+// Make fd non-blocking and fill in the engine callbacks
+int bpu_linux_io_open(BpuLinuxIo *lx, int fd, size_t buf_size, BpuIo *io_out)
+{
+    struct stat sb;
+    socklen_t sl;
+    int flags;
+    int sz;
+    int rc;
+
+    rc = BPU_RC_OK;
+
+    if (lx == NULL || io_out == NULL || fd < 0 || fstat(fd, &sb) != 0) {
+        rc = BPU_RC_ERR;
+    } else {
+        memset(lx, 0, sizeof(*lx));
+        lx->fd = fd;
+
+        flags = fcntl(fd, F_GETFL);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+            rc = BPU_RC_ERR;
+        }
+
+        sz = 0;
+
+        if (S_ISSOCK(sb.st_mode)) {
+            // SO_SNDBUF and SIOCOUTQ both count kernel buffer memory, not payload
+            lx->kind = BPU_LINUX_KIND_SOCKET;
+            sl = (socklen_t)sizeof(sz);
+            if (getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sz, &sl) != 0) {
+                sz = 0;
+            }
+        } else {
+            if (S_ISFIFO(sb.st_mode)) {
+                lx->kind = BPU_LINUX_KIND_PIPE;
+                sz = fcntl(fd, F_GETPIPE_SZ);
+            } else {
+                if (isatty(fd) != 0) {
+                    lx->kind = BPU_LINUX_KIND_TTY;
+                    sz = (int)LINUX_TTY_BUF;
+                } else {
+                    rc = BPU_RC_ERR;
+                }
+            }
+        }
+
+        lx->buf_size = (buf_size != 0U) ? buf_size : ((sz > 0) ? (size_t)sz : 0U);
+        if (lx->buf_size == 0U) {
+            rc = BPU_RC_ERR;
+        }
+
+        if (rc == BPU_RC_OK) {
+            io_out->ctx = lx;
+            io_out->tx_free = linux_tx_free;
+            io_out->tx_write_some = linux_tx_write_some;
+            io_out->time_us = linux_time_us;
+        }
+    }
+
+    return rc;
+}
+
+// Forget the cached free space
+void bpu_linux_io_refresh(BpuLinuxIo *lx)
+{
+    if (lx != NULL) {
+        lx->have_free = 0;
+    }
+}
+
+// Create the epoll set and the tick timer
+int bpu_linux_loop_init(BpuLinuxLoop *lp, Bpu *bpu, BpuLinuxIo *lx, uint32_t tick_ms)
+{
+    struct itimerspec its;
+    struct epoll_event ev;
+    unsigned i;
+    int rc;
+
+    rc = BPU_RC_OK;
+
+    if (lp == NULL || bpu == NULL || lx == NULL || tick_ms == 0U) {
+        rc = BPU_RC_ERR;
+    } else {
+        memset(lp, 0, sizeof(*lp));
+        lp->bpu = bpu;
+        lp->lx = lx;
+        lp->tick_ms = tick_ms;
+
+        i = 0U;
+        while (i < BPU_LINUX_WATCH_MAX) {
+            lp->watch_fd[i] = -1;
+            i++;
+        }
+
+        lp->ep = epoll_create1(EPOLL_CLOEXEC);
+        lp->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+        if (lp->ep < 0 || lp->tfd < 0) {
+            rc = BPU_RC_ERR;
+        } else {
+            its.it_value.tv_sec = (time_t)(tick_ms / 1000U);
+            its.it_value.tv_nsec = (long)(tick_ms % 1000U) * 1000000L;
+            its.it_interval = its.it_value;
+
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.u32 = LINUX_TAG_TIMER;
+
+            if (timerfd_settime(lp->tfd, 0, &its, NULL) != 0 || epoll_ctl(lp->ep, EPOLL_CTL_ADD, lp->tfd, &ev) != 0) {
+                rc = BPU_RC_ERR;
+            }
+
+            // The out fd is registered with no events; EPOLLOUT is armed on EAGAIN
+            memset(&ev, 0, sizeof(ev));
+            ev.events = 0U;
+            ev.data.u32 = LINUX_TAG_OUT;
+
+            if (rc == BPU_RC_OK && epoll_ctl(lp->ep, EPOLL_CTL_ADD, lx->fd, &ev) != 0) {
+                rc = BPU_RC_ERR;
+            }
+        }
+
+        if (rc != BPU_RC_OK) {
+            bpu_linux_loop_close(lp);
+        }
+    }
+
+    return rc;
+}
+
+// Watch one input fd
+int bpu_linux_loop_watch(BpuLinuxLoop *lp, int fd, BpuLinuxReadFn fn, void *ctx)
+{
+    struct epoll_event ev;
+    unsigned i;
+    int rc;
+
+    rc = BPU_RC_ERR;
+
+    if (lp != NULL && fd >= 0 && fn != NULL) {
+        i = 0U;
+        while (i < BPU_LINUX_WATCH_MAX && lp->watch_fd[i] >= 0) {
+            i++;
+        }
+
+        if (i < BPU_LINUX_WATCH_MAX) {
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.u32 = (uint32_t)i;
+
+            if (epoll_ctl(lp->ep, EPOLL_CTL_ADD, fd, &ev) == 0) {
+                lp->watch_fd[i] = fd;
+                lp->watch_fn[i] = fn;
+                lp->watch_ctx[i] = ctx;
+                rc = BPU_RC_OK;
+            }
+        }
+    }
+
+    return rc;
+}
+
+// Arm or disarm EPOLLOUT on the output fd to match its blocked state
+static void linux_loop_arm(BpuLinuxLoop *lp)
+{
+    struct epoll_event ev;
+    int want;
+
+    want = (lp->lx->blocked != 0) ? 1 : 0;
+
+    if (want != lp->out_armed) {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = (want != 0) ? (uint32_t)EPOLLOUT : 0U;
+        ev.data.u32 = LINUX_TAG_OUT;
+
+        if (epoll_ctl(lp->ep, EPOLL_CTL_MOD, lp->lx->fd, &ev) == 0) {
+            lp->out_armed = want;
+        }
+    }
+}
+
+// Wait and handle what fired: inputs, then one tick for timer expiry or a
+// writable output (a blocked link resumes as soon as the kernel drains,
+// not at the next timer tick)
+int bpu_linux_loop_step(BpuLinuxLoop *lp, int timeout_ms)
+{
+    struct epoll_event evs[BPU_LINUX_WATCH_MAX + 2U];
+    uint64_t expirations;
+    uint32_t now_ms;
+    int tick;
+    int n;
+    int k;
+    int rc;
+
+    rc = BPU_RC_OK;
+    tick = 0;
+
+    if (lp == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        n = epoll_wait(lp->ep, evs, (int)(BPU_LINUX_WATCH_MAX + 2U), timeout_ms);
+
+        if (n < 0 && errno != EINTR) {
+            rc = BPU_RC_ERR;
+        }
+
+        if (n > 0) {
+            lp->wakeups++;
+        }
+
+        now_ms = bpu_linux_now_ms();
+
+        k = 0;
+        while (k < n) {
+            if (evs[k].data.u32 == LINUX_TAG_TIMER) {
+                // Drain the expiration count; several missed periods still make one tick
+                (void)read(lp->tfd, &expirations, sizeof(expirations));
+                tick = 1;
+            } else {
+                if (evs[k].data.u32 == LINUX_TAG_OUT) {
+                    lp->lx->blocked = 0;
+                    tick = 1;
+                } else {
+                    if (evs[k].data.u32 < BPU_LINUX_WATCH_MAX) {
+                        lp->watch_fn[evs[k].data.u32](lp->watch_ctx[evs[k].data.u32], lp->watch_fd[evs[k].data.u32], now_ms);
+                    }
+                }
+            }
+            k++;
+        }
+
+        if (tick != 0) {
+            bpu_linux_io_refresh(lp->lx);
+            if (bpu_tick_ex(lp->bpu, now_ms, 0U) != BPU_RC_OK) {
+                rc = BPU_RC_ERR;
+            }
+            lp->ticks++;
+            linux_loop_arm(lp);
+        }
+    }
+
+    return rc;
+}
+
+// Close the epoll set and the timer (the fds stay open)
+void bpu_linux_loop_close(BpuLinuxLoop *lp)
+{
+    if (lp != NULL) {
+        if (lp->ep >= 0) {
+            close(lp->ep);
+        }
+        if (lp->tfd >= 0) {
+            close(lp->tfd);
+        }
+        lp->ep = -1;
+        lp->tfd = -1;
+    }
+}
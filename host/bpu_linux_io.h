@@ -0,0 +1,74 @@
+#ifndef BPU_LINUX_IO_H
+#define BPU_LINUX_IO_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Engine types only (Bpu, BpuIo); the engine itself is compiled elsewhere
+#define BPU_ESPIDF_DECLARE_ONLY 1
+#include "../bpu_espidf.c"
+
+// Linux BpuIo over one non-blocking fd (tty, socket or pipe).
+// tx_free = buf_size - bytes still queued in the kernel (TIOCOUTQ for ttys,
+// SIOCOUTQ for sockets, FIONREAD for pipes), queried once per tick and then
+// tracked locally; tx_write_some is one write(), EAGAIN = 0 bytes written;
+// time_us is CLOCK_MONOTONIC.
+typedef struct {
+    int fd;
+    int kind;
+    size_t buf_size;
+    size_t free_est;
+    int have_free;
+    int blocked;
+    unsigned long n_write;
+    unsigned long n_query;
+    unsigned long n_eagain;
+    unsigned long bytes;
+} BpuLinuxIo;
+
+#define BPU_LINUX_KIND_TTY 1
+#define BPU_LINUX_KIND_SOCKET 2
+#define BPU_LINUX_KIND_PIPE 3
+
+// Make fd non-blocking and fill in the engine callbacks; buf_size 0 uses the
+// kernel's size (SO_SNDBUF, F_GETPIPE_SZ, or 4096 for a tty)
+int bpu_linux_io_open(BpuLinuxIo *lx, int fd, size_t buf_size, BpuIo *io_out);
+// Forget the cached free space; the loop calls it before each tick, callers
+// ticking on their own must too
+void bpu_linux_io_refresh(BpuLinuxIo *lx);
+
+// Watched input fd: fn runs when fd is readable (typically pushes events)
+typedef void (*BpuLinuxReadFn)(void *ctx, int fd, uint32_t now_ms);
+
+#define BPU_LINUX_WATCH_MAX 8U
+
+// epoll loop driving bpu_tick_ex(): a timerfd fires every tick_ms, and the
+// output fd is watched for EPOLLOUT only while a write hit EAGAIN
+typedef struct {
+    Bpu *bpu;
+    BpuLinuxIo *lx;
+    int ep;
+    int tfd;
+    uint32_t tick_ms;
+    int out_armed;
+    int watch_fd[BPU_LINUX_WATCH_MAX];
+    BpuLinuxReadFn watch_fn[BPU_LINUX_WATCH_MAX];
+    void *watch_ctx[BPU_LINUX_WATCH_MAX];
+    unsigned long ticks;
+    unsigned long wakeups;
+} BpuLinuxLoop;
+
+// Create the epoll set and the tick timer
+int bpu_linux_loop_init(BpuLinuxLoop *lp, Bpu *bpu, BpuLinuxIo *lx, uint32_t tick_ms);
+// Watch one input fd (up to BPU_LINUX_WATCH_MAX)
+int bpu_linux_loop_watch(BpuLinuxLoop *lp, int fd, BpuLinuxReadFn fn, void *ctx);
+// Wait up to timeout_ms (-1 = forever) and handle what fired: inputs, then
+// one tick for timer expiry or a writable output
+int bpu_linux_loop_step(BpuLinuxLoop *lp, int timeout_ms);
+// Close the epoll set and the timer (the fds stay open)
+void bpu_linux_loop_close(BpuLinuxLoop *lp);
+
+// Milliseconds on CLOCK_MONOTONIC (the loop's now_ms)
+uint32_t bpu_linux_now_ms(void);
+
+#endif
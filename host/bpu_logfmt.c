@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "bpu_wire.h"
+#include "bpu_logfmt.h"
+
+// Format table of the firmware being decoded (override with -DBPU_LOG_FMT_DEF='"path"')
+#ifndef BPU_LOG_FMT_DEF
+#define BPU_LOG_FMT_DEF "../bpu_log_fmt.def"
+#endif
+
+static const char *const bpu_logfmt_table[] = {
+#define BPU_LOG_FMT(name, fmt) fmt,
+#include BPU_LOG_FMT_DEF
+#undef BPU_LOG_FMT
+};
+
+// Format string for an id (NULL if unknown)
+const char *bpu_logfmt_get(uint32_t id)
+{
+    const char *f;
+
+    f = NULL;
+
+    if (id < (uint32_t)(sizeof(bpu_logfmt_table) / sizeof(bpu_logfmt_table[0]))) {
+        f = bpu_logfmt_table[id];
+    }
+
+    return f;
+}
+
+// Render one record payload to text; returns BPU_WIRE_OK or BPU_WIRE_ERR
+int bpu_logfmt_render(const uint8_t *payload, size_t n, char *out, size_t out_max)
+{
+    const char *f;
+    uint32_t id;
+    size_t r;
+    size_t w;
+    size_t k;
+    int rc;
+
+    rc = BPU_WIRE_OK;
+    w = 0U;
+    f = NULL;
+
+    k = bpu_wire_varint(payload, n, &id);
+    r = k;
+
+    if (k == 0U || out_max == 0U) {
+        rc = BPU_WIRE_ERR;
+    } else {
+        f = bpu_logfmt_get(id);
+    }
+
+    if (rc == BPU_WIRE_OK && f == NULL) {
+        // Unknown id (older table): show it raw rather than drop it
+        (void)snprintf(out, out_max, "<log id %lu, %lu B>", (unsigned long)id, (unsigned long)(n - r));
+        w = strlen(out);
+        f = "";
+    }
+
+    while (rc == BPU_WIRE_OK && *f != '\0' && w + 1U < out_max) {
+        if (*f != '%') {
+            out[w] = *f;
+            w++;
+            f++;
+        } else {
+            char spec[16];
+            size_t s;
+            uint32_t v;
+            int m;
+
+            // Copy "%[0][width]" and find the conversion
+            s = 0U;
+            spec[s] = *f;
+            s++;
+            f++;
+            while ((*f == '0' || (*f >= '1' && *f <= '9')) && s < sizeof(spec) - 3U) {
+                spec[s] = *f;
+                s++;
+                f++;
+            }
+
+            m = 0;
+            if (*f == '%') {
+                out[w] = '%';
+                w++;
+                f++;
+            } else {
+                k = bpu_wire_varint(&payload[r], n - r, &v);
+                if (k == 0U || (*f != 'u' && *f != 'd' && *f != 'x' && *f != 'X' && *f != 'c')) {
+                    rc = BPU_WIRE_ERR;
+                } else {
+                    r += k;
+                    spec[s] = *f;
+                    spec[s + 1U] = '\0';
+                    f++;
+
+                    if (spec[s] == 'd') {
+                        m = snprintf(&out[w], out_max - w, spec, (int)(int32_t)v);
+                    } else {
+                        if (spec[s] == 'c') {
+                            m = snprintf(&out[w], out_max - w, spec, (int)(v & 0xFFU));
+                        } else {
+                            m = snprintf(&out[w], out_max - w, spec, (unsigned int)v);
+                        }
+                    }
+
+                    if (m < 0) {
+                        rc = BPU_WIRE_ERR;
+                    } else {
+                        w += (size_t)m;
+                        if (w >= out_max) {
+                            w = out_max - 1U;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Arguments left over mean the table does not match the firmware
+    if (rc == BPU_WIRE_OK && *f == '\0' && r != n) {
+        rc = BPU_WIRE_ERR;
+    }
+
+    out[w] = '\0';
+
+    return rc;
+}
@@ -0,0 +1,15 @@
+#ifndef BPU_LOGFMT_H
+#define BPU_LOGFMT_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Host-side renderer for tokenised LOG records (frame type 7):
+// payload = varint id, then one varint per argument
+
+// Format string for an id (NULL if unknown)
+const char *bpu_logfmt_get(uint32_t id);
+// Render one record payload to text; returns BPU_WIRE_OK or BPU_WIRE_ERR
+int bpu_logfmt_render(const uint8_t *payload, size_t n, char *out, size_t out_max);
+
+#endif
@@ -0,0 +1,645 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Engine API only; the engine itself is compiled from ../bpu_espidf.c
+#define BPU_ESPIDF_DECLARE_ONLY 1
+#include "../bpu_espidf.c"
+
+// One parsed capture record; times are absolute (deltas already summed)
+typedef struct {
+    uint8_t tag;
+    uint8_t rc;
+    uint8_t type;
+    uint8_t len;
+    uint16_t key;
+    uint32_t t_ms;
+    uint32_t a;
+    uint32_t b;
+    size_t off;
+} CapRec;
+
+// Replay state: parsed capture, virtual link and output sink
+typedef struct {
+    const uint8_t *buf;
+    CapRec *rec;
+    size_t n;
+    BpuTypeDesc *desc;
+    BpuField *fields;
+    size_t ndesc;
+    BpuConfig cfg;
+    uint8_t wire;
+    uint8_t has_time;
+    int link;
+    size_t io;
+    size_t io_end;
+    size_t link_free;
+    uint32_t last_us;
+    unsigned long diverge;
+    unsigned long out_bytes;
+    FILE *out;
+} Replay;
+
+// Read one byte of the capture
+static int rd_u8(const uint8_t *p, size_t len, size_t *pos, uint8_t *v)
+{
+    int rc;
+
+    rc = BPU_RC_ERR;
+
+    if (*pos < len) {
+        *v = p[*pos];
+        (*pos)++;
+        rc = BPU_RC_OK;
+    }
+
+    return rc;
+}
+
+// Read one unsigned LEB128 varint of the capture
+static int rd_varint(const uint8_t *p, size_t len, size_t *pos, uint32_t *v)
+{
+    uint8_t b;
+    unsigned shift;
+    int rc;
+
+    *v = 0U;
+    shift = 0U;
+
+    do {
+        rc = rd_u8(p, len, pos, &b);
+        if (rc == BPU_RC_OK) {
+            if (shift < 32U) {
+                *v |= (uint32_t)(b & 0x7FU) << shift;
+            }
+            shift += 7U;
+        }
+    } while (rc == BPU_RC_OK && (b & 0x80U) != 0U && shift < 35U);
+
+    return rc;
+}
+
+// Parse a TYPE record into the next descriptor slot
+static int parse_type(Replay *r, size_t len, size_t *pos, CapRec *c)
+{
+    BpuTypeDesc *d;
+    BpuField *f;
+    uint32_t v;
+    uint8_t nf;
+    uint8_t i;
+    int rc;
+
+    d = &r->desc[r->ndesc];
+    f = &r->fields[r->ndesc * BPU_CAP_FIELDS_MAX];
+    nf = 0U;
+    memset(d, 0, sizeof(*d));
+
+    rc = rd_u8(r->buf, len, pos, &c->type);
+    rc |= rd_u8(r->buf, len, pos, &d->merge);
+    rc |= rd_u8(r->buf, len, pos, &d->job);
+    rc |= rd_u8(r->buf, len, pos, &d->tag);
+    rc |= rd_u8(r->buf, len, pos, &d->prio);
+    rc |= rd_u8(r->buf, len, pos, &d->degrade);
+    rc |= rd_varint(r->buf, len, pos, &v);
+    d->ttl_ms = (uint16_t)v;
+    rc |= rd_varint(r->buf, len, pos, &v);
+    d->deadline_ms = (uint16_t)v;
+    rc |= rd_u8(r->buf, len, pos, &d->flags);
+    rc |= rd_u8(r->buf, len, pos, &d->state_slot);
+    i = 0U;
+    while (i <= BPU_LEVEL_MAX) {
+        rc |= rd_u8(r->buf, len, pos, &d->shed[i]);
+        i++;
+    }
+    rc |= rd_varint(r->buf, len, pos, &v);
+    d->keepalive_ms = (uint16_t)v;
+    rc |= rd_varint(r->buf, len, pos, &v);
+    d->deadband = (uint16_t)v;
+    rc |= rd_u8(r->buf, len, pos, &nf);
+
+    if (nf > BPU_CAP_FIELDS_MAX) {
+        rc = BPU_RC_ERR;
+    }
+
+    i = 0U;
+    while (i < nf && rc == BPU_RC_OK) {
+        rc |= rd_u8(r->buf, len, pos, &f[i].off);
+        rc |= rd_u8(r->buf, len, pos, &f[i].kind);
+        rc |= rd_u8(r->buf, len, pos, &f[i].op);
+        i++;
+    }
+
+    d->nfields = nf;
+    d->fields = (nf != 0U) ? f : NULL;
+    c->a = (uint32_t)r->ndesc;
+    r->ndesc++;
+
+    return rc;
+}
+
+// Parse the INIT record into the replay config
+static int parse_init(Replay *r, size_t len, size_t *pos)
+{
+    uint32_t v;
+    uint8_t flags;
+    int rc;
+
+    memset(&r->cfg, 0, sizeof(r->cfg));
+    flags = 0U;
+
+    rc = rd_varint(r->buf, len, pos, &v);
+    r->cfg.tx_budget_bytes = (uint16_t)v;
+    rc |= rd_varint(r->buf, len, pos, &v);
+    r->cfg.tx_min_free = (uint16_t)v;
+    rc |= rd_varint(r->buf, len, pos, &v);
+    r->cfg.tx_chunk_max = (uint16_t)v;
+    rc |= rd_varint(r->buf, len, pos, &v);
+    r->cfg.coalesce_window_ms = (uint16_t)v;
+    rc |= rd_varint(r->buf, len, pos, &v);
+    r->cfg.aged_ms = (uint16_t)v;
+    rc |= rd_u8(r->buf, len, pos, &flags);
+    rc |= rd_u8(r->buf, len, pos, &r->wire);
+
+    r->cfg.enable_degrade = (uint8_t)(flags & 0x01U);
+    r->cfg.enable_edf = (uint8_t)((flags >> 1) & 0x01U);
+    r->cfg.enable_preempt = (uint8_t)((flags >> 2) & 0x01U);
+    r->cfg.enable_admission = (uint8_t)((flags >> 3) & 0x01U);
+    r->has_time = (uint8_t)((flags >> 4) & 0x01U);
+
+    return rc;
+}
+
+// Parse a PUSH/TPUSH/TICK (timed) or FREE/WRITE/TIME (IO answer) record
+static int parse_event(Replay *r, size_t len, size_t *pos, CapRec *c, uint32_t *now)
+{
+    uint32_t v;
+    int rc;
+
+    rc = BPU_RC_OK;
+
+    if (c->tag == BPU_CAP_PUSH || c->tag == BPU_CAP_TPUSH || c->tag == BPU_CAP_TICK) {
+        rc = rd_varint(r->buf, len, pos, &v);
+        *now += v;
+        c->t_ms = *now;
+
+        if (c->tag == BPU_CAP_TICK) {
+            rc |= rd_varint(r->buf, len, pos, &c->a);
+        } else {
+            rc |= rd_u8(r->buf, len, pos, &c->type);
+            rc |= rd_varint(r->buf, len, pos, &v);
+            c->key = (uint16_t)v;
+            rc |= rd_u8(r->buf, len, pos, &c->len);
+            c->off = *pos;
+            *pos += c->len;
+            if (*pos > len) {
+                rc = BPU_RC_ERR;
+            }
+        }
+    } else {
+        if (c->tag == BPU_CAP_FREE || c->tag == BPU_CAP_WRITE || c->tag == BPU_CAP_TIME) {
+            rc = rd_u8(r->buf, len, pos, &c->rc);
+            rc |= rd_varint(r->buf, len, pos, &c->a);
+            if (c->tag == BPU_CAP_WRITE) {
+                rc |= rd_varint(r->buf, len, pos, &c->b);
+            }
+        } else {
+            rc = BPU_RC_ERR;
+        }
+    }
+
+    return rc;
+}
+
+// Split the capture into records; TYPE descriptors go to their own table
+static int parse_capture(Replay *r, size_t len)
+{
+    size_t pos;
+    uint32_t now;
+    CapRec *c;
+    int rc;
+
+    // Every record takes at least two bytes, so len / 2 bounds both tables
+    r->rec = (CapRec *)calloc(len / 2U + 1U, sizeof(CapRec));
+    r->desc = (BpuTypeDesc *)calloc(len / 2U + 1U, sizeof(BpuTypeDesc));
+    r->fields = (BpuField *)calloc((len / 2U + 1U) * BPU_CAP_FIELDS_MAX, sizeof(BpuField));
+    rc = (r->rec == NULL || r->desc == NULL || r->fields == NULL) ? BPU_RC_ERR : BPU_RC_OK;
+
+    pos = 0U;
+    now = 0U;
+
+    while (rc == BPU_RC_OK && pos < len) {
+        c = &r->rec[r->n];
+        rc = rd_u8(r->buf, len, &pos, &c->tag);
+
+        if (rc == BPU_RC_OK) {
+            if (c->tag == BPU_CAP_INIT) {
+                rc = parse_init(r, len, &pos);
+            } else {
+                if (c->tag == BPU_CAP_TYPE) {
+                    rc = parse_type(r, len, &pos, c);
+                } else {
+                    rc = parse_event(r, len, &pos, c, &now);
+                }
+            }
+        }
+
+        if (rc == BPU_RC_OK) {
+            r->n++;
+        } else {
+            fprintf(stderr, "bad record at byte %lu\n", (unsigned long)pos);
+        }
+    }
+
+    return rc;
+}
+
+// Next recorded answer of the given kind inside the current tick, or NULL
+// (exact mode only: a different kind next means the replay diverged)
+static const CapRec *next_io(Replay *r, uint8_t tag)
+{
+    const CapRec *c;
+
+    c = NULL;
+
+    if (r->link == 0) {
+        while (r->io < r->io_end && r->rec[r->io].tag == BPU_CAP_TPUSH) {
+            r->io++;
+        }
+
+        if (r->io < r->io_end && r->rec[r->io].tag == tag) {
+            c = &r->rec[r->io];
+            r->io++;
+        } else {
+            r->diverge++;
+        }
+    }
+
+    return c;
+}
+
+// BpuIo.tx_free: the recorded answer, or the virtual link's free space
+static int rp_tx_free(void *ctx, size_t *free_out)
+{
+    Replay *r;
+    const CapRec *c;
+    int rc;
+
+    r = (Replay *)ctx;
+    c = next_io(r, BPU_CAP_FREE);
+    rc = BPU_RC_OK;
+
+    if (c != NULL) {
+        rc = c->rc;
+        *free_out = (size_t)c->a;
+    } else {
+        *free_out = r->link_free;
+    }
+
+    return rc;
+}
+
+// BpuIo.tx_write_some: accept what the device accepted (or what the
+// virtual link has room for) and append it to the output file
+static int rp_tx_write_some(void *ctx, const uint8_t *p, size_t len, size_t *wrote_out)
+{
+    Replay *r;
+    const CapRec *c;
+    size_t n;
+    int rc;
+
+    r = (Replay *)ctx;
+    c = next_io(r, BPU_CAP_WRITE);
+    rc = BPU_RC_OK;
+
+    if (c != NULL) {
+        rc = c->rc;
+        n = (size_t)c->b;
+        if (c->a != (uint32_t)len) {
+            r->diverge++;
+        }
+    } else {
+        n = r->link_free;
+    }
+
+    if (n > len) {
+        n = len;
+    }
+    if (r->link != 0) {
+        r->link_free -= n;
+    }
+
+    *wrote_out = (rc == BPU_RC_OK) ? n : 0U;
+
+    if (r->out != NULL && *wrote_out != 0U) {
+        (void)fwrite(p, 1U, *wrote_out, r->out);
+    }
+    r->out_bytes += (unsigned long)*wrote_out;
+
+    return rc;
+}
+
+// BpuIo.time_us: the recorded clock (only feeds the work_us stats)
+static int rp_time_us(void *ctx, uint32_t *us_out)
+{
+    Replay *r;
+    size_t i;
+
+    r = (Replay *)ctx;
+
+    if (r->link == 0) {
+        const CapRec *c;
+
+        c = next_io(r, BPU_CAP_TIME);
+        if (c != NULL) {
+            r->last_us = c->a;
+        }
+    } else {
+        i = r->io;
+        while (i < r->io_end && r->rec[i].tag != BPU_CAP_TIME) {
+            i++;
+        }
+        if (i < r->io_end) {
+            r->last_us = r->rec[i].a;
+            r->io = i + 1U;
+        }
+    }
+
+    *us_out = r->last_us;
+
+    return BPU_RC_OK;
+}
+
+// Replay one tick: timer pushes first (they ran first on the device), then
+// the tick with the recorded answers of this tick only
+static size_t replay_tick(Replay *r, Bpu *bpu, size_t i)
+{
+    size_t j;
+    size_t k;
+
+    j = i + 1U;
+    while (j < r->n && r->rec[j].tag != BPU_CAP_PUSH && r->rec[j].tag != BPU_CAP_TICK && r->rec[j].tag != BPU_CAP_TYPE &&
+           r->rec[j].tag != BPU_CAP_INIT) {
+        j++;
+    }
+
+    k = i + 1U;
+    while (k < j) {
+        if (r->rec[k].tag == BPU_CAP_TPUSH) {
+            (void)bpu_push_event_keyed(bpu, r->rec[k].type, r->rec[k].key, &r->buf[r->rec[k].off], r->rec[k].len, r->rec[k].t_ms);
+        }
+        k++;
+    }
+
+    // The virtual link starts each tick with the free space the device saw
+    k = i + 1U;
+    while (k < j && r->rec[k].tag != BPU_CAP_FREE) {
+        k++;
+    }
+    if (k < j) {
+        r->link_free = (r->rec[k].rc == BPU_RC_OK) ? (size_t)r->rec[k].a : 0U;
+    }
+
+    r->io = i + 1U;
+    r->io_end = j;
+
+    (void)bpu_tick_ex(bpu, r->rec[i].t_ms, r->rec[i].a);
+
+    // Answers the replay did not ask for also mean it diverged
+    k = r->io;
+    while (r->link == 0 && k < j) {
+        if (r->rec[k].tag != BPU_CAP_TPUSH) {
+            r->diverge++;
+        }
+        k++;
+    }
+
+    return j;
+}
+
+// Print usage
+static void usage(void)
+{
+    fprintf(stderr, "usage: bpu_replay [-o out.bin] [-l] [-b budget] [-c chunk_max] [-m min_free] [-w coalesce_ms]\n"
+                    "                  [-a aged_ms] [-f enable_mask] capture.bin\n"
+                    "  -l        virtual link: replay the free space seen per tick, not each IO answer\n"
+                    "  -f mask   1=degrade 2=edf 4=preempt 8=admission\n"
+                    "  any config override implies -l\n");
+}
+
+int main(int argc, char **argv)
+{
+    static Bpu bpu;
+    Replay r;
+    BpuIo io;
+    BpuStats st;
+    FILE *in;
+    uint8_t *buf;
+    long flen;
+    long ov[6];
+    const char *out_path;
+    const char *in_path;
+    unsigned long pushes;
+    unsigned long ticks;
+    uint32_t t_first;
+    uint32_t t_last;
+    clock_t c0;
+    clock_t c1;
+    double wall_ms;
+    size_t i;
+    int argi;
+    int rc;
+
+    memset(&r, 0, sizeof(r));
+    out_path = NULL;
+    in_path = NULL;
+    buf = NULL;
+    pushes = 0UL;
+    ticks = 0UL;
+    t_first = 0U;
+    t_last = 0U;
+    rc = 0;
+
+    i = 0U;
+    while (i < 6U) {
+        ov[i] = -1L;
+        i++;
+    }
+
+    // -o and the config overrides take a value; overrides imply -l
+    argi = 1;
+    while (argi < argc && rc == 0) {
+        if (strcmp(argv[argi], "-l") == 0) {
+            r.link = 1;
+        } else {
+            if (argv[argi][0] == '-' && argv[argi][1] != '\0' && argv[argi][2] == '\0' && strchr("obcmwaf", argv[argi][1]) != NULL &&
+                argi + 1 < argc) {
+                if (argv[argi][1] == 'o') {
+                    out_path = argv[argi + 1];
+                } else {
+                    ov[strchr("bcmwaf", argv[argi][1]) - "bcmwaf"] = strtol(argv[argi + 1], NULL, 0);
+                    r.link = 1;
+                }
+                argi++;
+            } else {
+                if (argv[argi][0] != '-' && in_path == NULL) {
+                    in_path = argv[argi];
+                } else {
+                    rc = 1;
+                }
+            }
+        }
+        argi++;
+    }
+
+    if (rc != 0 || in_path == NULL) {
+        usage();
+        rc = 1;
+    }
+
+    if (rc == 0) {
+        in = fopen(in_path, "rb");
+        if (in == NULL) {
+            fprintf(stderr, "cannot open %s\n", in_path);
+            rc = 1;
+        } else {
+            flen = -1L;
+            if (fseek(in, 0L, SEEK_END) == 0) {
+                flen = ftell(in);
+            }
+            buf = (flen > 0L) ? (uint8_t *)malloc((size_t)flen) : NULL;
+            if (buf == NULL || fseek(in, 0L, SEEK_SET) != 0 || fread(buf, 1U, (size_t)flen, in) != (size_t)flen) {
+                fprintf(stderr, "cannot read %s\n", in_path);
+                rc = 1;
+            }
+            fclose(in);
+
+            r.buf = buf;
+            if (rc == 0 && parse_capture(&r, (size_t)flen) != BPU_RC_OK) {
+                rc = 1;
+            }
+        }
+    }
+
+    if (rc == 0 && (r.n == 0U || r.rec[0].tag != BPU_CAP_INIT)) {
+        fprintf(stderr, "capture does not start with an INIT record\n");
+        rc = 1;
+    }
+
+    if (rc == 0 && r.wire != (uint8_t)BPU_WIRE_VERSION) {
+        fprintf(stderr, "warning: captured with wire v%u, replaying with v%u\n", (unsigned)r.wire, (unsigned)BPU_WIRE_VERSION);
+    }
+
+    if (rc == 0 && out_path != NULL) {
+        r.out = fopen(out_path, "wb");
+        if (r.out == NULL) {
+            fprintf(stderr, "cannot open %s\n", out_path);
+            rc = 1;
+        }
+    }
+
+    if (rc == 0) {
+        if (ov[0] >= 0L) {
+            r.cfg.tx_budget_bytes = (uint16_t)ov[0];
+        }
+        if (ov[1] >= 0L) {
+            r.cfg.tx_chunk_max = (uint16_t)ov[1];
+        }
+        if (ov[2] >= 0L) {
+            r.cfg.tx_min_free = (uint16_t)ov[2];
+        }
+        if (ov[3] >= 0L) {
+            r.cfg.coalesce_window_ms = (uint16_t)ov[3];
+        }
+        if (ov[4] >= 0L) {
+            r.cfg.aged_ms = (uint16_t)ov[4];
+        }
+        if (ov[5] >= 0L) {
+            r.cfg.enable_degrade = (uint8_t)(ov[5] & 0x01L);
+            r.cfg.enable_edf = (uint8_t)((ov[5] >> 1) & 0x01L);
+            r.cfg.enable_preempt = (uint8_t)((ov[5] >> 2) & 0x01L);
+            r.cfg.enable_admission = (uint8_t)((ov[5] >> 3) & 0x01L);
+        }
+
+        io.ctx = &r;
+        io.tx_free = rp_tx_free;
+        io.tx_write_some = rp_tx_write_some;
+        // Only a device IO with time_us made TIME calls to answer
+        io.time_us = (r.has_time != 0U) ? rp_time_us : NULL;
+
+        (void)bpu_init(&bpu, &io, &r.cfg);
+
+        c0 = clock();
+        i = 1U;
+        while (i < r.n) {
+            const CapRec *c;
+
+            c = &r.rec[i];
+
+            if (c->tag == BPU_CAP_PUSH || c->tag == BPU_CAP_TICK) {
+                if (pushes == 0UL && ticks == 0UL) {
+                    t_first = c->t_ms;
+                }
+                t_last = c->t_ms;
+            }
+
+            if (c->tag == BPU_CAP_TICK) {
+                i = replay_tick(&r, &bpu, i);
+                ticks++;
+            } else {
+                if (c->tag == BPU_CAP_TYPE) {
+                    (void)bpu_register_type(&bpu, c->type, &r.desc[c->a]);
+                } else {
+                    if (c->tag == BPU_CAP_PUSH) {
+                        (void)bpu_push_event_keyed(&bpu, c->type, c->key, &r.buf[c->off], c->len, c->t_ms);
+                        pushes++;
+                    } else {
+                        // A second INIT or IO answers outside a tick cannot be replayed
+                        r.diverge++;
+                    }
+                }
+                i++;
+            }
+        }
+        c1 = clock();
+
+        wall_ms = 1000.0 * (double)(c1 - c0) / (double)CLOCKS_PER_SEC;
+
+        (void)bpu_get_stats(&bpu, &st);
+
+        printf("# mode=%s records=%lu pushes=%lu ticks=%lu out_bytes=%lu diverge=%lu\n", (r.link != 0) ? "link" : "exact",
+               (unsigned long)r.n, pushes, ticks, r.out_bytes, r.diverge);
+        printf("# cfg budget=%u chunk=%u min_free=%u coalesce=%u aged=%u degrade=%u edf=%u preempt=%u admission=%u\n",
+               (unsigned)r.cfg.tx_budget_bytes, (unsigned)r.cfg.tx_chunk_max, (unsigned)r.cfg.tx_min_free,
+               (unsigned)r.cfg.coalesce_window_ms, (unsigned)r.cfg.aged_ms, (unsigned)r.cfg.enable_degrade,
+               (unsigned)r.cfg.enable_edf, (unsigned)r.cfg.enable_preempt, (unsigned)r.cfg.enable_admission);
+        printf("sent=%lu bytes=%lu skipB=%lu skipTX=%lu ev_drop=%lu job_drop=%lu degrade_drop=%lu expired=%lu/%lu shed=%lu reject=%lu\n",
+               (unsigned long)st.tx_frame_sent, (unsigned long)st.tx_bytes, (unsigned long)st.tx_skip_budget,
+               (unsigned long)st.tx_skip_backpressure, (unsigned long)st.ev_drop, (unsigned long)st.job_drop,
+               (unsigned long)st.degrade_drop, (unsigned long)st.expired_ev, (unsigned long)st.expired_job, (unsigned long)st.shed,
+               (unsigned long)st.admit_reject);
+        printf("miss(cmd/sensor/hb/telem)=%lu/%lu/%lu/%lu level_up=%lu level_max_ms=%lu\n", (unsigned long)st.deadline_miss_cmd,
+               (unsigned long)st.deadline_miss_sensor, (unsigned long)st.deadline_miss_hb, (unsigned long)st.deadline_miss_telem,
+               (unsigned long)st.level_up, (unsigned long)st.level_ms[BPU_LEVEL_MAX]);
+        printf("# virtual=%lu ms wall=%.1f ms", (unsigned long)(t_last - t_first), wall_ms);
+        if (wall_ms > 0.0) {
+            printf(" speedup=%.0fx", (double)(t_last - t_first) / wall_ms);
+        }
+        printf("\n");
+
+        if (r.link == 0 && r.diverge != 0UL) {
+            fprintf(stderr, "warning: exact replay diverged %lu times (use -l for A/B runs)\n", r.diverge);
+        }
+    }
+
+    if (r.out != NULL) {
+        fclose(r.out);
+    }
+    free(r.rec);
+    free(r.desc);
+    free(r.fields);
+    free(buf);
+
+    return rc;
+}
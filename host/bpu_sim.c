@@ -0,0 +1,1390 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bpu_simlink.h"
+
+// Scenario runner: drives the real engine on a simulated UART in virtual
+// time and measures delivery at the receiver. Event payloads start with the
+// push time (u32 LE), so latency is rx_ms minus that stamp; job payloads
+// carry it after their [tag, len] prefix.
+
+#define SIM_TYPES 8U
+#define SIM_LAT_MAX 200000U
+
+// Latencies of one wire type and how many exceeded its deadline
+typedef struct {
+    uint32_t *lat;
+    size_t n;
+    unsigned long miss;
+    uint16_t deadline_ms;
+} SimLat;
+
+// Receiver side of one run
+typedef struct {
+    SimLat t[SIM_TYPES];
+} SimRx;
+
+// Scenario entry point
+typedef int (*SimFn)(void);
+
+typedef struct {
+    const char *name;
+    SimFn fn;
+    const char *what;
+} SimScenario;
+
+// Record one delivered frame against its push stamp
+static void sim_on_frame(void *ctx, const BpuWireFrame *f, uint32_t rx_ms)
+{
+    SimRx *rx;
+    SimLat *l;
+    uint32_t t;
+
+    rx = (SimRx *)ctx;
+
+    if (f->type < SIM_TYPES && f->len >= 6U) {
+        l = &rx->t[f->type];
+        t = (uint32_t)f->payload[2] | ((uint32_t)f->payload[3] << 8) | ((uint32_t)f->payload[4] << 16) | ((uint32_t)f->payload[5] << 24);
+
+        if (l->n < SIM_LAT_MAX) {
+            l->lat[l->n] = rx_ms - t;
+            l->n++;
+        }
+        if (l->deadline_ms != 0U && rx_ms - t > (uint32_t)l->deadline_ms) {
+            l->miss++;
+        }
+    }
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x;
+    uint32_t y;
+
+    x = *(const uint32_t *)a;
+    y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+// Percentile p (0..100) of a latency set (sorts it)
+static uint32_t sim_pct(SimLat *l, unsigned p)
+{
+    size_t i;
+
+    i = 0U;
+
+    if (l->n != 0U) {
+        qsort(l->lat, l->n, sizeof(l->lat[0]), cmp_u32);
+        i = (l->n * (size_t)p) / 100U;
+        if (i >= l->n) {
+            i = l->n - 1U;
+        }
+    }
+
+    return (l->n != 0U) ? l->lat[i] : 0U;
+}
+
+static int sim_rx_init(SimRx *rx)
+{
+    unsigned i;
+    int rc;
+
+    memset(rx, 0, sizeof(*rx));
+    rc = 0;
+
+    i = 0U;
+    while (i < SIM_TYPES) {
+        rx->t[i].lat = (uint32_t *)calloc(SIM_LAT_MAX, sizeof(uint32_t));
+        if (rx->t[i].lat == NULL) {
+            rc = 1;
+        }
+        i++;
+    }
+
+    return rc;
+}
+
+static void sim_rx_free(SimRx *rx)
+{
+    unsigned i;
+
+    i = 0U;
+    while (i < SIM_TYPES) {
+        free(rx->t[i].lat);
+        i++;
+    }
+}
+
+// Push one event stamped with now_ms; pad bytes follow the stamp
+static void sim_push(Bpu *bpu, uint8_t type, uint16_t key, uint16_t len, uint32_t now_ms)
+{
+    uint8_t p[16];
+    uint16_t i;
+
+    memset(p, 0, sizeof(p));
+    p[0] = (uint8_t)(now_ms & 0xFFU);
+    p[1] = (uint8_t)((now_ms >> 8) & 0xFFU);
+    p[2] = (uint8_t)((now_ms >> 16) & 0xFFU);
+    p[3] = (uint8_t)((now_ms >> 24) & 0xFFU);
+
+    i = 4U;
+    while (i < len) {
+        p[i] = (uint8_t)(key + i);
+        i++;
+    }
+
+    (void)bpu_push_event_keyed(bpu, type, key, p, len, now_ms);
+}
+
+// One run of the mixed-deadline load: 2 SENSOR keys every 20 ms (deadline
+// 10 ms), HB every 250 ms (50 ms), 16-byte TELEM every tick for 200 ms of
+// each second (100 ms), random CMDs (built-in CMD, no deadline).
+// 115200 baud, 10 ms ticks, 48 B/tick: the TELEM bursts overload the budget.
+static int sim_edf_run(uint8_t edf, SimRx *rx, BpuStats *st)
+{
+    static Bpu bpu;
+    static BpuSimLink link;
+    BpuTypeDesc d;
+    BpuConfig cfg;
+    BpuIo io;
+    uint32_t seed;
+    uint32_t t;
+    uint16_t k;
+    int rc;
+
+    rc = sim_rx_init(rx);
+    rx->t[BPU_JOB_SENSOR].deadline_ms = 10U;
+    rx->t[BPU_JOB_HB].deadline_ms = 50U;
+    rx->t[BPU_JOB_TELEM].deadline_ms = 100U;
+
+    bpu_simlink_init(&link, 256U, 11520U, sim_on_frame, rx);
+    bpu_simlink_io(&link, &io);
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tx_budget_bytes = 48U;
+    cfg.tx_min_free = 16U;
+    cfg.tx_chunk_max = 64U;
+    cfg.coalesce_window_ms = 20U;
+    cfg.aged_ms = 200U;
+    cfg.enable_edf = edf;
+
+    if (rc == 0 && bpu_init(&bpu, &io, &cfg) != BPU_RC_OK) {
+        rc = 1;
+    }
+
+    // Same descriptors as the built-ins, plus deadlines
+    memset(&d, 0, sizeof(d));
+    d.merge = BPU_MERGE_LAST;
+    d.job = BPU_JOB_SENSOR;
+    d.tag = 0x01U;
+    d.prio = BPU_PRIO_SENSOR;
+    d.deadline_ms = 10U;
+    rc |= bpu_register_type(&bpu, BPU_EVT_SENSOR, &d);
+    d.job = BPU_JOB_HB;
+    d.tag = 0x02U;
+    d.prio = BPU_PRIO_HB;
+    d.deadline_ms = 50U;
+    rc |= bpu_register_type(&bpu, BPU_EVT_HB, &d);
+    d.merge = BPU_MERGE_NONE;
+    d.job = BPU_JOB_TELEM;
+    d.tag = 0x03U;
+    d.prio = BPU_PRIO_TELEM;
+    d.deadline_ms = 100U;
+    rc |= bpu_register_type(&bpu, BPU_EVT_TELEM, &d);
+
+    seed = 0x2545F491U;
+    t = 0U;
+    while (rc == 0 && t < 60000U) {
+        k = (uint16_t)((t / 10U) % 2U);
+        sim_push(&bpu, BPU_EVT_SENSOR, k, 6U, t);
+        if (t % 250U == 0U) {
+            sim_push(&bpu, BPU_EVT_HB, 0U, 4U, t);
+        }
+        if (t % 1000U < 200U) {
+            sim_push(&bpu, BPU_EVT_TELEM, 0U, 16U, t);
+        }
+        if (bpu_sim_rand(&seed) % 20U == 0U) {
+            sim_push(&bpu, BPU_EVT_CMD, 0U, 8U, t);
+        }
+
+        (void)bpu_tick(&bpu, t);
+
+        t += 10U;
+        bpu_simlink_advance(&link, t);
+    }
+
+    bpu_simlink_advance(&link, t + 2000U);
+    (void)bpu_get_stats(&bpu, st);
+
+    return rc;
+}
+
+// FIFO vs EDF on the same traffic: deadline misses seen by the receiver
+// and counted by the engine, and CMD latency
+static int sim_edf(void)
+{
+    static const char *const names[SIM_TYPES] = { "", "cmd", "sensor", "hb", "telem", "", "", "" };
+    SimRx rx;
+    BpuStats st;
+    uint8_t edf;
+    uint8_t ty;
+    int rc;
+
+    rc = 0;
+
+    printf("%-5s %-7s %8s %8s %8s %8s %8s\n", "order", "type", "frames", "miss", "eng_miss", "p50_ms", "p99_ms");
+
+    edf = 0U;
+    while (rc == 0 && edf < 2U) {
+        rc = sim_edf_run(edf, &rx, &st);
+
+        ty = BPU_JOB_CMD;
+        while (rc == 0 && ty <= BPU_JOB_TELEM) {
+            uint32_t eng;
+
+            eng = st.deadline_miss_cmd;
+            if (ty == BPU_JOB_SENSOR) {
+                eng = st.deadline_miss_sensor;
+            } else {
+                if (ty == BPU_JOB_HB) {
+                    eng = st.deadline_miss_hb;
+                } else {
+                    if (ty == BPU_JOB_TELEM) {
+                        eng = st.deadline_miss_telem;
+                    }
+                }
+            }
+
+            printf("%-5s %-7s %8lu %8lu %8lu %8lu %8lu\n", (edf != 0U) ? "edf" : "fifo", names[ty], (unsigned long)rx.t[ty].n,
+                   rx.t[ty].miss, (unsigned long)eng, (unsigned long)sim_pct(&rx.t[ty], 50U), (unsigned long)sim_pct(&rx.t[ty], 99U));
+            ty++;
+        }
+
+        sim_rx_free(&rx);
+        edf++;
+    }
+
+    return rc;
+}
+
+// One run of the saturated-link load: a 16-byte TELEM every tick (no
+// merging) and a SENSOR every 20 ms keep a 800 B/s link full, so most
+// frames leave over several ticks; random CMDs arrive about once a second.
+// The 16-byte TX FIFO makes every frame longer than it go out in parts.
+static int sim_preempt_run(uint8_t preempt, uint8_t edf, SimRx *rx, BpuStats *st)
+{
+    static Bpu bpu;
+    static BpuSimLink link;
+    BpuConfig cfg;
+    BpuIo io;
+    uint32_t seed;
+    uint32_t t;
+    int rc;
+
+    rc = sim_rx_init(rx);
+
+    bpu_simlink_init(&link, 16U, 800U, sim_on_frame, rx);
+    bpu_simlink_io(&link, &io);
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tx_budget_bytes = 64U;
+    cfg.tx_min_free = 4U;
+    cfg.tx_chunk_max = 64U;
+    cfg.coalesce_window_ms = 20U;
+    cfg.aged_ms = 200U;
+    cfg.enable_edf = edf;
+    cfg.enable_preempt = preempt;
+
+    if (rc == 0 && bpu_init(&bpu, &io, &cfg) != BPU_RC_OK) {
+        rc = 1;
+    }
+
+    seed = 0x6B43A9B5U;
+    t = 0U;
+    while (rc == 0 && t < 120000U) {
+        if (t % 20U == 0U) {
+            sim_push(&bpu, BPU_EVT_SENSOR, 0U, 6U, t);
+        }
+        sim_push(&bpu, BPU_EVT_TELEM, 0U, 16U, t);
+        if (bpu_sim_rand(&seed) % 100U == 0U) {
+            sim_push(&bpu, BPU_EVT_CMD, 0U, 8U, t);
+        }
+
+        (void)bpu_tick(&bpu, t);
+
+        t += 10U;
+        bpu_simlink_advance(&link, t);
+    }
+
+    bpu_simlink_advance(&link, t + 2000U);
+    (void)bpu_get_stats(&bpu, st);
+
+    return rc;
+}
+
+#define SIM_PB_ROUNDS 40U
+
+// SENSOR values seen by the receiver of the put-back check
+typedef struct {
+    uint8_t old_val;
+    uint8_t last;
+    uint8_t cmd_seen;
+    uint8_t old_after_cmd;
+} SimPutBack;
+
+static void sim_on_put_back(void *ctx, const BpuWireFrame *f, uint32_t rx_ms)
+{
+    SimPutBack *pb;
+
+    pb = (SimPutBack *)ctx;
+    (void)rx_ms;
+
+    if (f->type == BPU_JOB_CMD) {
+        pb->cmd_seen = 1U;
+    } else {
+        if (f->type == BPU_JOB_SENSOR && f->len >= 3U) {
+            pb->last = f->payload[2];
+            if (pb->cmd_seen != 0U && pb->last == pb->old_val) {
+                pb->old_after_cmd = 1U;
+            }
+        }
+    }
+}
+
+// A SENSOR value is cut by a CMD. In even rounds a newer value of the same
+// key arrives with the CMD: the receiver must end on the newer value and
+// never see the old one after the CMD. In odd rounds the CMD comes with
+// three TELEM keys that fill the job queue: the old value must still be
+// sent again after the CMD
+static int sim_preempt_put_back(uint8_t edf, unsigned *bad_out, BpuStats *st)
+{
+    static Bpu bpu;
+    static BpuSimLink link;
+    static SimPutBack pb;
+    BpuConfig cfg;
+    BpuIo io;
+    uint8_t p[16];
+    uint32_t t;
+    uint32_t end;
+    unsigned r;
+    uint16_t k;
+    int rc;
+
+    rc = 0;
+    *bad_out = 0U;
+
+    bpu_simlink_init(&link, 16U, 800U, sim_on_put_back, &pb);
+    bpu_simlink_io(&link, &io);
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tx_budget_bytes = 64U;
+    cfg.tx_min_free = 4U;
+    cfg.tx_chunk_max = 64U;
+    cfg.aged_ms = 200U;
+    cfg.enable_edf = edf;
+    cfg.enable_preempt = 1U;
+
+    if (bpu_init(&bpu, &io, &cfg) != BPU_RC_OK) {
+        rc = 1;
+    }
+
+    t = 0U;
+    r = 0U;
+    while (rc == 0 && r < SIM_PB_ROUNDS) {
+        memset(&pb, 0, sizeof(pb));
+        pb.old_val = (uint8_t)(2U * r + 1U);
+
+        // The old value is partly on the wire after this tick
+        memset(p, pb.old_val, sizeof(p));
+        (void)bpu_push_event(&bpu, BPU_EVT_SENSOR, p, (uint16_t)sizeof(p), t);
+        (void)bpu_tick(&bpu, t);
+        t += 10U;
+        bpu_simlink_advance(&link, t);
+
+        if ((r & 1U) == 0U) {
+            memset(p, pb.old_val + 1U, sizeof(p));
+            (void)bpu_push_event(&bpu, BPU_EVT_SENSOR, p, (uint16_t)sizeof(p), t);
+            memset(p, 0xC0U, 8U);
+            (void)bpu_push_event(&bpu, BPU_EVT_CMD, p, 8U, t);
+        } else {
+            memset(p, 0xC0U, 8U);
+            (void)bpu_push_event(&bpu, BPU_EVT_CMD, p, 8U, t);
+            k = 1U;
+            while (k <= 3U) {
+                (void)bpu_push_event_keyed(&bpu, BPU_EVT_TELEM, k, p, 4U, t);
+                k++;
+            }
+        }
+
+        end = t + 600U;
+        while (t < end) {
+            (void)bpu_tick(&bpu, t);
+            t += 10U;
+            bpu_simlink_advance(&link, t);
+        }
+
+        if ((r & 1U) == 0U) {
+            if (pb.last != (uint8_t)(pb.old_val + 1U) || pb.old_after_cmd != 0U) {
+                (*bad_out)++;
+            }
+        } else {
+            if (pb.old_after_cmd == 0U) {
+                (*bad_out)++;
+            }
+        }
+        r++;
+    }
+
+    (void)bpu_get_stats(&bpu, st);
+
+    return rc;
+}
+
+// CMD latency on a saturated link with preemption off and on, FIFO and
+// EDF, then the put-back check
+static int sim_preempt(void)
+{
+    SimRx rx;
+    BpuStats st;
+    unsigned bad;
+    uint8_t run;
+    int rc;
+
+    rc = 0;
+    bad = 0U;
+
+    printf("%-5s %-7s %6s %8s %8s %8s %8s %10s\n", "order", "preempt", "cmds", "p50_ms", "p99_ms", "max_ms", "aborts", "cut_bytes");
+
+    run = 0U;
+    while (rc == 0 && run < 4U) {
+        rc = sim_preempt_run((uint8_t)(run & 1U), (uint8_t)(run >> 1), &rx, &st);
+
+        if (rc == 0) {
+            printf("%-5s %-7s %6lu %8lu %8lu %8lu %8lu %10lu\n", ((run >> 1) != 0U) ? "edf" : "fifo", ((run & 1U) != 0U) ? "on" : "off",
+                   (unsigned long)rx.t[BPU_JOB_CMD].n, (unsigned long)sim_pct(&rx.t[BPU_JOB_CMD], 50U), (unsigned long)sim_pct(&rx.t[BPU_JOB_CMD], 99U),
+                   (unsigned long)sim_pct(&rx.t[BPU_JOB_CMD], 100U), (unsigned long)st.preempt_abort, (unsigned long)st.preempt_bytes);
+        }
+
+        sim_rx_free(&rx);
+        run++;
+    }
+
+    printf("%-5s %8s %8s %8s\n", "order", "rounds", "aborts", "bad");
+
+    run = 0U;
+    while (rc == 0 && run < 2U) {
+        rc = sim_preempt_put_back(run, &bad, &st);
+
+        printf("%-5s %8u %8lu %8u\n", (run != 0U) ? "edf" : "fifo", SIM_PB_ROUNDS, (unsigned long)st.preempt_abort, bad);
+
+        if (rc == 0 && (bad != 0U || st.preempt_abort < SIM_PB_ROUNDS)) {
+            fprintf(stderr, "preempt: an aborted job replaced a newer value or was lost\n");
+            rc = 1;
+        }
+        run++;
+    }
+
+    return rc;
+}
+
+#define SIM_TTL_MS 200U
+#define SIM_STALL_FROM 5000U
+#define SIM_STALL_TO 8000U
+#define SIM_TTL_FIFO 32U
+#define SIM_TTL_BPS 500U
+#define SIM_TTL_EVERY 50U
+
+// Receiver of the ttl scenario: what arrived after the stall ended
+typedef struct {
+    uint32_t first_fresh;
+    unsigned long stale;
+    unsigned long fresh;
+} SimTtl;
+
+// A SENSOR or HB frame is fresh if it is at most SIM_TTL_MS old on arrival
+static void sim_on_ttl_frame(void *ctx, const BpuWireFrame *f, uint32_t rx_ms)
+{
+    SimTtl *tt;
+    uint32_t t;
+
+    tt = (SimTtl *)ctx;
+
+    if ((f->type == BPU_JOB_SENSOR || f->type == BPU_JOB_HB) && f->len >= 6U && rx_ms >= SIM_STALL_TO) {
+        t = (uint32_t)f->payload[2] | ((uint32_t)f->payload[3] << 8) | ((uint32_t)f->payload[4] << 16) | ((uint32_t)f->payload[5] << 24);
+
+        if (rx_ms - t > SIM_TTL_MS) {
+            tt->stale++;
+        } else {
+            if (tt->fresh == 0UL) {
+                tt->first_fresh = rx_ms;
+            }
+            tt->fresh++;
+        }
+    }
+}
+
+// One run of the stall load: a SENSOR sample every 50 ms (not merged, so
+// every sample is a job) and a merged HB every 250 ms on a 500 B/s link.
+// The link stalls for 3 s; the job queue keeps the samples it took in
+// before it filled up
+static int sim_ttl_run(uint16_t ttl_ms, SimTtl *tt, BpuStats *st)
+{
+    static Bpu bpu;
+    static BpuSimLink link;
+    BpuTypeDesc d;
+    BpuConfig cfg;
+    BpuIo io;
+    uint32_t t;
+    int rc;
+
+    rc = 0;
+    memset(tt, 0, sizeof(*tt));
+
+    bpu_simlink_init(&link, SIM_TTL_FIFO, SIM_TTL_BPS, sim_on_ttl_frame, tt);
+    bpu_simlink_io(&link, &io);
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tx_budget_bytes = 48U;
+    cfg.tx_min_free = 4U;
+    cfg.tx_chunk_max = 64U;
+    cfg.aged_ms = 200U;
+
+    if (bpu_init(&bpu, &io, &cfg) != BPU_RC_OK) {
+        rc = 1;
+    }
+
+    memset(&d, 0, sizeof(d));
+    d.merge = BPU_MERGE_NONE;
+    d.job = BPU_JOB_SENSOR;
+    d.tag = 0x01U;
+    d.prio = BPU_PRIO_SENSOR;
+    d.ttl_ms = ttl_ms;
+    rc |= bpu_register_type(&bpu, BPU_EVT_SENSOR, &d);
+    d.merge = BPU_MERGE_LAST;
+    d.job = BPU_JOB_HB;
+    d.tag = 0x02U;
+    d.prio = BPU_PRIO_HB;
+    rc |= bpu_register_type(&bpu, BPU_EVT_HB, &d);
+
+    t = 0U;
+    while (rc == 0 && t < 12000U) {
+        link.stalled = (t >= SIM_STALL_FROM && t < SIM_STALL_TO) ? 1 : 0;
+
+        if (t % SIM_TTL_EVERY == 0U) {
+            sim_push(&bpu, BPU_EVT_SENSOR, 0U, 8U, t);
+        }
+        if (t % 250U == 0U) {
+            sim_push(&bpu, BPU_EVT_HB, 0U, 4U, t);
+        }
+
+        (void)bpu_tick(&bpu, t);
+
+        t += 10U;
+        bpu_simlink_advance(&link, t);
+    }
+
+    bpu_simlink_advance(&link, t + 1000U);
+    (void)bpu_get_stats(&bpu, st);
+
+    return rc;
+}
+
+// Recovery after a 3 s stall with TTL off and on: time to the first fresh
+// SENSOR/HB frame and stale frames sent after the link came back
+static int sim_ttl(void)
+{
+    SimTtl tt;
+    BpuStats st;
+    uint32_t rec[2];
+    uint8_t run;
+    int rc;
+
+    rc = 0;
+    rec[0] = 0U;
+    rec[1] = 0U;
+
+    printf("%-4s %12s %8s %8s %10s %11s\n", "ttl", "recovery_ms", "stale", "fresh", "expired_ev", "expired_job");
+
+    run = 0U;
+    while (rc == 0 && run < 2U) {
+        rc = sim_ttl_run((run != 0U) ? (uint16_t)SIM_TTL_MS : 0U, &tt, &st);
+
+        if (rc == 0 && tt.fresh == 0UL) {
+            fprintf(stderr, "ttl: no fresh frame after the stall\n");
+            rc = 1;
+        }
+        rec[run] = tt.first_fresh - SIM_STALL_TO;
+
+        printf("%-4s %12lu %8lu %8lu %10lu %11lu\n", (run != 0U) ? "on" : "off", (unsigned long)rec[run], tt.stale, tt.fresh,
+               (unsigned long)st.expired_ev, (unsigned long)st.expired_job);
+        run++;
+    }
+
+    if (rc == 0 && rec[1] >= rec[0]) {
+        fprintf(stderr, "ttl: recovery with TTL is not faster\n");
+        rc = 1;
+    }
+
+    return rc;
+}
+
+#define SIM_SAMPLES 1000U
+
+// Samples seen by the receiver of the batch scenario
+typedef struct {
+    int32_t v[SIM_SAMPLES];
+    size_t n;
+    unsigned long mismatch;
+    const int32_t *sent;
+} SimSamples;
+
+// Expand a frame into samples (a batch frame or one plain U16 sample) and
+// compare them with what was pushed
+static void sim_on_samples(void *ctx, const BpuWireFrame *f, uint32_t rx_ms)
+{
+    SimSamples *ss;
+    BpuWireSample s[64];
+    size_t n;
+    size_t i;
+
+    ss = (SimSamples *)ctx;
+    (void)rx_ms;
+    n = 0U;
+
+    if (f->len >= 2U && f->payload[0] == BPU_WIRE_TAG_SENSOR_BATCH) {
+        if (bpu_wire_batch_decode(&f->payload[2], (size_t)f->payload[1], s, 64U, &n) != BPU_WIRE_OK) {
+            n = 0U;
+            ss->mismatch++;
+        }
+    } else {
+        if (f->len >= 4U) {
+            s[0].v = (int32_t)((uint32_t)f->payload[2] | ((uint32_t)f->payload[3] << 8));
+            n = 1U;
+        }
+    }
+
+    i = 0U;
+    while (i < n) {
+        if (ss->n >= SIM_SAMPLES || s[i].v != ss->sent[ss->n]) {
+            ss->mismatch++;
+        } else {
+            ss->n++;
+        }
+        i++;
+    }
+}
+
+// Bytes per sample for a slowly varying 10 ms channel (random walk of
+// +-3 around 1000), one frame per sample vs SENSOR_BATCH
+static int sim_batch(void)
+{
+    static Bpu bpu;
+    static BpuSimLink link;
+    static SimSamples ss;
+    static int32_t sent[SIM_SAMPLES];
+    BpuTypeDesc d;
+    BpuConfig cfg;
+    BpuIo io;
+    uint32_t seed;
+    uint32_t i;
+    uint8_t batched;
+    uint8_t p[2];
+    int32_t v;
+    int rc;
+
+    rc = 0;
+
+    seed = 0x0BADF00DU;
+    v = 1000;
+    i = 0U;
+    while (i < SIM_SAMPLES) {
+        v += (int32_t)(bpu_sim_rand(&seed) % 7U) - 3;
+        sent[i] = v;
+        i++;
+    }
+
+    printf("# wire v%u, %u samples\n", (unsigned)BPU_WIRE_VERSION, SIM_SAMPLES);
+    printf("%-8s %8s %8s %8s %12s %8s\n", "path", "samples", "frames", "bytes", "bytes/sample", "errors");
+
+    batched = 0U;
+    while (rc == 0 && batched < 2U) {
+        memset(&ss, 0, sizeof(ss));
+        ss.sent = sent;
+
+        bpu_simlink_init(&link, 256U, 11520U, sim_on_samples, &ss);
+        bpu_simlink_io(&link, &io);
+
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.tx_budget_bytes = 64U;
+        cfg.tx_min_free = 16U;
+        cfg.tx_chunk_max = 64U;
+        cfg.aged_ms = 200U;
+
+        if (bpu_init(&bpu, &io, &cfg) != BPU_RC_OK) {
+            rc = 1;
+        }
+
+        // Per-frame path: built-in SENSOR without coalescing, so no sample is lost
+        memset(&d, 0, sizeof(d));
+        d.merge = BPU_MERGE_NONE;
+        d.job = BPU_JOB_SENSOR;
+        d.tag = 0x01U;
+        d.prio = BPU_PRIO_SENSOR;
+        rc |= bpu_register_type(&bpu, BPU_EVT_SENSOR, &d);
+
+        i = 0U;
+        while (rc == 0 && i < SIM_SAMPLES) {
+            p[0] = (uint8_t)((uint32_t)sent[i] & 0xFFU);
+            p[1] = (uint8_t)(((uint32_t)sent[i] >> 8) & 0xFFU);
+            (void)bpu_push_event(&bpu, (batched != 0U) ? BPU_EVT_SENSOR_BATCH : BPU_EVT_SENSOR, p, 2U, i * 10U);
+            (void)bpu_tick(&bpu, i * 10U);
+            bpu_simlink_advance(&link, (i + 1U) * 10U);
+            i++;
+        }
+
+        // Let the last batch reach its hold time
+        while (rc == 0 && i < SIM_SAMPLES + 100U) {
+            (void)bpu_tick(&bpu, i * 10U);
+            bpu_simlink_advance(&link, (i + 1U) * 10U);
+            i++;
+        }
+
+        printf("%-8s %8lu %8lu %8lu %12.2f %8lu\n", (batched != 0U) ? "batch" : "frame", (unsigned long)ss.n, link.frames, link.bytes,
+               (ss.n != 0U) ? (double)link.bytes / (double)ss.n : 0.0, ss.mismatch + link.bad);
+
+        if (ss.n != SIM_SAMPLES || ss.mismatch != 0UL || link.bad != 0UL) {
+            fprintf(stderr, "batch: samples lost or changed\n");
+            rc = 1;
+        }
+        batched++;
+    }
+
+    return rc;
+}
+
+#define SIM_OC_TYPE 9U
+#define SIM_OC_VALUES 20U
+
+// On-change frames seen by the receiver, by value
+typedef struct {
+    unsigned long got[SIM_OC_VALUES];
+    unsigned long cmds;
+} SimOnChange;
+
+static void sim_on_change_frame(void *ctx, const BpuWireFrame *f, uint32_t rx_ms)
+{
+    SimOnChange *oc;
+
+    oc = (SimOnChange *)ctx;
+    (void)rx_ms;
+
+    if (f->len >= 3U && f->payload[0] == (uint8_t)SIM_OC_TYPE && f->payload[2] < SIM_OC_VALUES) {
+        oc->got[f->payload[2]]++;
+    } else {
+        if (f->len >= 1U && f->payload[0] == 0x04U) {
+            oc->cmds++;
+        }
+    }
+}
+
+// An on-change value whose frame is cut by a CMD must still be delivered
+// once it is resent, and a repeat of the delivered value must be suppressed
+static int sim_onchange(void)
+{
+    static Bpu bpu;
+    static BpuSimLink link;
+    static SimOnChange oc;
+    BpuTypeDesc d;
+    BpuConfig cfg;
+    BpuStats st;
+    BpuIo io;
+    uint8_t p[20];
+    uint32_t t;
+    uint32_t end;
+    uint8_t v;
+    int rc;
+
+    rc = 0;
+    memset(&oc, 0, sizeof(oc));
+
+    bpu_simlink_init(&link, 16U, 800U, sim_on_change_frame, &oc);
+    bpu_simlink_io(&link, &io);
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tx_budget_bytes = 64U;
+    cfg.tx_min_free = 4U;
+    cfg.tx_chunk_max = 64U;
+    cfg.aged_ms = 200U;
+    cfg.enable_preempt = 1U;
+
+    if (bpu_init(&bpu, &io, &cfg) != BPU_RC_OK) {
+        rc = 1;
+    }
+
+    memset(&d, 0, sizeof(d));
+    d.merge = BPU_MERGE_LAST;
+    d.job = SIM_OC_TYPE;
+    d.tag = SIM_OC_TYPE;
+    d.prio = BPU_PRIO_SENSOR;
+    d.flags = BPU_TF_ON_CHANGE;
+    rc |= bpu_register_type(&bpu, SIM_OC_TYPE, &d);
+
+    t = 0U;
+    v = 0U;
+    while (rc == 0 && v < SIM_OC_VALUES) {
+        // New value, then a CMD while its frame is still on the way out
+        memset(p, v, sizeof(p));
+        (void)bpu_push_event(&bpu, SIM_OC_TYPE, p, (uint16_t)sizeof(p), t);
+        (void)bpu_tick(&bpu, t);
+        t += 10U;
+        bpu_simlink_advance(&link, t);
+
+        memset(p, 0xC0U, 8U);
+        (void)bpu_push_event(&bpu, BPU_EVT_CMD, p, 8U, t);
+
+        // The same value again once everything is out
+        end = t + 500U;
+        while (t < end) {
+            if (t + 250U == end) {
+                memset(p, v, sizeof(p));
+                (void)bpu_push_event(&bpu, SIM_OC_TYPE, p, (uint16_t)sizeof(p), t);
+            }
+            (void)bpu_tick(&bpu, t);
+            t += 10U;
+            bpu_simlink_advance(&link, t);
+        }
+        v++;
+    }
+
+    (void)bpu_get_stats(&bpu, &st);
+
+    printf("%8s %8s %8s %8s %10s\n", "values", "cmds", "aborts", "missing", "suppressed");
+
+    end = 0U;
+    v = 0U;
+    while (v < SIM_OC_VALUES) {
+        if (oc.got[v] != 1UL) {
+            end++;
+        }
+        v++;
+    }
+
+    printf("%8u %8lu %8lu %8lu %10lu\n", SIM_OC_VALUES, oc.cmds, (unsigned long)st.preempt_abort, (unsigned long)end, (unsigned long)st.suppressed);
+
+    if (end != 0U || oc.cmds != SIM_OC_VALUES || st.preempt_abort == 0U) {
+        fprintf(stderr, "onchange: aborted values were not resent exactly once\n");
+        rc = 1;
+    }
+
+    return rc;
+}
+
+#define SIM_BLOB_LEN (256UL * 1024UL)
+
+// Blob source and receiver for the bulk scenario
+typedef struct {
+    SimRx *rx;
+    uint8_t *src;
+    uint8_t *dst;
+    uint8_t *have;
+    unsigned long frags;
+    unsigned long bad;
+    uint32_t done_ms;
+} SimBlob;
+
+static int sim_blob_pull(void *ctx, uint32_t offset, uint8_t *buf, uint16_t max, uint16_t *got_out)
+{
+    SimBlob *b;
+    uint32_t n;
+
+    b = (SimBlob *)ctx;
+    n = (uint32_t)max;
+    if (n > SIM_BLOB_LEN - offset) {
+        n = (uint32_t)(SIM_BLOB_LEN - offset);
+    }
+
+    memcpy(buf, &b->src[offset], n);
+    *got_out = (uint16_t)n;
+
+    return BPU_RC_OK;
+}
+
+// Write bulk fragments at their offsets; everything else goes to the
+// latency receiver
+static void sim_on_blob(void *ctx, const BpuWireFrame *f, uint32_t rx_ms)
+{
+    SimBlob *b;
+    BpuWireBulk frag;
+
+    b = (SimBlob *)ctx;
+
+    if (f->type == BPU_JOB_BULK) {
+        if (bpu_wire_bulk_parse(f, &frag) != BPU_WIRE_OK || (unsigned long)frag.off + frag.n > SIM_BLOB_LEN) {
+            b->bad++;
+        } else {
+            memcpy(&b->dst[frag.off], frag.data, frag.n);
+            memset(&b->have[frag.off], 1, frag.n);
+            b->frags++;
+            if ((frag.flags & BPU_BULK_F_LAST) != 0U) {
+                b->done_ms = rx_ms;
+            }
+        }
+    } else {
+        sim_on_frame(b->rx, f, rx_ms);
+    }
+}
+
+// One run of SENSOR every 20 ms and TELEM every 100 ms at 115200 baud
+// (128 B/tick budget), optionally with a 256 KiB blob started at 1 s, and a
+// 500 ms TX stall at 5 s
+static int sim_bulk_run(uint8_t with_blob, SimBlob *b, BpuStats *st)
+{
+    static Bpu bpu;
+    static BpuSimLink link;
+    BpuConfig cfg;
+    BpuIo io;
+    uint32_t t;
+    int rc;
+
+    rc = 0;
+
+    bpu_simlink_init(&link, 256U, 11520U, sim_on_blob, b);
+    bpu_simlink_io(&link, &io);
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tx_budget_bytes = 128U;
+    cfg.tx_min_free = 16U;
+    cfg.tx_chunk_max = 128U;
+    cfg.aged_ms = 200U;
+
+    if (bpu_init(&bpu, &io, &cfg) != BPU_RC_OK) {
+        rc = 1;
+    }
+
+    t = 0U;
+    while (rc == 0 && t < 60000U) {
+        if (with_blob != 0U && t == 1000U) {
+            rc = bpu_bulk_start(&bpu, 1U, (uint32_t)SIM_BLOB_LEN, sim_blob_pull, b);
+        }
+        link.stalled = (t >= 5000U && t < 5500U) ? 1 : 0;
+
+        if (t % 20U == 0U) {
+            sim_push(&bpu, BPU_EVT_SENSOR, 0U, 8U, t);
+        }
+        if (t % 100U == 0U) {
+            sim_push(&bpu, BPU_EVT_TELEM, 0U, 16U, t);
+        }
+
+        (void)bpu_tick(&bpu, t);
+
+        t += 10U;
+        bpu_simlink_advance(&link, t);
+    }
+
+    bpu_simlink_advance(&link, t + 1000U);
+    (void)bpu_get_stats(&bpu, st);
+
+    return rc;
+}
+
+// A large blob on the bulk lane next to real-time traffic: goodput against
+// the link rate, SENSOR latency with and without it, byte-exact reassembly
+static int sim_bulk(void)
+{
+    static SimBlob b;
+    SimRx rx;
+    BpuStats st;
+    uint32_t seed;
+    unsigned long i;
+    unsigned long missing;
+    uint8_t run;
+    int rc;
+
+    memset(&b, 0, sizeof(b));
+    b.rx = &rx;
+    b.src = (uint8_t *)malloc(SIM_BLOB_LEN);
+    b.dst = (uint8_t *)calloc(SIM_BLOB_LEN, 1U);
+    b.have = (uint8_t *)calloc(SIM_BLOB_LEN, 1U);
+    rc = (b.src == NULL || b.dst == NULL || b.have == NULL) ? 1 : 0;
+
+    seed = 0x5EEDB10BU;
+    i = 0UL;
+    while (rc == 0 && i < SIM_BLOB_LEN) {
+        b.src[i] = (uint8_t)bpu_sim_rand(&seed);
+        i++;
+    }
+
+    printf("%-5s %8s %8s %8s %8s %8s %9s %8s %9s %6s\n", "blob", "sensor", "p50_ms", "p99_ms", "max_ms", "frags", "avg_frag", "done_s", "goodput", "link");
+
+    run = 0U;
+    while (rc == 0 && run < 2U) {
+        rc = sim_rx_init(&rx);
+        if (rc == 0) {
+            rc = sim_bulk_run(run, &b, &st);
+        }
+
+        if (rc == 0) {
+            if (run == 0U) {
+                printf("%-5s %8lu %8lu %8lu %8lu %8s %9s %8s %9s %6s\n", "off", (unsigned long)rx.t[BPU_JOB_SENSOR].n,
+                       (unsigned long)sim_pct(&rx.t[BPU_JOB_SENSOR], 50U), (unsigned long)sim_pct(&rx.t[BPU_JOB_SENSOR], 99U),
+                       (unsigned long)sim_pct(&rx.t[BPU_JOB_SENSOR], 100U), "-", "-", "-", "-", "-");
+            } else {
+                missing = 0UL;
+                i = 0UL;
+                while (i < SIM_BLOB_LEN) {
+                    if (b.have[i] == 0U || b.dst[i] != b.src[i]) {
+                        missing++;
+                    }
+                    i++;
+                }
+
+                // Goodput over the transfer time, also as a share of the 11520 B/s link
+                printf("%-5s %8lu %8lu %8lu %8lu %8lu %9.1f %8.1f %7.0f/s %5.0f%%\n", "256K", (unsigned long)rx.t[BPU_JOB_SENSOR].n,
+                       (unsigned long)sim_pct(&rx.t[BPU_JOB_SENSOR], 50U), (unsigned long)sim_pct(&rx.t[BPU_JOB_SENSOR], 99U),
+                       (unsigned long)sim_pct(&rx.t[BPU_JOB_SENSOR], 100U), b.frags, (double)SIM_BLOB_LEN / (double)b.frags,
+                       (double)(b.done_ms - 1000U) / 1000.0, (double)SIM_BLOB_LEN * 1000.0 / (double)(b.done_ms - 1000U),
+                       100.0 * (double)SIM_BLOB_LEN / ((double)(b.done_ms - 1000U) * 11.52));
+
+                if (missing != 0UL || b.bad != 0UL || b.done_ms == 0U || st.bulk_done != 1U) {
+                    fprintf(stderr, "bulk: blob not reassembled (%lu bytes missing or wrong)\n", missing);
+                    rc = 1;
+                }
+            }
+        }
+
+        sim_rx_free(&rx);
+        run++;
+    }
+
+    free(b.src);
+    free(b.dst);
+    free(b.have);
+
+    return rc;
+}
+
+#define SIM_SPILL_TYPE 10U
+#define SIM_SPILL_SEGS 32U
+#define SIM_SPILL_SEG_SIZE 4096U
+#define SIM_SPILL_RECS 18000U
+
+#define SIM_SPILL_FORGED 0xC0U
+
+// RAM flash for the spill scenario; erases fail while now_ms is in
+// [fail_from_ms, fail_to_ms). With forge set, the first record written gets
+// type SIM_SPILL_FORGED and a matching CRC
+typedef struct {
+    uint8_t mem[SIM_SPILL_SEGS][SIM_SPILL_SEG_SIZE];
+    unsigned long erase_fail;
+    uint32_t now_ms;
+    uint32_t fail_from_ms;
+    uint32_t fail_to_ms;
+    uint8_t forge;
+} SimFlash;
+
+// Receiver of the spill scenario: how often each record arrived
+typedef struct {
+    SimRx *rx;
+    uint8_t seen[SIM_SPILL_RECS];
+    unsigned long dup;
+    unsigned long forged;
+} SimSpillRx;
+
+static int sim_flash_read(void *ctx, uint16_t seg, uint32_t off, uint8_t *p, size_t len)
+{
+    memcpy(p, &((SimFlash *)ctx)->mem[seg][off], len);
+
+    return BPU_RC_OK;
+}
+
+// Flash semantics: a write can only clear bits of an erased segment
+static int sim_flash_write(void *ctx, uint16_t seg, uint32_t off, const uint8_t *p, size_t len)
+{
+    SimFlash *fl;
+    uint8_t *r;
+    size_t size;
+    size_t i;
+
+    fl = (SimFlash *)ctx;
+
+    i = 0U;
+    while (i < len) {
+        fl->mem[seg][off + i] &= p[i];
+        i++;
+    }
+
+    // A record that passes its CRC but names a type past the table
+    if (fl->forge != 0U && len >= 12U) {
+        r = &fl->mem[seg][off];
+        size = (size_t)r[10] + 12U;
+        if (size <= len) {
+            r[1] = SIM_SPILL_FORGED;
+            r[size - 1U] = bpu_wire_crc8(r, size - 1U);
+        }
+        fl->forge = 0U;
+    }
+
+    return BPU_RC_OK;
+}
+
+static int sim_flash_erase(void *ctx, uint16_t seg)
+{
+    SimFlash *fl;
+    int rc;
+
+    fl = (SimFlash *)ctx;
+    rc = BPU_RC_OK;
+
+    if (fl->now_ms >= fl->fail_from_ms && fl->now_ms < fl->fail_to_ms) {
+        fl->erase_fail++;
+        rc = BPU_RC_ERR;
+    } else {
+        memset(fl->mem[seg], 0xFF, SIM_SPILL_SEG_SIZE);
+    }
+
+    return rc;
+}
+
+static void sim_on_spill_frame(void *ctx, const BpuWireFrame *f, uint32_t rx_ms)
+{
+    SimSpillRx *sr;
+    uint32_t n;
+
+    sr = (SimSpillRx *)ctx;
+
+    if (f->type == SIM_SPILL_FORGED) {
+        sr->forged++;
+    }
+    if (f->type == SIM_SPILL_TYPE && f->len >= 10U) {
+        n = (uint32_t)f->payload[6] | ((uint32_t)f->payload[7] << 8) | ((uint32_t)f->payload[8] << 16) | ((uint32_t)f->payload[9] << 24);
+        if (n < SIM_SPILL_RECS) {
+            if (sr->seen[n] != 0U) {
+                sr->dup++;
+            }
+            sr->seen[n] = 1U;
+        }
+    }
+    sim_on_frame(sr->rx, f, rx_ms);
+}
+
+// One run: a numbered spill type in bursts of 6 every 100 ms (more than the
+// job queue takes, so it spills and replays all the time) next to
+// SENSOR/TELEM load, the link down for 60 s twice (5..65 s, 125..185 s) so
+// the log wraps around its 32 x 4 KiB segments. faulty 1: every erase
+// fails for 10 s while the second backlog drains; faulty 2: the first
+// record in flash is forged. drained_ms is when the first outage's backlog
+// was fully replayed
+static int sim_spill_run(uint8_t faulty, SimSpillRx *sr, SimFlash *fl, BpuStats *st, uint32_t *drained_ms)
+{
+    static Bpu bpu;
+    static BpuSimLink link;
+    BpuTypeDesc d;
+    BpuSpillIo sio;
+    BpuConfig cfg;
+    BpuIo io;
+    uint8_t p[8];
+    uint32_t t;
+    uint32_t n;
+    unsigned k;
+    int rc;
+
+    rc = 0;
+    *drained_ms = 0U;
+
+    memset(fl, 0xFF, sizeof(fl->mem));
+    fl->erase_fail = 0UL;
+    fl->now_ms = 0U;
+    fl->fail_from_ms = (faulty == 1U) ? 185000U : 0U;
+    fl->fail_to_ms = (faulty == 1U) ? 195000U : 0U;
+    fl->forge = (faulty == 2U) ? 1U : 0U;
+
+    sio.ctx = fl;
+    sio.read = sim_flash_read;
+    sio.write = sim_flash_write;
+    sio.erase = sim_flash_erase;
+    sio.seg_size = SIM_SPILL_SEG_SIZE;
+    sio.seg_count = SIM_SPILL_SEGS;
+
+    bpu_simlink_init(&link, 256U, 11520U, sim_on_spill_frame, sr);
+    bpu_simlink_io(&link, &io);
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tx_budget_bytes = 100U;
+    cfg.tx_min_free = 16U;
+    cfg.tx_chunk_max = 100U;
+    cfg.aged_ms = 200U;
+
+    if (bpu_init(&bpu, &io, &cfg) != BPU_RC_OK) {
+        rc = 1;
+    }
+
+    memset(&d, 0, sizeof(d));
+    d.merge = BPU_MERGE_NONE;
+    d.job = SIM_SPILL_TYPE;
+    d.tag = SIM_SPILL_TYPE;
+    d.prio = BPU_PRIO_SENSOR;
+    d.flags = BPU_TF_SPILL;
+    rc |= bpu_register_type(&bpu, SIM_SPILL_TYPE, &d);
+    rc |= bpu_spill_attach(&bpu, &sio);
+
+    n = 0U;
+    t = 0U;
+    while (rc == 0 && t < 300000U) {
+        fl->now_ms = t;
+        link.stalled = ((t >= 5000U && t < 65000U) || (t >= 125000U && t < 185000U)) ? 1 : 0;
+
+        k = 0U;
+        while (t % 100U == 0U && k < 6U && n < SIM_SPILL_RECS) {
+            p[0] = (uint8_t)(t & 0xFFU);
+            p[1] = (uint8_t)((t >> 8) & 0xFFU);
+            p[2] = (uint8_t)((t >> 16) & 0xFFU);
+            p[3] = (uint8_t)((t >> 24) & 0xFFU);
+            p[4] = (uint8_t)(n & 0xFFU);
+            p[5] = (uint8_t)((n >> 8) & 0xFFU);
+            p[6] = (uint8_t)((n >> 16) & 0xFFU);
+            p[7] = (uint8_t)((n >> 24) & 0xFFU);
+            (void)bpu_push_event(&bpu, SIM_SPILL_TYPE, p, 8U, t);
+            n++;
+            k++;
+        }
+        if (t % 20U == 10U) {
+            sim_push(&bpu, BPU_EVT_SENSOR, 0U, 8U, t);
+        }
+        if (t % 100U == 0U) {
+            sim_push(&bpu, BPU_EVT_TELEM, 0U, 16U, t);
+        }
+
+        (void)bpu_tick(&bpu, t);
+
+        t += 10U;
+        bpu_simlink_advance(&link, t);
+
+        if (*drained_ms == 0U && t > 65000U && bpu.spill.buf_rd >= bpu.spill.buf_len &&
+            bpu.spill.rd_seg == bpu.spill.wr_seg && bpu.spill.rd_off >= bpu.spill.wr_off && bpu.jobq.count == 0U) {
+            *drained_ms = t;
+        }
+    }
+
+    bpu_simlink_advance(&link, t + 1000U);
+    (void)bpu_get_stats(&bpu, st);
+
+    return rc;
+}
+
+// 60 s link outages with a spill store: every record of the spill type must
+// arrive exactly once; while flash erases fail, only refused records may be
+// missing. A forged record with an out-of-range type must be rejected as
+// corrupt (only the rest of its segment is lost) and never sent
+static int sim_spill(void)
+{
+    static SimSpillRx sr;
+    static SimFlash fl;
+    static const char *const LABEL[] = { "none", "10 s", "forged" };
+    SimRx rx;
+    BpuStats st;
+    uint32_t drained_ms;
+    unsigned long lost;
+    uint8_t ok;
+    unsigned i;
+    unsigned run;
+    int rc;
+
+    rc = 0;
+
+    printf("%-10s %7s %7s %5s %8s %9s %7s %6s %6s %9s\n", "erase_fail", "records", "lost", "dup", "spill_in", "spill_out", "erases", "failed", "full", "drained_s");
+
+    run = 0U;
+    while (rc == 0 && run < 3U) {
+        memset(&sr, 0, sizeof(sr));
+        sr.rx = &rx;
+        drained_ms = 0U;
+        rc = sim_rx_init(&rx);
+
+        if (rc == 0) {
+            rc = sim_spill_run((uint8_t)run, &sr, &fl, &st, &drained_ms);
+        }
+
+        lost = 0UL;
+        i = 0U;
+        while (i < SIM_SPILL_RECS) {
+            if (sr.seen[i] == 0U) {
+                lost++;
+            }
+            i++;
+        }
+
+        if (rc == 0) {
+            printf("%-10s %7u %7lu %5lu %8lu %9lu %7lu %6lu %6lu %9.1f\n", LABEL[run], SIM_SPILL_RECS, lost, sr.dup,
+                   (unsigned long)st.spill_in, (unsigned long)st.spill_out, (unsigned long)st.spill_erase, fl.erase_fail, (unsigned long)st.spill_full,
+                   (drained_ms != 0U) ? (double)(drained_ms - 65000U) / 1000.0 : -1.0);
+        }
+
+        // Outages alone lose nothing; while erases fail, records the full
+        // RAM batch refuses are counted in spill_full and nothing else is lost.
+        // Nothing may arrive twice (a stale segment replayed). The forged
+        // record costs the rest of its segment, at most 4096 / 20 records
+        if (run == 2U) {
+            ok = (st.spill_bad == 1U && sr.forged == 0UL && lost != 0UL && lost <= SIM_SPILL_SEG_SIZE / 20U && sr.dup == 0UL) ? 1U : 0U;
+        } else {
+            ok = ((run == 0U && lost != 0UL) || lost != (unsigned long)st.spill_full || sr.dup != 0UL || st.spill_bad != 0U || drained_ms == 0U) ? 0U : 1U;
+        }
+        if (ok == 0U) {
+            fprintf(stderr, "spill: records lost or repeated\n");
+            rc = 1;
+        }
+
+        sim_rx_free(&rx);
+        run++;
+    }
+
+    return rc;
+}
+
+static const SimScenario SCENARIOS[] = {
+    { "edf", sim_edf, "FIFO vs EDF deadline misses on a mixed-deadline load" },
+    { "preempt", sim_preempt, "CMD latency on a saturated link, preemption off/on" },
+    { "ttl", sim_ttl, "recovery after a 3 s link stall, TTL off/on" },
+    { "batch", sim_batch, "bytes/sample of one frame per sample vs SENSOR_BATCH" },
+    { "onchange", sim_onchange, "on-change values cut by a CMD are resent, repeats suppressed" },
+    { "bulk", sim_bulk, "256 KiB blob on the bulk lane next to SENSOR/TELEM traffic" },
+    { "spill", sim_spill, "two 60 s outages with a spill store: no record lost or repeated" },
+};
+#define SCENARIO_COUNT (sizeof(SCENARIOS) / sizeof(SCENARIOS[0]))
+
+// Run one named scenario, or all of them.
+// Usage: bpu_sim [scenario]
+int main(int argc, char **argv)
+{
+    size_t i;
+    int found;
+    int rc;
+
+    rc = 0;
+    found = 0;
+
+    i = 0U;
+    while (i < SCENARIO_COUNT && rc == 0) {
+        if (argc < 2 || strcmp(argv[1], SCENARIOS[i].name) == 0) {
+            printf("# %s: %s\n", SCENARIOS[i].name, SCENARIOS[i].what);
+            rc = SCENARIOS[i].fn();
+            found = 1;
+        }
+        i++;
+    }
+
+    if (found == 0) {
+        fprintf(stderr, "usage: bpu_sim [scenario]; scenarios:");
+        i = 0U;
+        while (i < SCENARIO_COUNT) {
+            fprintf(stderr, " %s", SCENARIOS[i].name);
+            i++;
+        }
+        fprintf(stderr, "\n");
+        rc = 1;
+    }
+
+    return rc;
+}
@@ -0,0 +1,140 @@
+// clock_gettime under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <time.h>
+
+#include "bpu_simlink.h"
+
+// Free FIFO space (none while stalled)
+static int sl_tx_free(void *ctx, size_t *free_out)
+{
+    BpuSimLink *l;
+
+    l = (BpuSimLink *)ctx;
+    *free_out = (l->stalled != 0) ? 0U : l->cap - l->count;
+
+    return BPU_RC_OK;
+}
+
+// Queue as much as fits into the FIFO
+static int sl_tx_write_some(void *ctx, const uint8_t *p, size_t len, size_t *wrote_out)
+{
+    BpuSimLink *l;
+    size_t n;
+    size_t i;
+
+    l = (BpuSimLink *)ctx;
+    n = (l->stalled != 0) ? 0U : l->cap - l->count;
+    if (n > len) {
+        n = len;
+    }
+
+    i = 0U;
+    while (i < n) {
+        l->fifo[(l->head + l->count + i) % BPU_SIMLINK_FIFO_MAX] = p[i];
+        i++;
+    }
+
+    l->count += n;
+    l->writes++;
+    *wrote_out = n;
+
+    return BPU_RC_OK;
+}
+
+// Receive one byte off the wire; a delimiter completes the COBS block
+static void sl_rx(BpuSimLink *l, uint8_t c)
+{
+    BpuWireFrame f;
+    size_t n;
+
+    l->bytes++;
+
+    if (c != 0U) {
+        if (l->enc_len < sizeof(l->enc)) {
+            l->enc[l->enc_len] = c;
+        }
+        l->enc_len++;
+    } else {
+        if (l->enc_len != 0U) {
+            n = 0U;
+            if (l->enc_len <= sizeof(l->enc)) {
+                n = bpu_wire_cobs_decode(l->enc, l->enc_len, l->dec, sizeof(l->dec));
+            }
+
+            if (n == 0U || bpu_wire_parse(l->dec, n, &f) != BPU_WIRE_OK) {
+                l->bad++;
+            } else {
+                l->frames++;
+                if (l->fn != NULL) {
+                    l->fn(l->ctx, &f, l->now_ms);
+                }
+            }
+        }
+
+        l->enc_len = 0U;
+    }
+}
+
+void bpu_simlink_init(BpuSimLink *l, size_t cap, uint32_t rate_Bps, BpuSimFrameFn fn, void *ctx)
+{
+    memset(l, 0, sizeof(*l));
+
+    l->cap = (cap > BPU_SIMLINK_FIFO_MAX) ? BPU_SIMLINK_FIFO_MAX : cap;
+    l->rate_Bps = rate_Bps;
+    l->fn = fn;
+    l->ctx = ctx;
+}
+
+void bpu_simlink_io(BpuSimLink *l, BpuIo *io)
+{
+    io->ctx = l;
+    io->tx_free = sl_tx_free;
+    io->tx_write_some = sl_tx_write_some;
+    io->time_us = NULL;
+}
+
+void bpu_simlink_advance(BpuSimLink *l, uint32_t now_ms)
+{
+    uint32_t n;
+
+    while (l->now_ms != now_ms) {
+        // One millisecond at a time so every frame gets its own delivery time
+        l->now_ms++;
+
+        if (l->stalled == 0) {
+            n = (l->rate_Bps + l->carry) / 1000U;
+            l->carry = (l->rate_Bps + l->carry) % 1000U;
+
+            while (n != 0U && l->count != 0U) {
+                sl_rx(l, l->fifo[l->head]);
+                l->head = (l->head + 1U) % BPU_SIMLINK_FIFO_MAX;
+                l->count--;
+                n--;
+            }
+        }
+    }
+}
+
+uint32_t bpu_sim_rand(uint32_t *state)
+{
+    uint32_t x;
+
+    x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return x;
+}
+
+uint64_t bpu_sim_now_ns(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
@@ -0,0 +1,57 @@
+#ifndef BPU_SIMLINK_H
+#define BPU_SIMLINK_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "bpu_wire.h"
+
+// Engine API only; the engine itself is compiled from ../bpu_espidf.c
+#define BPU_ESPIDF_DECLARE_ONLY 1
+#include "../bpu_espidf.c"
+
+// Simulated UART for host scenarios and benchmarks, driven in virtual time:
+// a TX FIFO of cap bytes drained at rate_Bps, optional stall (no drain and
+// no free space), and a receiver that decodes every frame when its
+// delimiter leaves the wire, so rx_ms is the frame's delivery time.
+
+#ifndef BPU_SIMLINK_FIFO_MAX
+#define BPU_SIMLINK_FIFO_MAX 4096U
+#endif
+
+// Called for every frame that decodes cleanly
+typedef void (*BpuSimFrameFn)(void *ctx, const BpuWireFrame *f, uint32_t rx_ms);
+
+typedef struct {
+    uint8_t fifo[BPU_SIMLINK_FIFO_MAX];
+    size_t cap;
+    size_t head;
+    size_t count;
+    uint32_t rate_Bps;
+    uint32_t carry;
+    uint32_t now_ms;
+    int stalled;
+    uint8_t enc[1024];
+    size_t enc_len;
+    uint8_t dec[1024];
+    BpuSimFrameFn fn;
+    void *ctx;
+    unsigned long bytes;
+    unsigned long frames;
+    unsigned long bad;
+    unsigned long writes;
+} BpuSimLink;
+
+// Empty link of cap FIFO bytes (at most BPU_SIMLINK_FIFO_MAX) at rate_Bps;
+// fn may be NULL
+void bpu_simlink_init(BpuSimLink *l, size_t cap, uint32_t rate_Bps, BpuSimFrameFn fn, void *ctx);
+// Fill an engine BpuIo that writes into the link (no time_us)
+void bpu_simlink_io(BpuSimLink *l, BpuIo *io);
+// Move the wire forward to now_ms, decoding what was sent
+void bpu_simlink_advance(BpuSimLink *l, uint32_t now_ms);
+// Deterministic 32-bit xorshift for scenario traffic
+uint32_t bpu_sim_rand(uint32_t *state);
+// Wall-clock nanoseconds (CLOCK_MONOTONIC) for benchmarks
+uint64_t bpu_sim_now_ns(void);
+
+#endif
@@ -0,0 +1,121 @@
+#include "bpu_spill_file.h"
+
+// Seek to (seg, off) inside the store file
+static int spill_file_seek(BpuSpillFile *sf, uint16_t seg, uint32_t off)
+{
+    int rc;
+
+    rc = BPU_RC_OK;
+
+    if (fseek(sf->f, (long)seg * (long)sf->seg_size + (long)off, SEEK_SET) != 0) {
+        rc = BPU_RC_ERR;
+    }
+
+    return rc;
+}
+
+// BpuSpillIo.read
+static int spill_file_read(void *ctx, uint16_t seg, uint32_t off, uint8_t *p, size_t len)
+{
+    BpuSpillFile *sf;
+    int rc;
+
+    sf = (BpuSpillFile *)ctx;
+    rc = spill_file_seek(sf, seg, off);
+
+    if (rc == BPU_RC_OK && fread(p, 1U, len, sf->f) != len) {
+        rc = BPU_RC_ERR;
+    }
+
+    return rc;
+}
+
+// BpuSpillIo.write
+static int spill_file_write(void *ctx, uint16_t seg, uint32_t off, const uint8_t *p, size_t len)
+{
+    BpuSpillFile *sf;
+    int rc;
+
+    sf = (BpuSpillFile *)ctx;
+    rc = spill_file_seek(sf, seg, off);
+
+    if (rc == BPU_RC_OK && fwrite(p, 1U, len, sf->f) != len) {
+        rc = BPU_RC_ERR;
+    }
+
+    if (rc == BPU_RC_OK && fflush(sf->f) != 0) {
+        rc = BPU_RC_ERR;
+    }
+
+    return rc;
+}
+
+// BpuSpillIo.erase
+static int spill_file_erase(void *ctx, uint16_t seg)
+{
+    BpuSpillFile *sf;
+    uint8_t ff[256];
+    uint32_t done;
+    size_t n;
+    int rc;
+
+    sf = (BpuSpillFile *)ctx;
+    done = 0U;
+
+    for (n = 0U; n < sizeof(ff); n++) {
+        ff[n] = 0xFFU;
+    }
+
+    rc = spill_file_seek(sf, seg, 0U);
+
+    while (rc == BPU_RC_OK && done < sf->seg_size) {
+        n = sizeof(ff);
+        if ((uint32_t)n > sf->seg_size - done) {
+            n = (size_t)(sf->seg_size - done);
+        }
+
+        if (fwrite(ff, 1U, n, sf->f) != n) {
+            rc = BPU_RC_ERR;
+        }
+        done += (uint32_t)n;
+    }
+
+    return rc;
+}
+
+// Open (create or truncate) the store file and fill in the engine callbacks
+int bpu_spill_file_open(BpuSpillFile *sf, const char *path, uint16_t seg_count, uint32_t seg_size, BpuSpillIo *io_out)
+{
+    int rc;
+
+    rc = BPU_RC_OK;
+
+    if (sf == NULL || path == NULL || io_out == NULL) {
+        rc = BPU_RC_ERR;
+    } else {
+        sf->seg_size = seg_size;
+        sf->f = fopen(path, "w+b");
+
+        if (sf->f == NULL) {
+            rc = BPU_RC_ERR;
+        } else {
+            io_out->ctx = sf;
+            io_out->read = spill_file_read;
+            io_out->write = spill_file_write;
+            io_out->erase = spill_file_erase;
+            io_out->seg_size = seg_size;
+            io_out->seg_count = seg_count;
+        }
+    }
+
+    return rc;
+}
+
+// Close the store file
+void bpu_spill_file_close(BpuSpillFile *sf)
+{
+    if (sf != NULL && sf->f != NULL) {
+        fclose(sf->f);
+        sf->f = NULL;
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef BPU_SPILL_FILE_H
+#define BPU_SPILL_FILE_H 1
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Engine types only (BpuSpillIo); the engine itself is compiled elsewhere
+#define BPU_ESPIDF_DECLARE_ONLY 1
+#include "../bpu_espidf.c"
+
+// File-backed spill store for Linux hosts: segment s lives at s * seg_size
+// in one file; erase fills the segment with 0xFF like a flash sector
+typedef struct {
+    FILE *f;
+    uint32_t seg_size;
+} BpuSpillFile;
+
+// Open (create or truncate) the store file and fill in the engine callbacks
+int bpu_spill_file_open(BpuSpillFile *sf, const char *path, uint16_t seg_count, uint32_t seg_size, BpuSpillIo *io_out);
+// Close the store file
+void bpu_spill_file_close(BpuSpillFile *sf);
+
+#endif
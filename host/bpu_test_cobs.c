@@ -0,0 +1,329 @@
+// clock_gettime under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Whole engine in this translation unit: the test calls the static
+// bpu_cobs_encode() directly
+#include "../bpu_espidf.c"
+#include "bpu_wire.h"
+
+// COBS encoder equivalence. The block encoders (engine, .ino and the host
+// decoder's run scan) must give the same bytes as the original
+// byte-at-a-time encoder below, including the out_max failures. Build it
+// once per scan kernel (BPU_COBS_FAST=0, default SWAR/SSE2, -mavx2); with
+// -DBPU_TEST_INO it also checks the sketch's cobs_encode(), extracted into
+// ino_cobs.inc (see host/README.md).
+//
+// Cases: every all-nonzero length 0..1100 (254-byte blocks, 0xFF codes),
+// one zero at the 253/254/255 and 507/508/509 boundaries and at both ends,
+// and random inputs of four zero densities; each at out_max = large, exact,
+// exact - 1 and 1. Every encoding is decoded back with bpu_wire.
+//
+// bpu_test_cobs -b: encode throughput against the original encoder.
+
+#if defined(BPU_TEST_INO)
+#include "ino_cobs.inc"
+#endif
+
+#define IN_MAX 1100U
+#define OUT_MAX 1200U
+#define RANDOM_CASES 200000UL
+
+static uint8_t g_in[IN_MAX];
+static uint8_t g_ref[OUT_MAX];
+static uint8_t g_out[OUT_MAX];
+static uint8_t g_dec[OUT_MAX];
+static unsigned long g_cases;
+static unsigned long g_fail;
+
+// 32-bit xorshift
+static uint32_t rnd(uint32_t *state)
+{
+    uint32_t x;
+
+    x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return x;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Original encoder: one byte per step, the reference for every other copy
+static size_t ref_cobs_encode(const uint8_t *input, size_t length, uint8_t *output, size_t out_max)
+{
+    size_t out_len;
+    size_t read_index;
+    size_t write_index;
+    size_t code_index;
+    uint8_t code;
+    int rc;
+
+    out_len = 0U;
+    rc = (out_max == 0U) ? BPU_RC_ERR : BPU_RC_OK;
+
+    if (rc == BPU_RC_OK) {
+        read_index = 0U;
+        write_index = 1U;
+        code_index = 0U;
+        code = 1U;
+
+        while (read_index < length && rc == BPU_RC_OK) {
+            if (write_index >= out_max) {
+                rc = BPU_RC_ERR;
+            } else {
+                if (input[read_index] == 0U) {
+                    output[code_index] = code;
+                    code = 1U;
+                    code_index = write_index;
+                    write_index++;
+                    read_index++;
+                } else {
+                    output[write_index] = input[read_index];
+                    write_index++;
+                    read_index++;
+                    code++;
+                    if (code == 0xFFU) {
+                        if (write_index >= out_max) {
+                            rc = BPU_RC_ERR;
+                        } else {
+                            output[code_index] = code;
+                            code = 1U;
+                            code_index = write_index;
+                            write_index++;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (rc == BPU_RC_OK) {
+            if (code_index >= out_max) {
+                rc = BPU_RC_ERR;
+            } else {
+                output[code_index] = code;
+                out_len = write_index;
+            }
+        }
+    }
+
+    return out_len;
+}
+
+static void fail(const char *who, size_t n, size_t out_max, size_t want, size_t got)
+{
+    g_fail++;
+    if (g_fail <= 5UL) {
+        fprintf(stderr, "%s: n=%lu out_max=%lu want %lu got %lu\n", who, (unsigned long)n, (unsigned long)out_max, (unsigned long)want,
+                (unsigned long)got);
+    }
+}
+
+// Compare every encoder on g_in[0..n) at four out_max values
+static void check(size_t n)
+{
+    size_t limits[4];
+    size_t need;
+    size_t want;
+    size_t got;
+    unsigned k;
+
+    need = ref_cobs_encode(g_in, n, g_ref, OUT_MAX);
+    limits[0] = OUT_MAX;
+    limits[1] = need;
+    limits[2] = need - 1U;
+    limits[3] = 1U;
+
+    k = 0U;
+    while (k < 4U) {
+        if (limits[k] != 0U) {
+            g_cases++;
+            want = ref_cobs_encode(g_in, n, g_ref, limits[k]);
+
+            got = bpu_cobs_encode(g_in, n, g_out, limits[k]);
+            if (got != want || memcmp(g_ref, g_out, want) != 0) {
+                fail("engine", n, limits[k], want, got);
+            }
+
+#if defined(BPU_TEST_INO)
+            got = cobs_encode(g_in, n, g_out, limits[k]);
+            if (got != want || memcmp(g_ref, g_out, want) != 0) {
+                fail("ino", n, limits[k], want, got);
+            }
+#endif
+
+            if (want != 0U) {
+                got = bpu_wire_cobs_decode(g_ref, want, g_dec, sizeof(g_dec));
+                if (got != n || memcmp(g_dec, g_in, n) != 0) {
+                    fail("decode", n, limits[k], n, got);
+                }
+            }
+        }
+        k++;
+    }
+}
+
+static int equivalence(void)
+{
+    static const size_t edges[] = { 0U, 1U, 252U, 253U, 254U, 255U, 256U, 507U, 508U, 509U };
+    uint32_t seed;
+    unsigned long c;
+    size_t n;
+    size_t i;
+    unsigned e;
+    unsigned dens;
+
+    g_cases = 0UL;
+    g_fail = 0UL;
+
+    n = 0U;
+    while (n <= IN_MAX) {
+        i = 0U;
+        while (i < n) {
+            g_in[i] = (uint8_t)(1U + i % 255U);
+            i++;
+        }
+        check(n);
+
+        // One zero at each block edge, at the middle and at the end
+        e = 0U;
+        while (e < sizeof(edges) / sizeof(edges[0]) + 2U) {
+            i = (e < sizeof(edges) / sizeof(edges[0])) ? edges[e] : ((e == sizeof(edges) / sizeof(edges[0])) ? n / 2U : n - 1U);
+            if (i < n) {
+                g_in[i] = 0U;
+                check(n);
+                g_in[i] = (uint8_t)(1U + i % 255U);
+            }
+            e++;
+        }
+        n++;
+    }
+
+    // Random lengths; zero density all bytes random, 1/8, 1/64, 1/512
+    seed = 0xC0B5C0B5U;
+    c = 0UL;
+    while (c < RANDOM_CASES) {
+        n = (size_t)(rnd(&seed) % 600U);
+        dens = (unsigned)(rnd(&seed) % 4U);
+
+        i = 0U;
+        while (i < n) {
+            if (dens == 0U) {
+                g_in[i] = (uint8_t)rnd(&seed);
+            } else {
+                g_in[i] = (uint8_t)((rnd(&seed) % (1U << (dens * 3U)) == 0U) ? 0U : 1U + rnd(&seed) % 255U);
+            }
+            i++;
+        }
+        check(n);
+        c++;
+    }
+
+    printf("equivalence: %lu cases, %lu mismatches\n", g_cases, g_fail);
+
+    return (g_fail == 0UL) ? 0 : 1;
+}
+
+// MB/s of the original and the engine encoder, 1/64 zero density
+static void bench(void)
+{
+    static const size_t sizes[] = { 8U, 16U, 32U, 64U, 128U, 256U, 1024U };
+    volatile size_t sink;
+    uint64_t t0;
+    uint64_t ref_ns;
+    uint64_t new_ns;
+    unsigned long it;
+    unsigned long r;
+    uint32_t seed;
+    size_t n;
+    size_t i;
+    unsigned s;
+
+    seed = 0x0B5E55EDU;
+    sink = 0U;
+
+    printf("%6s %12s %12s\n", "bytes", "ref_MB/s", "engine_MB/s");
+
+    s = 0U;
+    while (s < sizeof(sizes) / sizeof(sizes[0])) {
+        n = sizes[s];
+        i = 0U;
+        while (i < n) {
+            g_in[i] = (uint8_t)((rnd(&seed) % 64U == 0U) ? 0U : 1U + rnd(&seed) % 255U);
+            i++;
+        }
+
+        it = 50000000UL / (unsigned long)n;
+
+        t0 = now_ns();
+        r = 0UL;
+        while (r < it) {
+            g_in[0] ^= (uint8_t)(r | 1UL);
+            sink += ref_cobs_encode(g_in, n, g_ref, OUT_MAX);
+            r++;
+        }
+        ref_ns = now_ns() - t0;
+
+        t0 = now_ns();
+        r = 0UL;
+        while (r < it) {
+            g_in[0] ^= (uint8_t)(r | 1UL);
+            sink += bpu_cobs_encode(g_in, n, g_out, OUT_MAX);
+            r++;
+        }
+        new_ns = now_ns() - t0;
+
+        printf("%6lu %12.0f %12.0f\n", (unsigned long)n, (double)n * (double)it * 1000.0 / (double)ref_ns,
+               (double)n * (double)it * 1000.0 / (double)new_ns);
+        s++;
+    }
+
+    (void)sink;
+}
+
+// Usage: bpu_test_cobs [-b]
+int main(int argc, char **argv)
+{
+    int rc;
+
+    printf("# BPU_COBS_FAST=%u%s%s%s\n", (unsigned)BPU_COBS_FAST,
+#if defined(__AVX2__)
+           " AVX2",
+#else
+           "",
+#endif
+#if defined(__SSE2__)
+           " SSE2",
+#else
+           "",
+#endif
+#if defined(BPU_TEST_INO)
+           " +ino"
+#else
+           ""
+#endif
+    );
+
+    rc = equivalence();
+
+    if (rc == 0 && argc > 1 && strcmp(argv[1], "-b") == 0) {
+        bench();
+    }
+
+    return rc;
+}
@@ -0,0 +1,399 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "../bpu.hpp"
+
+// Engine API only; the C core is compiled from ../bpu_espidf.c
+extern "C" {
+#define BPU_ESPIDF_DECLARE_ONLY 1
+#include "../bpu_espidf.c"
+}
+
+// bpu::Engine against the C core. Both get the same random push/tick
+// script (keys, merges, queue overflow, budget misses) through the same
+// sink; the output bytes and the shared counters must be identical. The
+// sink runs once ideal and once flaky (tx_free stalls below tx_min_free,
+// zero and short writes, from a seeded generator each side replays). The
+// C core runs with enable_degrade = 0: its ladder has no Engine
+// counterpart.
+//
+// bpu_test_hpp -b: ns per event (push plus share of tick) on a counting
+// sink, C core vs Engine.
+
+#define SCRIPTS 200U
+#define SCRIPT_STEPS 4000U
+#define BENCH_STEPS 100000U
+#define BENCH_ROUNDS 50U
+
+struct Step {
+    uint8_t tick;
+    uint8_t type;
+    uint16_t key;
+    uint16_t len;
+    uint32_t now;
+    uint8_t p[16];
+};
+
+// Shared by the C and the C++ IO adapters
+struct Sink {
+    std::vector<uint8_t> out;
+    uint32_t rng;
+    uint8_t flaky;
+    uint8_t count_only;
+    size_t counted;
+};
+
+static Sink g_sink;
+
+static uint32_t sink_rand(void)
+{
+    g_sink.rng = g_sink.rng * 1664525U + 1013904223U;
+
+    return g_sink.rng >> 8;
+}
+
+static void sink_free(size_t *free_out)
+{
+    *free_out = 4096U;
+    if (g_sink.flaky != 0U && sink_rand() % 4U == 0U) {
+        *free_out = 40U;
+    }
+}
+
+static void sink_write(const uint8_t *p, size_t len, size_t *wrote_out)
+{
+    size_t n;
+    uint32_t r;
+
+    n = len;
+    if (g_sink.flaky != 0U) {
+        r = sink_rand() % 8U;
+        if (r == 0U) {
+            n = 0U;
+        } else {
+            if (r == 1U) {
+                n = len / 2U;
+            }
+        }
+    }
+
+    if (g_sink.count_only != 0U) {
+        g_sink.counted += n;
+    } else {
+        g_sink.out.insert(g_sink.out.end(), p, p + n);
+    }
+    *wrote_out = n;
+}
+
+static int c_tx_free(void *ctx, size_t *free_out)
+{
+    (void)ctx;
+    sink_free(free_out);
+
+    return BPU_RC_OK;
+}
+
+static int c_tx_write_some(void *ctx, const uint8_t *p, size_t len, size_t *wrote_out)
+{
+    (void)ctx;
+    sink_write(p, len, wrote_out);
+
+    return BPU_RC_OK;
+}
+
+struct HppIo {
+    bool tx_free(size_t &free_out)
+    {
+        sink_free(&free_out);
+        return true;
+    }
+
+    bool tx_write_some(const uint8_t *p, size_t len, size_t &wrote_out)
+    {
+        sink_write(p, len, &wrote_out);
+        return true;
+    }
+};
+
+struct HppCfg : bpu::DefaultConfig {
+    using Io = HppIo;
+    static constexpr uint8_t wire_version = BPU_WIRE_VERSION;
+};
+
+using HppEngine = bpu::Engine<HppCfg>;
+
+// Same settings as bpu::DefaultConfig
+static void c_setup(Bpu *bpu)
+{
+    BpuConfig cfg;
+    BpuIo io;
+
+    io.ctx = NULL;
+    io.tx_free = c_tx_free;
+    io.tx_write_some = c_tx_write_some;
+    io.time_us = NULL;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tx_budget_bytes = HppCfg::tx_budget_bytes;
+    cfg.tx_min_free = HppCfg::tx_min_free;
+    cfg.tx_chunk_max = HppCfg::tx_chunk_max;
+    cfg.coalesce_window_ms = HppCfg::coalesce_window_ms;
+    cfg.aged_ms = HppCfg::aged_ms;
+    cfg.enable_degrade = HppCfg::enable_degrade ? 1U : 0U;
+
+    (void)bpu_init(bpu, &io, &cfg);
+}
+
+// One tick in five, otherwise an event of a random built-in type; the
+// last step is a tick, so bpu_get_stats() covers every push
+static void make_script(std::vector<Step> &v, uint32_t seed, unsigned steps)
+{
+    uint32_t s;
+    uint32_t now;
+    unsigned i;
+    unsigned k;
+
+    v.clear();
+    s = seed;
+    now = 0U;
+
+    i = 0U;
+    while (i < steps) {
+        Step st;
+
+        memset(&st, 0, sizeof(st));
+        s = s * 22695477U + 1U;
+        if ((s >> 10) % 5U == 0U || i + 1U == steps) {
+            now += 20U;
+            st.tick = 1U;
+            st.now = now;
+        } else {
+            s = s * 22695477U + 1U;
+            st.type = (uint8_t)(1U + (s >> 10) % 4U);
+            s = s * 22695477U + 1U;
+            st.key = (uint16_t)((s >> 10) % 3U);
+            s = s * 22695477U + 1U;
+            st.len = (uint16_t)((s >> 10) % 17U);
+            k = 0U;
+            while (k < sizeof(st.p)) {
+                s = s * 22695477U + 1U;
+                st.p[k] = (uint8_t)(s >> 10);
+                k++;
+            }
+            s = s * 22695477U + 1U;
+            st.now = now + (s >> 10) % 20U;
+        }
+        v.push_back(st);
+        i++;
+    }
+}
+
+static void c_run(Bpu *bpu, const std::vector<Step> &v)
+{
+    size_t i;
+
+    i = 0U;
+    while (i < v.size()) {
+        if (v[i].tick != 0U) {
+            (void)bpu_tick(bpu, v[i].now);
+        } else {
+            (void)bpu_push_event_keyed(bpu, v[i].type, v[i].key, v[i].p, v[i].len, v[i].now);
+        }
+        i++;
+    }
+}
+
+static void hpp_push(HppEngine &e, const Step &s)
+{
+    if (s.type == bpu::Cmd::evt) {
+        (void)e.push<bpu::Cmd>(s.p, s.len, s.now, s.key);
+    } else {
+        if (s.type == bpu::Sensor::evt) {
+            (void)e.push<bpu::Sensor>(s.p, s.len, s.now, s.key);
+        } else {
+            if (s.type == bpu::Hb::evt) {
+                (void)e.push<bpu::Hb>(s.p, s.len, s.now, s.key);
+            } else {
+                (void)e.push<bpu::Telem>(s.p, s.len, s.now, s.key);
+            }
+        }
+    }
+}
+
+static void hpp_run(HppEngine &e, const std::vector<Step> &v)
+{
+    size_t i;
+
+    i = 0U;
+    while (i < v.size()) {
+        if (v[i].tick != 0U) {
+            e.tick(v[i].now);
+        } else {
+            hpp_push(e, v[i]);
+        }
+        i++;
+    }
+}
+
+// Counters both implementations keep
+static void c_counters(const BpuStats &s, uint32_t *o)
+{
+    const uint32_t v[] = { s.ev_in, s.ev_merge, s.ev_drop, s.job_in, s.job_merge, s.job_drop, s.job_out,
+                           s.tx_frame_sent, s.tx_frame_partial, s.tx_bytes, s.tx_skip_budget, s.tx_skip_backpressure,
+                           s.flush_try, s.flush_ok, s.degrade_drop, s.degrade_requeue, s.pick_aged };
+
+    memcpy(o, v, sizeof(v));
+}
+
+static void hpp_counters(const bpu::Stats &s, uint32_t *o)
+{
+    const uint32_t v[] = { s.ev_in, s.ev_merge, s.ev_drop, s.job_in, s.job_merge, s.job_drop, s.job_out,
+                           s.tx_frame_sent, s.tx_frame_partial, s.tx_bytes, s.tx_skip_budget, s.tx_skip_backpressure,
+                           s.flush_try, s.flush_ok, s.degrade_drop, s.degrade_requeue, s.pick_aged };
+
+    memcpy(o, v, sizeof(v));
+}
+
+#define COUNTERS 17U
+
+static int differential(void)
+{
+    static Bpu bpu;
+    static HppIo io;
+    std::vector<Step> script;
+    std::vector<uint8_t> c_out;
+    uint32_t c_cnt[COUNTERS];
+    uint32_t h_cnt[COUNTERS];
+    BpuStats st;
+    unsigned long frames;
+    unsigned bad;
+    uint32_t seed;
+    uint8_t flaky;
+
+    bad = 0U;
+    frames = 0UL;
+
+    flaky = 0U;
+    while (flaky < 2U) {
+        seed = 1U;
+        while (seed <= SCRIPTS) {
+            make_script(script, seed, SCRIPT_STEPS);
+
+            g_sink.out.clear();
+            g_sink.rng = seed;
+            g_sink.flaky = flaky;
+            g_sink.count_only = 0U;
+            c_setup(&bpu);
+            c_run(&bpu, script);
+            (void)bpu_get_stats(&bpu, &st);
+            c_counters(st, c_cnt);
+            c_out = g_sink.out;
+
+            g_sink.out.clear();
+            g_sink.rng = seed;
+            {
+                HppEngine e(io);
+
+                hpp_run(e, script);
+                hpp_counters(e.stats(), h_cnt);
+            }
+
+            frames += st.tx_frame_sent;
+            if (c_out != g_sink.out || memcmp(c_cnt, h_cnt, sizeof(c_cnt)) != 0) {
+                if (bad < 3U) {
+                    printf("mismatch: flaky=%u seed=%u bytes %lu vs %lu\n", (unsigned)flaky, (unsigned)seed, (unsigned long)c_out.size(),
+                           (unsigned long)g_sink.out.size());
+                }
+                bad++;
+            }
+            seed++;
+        }
+        flaky++;
+    }
+
+    printf("differential: wire v%u, %u scripts, %lu frames, %u mismatches\n", (unsigned)BPU_WIRE_VERSION, SCRIPTS * 2U, frames, bad);
+
+    return (bad == 0U && frames != 0UL) ? 0 : 1;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// ns per event over the same script, counting sink, best of BENCH_ROUNDS
+static void bench(void)
+{
+    static Bpu bpu;
+    static HppIo io;
+    std::vector<Step> script;
+    unsigned long events;
+    uint64_t t0;
+    uint64_t c_ns;
+    uint64_t h_ns;
+    uint64_t ns;
+    unsigned r;
+    size_t i;
+
+    make_script(script, 7U, BENCH_STEPS);
+    events = 0UL;
+    i = 0U;
+    while (i < script.size()) {
+        events += (script[i].tick == 0U) ? 1UL : 0UL;
+        i++;
+    }
+
+    g_sink.flaky = 0U;
+    g_sink.count_only = 1U;
+    c_ns = 0U;
+    h_ns = 0U;
+
+    r = 0U;
+    while (r < BENCH_ROUNDS) {
+        t0 = now_ns();
+        c_setup(&bpu);
+        c_run(&bpu, script);
+        ns = now_ns() - t0;
+        if (r == 0U || ns < c_ns) {
+            c_ns = ns;
+        }
+
+        t0 = now_ns();
+        {
+            HppEngine e(io);
+
+            hpp_run(e, script);
+        }
+        ns = now_ns() - t0;
+        if (r == 0U || ns < h_ns) {
+            h_ns = ns;
+        }
+        r++;
+    }
+
+    printf("# wire v%u, %lu events, counting sink, best of %u\n", (unsigned)BPU_WIRE_VERSION, events, BENCH_ROUNDS);
+    printf("C core:      %.1f ns/event\n", (double)c_ns / (double)events);
+    printf("bpu::Engine: %.1f ns/event\n", (double)h_ns / (double)events);
+}
+
+// Usage: bpu_test_hpp [-b]
+int main(int argc, char **argv)
+{
+    int rc;
+
+    rc = differential();
+
+    if (rc == 0 && argc > 1 && strcmp(argv[1], "-b") == 0) {
+        bench();
+    }
+
+    return rc;
+}
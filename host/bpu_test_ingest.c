@@ -0,0 +1,387 @@
+// Linux-only: pipes, pthread CPU clocks and the ingest epoll sets
+#define _DEFAULT_SOURCE 1
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bpu_ingest.h"
+
+// Engine API only; the engine itself is compiled from ../bpu_espidf.c
+#define BPU_ESPIDF_DECLARE_ONLY 1
+#include "../bpu_espidf.c"
+
+// Gateway load test for bpu_ingest. The real engine first renders a CMD
+// stream into memory (STREAM_TICKS x 4 frames, so the 8-bit seq wraps
+// cleanly when the stream loops). Each case then feeds that stream into N
+// pipes, one writer thread per link starting at its own frame boundary,
+// either paced to a 921600 baud UART or as fast as the pipe takes it. The
+// main thread is the consumer. Every byte written must be counted, every
+// frame decoded must reach the consumer, and clean links must show no CRC,
+// COBS, overrun, gap or ring-drop error. On the corrupted case every eighth
+// link gets one byte flipped per 16 KiB: those links must report errors
+// and all others must stay clean.
+//
+// CPU is the whole process (writers included) and, separately, the ingest
+// worker threads alone.
+
+#define RUN_MS 3000U
+#define STREAM_TICKS 19968U
+#define STREAM_MAX (4UL << 20)
+#define CHUNK 4096U
+#define UART_BPS 92160UL  // 921600 baud, 10 bits per byte
+
+typedef struct {
+    const char *name;
+    unsigned links;
+    unsigned workers;
+    unsigned long bps;  // 0: unpaced
+    int corrupt;
+} LoadCase;
+
+static const LoadCase CASES[] = {
+    { "64 links at 921600 baud", 64U, 4U, UART_BPS, 0 },
+    { "64 links, unpaced", 64U, 1U, 0UL, 0 },
+    { "64 links, unpaced", 64U, 4U, 0UL, 0 },
+    { "1 link, unpaced", 1U, 1U, 0UL, 0 },
+    { "64 links, corrupted", 64U, 4U, UART_BPS, 1 },
+};
+
+#define CASE_COUNT (sizeof(CASES) / sizeof(CASES[0]))
+
+// CMD, never merged
+static const BpuTypeDesc T_CMD = { BPU_MERGE_NONE, BPU_JOB_CMD, 0x04U, BPU_PRIO_CMD, BPU_DEGRADE_REQUEUE, 0U, 0U, 0U, NULL, 0U, 0U, { 0U }, 0U, 0U };
+
+static uint8_t g_stream[STREAM_MAX];
+static size_t g_stream_len;
+
+// Write end of one link
+typedef struct {
+    int fd;
+    unsigned idx;
+    unsigned long bps;
+    int corrupt;
+    unsigned long written;
+} LinkWriter;
+
+static uint64_t mono_us(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+static uint64_t cpu_us(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+static void sleep_us(long us)
+{
+    struct timespec ts;
+
+    ts.tv_sec = us / 1000000L;
+    ts.tv_nsec = (us % 1000000L) * 1000L;
+    (void)nanosleep(&ts, NULL);
+}
+
+static int mem_tx_free(void *ctx, size_t *free_out)
+{
+    (void)ctx;
+    *free_out = STREAM_MAX - g_stream_len;
+
+    return BPU_RC_OK;
+}
+
+static int mem_tx_write_some(void *ctx, const uint8_t *p, size_t len, size_t *wrote_out)
+{
+    (void)ctx;
+    if (len > STREAM_MAX - g_stream_len) {
+        len = STREAM_MAX - g_stream_len;
+    }
+    memcpy(&g_stream[g_stream_len], p, len);
+    g_stream_len += len;
+    *wrote_out = len;
+
+    return BPU_RC_OK;
+}
+
+// Four CMD events of 8..32 bytes per tick, every frame sent in its tick
+static unsigned long make_stream(void)
+{
+    static Bpu bpu;
+    BpuConfig cfg;
+    BpuIo io;
+    uint8_t p[32];
+    unsigned long frames;
+    uint32_t t;
+    unsigned k;
+    unsigned i;
+    unsigned len;
+
+    io.ctx = NULL;
+    io.tx_free = mem_tx_free;
+    io.tx_write_some = mem_tx_write_some;
+    io.time_us = NULL;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tx_budget_bytes = 60000U;
+    cfg.aged_ms = 100U;
+
+    (void)bpu_init(&bpu, &io, &cfg);
+    (void)bpu_register_type(&bpu, BPU_EVT_CMD, &T_CMD);
+
+    frames = 0UL;
+    t = 0U;
+    while (t < STREAM_TICKS) {
+        k = 0U;
+        while (k < 4U) {
+            len = 8U + (t * 7U + k * 13U) % 25U;
+            i = 0U;
+            while (i < len) {
+                p[i] = (uint8_t)(t * 31U + i * k);
+                i++;
+            }
+            if (bpu_push_event(&bpu, BPU_EVT_CMD, p, (uint16_t)len, t) == BPU_RC_OK) {
+                frames++;
+            }
+            k++;
+        }
+        (void)bpu_tick_ex(&bpu, t, 0U);
+        t++;
+    }
+
+    // End on a delimiter so the loop is seamless
+    while (g_stream_len != 0U && g_stream[g_stream_len - 1U] != 0U) {
+        g_stream_len--;
+    }
+
+    return frames;
+}
+
+// Loop the stream into one pipe for RUN_MS, then close it (EOF)
+static void *writer(void *arg)
+{
+    LinkWriter *lw;
+    uint8_t buf[CHUNK];
+    uint64_t t0;
+    uint64_t el;
+    unsigned long chunks;
+    size_t pos;
+    size_t k;
+    size_t m;
+    ssize_t w;
+
+    lw = (LinkWriter *)arg;
+
+    // Start just after a delimiter somewhere in the stream
+    pos = (size_t)lw->idx * 7919U % g_stream_len;
+    while (g_stream[pos] != 0U) {
+        pos++;
+    }
+    pos = (pos + 1U) % g_stream_len;
+
+    chunks = 0UL;
+    t0 = mono_us();
+    el = 0U;
+    while (el < (uint64_t)RUN_MS * 1000ULL) {
+        if (lw->bps != 0UL && (double)(lw->written + CHUNK) > (double)el * (double)lw->bps / 1e6) {
+            sleep_us(2000L);
+        } else {
+            k = 0U;
+            while (k < CHUNK) {
+                m = g_stream_len - pos;
+                if (m > CHUNK - k) {
+                    m = CHUNK - k;
+                }
+                memcpy(&buf[k], &g_stream[pos], m);
+                k += m;
+                pos = (pos + m) % g_stream_len;
+            }
+
+            chunks++;
+            if (lw->corrupt != 0 && chunks % 4U == 0U) {
+                buf[(chunks * 613U) % CHUNK] ^= 0x5AU;
+            }
+
+            k = 0U;
+            while (k < CHUNK) {
+                w = write(lw->fd, &buf[k], CHUNK - k);
+                if (w > 0) {
+                    k += (size_t)w;
+                }
+            }
+            lw->written += CHUNK;
+        }
+        el = mono_us() - t0;
+    }
+
+    (void)close(lw->fd);
+
+    return NULL;
+}
+
+static int run_case(const LoadCase *lc)
+{
+    static BpuIngest ing;
+    static LinkWriter lw[BPU_INGEST_LINKS_MAX];
+    static pthread_t th[BPU_INGEST_LINKS_MAX];
+    static uint8_t payload[BPU_INGEST_FRAME_MAX];
+    BpuIngestLinkStats st;
+    BpuIngestFrame f;
+    unsigned long delivered;
+    unsigned long frames;
+    unsigned long bytes;
+    unsigned long errs;
+    unsigned long link_errs;
+    uint64_t t0;
+    uint64_t c0;
+    uint64_t wall;
+    uint64_t cpu;
+    uint64_t dec;
+    unsigned open_links;
+    unsigned started;
+    unsigned i;
+    int fds[2];
+    int got;
+    int ok;
+    int rc;
+
+    rc = bpu_ingest_init(&ing, lc->workers);
+    ok = (rc == BPU_WIRE_OK) ? 1 : 0;
+
+    i = 0U;
+    while (ok != 0 && i < lc->links) {
+        memset(&lw[i], 0, sizeof(lw[i]));
+        if (pipe(fds) != 0 || bpu_ingest_add(&ing, fds[0], NULL) != BPU_WIRE_OK) {
+            ok = 0;
+        } else {
+            lw[i].fd = fds[1];
+            lw[i].idx = i;
+            lw[i].bps = lc->bps;
+            lw[i].corrupt = (lc->corrupt != 0 && i % 8U == 0U) ? 1 : 0;
+        }
+        i++;
+    }
+
+    started = 0U;
+    if (ok != 0 && bpu_ingest_start(&ing) == BPU_WIRE_OK) {
+        t0 = mono_us();
+        c0 = cpu_us();
+        while (started < lc->links) {
+            (void)pthread_create(&th[started], NULL, writer, &lw[started]);
+            started++;
+        }
+
+        // Same consumer loop as bpu_ingestd: open_links is read before the
+        // pass, so the last pass after every link closed sees all frames
+        delivered = 0UL;
+        got = 1;
+        open_links = 1U;
+        while (got != 0 || open_links != 0U) {
+            got = 0;
+            open_links = bpu_ingest_open_links(&ing);
+            i = 0U;
+            while (i < ing.nworkers) {
+                while (bpu_ingest_pop(&ing, i, &f, payload, sizeof(payload)) == BPU_WIRE_OK) {
+                    got = 1;
+                    delivered++;
+                }
+                i++;
+            }
+            if (got == 0) {
+                sleep_us(1000L);
+            }
+        }
+
+        wall = mono_us() - t0;
+        cpu = cpu_us() - c0;
+        dec = 0U;
+        i = 0U;
+        while (i < ing.nworkers) {
+            dec += bpu_ingest_worker_cpu_us(&ing, i);
+            i++;
+        }
+
+        frames = 0UL;
+        bytes = 0UL;
+        errs = 0UL;
+        i = 0U;
+        while (i < lc->links) {
+            (void)pthread_join(th[i], NULL);
+            bpu_ingest_link_stats(&ing, i, &st);
+            link_errs = (unsigned long)st.crc_err + st.cobs_err + st.overrun + st.seq_gaps + st.ring_drop;
+
+            frames += st.frames;
+            bytes += st.bytes;
+            errs += link_errs;
+            if (st.bytes != (uint32_t)lw[i].written || st.ring_drop != 0U) {
+                ok = 0;
+            }
+            if ((lw[i].corrupt != 0) != (link_errs != 0UL)) {
+                ok = 0;
+            }
+            i++;
+        }
+        if (delivered != frames || frames == 0UL) {
+            ok = 0;
+        }
+
+        printf("%-24s %7u %6.2f %8.2fM %5.1f%% %7.1f %7.1f %6lu  %s\n", lc->name, lc->workers, (double)bytes / (double)wall,
+               (double)frames / (double)wall, (double)cpu * 100.0 / (double)wall, ((double)cpu / 1000.0) / ((double)bytes / 1e6),
+               ((double)dec / 1000.0) / ((double)bytes / 1e6), errs, (ok != 0) ? "ok" : "FAIL");
+    } else {
+        ok = 0;
+        i = 0U;
+        while (i < lc->links) {
+            if (lw[i].fd > 0) {
+                (void)close(lw[i].fd);
+            }
+            i++;
+        }
+        printf("%-24s setup failed\n", lc->name);
+    }
+
+    if (rc == BPU_WIRE_OK) {
+        bpu_ingest_close(&ing);
+    }
+
+    return (ok != 0) ? BPU_RC_OK : BPU_RC_ERR;
+}
+
+// Usage: bpu_test_ingest
+int main(void)
+{
+    unsigned long frames;
+    unsigned i;
+    int rc;
+
+    rc = 0;
+    (void)signal(SIGPIPE, SIG_IGN);
+
+    frames = make_stream();
+    printf("# stream: %lu bytes, %lu CMD frames, %.1f B/frame; %u ms per run\n", (unsigned long)g_stream_len, frames,
+           (double)g_stream_len / (double)frames, RUN_MS);
+    printf("%-24s %7s %6s %9s %6s %7s %7s %6s\n", "load", "workers", "MB/s", "frames/s", "CPU", "ms/MB", "dec/MB", "errors");
+
+    i = 0U;
+    while (i < CASE_COUNT) {
+        if (run_case(&CASES[i]) != BPU_RC_OK) {
+            rc = 1;
+        }
+        i++;
+    }
+
+    return rc;
+}
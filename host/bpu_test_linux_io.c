@@ -0,0 +1,334 @@
+// Linux-only: ptys, socketpair and the loop's epoll/timerfd
+#define _DEFAULT_SOURCE 1
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "bpu_linux_io.h"
+#include "bpu_wire.h"
+
+// BpuLinuxIo and BpuLinuxLoop on local stand-ins for a serial link: a UNIX
+// socketpair and a raw pty pair. CMD events are pushed from a watched pipe
+// for RUN_MS while a reader thread decodes the far end with bpu_wire. Each
+// run must deliver every frame the engine counts as sent, with no bad
+// frame; the stalled-reader runs must also hit backpressure (EAGAIN or a
+// tx_free skip) and recover from it.
+
+#define RUN_MS 3000U
+#define STALL_MS 1500U
+#define REC_LEN 24U
+
+typedef struct {
+    const char *name;
+    int pty;
+    uint32_t tick_ms;
+    size_t sndbuf;
+    uint32_t stall_ms;
+} LinkCase;
+
+static const LinkCase CASES[] = {
+    { "socketpair", 0, 5U, 0U, 0U },
+    { "pty", 1, 5U, 0U, 0U },
+    { "socketpair", 0, 1U, 0U, 0U },
+    { "pty", 1, 1U, 0U, 0U },
+    { "socketpair, 8 KB, stalled", 0, 5U, 4096U, STALL_MS },  // SO_SNDBUF doubles 4096
+    { "pty, stalled", 1, 5U, 0U, STALL_MS },
+};
+
+#define CASE_COUNT (sizeof(CASES) / sizeof(CASES[0]))
+
+// CMD with a 40 ms deadline, never merged
+static const BpuTypeDesc T_CMD = { BPU_MERGE_NONE, BPU_JOB_CMD, 0x04U, BPU_PRIO_CMD, BPU_DEGRADE_REQUEUE, 0U, 40U, 0U, NULL, 0U, 0U, { 0U }, 0U, 0U };
+
+// Far end of the link
+typedef struct {
+    int fd;
+    uint32_t stall_ms;
+    int stop;
+    unsigned long ok;
+    unsigned long bad;
+    unsigned long bytes;
+} LinkReader;
+
+// Event source feeding the watched pipe
+typedef struct {
+    int fd;
+    int stop;
+} LinkGen;
+
+static void sleep_us(long us)
+{
+    struct timespec ts;
+
+    ts.tv_sec = us / 1000000L;
+    ts.tv_nsec = (us % 1000000L) * 1000L;
+    (void)nanosleep(&ts, NULL);
+}
+
+// Split on 0x00, COBS-decode and parse every frame
+static void *reader(void *arg)
+{
+    static uint8_t buf[4096];
+    static uint8_t acc[1024];
+    static uint8_t dec[1024];
+    LinkReader *rd;
+    BpuWireFrame f;
+    ssize_t r;
+    ssize_t i;
+    size_t n;
+    size_t d;
+
+    rd = (LinkReader *)arg;
+    n = 0U;
+
+    if (rd->stall_ms != 0U) {
+        sleep_us((long)rd->stall_ms * 1000L);
+    }
+
+    while (__atomic_load_n(&rd->stop, __ATOMIC_ACQUIRE) == 0) {
+        r = read(rd->fd, buf, sizeof(buf));
+        if (r <= 0) {
+            sleep_us(100L);
+        } else {
+            (void)__atomic_fetch_add(&rd->bytes, (unsigned long)r, __ATOMIC_RELEASE);
+            i = 0;
+            while (i < r) {
+                if (buf[i] == 0U) {
+                    if (n != 0U) {
+                        d = bpu_wire_cobs_decode(acc, n, dec, sizeof(dec));
+                        if (d != 0U && bpu_wire_parse(dec, d, &f) == BPU_WIRE_OK) {
+                            rd->ok++;
+                        } else {
+                            rd->bad++;
+                        }
+                    }
+                    n = 0U;
+                } else {
+                    if (n < sizeof(acc)) {
+                        acc[n] = buf[i];
+                        n++;
+                    }
+                }
+                i++;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// One REC_LEN record every 10 us: far more than the engine can send
+static void *generator(void *arg)
+{
+    LinkGen *g;
+    uint8_t rec[REC_LEN];
+    unsigned k;
+
+    g = (LinkGen *)arg;
+    k = 0U;
+
+    while (__atomic_load_n(&g->stop, __ATOMIC_ACQUIRE) == 0) {
+        memset(rec, (int)(k & 0xFFU), sizeof(rec));
+        k++;
+        if (write(g->fd, rec, sizeof(rec)) < 0) {
+            sleep_us(10L);
+        }
+        sleep_us(10L);
+    }
+
+    return NULL;
+}
+
+// Watched pipe: every whole record becomes one CMD event
+static void on_input(void *ctx, int fd, uint32_t now_ms)
+{
+    static uint8_t rec[REC_LEN * 64U];
+    Bpu *bpu;
+    ssize_t r;
+    ssize_t o;
+
+    bpu = (Bpu *)ctx;
+    r = read(fd, rec, sizeof(rec));
+
+    o = 0;
+    while (o + (ssize_t)REC_LEN <= r) {
+        (void)bpu_push_event(bpu, BPU_EVT_CMD, &rec[o], (uint16_t)REC_LEN, now_ms);
+        o += (ssize_t)REC_LEN;
+    }
+}
+
+// Writer and reader ends of a socketpair or a raw pty pair
+static int open_link(const LinkCase *lc, int *wfd, int *rfd)
+{
+    struct termios t;
+    int sv[2];
+    int m;
+    int s;
+    int z;
+    int rc;
+
+    rc = BPU_RC_ERR;
+
+    if (lc->pty == 0) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0) {
+            if (lc->sndbuf != 0U) {
+                z = (int)lc->sndbuf;
+                (void)setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &z, sizeof(z));
+            }
+            *wfd = sv[0];
+            *rfd = sv[1];
+            rc = BPU_RC_OK;
+        }
+    } else {
+        m = posix_openpt(O_RDWR | O_NOCTTY);
+        if (m >= 0 && grantpt(m) == 0 && unlockpt(m) == 0) {
+            s = open(ptsname(m), O_RDWR | O_NOCTTY);
+            if (s >= 0) {
+                (void)tcgetattr(s, &t);
+                cfmakeraw(&t);
+                (void)tcsetattr(s, TCSANOW, &t);
+                (void)tcgetattr(m, &t);
+                cfmakeraw(&t);
+                (void)tcsetattr(m, TCSANOW, &t);
+                *wfd = s;
+                *rfd = m;
+                rc = BPU_RC_OK;
+            }
+        }
+    }
+
+    return rc;
+}
+
+static int run_case(const LinkCase *lc)
+{
+    static Bpu bpu;
+    BpuLinuxIo lx;
+    BpuLinuxLoop lp;
+    BpuConfig cfg;
+    BpuStats st;
+    BpuIo io;
+    LinkReader rd;
+    LinkGen gen;
+    pthread_t rt;
+    pthread_t gt;
+    uint32_t t0;
+    int gen_fd[2];
+    int wfd;
+    int rfd;
+    int rc;
+    int ok;
+
+    memset(&rd, 0, sizeof(rd));
+    memset(&gen, 0, sizeof(gen));
+    wfd = -1;
+    rfd = -1;
+
+    rc = open_link(lc, &wfd, &rfd);
+    if (rc == BPU_RC_OK && pipe(gen_fd) != 0) {
+        rc = BPU_RC_ERR;
+    }
+    // Neither helper thread may block once it is told to stop
+    if (rc == BPU_RC_OK && (fcntl(rfd, F_SETFL, O_NONBLOCK) != 0 || fcntl(gen_fd[1], F_SETFL, O_NONBLOCK) != 0)) {
+        rc = BPU_RC_ERR;
+    }
+    if (rc == BPU_RC_OK) {
+        rc = bpu_linux_io_open(&lx, wfd, 0U, &io);
+    }
+
+    if (rc == BPU_RC_OK) {
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.tx_budget_bytes = 4096U;
+        cfg.tx_min_free = 16U;
+        cfg.tx_chunk_max = 512U;
+        cfg.aged_ms = 100U;
+        cfg.enable_edf = 1U;
+
+        rc = bpu_init(&bpu, &io, &cfg);
+        rc |= bpu_register_type(&bpu, BPU_EVT_CMD, &T_CMD);
+        rc |= bpu_linux_loop_init(&lp, &bpu, &lx, lc->tick_ms);
+        rc |= bpu_linux_loop_watch(&lp, gen_fd[0], on_input, &bpu);
+    }
+
+    if (rc == BPU_RC_OK) {
+        rd.fd = rfd;
+        rd.stall_ms = lc->stall_ms;
+        gen.fd = gen_fd[1];
+        (void)pthread_create(&rt, NULL, reader, &rd);
+        (void)pthread_create(&gt, NULL, generator, &gen);
+
+        t0 = bpu_linux_now_ms();
+        while (bpu_linux_now_ms() - t0 < RUN_MS) {
+            (void)bpu_linux_loop_step(&lp, 100);
+        }
+
+        __atomic_store_n(&gen.stop, 1, __ATOMIC_RELEASE);
+        (void)pthread_join(gt, NULL);
+
+        // Let the reader drain what the kernel still holds
+        t0 = bpu_linux_now_ms();
+        while (__atomic_load_n(&rd.bytes, __ATOMIC_ACQUIRE) < lx.bytes && bpu_linux_now_ms() - t0 < 2000U) {
+            sleep_us(1000L);
+        }
+        __atomic_store_n(&rd.stop, 1, __ATOMIC_RELEASE);
+        (void)pthread_join(rt, NULL);
+
+        (void)bpu_get_stats(&bpu, &st);
+
+        ok = (rd.bad == 0UL && st.tx_frame_sent != 0U && rd.ok == (unsigned long)st.tx_frame_sent);
+        if (lc->stall_ms != 0U && lx.n_eagain == 0UL && st.tx_skip_backpressure == 0U) {
+            ok = 0;
+        }
+
+        printf("%-26s %4lu %9.0f %5lu %9.2f %6lu %8lu  %s\n", lc->name, (unsigned long)lc->tick_ms, (double)rd.ok * 1000.0 / (double)RUN_MS,
+               rd.bad, (double)(lx.n_write + lx.n_query) / (double)((rd.ok != 0UL) ? rd.ok : 1UL), lx.n_eagain,
+               (unsigned long)st.tx_skip_backpressure, (ok != 0) ? "ok" : "FAIL");
+
+        rc = (ok != 0) ? BPU_RC_OK : BPU_RC_ERR;
+
+        bpu_linux_loop_close(&lp);
+        (void)close(gen_fd[0]);
+        (void)close(gen_fd[1]);
+    } else {
+        printf("%-26s setup failed\n", lc->name);
+    }
+
+    if (wfd >= 0) {
+        (void)close(wfd);
+    }
+    if (rfd >= 0) {
+        (void)close(rfd);
+    }
+
+    return rc;
+}
+
+// Usage: bpu_test_linux_io
+int main(void)
+{
+    unsigned i;
+    int rc;
+
+    rc = 0;
+
+    printf("# %u ms per run, CMD events from a watched pipe\n", RUN_MS);
+    printf("%-26s %4s %9s %5s %9s %6s %8s\n", "link", "tick", "frames/s", "bad", "sys/frame", "EAGAIN", "skip_bp");
+
+    i = 0U;
+    while (i < CASE_COUNT) {
+        if (run_case(&CASES[i]) != BPU_RC_OK) {
+            rc = 1;
+        }
+        i++;
+    }
+
+    return rc;
+}
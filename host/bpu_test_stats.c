@@ -0,0 +1,238 @@
+// pthreads and sched_yield under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+// Engine API only; the engine itself is compiled from ../bpu_espidf.c
+#define BPU_ESPIDF_DECLARE_ONLY 1
+#include "../bpu_espidf.c"
+
+// Cross-thread stats snapshots. One writer thread pushes and ticks; after
+// each tick it keeps its own copy of the counters for that tick. Reader
+// threads call bpu_get_stats() without pause, and every snapshot must equal
+// the writer's copy for the tick it reports: a torn snapshot mixes two
+// ticks and matches neither. Readers that give up (BPU_RC_ERR while a
+// publish is in progress) are counted separately.
+//
+// bpu_test_stats -p: read Bpu.pub with a plain struct copy instead, to show
+// that the test does catch tearing (expect torn reads; exit status 0).
+
+#define TICKS 200000U
+#define READERS 3U
+#define SNAPS 4096U
+
+typedef struct {
+    size_t cap;
+    size_t fill;
+} StatsPort;
+
+typedef struct {
+    unsigned long reads;
+    unsigned long torn;
+    unsigned long busy;
+} ReaderResult;
+
+static Bpu g_bpu;
+static BpuStats *g_hist;
+static uint32_t g_hist_tick;
+static int g_done;
+static int g_plain;
+
+static int port_tx_free(void *ctx, size_t *free_out)
+{
+    StatsPort *u;
+
+    u = (StatsPort *)ctx;
+    *free_out = u->cap - u->fill;
+
+    return BPU_RC_OK;
+}
+
+static int port_tx_write_some(void *ctx, const uint8_t *p, size_t len, size_t *wrote_out)
+{
+    StatsPort *u;
+    size_t n;
+
+    (void)p;
+    u = (StatsPort *)ctx;
+    n = u->cap - u->fill;
+    if (len < n) {
+        n = len;
+    }
+    u->fill += n;
+    *wrote_out = n;
+
+    return BPU_RC_OK;
+}
+
+// Keyed SENSOR bursts and TELEM, a port that drains 150 B per tick
+static void *writer(void *arg)
+{
+    static const uint8_t p[8] = { 1U, 2U, 3U, 4U, 5U, 6U, 7U, 8U };
+    StatsPort *u;
+    uint32_t t;
+    uint32_t k;
+
+    u = (StatsPort *)arg;
+
+    t = 1U;
+    while (t <= TICKS) {
+        k = 0U;
+        while (k < t % 5U) {
+            (void)bpu_push_event_keyed(&g_bpu, BPU_EVT_SENSOR, (uint16_t)(t * 7U + k), p, 8U, t * 10U);
+            k++;
+        }
+        if (t % 3U == 0U) {
+            (void)bpu_push_event(&g_bpu, BPU_EVT_TELEM, p, 4U, t * 10U);
+        }
+
+        (void)bpu_tick(&g_bpu, t * 10U);
+        u->fill = (u->fill > 150U) ? u->fill - 150U : 0U;
+
+        g_hist[g_bpu.st.tick] = g_bpu.st;
+        __atomic_store_n(&g_hist_tick, g_bpu.st.tick, __ATOMIC_RELEASE);
+        t++;
+    }
+
+    __atomic_store_n(&g_done, 1, __ATOMIC_RELEASE);
+
+    return NULL;
+}
+
+// Compare a batch of snapshots once the writer has recorded their ticks
+static unsigned long check_batch(const BpuStats *snap, uint32_t n, uint32_t max_tick)
+{
+    unsigned long torn;
+    uint32_t i;
+
+    torn = 0UL;
+
+    while (__atomic_load_n(&g_hist_tick, __ATOMIC_ACQUIRE) < max_tick) {
+        sched_yield();
+    }
+
+    i = 0U;
+    while (i < n) {
+        if (memcmp(&snap[i], &g_hist[snap[i].tick], sizeof(BpuStats)) != 0) {
+            torn++;
+        }
+        i++;
+    }
+
+    return torn;
+}
+
+static void *reader(void *arg)
+{
+    ReaderResult *res;
+    BpuStats *snap;
+    uint32_t n;
+    uint32_t max_tick;
+    int rc;
+
+    res = (ReaderResult *)arg;
+    snap = (BpuStats *)malloc(SNAPS * sizeof(BpuStats));
+    n = 0U;
+    max_tick = 0U;
+
+    while (snap != NULL && __atomic_load_n(&g_done, __ATOMIC_ACQUIRE) == 0) {
+        if (g_plain != 0) {
+            snap[n] = g_bpu.pub;
+            rc = BPU_RC_OK;
+        } else {
+            rc = bpu_get_stats(&g_bpu, &snap[n]);
+        }
+
+        if (rc != BPU_RC_OK) {
+            res->busy++;
+            sched_yield();
+        } else {
+            res->reads++;
+            if (snap[n].tick > max_tick) {
+                max_tick = snap[n].tick;
+            }
+            n++;
+            if (n == SNAPS) {
+                res->torn += check_batch(snap, n, max_tick);
+                n = 0U;
+            }
+        }
+    }
+
+    if (snap != NULL) {
+        res->torn += check_batch(snap, n, max_tick);
+    } else {
+        res->torn++;
+    }
+    free(snap);
+
+    return NULL;
+}
+
+// Usage: bpu_test_stats [-p]
+int main(int argc, char **argv)
+{
+    static StatsPort port;
+    pthread_t w;
+    pthread_t r[READERS];
+    ReaderResult res[READERS];
+    BpuConfig cfg;
+    BpuIo io;
+    unsigned long torn;
+    unsigned i;
+    int rc;
+
+    g_plain = (argc > 1 && strcmp(argv[1], "-p") == 0) ? 1 : 0;
+    g_hist = (BpuStats *)calloc(TICKS + 2U, sizeof(BpuStats));
+    rc = (g_hist == NULL) ? 1 : 0;
+
+    port.cap = 512U;
+    port.fill = 0U;
+    io.ctx = &port;
+    io.tx_free = port_tx_free;
+    io.tx_write_some = port_tx_write_some;
+    io.time_us = NULL;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tx_budget_bytes = 120U;
+    cfg.tx_min_free = 16U;
+    cfg.tx_chunk_max = 64U;
+    cfg.enable_edf = 1U;
+
+    if (rc == 0) {
+        (void)bpu_init(&g_bpu, &io, &cfg);
+        g_hist[0] = g_bpu.st;
+        memset(res, 0, sizeof(res));
+
+        (void)pthread_create(&w, NULL, writer, &port);
+        i = 0U;
+        while (i < READERS) {
+            (void)pthread_create(&r[i], NULL, reader, &res[i]);
+            i++;
+        }
+
+        (void)pthread_join(w, NULL);
+        torn = 0UL;
+        i = 0U;
+        while (i < READERS) {
+            (void)pthread_join(r[i], NULL);
+            printf("%s reader %u: %lu reads, %lu torn, %lu busy\n", (g_plain != 0) ? "plain" : "seqlock", i, res[i].reads, res[i].torn,
+                   res[i].busy);
+            torn += res[i].torn;
+            i++;
+        }
+
+        if (g_plain == 0 && torn != 0UL) {
+            rc = 1;
+        }
+    }
+
+    free(g_hist);
+
+    return rc;
+}
@@ -0,0 +1,422 @@
+#include <string.h>
+
+#include "bpu_wire.h"
+
+// Same zero-scan kernels as the engine encoder (BPU_COBS_FAST=0: byte loop)
+#ifndef BPU_COBS_FAST
+#define BPU_COBS_FAST 1U
+#endif
+#if BPU_COBS_FAST && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
+
+#if BPU_COBS_FAST && (defined(__AVX2__) || defined(__SSE2__))
+// Index of the lowest set bit of a movemask (m must be non-zero)
+static unsigned wire_ctz32(uint32_t m)
+{
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctz(m);
+#else
+    unsigned n;
+
+    n = 0U;
+    while ((m & 1U) == 0U) {
+        m >>= 1;
+        n++;
+    }
+
+    return n;
+#endif
+}
+#endif
+
+// Index of the first zero byte in p[0..n), or n if there is none
+size_t bpu_wire_zero_scan(const uint8_t *p, size_t n)
+{
+    size_t i;
+#if BPU_COBS_FAST
+    int found;
+#endif
+
+    i = 0U;
+
+#if BPU_COBS_FAST
+    found = 0;
+
+#if defined(__AVX2__)
+    while (!found && i + 32U <= n) {
+        uint32_t m;
+
+        m = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(const void *)&p[i]), _mm256_setzero_si256()));
+        if (m != 0U) {
+            i += (size_t)wire_ctz32(m);
+            found = 1;
+        } else {
+            i += 32U;
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    while (!found && i + 16U <= n) {
+        uint32_t m;
+
+        m = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(const void *)&p[i]), _mm_setzero_si128()));
+        if (m != 0U) {
+            i += (size_t)wire_ctz32(m);
+            found = 1;
+        } else {
+            i += 16U;
+        }
+    }
+#endif
+    while (!found && i + 4U <= n) {
+        uint32_t w;
+
+        memcpy(&w, &p[i], 4U);
+        if (((w - 0x01010101U) & ~w & 0x80808080U) != 0U) {
+            found = 1;
+        } else {
+            i += 4U;
+        }
+    }
+#endif
+
+    while (i < n && p[i] != 0U) {
+        i++;
+    }
+
+    return i;
+}
+
+// Compute CRC16 over raw bytes
+uint16_t bpu_wire_crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc;
+    size_t i;
+
+    crc = 0xFFFFU;
+    i = 0U;
+
+    while (i < len) {
+        int b;
+
+        crc ^= (uint16_t)data[i] << 8;
+
+        b = 0;
+        while (b < 8) {
+            if ((crc & 0x8000U) != 0U) {
+                crc = (uint16_t)((crc << 1) ^ 0x1021U);
+            } else {
+                crc = (uint16_t)(crc << 1);
+            }
+            b++;
+        }
+
+        i++;
+    }
+
+    return crc;
+}
+
+// Compute CRC-8 (poly 0x07) over raw bytes
+uint8_t bpu_wire_crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc;
+    size_t i;
+
+    crc = 0x00U;
+    i = 0U;
+
+    while (i < len) {
+        int b;
+
+        crc ^= data[i];
+
+        b = 0;
+        while (b < 8) {
+            if ((crc & 0x80U) != 0U) {
+                crc = (uint8_t)((crc << 1) ^ 0x07U);
+            } else {
+                crc = (uint8_t)(crc << 1);
+            }
+            b++;
+        }
+
+        i++;
+    }
+
+    return crc;
+}
+
+// Undo COBS for one delimited block
+size_t bpu_wire_cobs_decode(const uint8_t *in, size_t n, uint8_t *out, size_t out_max)
+{
+    size_t r;
+    size_t w;
+    int rc;
+
+    r = 0U;
+    w = 0U;
+    rc = BPU_WIRE_OK;
+
+    while (r < n && rc == BPU_WIRE_OK) {
+        uint8_t code;
+        uint8_t k;
+
+        code = in[r];
+        r++;
+
+        if (code == 0U) {
+            rc = BPU_WIRE_ERR;
+        } else {
+            k = (uint8_t)(code - 1U);
+
+            // The whole run must be present, fit, and be free of zeros
+            if (n - r < (size_t)k || out_max - w < (size_t)k || bpu_wire_zero_scan(&in[r], (size_t)k) != (size_t)k) {
+                rc = BPU_WIRE_ERR;
+            } else {
+                memcpy(&out[w], &in[r], (size_t)k);
+                w += (size_t)k;
+                r += (size_t)k;
+            }
+
+            if (rc == BPU_WIRE_OK && code != 0xFFU && r < n) {
+                if (w >= out_max) {
+                    rc = BPU_WIRE_ERR;
+                } else {
+                    out[w] = 0U;
+                    w++;
+                }
+            }
+        }
+    }
+
+    if (rc != BPU_WIRE_OK) {
+        w = 0U;
+    }
+
+    return w;
+}
+
+// Validate a v1 frame: magic, length and CRC-16
+static int bpu_wire_parse_v1(const uint8_t *dec, size_t n, BpuWireFrame *f)
+{
+    int rc;
+    uint16_t crc;
+    size_t len;
+
+    rc = BPU_WIRE_OK;
+
+    if (n < 6U) {
+        rc = BPU_WIRE_ERR;
+    } else {
+        len = (size_t)dec[3];
+
+        if (n != 4U + len + 2U) {
+            rc = BPU_WIRE_ERR;
+        } else {
+            crc = bpu_wire_crc16(&dec[1], 3U + len);
+
+            if ((uint16_t)(dec[4U + len] | ((uint16_t)dec[5U + len] << 8)) != crc) {
+                rc = BPU_WIRE_ERR;
+            } else {
+                f->version = 1U;
+                f->type = dec[1];
+                f->seq = dec[2];
+                f->len = (uint16_t)len;
+                f->payload = &dec[4];
+            }
+        }
+    }
+
+    return rc;
+}
+
+// Validate a v2 frame: varint length and CRC-8/CRC-16 over the whole header
+static int bpu_wire_parse_v2(const uint8_t *dec, size_t n, BpuWireFrame *f)
+{
+    int rc;
+    uint32_t len;
+    size_t k;
+    size_t hdr;
+    size_t crc_n;
+    uint16_t crc;
+    uint16_t got;
+
+    rc = BPU_WIRE_OK;
+    len = 0U;
+    k = 0U;
+    crc_n = ((dec[0] & 0x20U) != 0U) ? 1U : 2U;
+
+    if (n < 3U + crc_n) {
+        rc = BPU_WIRE_ERR;
+    } else {
+        k = bpu_wire_varint(&dec[2], n - 2U, &len);
+    }
+
+    if (rc == BPU_WIRE_OK) {
+        hdr = 2U + k;
+
+        if (k == 0U || n != hdr + (size_t)len + crc_n || len > 0xFFFFU) {
+            rc = BPU_WIRE_ERR;
+        } else {
+            if (crc_n == 1U) {
+                crc = (uint16_t)bpu_wire_crc8(dec, hdr + len);
+                got = dec[hdr + len];
+            } else {
+                crc = bpu_wire_crc16(dec, hdr + len);
+                got = (uint16_t)(dec[hdr + len] | ((uint16_t)dec[hdr + len + 1U] << 8));
+            }
+
+            if (got != crc) {
+                rc = BPU_WIRE_ERR;
+            } else {
+                f->version = 2U;
+                f->type = (uint8_t)(dec[0] & 0x1FU);
+                f->seq = dec[1];
+                f->len = (uint16_t)len;
+                f->payload = &dec[hdr];
+            }
+        }
+    }
+
+    return rc;
+}
+
+// Dispatch on the first byte: 0xB2 = v1, 01xxxxxx = v2
+int bpu_wire_parse(const uint8_t *dec, size_t n, BpuWireFrame *f)
+{
+    int rc;
+
+    rc = BPU_WIRE_ERR;
+
+    if (dec != NULL && f != NULL && n != 0U) {
+        if (dec[0] == 0xB2U) {
+            rc = bpu_wire_parse_v1(dec, n, f);
+        } else {
+            if ((dec[0] & 0xC0U) == 0x40U) {
+                rc = bpu_wire_parse_v2(dec, n, f);
+            }
+        }
+    }
+
+    return rc;
+}
+
+// Read an unsigned LEB128 varint (at most 5 bytes)
+size_t bpu_wire_varint(const uint8_t *p, size_t n, uint32_t *v_out)
+{
+    size_t i;
+    uint32_t v;
+    int done;
+
+    i = 0U;
+    v = 0U;
+    done = 0;
+
+    while (!done && i < n && i < 5U) {
+        v |= (uint32_t)(p[i] & 0x7FU) << (7U * i);
+        if ((p[i] & 0x80U) == 0U) {
+            done = 1;
+        }
+        i++;
+    }
+
+    if (!done) {
+        i = 0U;
+    } else {
+        *v_out = v;
+    }
+
+    return i;
+}
+
+// Undo zigzag mapping
+static int32_t bpu_wire_unzigzag(uint32_t z)
+{
+    int32_t v;
+
+    if ((z & 1U) != 0U) {
+        v = -(int32_t)(z >> 1) - 1;
+    } else {
+        v = (int32_t)(z >> 1);
+    }
+
+    return v;
+}
+
+// Expand varint t0, zigzag v0, then (varint dt, zigzag dv) pairs
+int bpu_wire_batch_decode(const uint8_t *p, size_t n, BpuWireSample *out, size_t max, size_t *count_out)
+{
+    int rc;
+    size_t pos;
+    size_t cnt;
+    uint32_t t;
+    int32_t v;
+
+    rc = BPU_WIRE_OK;
+    pos = 0U;
+    cnt = 0U;
+    t = 0U;
+    v = 0;
+
+    while (pos < n && rc == BPU_WIRE_OK) {
+        uint32_t a;
+        uint32_t b;
+        size_t k1;
+        size_t k2;
+
+        k1 = bpu_wire_varint(&p[pos], n - pos, &a);
+        k2 = 0U;
+        if (k1 != 0U) {
+            k2 = bpu_wire_varint(&p[pos + k1], n - pos - k1, &b);
+        }
+
+        if (k1 == 0U || k2 == 0U || cnt >= max) {
+            rc = BPU_WIRE_ERR;
+        } else {
+            if (cnt == 0U) {
+                t = a;
+                v = bpu_wire_unzigzag(b);
+            } else {
+                t += a;
+                v = (int32_t)((uint32_t)v + (uint32_t)bpu_wire_unzigzag(b));
+            }
+
+            out[cnt].t_ms = t;
+            out[cnt].v = v;
+            cnt++;
+            pos += k1 + k2;
+        }
+    }
+
+    if (count_out != NULL) {
+        *count_out = cnt;
+    }
+
+    return rc;
+}
+
+// Split a bulk frame payload into header fields and data
+int bpu_wire_bulk_parse(const BpuWireFrame *f, BpuWireBulk *out)
+{
+    int rc;
+
+    rc = BPU_WIRE_OK;
+
+    if (f == NULL || out == NULL) {
+        rc = BPU_WIRE_ERR;
+    } else {
+        if (f->type != BPU_WIRE_TYPE_BULK || f->len < BPU_WIRE_BULK_HDR) {
+            rc = BPU_WIRE_ERR;
+        } else {
+            out->id = f->payload[0];
+            out->flags = f->payload[1];
+            out->off = (uint32_t)f->payload[2] | ((uint32_t)f->payload[3] << 8) | ((uint32_t)f->payload[4] << 16) | ((uint32_t)f->payload[5] << 24);
+            out->n = (uint16_t)(f->len - BPU_WIRE_BULK_HDR);
+            out->data = &f->payload[BPU_WIRE_BULK_HDR];
+        }
+    }
+
+    return rc;
+}
@@ -0,0 +1,75 @@
+#ifndef BPU_WIRE_H
+#define BPU_WIRE_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Host-side reference decoder for the BPU wire format
+// v1: 0x00 delimiter + COBS( [0xB2, type, seq, len, payload..., crc16] )
+// v2: 0x00 delimiter + COBS( [01 C TTTTT, seq, varint len, payload..., crc] )
+//     crc is CRC-8 (poly 0x07) when C is set, else CRC-16; both cover byte 0
+
+// Return codes (same values as the engine)
+#define BPU_WIRE_OK 0
+#define BPU_WIRE_ERR 1
+
+// Job payload tag for delta-encoded sensor batches
+#define BPU_WIRE_TAG_SENSOR_BATCH 0x05U
+
+// Bulk lane frames: type 6, payload [id, flags, offset u32 LE, data...]
+#define BPU_WIRE_TYPE_BULK 6U
+#define BPU_WIRE_BULK_HDR 6U
+#define BPU_WIRE_BULK_F_LAST 0x01U
+
+// Tokenised log records: type 7, payload [varint id, varint args...] (see bpu_logfmt.h)
+#define BPU_WIRE_TYPE_LOG 7U
+
+// Decoded frame (payload points into the caller's decode buffer)
+typedef struct {
+    uint8_t version;
+    uint8_t type;
+    uint8_t seq;
+    uint16_t len;
+    const uint8_t *payload;
+} BpuWireFrame;
+
+// One bulk fragment (data points into the frame payload)
+typedef struct {
+    uint8_t id;
+    uint8_t flags;
+    uint32_t off;
+    uint16_t n;
+    const uint8_t *data;
+} BpuWireBulk;
+
+// One sample of a sensor batch
+typedef struct {
+    uint32_t t_ms;
+    int32_t v;
+} BpuWireSample;
+
+// CRC16-CCITT as used by the engine
+uint16_t bpu_wire_crc16(const uint8_t *data, size_t len);
+
+// CRC-8 (poly 0x07) used by short v2 frames
+uint8_t bpu_wire_crc8(const uint8_t *data, size_t len);
+
+// Index of the first zero byte (frame delimiter) in p[0..n), or n if there is none
+size_t bpu_wire_zero_scan(const uint8_t *p, size_t n);
+
+// Decode one COBS block (without the 0x00 delimiter); returns decoded length, 0 on error
+size_t bpu_wire_cobs_decode(const uint8_t *in, size_t n, uint8_t *out, size_t out_max);
+
+// Check header and CRC of a decoded frame (v1 or v2)
+int bpu_wire_parse(const uint8_t *dec, size_t n, BpuWireFrame *f);
+
+// Read an unsigned LEB128 varint; returns bytes consumed, 0 on error
+size_t bpu_wire_varint(const uint8_t *p, size_t n, uint32_t *v_out);
+
+// Expand a sensor batch body (after tag and len) into samples
+int bpu_wire_batch_decode(const uint8_t *p, size_t n, BpuWireSample *out, size_t max, size_t *count_out);
+
+// Split a bulk frame payload into header fields and data
+int bpu_wire_bulk_parse(const BpuWireFrame *f, BpuWireBulk *out);
+
+#endif